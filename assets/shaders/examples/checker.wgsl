@@ -0,0 +1,9 @@
+@fragment
+fn main(@builtin(position) pos: vec4f) -> @location(0) vec4f {
+  let uv = pos.xy / mw.resolution.y;
+  let cell = floor(8.0 * uv + vec2f(mw.time, 0.0));
+  let parity = (cell.x + cell.y) - 2.0 * floor(0.5 * (cell.x + cell.y));
+  let color = mix(vec3f(0.1), vec3f(0.9), parity);
+
+  return vec4f(color, 1.0);
+}
@@ -0,0 +1,7 @@
+@fragment
+fn main(@builtin(position) pos: vec4f) -> @location(0) vec4f {
+  let uv = pos.xy / mw.resolution;
+  let color = 0.5 + 0.5 * cos(mw.time + uv.xyx + vec3f(0.0, 2.0, 4.0));
+
+  return vec4f(color, 1.0);
+}
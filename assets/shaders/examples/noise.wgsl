@@ -0,0 +1,51 @@
+// Compares the built-in noise texture with computing the same kind of noise from hashes.
+// Toggle USE_TEXTURE and watch the viewport's GPU time in the statistics panel
+override USE_TEXTURE: bool = true;
+override OCTAVES: u32 = 6;
+
+fn hash(p: vec3f) -> f32 {
+  var q = fract(p * 0.3183099 + 0.1);
+  q *= 17.0;
+  return fract(q.x * q.y * q.z * (q.x + q.y + q.z));
+}
+
+fn alu_value_noise(p: vec3f) -> f32 {
+  let cell = floor(p);
+  let f = p - cell;
+  let u = f * f * (3.0 - 2.0 * f);
+
+  return mix(
+      mix(mix(hash(cell), hash(cell + vec3f(1, 0, 0)), u.x),
+          mix(hash(cell + vec3f(0, 1, 0)), hash(cell + vec3f(1, 1, 0)), u.x), u.y),
+      mix(mix(hash(cell + vec3f(0, 0, 1)), hash(cell + vec3f(1, 0, 1)), u.x),
+          mix(hash(cell + vec3f(0, 1, 1)), hash(cell + vec3f(1, 1, 1)), u.x), u.y),
+      u.z);
+}
+
+fn noise(p: vec3f) -> f32 {
+  if (USE_TEXTURE) {
+    return mw_value_noise(p);
+  }
+
+  return alu_value_noise(p);
+}
+
+@fragment
+fn main(@builtin(position) pos: vec4f) -> @location(0) vec4f {
+  let uv = pos.xy / mw.resolution.y;
+  var p = vec3f(6.0 * uv, 0.2 * mw.time);
+
+  var value = 0.0;
+  var amplitude = 0.5;
+
+  for (var octave = 0u; octave < OCTAVES; octave++) {
+    value += amplitude * noise(p);
+    p *= 2.03;
+    amplitude *= 0.5;
+  }
+
+  let color = mix(vec3f(0.1, 0.15, 0.3), vec3f(0.9, 0.8, 0.6), value);
+
+  // Dithered, so gradients don't band in 8-bit output
+  return vec4f(color + (mw_blue_noise(pos.xy) - 0.5) / 255.0, 1.0);
+}
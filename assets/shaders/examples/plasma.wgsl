@@ -0,0 +1,15 @@
+@fragment
+fn main(@builtin(position) pos: vec4f) -> @location(0) vec4f {
+  let uv = pos.xy / mw.resolution.y;
+  let t = 0.5 * mw.time;
+
+  var value = sin(10.0 * uv.x + t);
+  value += sin(10.0 * (uv.x * sin(t / 2.0) + uv.y * cos(t / 3.0)) + t);
+
+  let center = uv + 0.5 * vec2f(sin(t / 5.0), cos(t / 3.0));
+  value += sin(sqrt(100.0 * dot(center, center) + 1.0) + t);
+
+  let color = vec3f(sin(3.14159 * value), sin(3.14159 * value + 2.0), sin(3.14159 * value + 4.0));
+
+  return vec4f(0.5 + 0.5 * color, 1.0);
+}
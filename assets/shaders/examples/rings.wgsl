@@ -0,0 +1,9 @@
+@fragment
+fn main(@builtin(position) pos: vec4f) -> @location(0) vec4f {
+  let uv = (2.0 * pos.xy - mw.resolution) / mw.resolution.y;
+  let dist = length(uv);
+  let rings = 0.5 + 0.5 * sin(24.0 * dist - 4.0 * mw.time);
+  let color = mix(vec3f(0.05, 0.05, 0.15), vec3f(0.95, 0.6, 0.3), rings * exp(-dist));
+
+  return vec4f(color, 1.0);
+}
@@ -0,0 +1,104 @@
+// Counts the viewport's pixels into the histogram, waveform and vectorscope. A fixed grid of
+// invocations strides over the texture, so the dispatch doesn't depend on its size. Histogram
+// bins are few and heavily contended, so each workgroup counts into shared memory first and
+// only adds its totals to the buffer.
+
+// Set when the texture has an sRGB format, whose loads are decoded. Scopes show encoded values
+override IS_SRGB: bool = false;
+
+const BINS = 256u;
+const WAVEFORM_WIDTH = 256u;
+const VECTORSCOPE_SIZE = 256u;
+const WORKGROUP_SIZE = 16u;
+
+// Must match the layout in scopes_draw.comp.wgsl
+struct Counts {
+  // Red, green, blue and luma, one after another
+  histogram: array<atomic<u32>, 1024>,
+  // Red, green and blue, each with one row per level and one column per slice of the width
+  waveform: array<atomic<u32>, 196608>,
+  vectorscope: array<atomic<u32>, 65536>,
+  // Highest count of each scope, for normalizing
+  histogram_max: atomic<u32>,
+  waveform_max: atomic<u32>,
+  vectorscope_max: atomic<u32>,
+}
+
+@group(0) @binding(0)
+var source_texture: texture_2d<f32>;
+
+@group(0) @binding(1)
+var<storage, read_write> counts: Counts;
+
+var<workgroup> local_histogram: array<atomic<u32>, 1024>;
+
+fn encode_srgb(linear: vec3f) -> vec3f {
+  let low = linear * 12.92;
+  let high = 1.055 * pow(linear, vec3f(1.0 / 2.4)) - 0.055;
+
+  return select(high, low, linear <= vec3f(0.0031308));
+}
+
+fn to_level(value: f32) -> u32 {
+  return u32(clamp(value, 0.0, 1.0) * f32(BINS - 1u) + 0.5);
+}
+
+fn add_waveform(channel: u32, column: u32, value: f32) {
+  let idx = (channel * BINS + to_level(value)) * WAVEFORM_WIDTH + column;
+  atomicMax(&counts.waveform_max, atomicAdd(&counts.waveform[idx], 1u) + 1u);
+}
+
+@compute @workgroup_size(16, 16)
+fn main(@builtin(global_invocation_id) global_id: vec3u,
+    @builtin(local_invocation_index) local_idx: u32,
+    @builtin(num_workgroups) workgroup_count: vec3u) {
+  for (var bin = local_idx; bin < 4u * BINS; bin += WORKGROUP_SIZE * WORKGROUP_SIZE) {
+    atomicStore(&local_histogram[bin], 0u);
+  }
+
+  workgroupBarrier();
+
+  let size = textureDimensions(source_texture);
+  let stride = workgroup_count.xy * WORKGROUP_SIZE;
+
+  for (var y = global_id.y; y < size.y; y += stride.y) {
+    for (var x = global_id.x; x < size.x; x += stride.x) {
+      var rgb = textureLoad(source_texture, vec2u(x, y), 0).rgb;
+
+      if (IS_SRGB) {
+        rgb = encode_srgb(rgb);
+      }
+
+      // Rec. 709, like the rest of the scopes
+      let luma = dot(rgb, vec3f(0.2126, 0.7152, 0.0722));
+
+      atomicAdd(&local_histogram[to_level(rgb.r)], 1u);
+      atomicAdd(&local_histogram[BINS + to_level(rgb.g)], 1u);
+      atomicAdd(&local_histogram[2u * BINS + to_level(rgb.b)], 1u);
+      atomicAdd(&local_histogram[3u * BINS + to_level(luma)], 1u);
+
+      let column = x * WAVEFORM_WIDTH / size.x;
+      add_waveform(0u, column, rgb.r);
+      add_waveform(1u, column, rgb.g);
+      add_waveform(2u, column, rgb.b);
+
+      // Blue and red color differences, both in [-0.5, 0.5], with red pointing up
+      let cb = (rgb.b - luma) / 1.8556;
+      let cr = (rgb.r - luma) / 1.5748;
+      let position = vec2u(clamp(vec2f(0.5 + cb, 0.5 - cr), vec2f(0.0), vec2f(1.0))
+          * f32(VECTORSCOPE_SIZE - 1u) + 0.5);
+      let vectorscope_idx = position.y * VECTORSCOPE_SIZE + position.x;
+      atomicMax(&counts.vectorscope_max, atomicAdd(&counts.vectorscope[vectorscope_idx], 1u) + 1u);
+    }
+  }
+
+  workgroupBarrier();
+
+  for (var bin = local_idx; bin < 4u * BINS; bin += WORKGROUP_SIZE * WORKGROUP_SIZE) {
+    let count = atomicLoad(&local_histogram[bin]);
+
+    if (count != 0u) {
+      atomicMax(&counts.histogram_max, atomicAdd(&counts.histogram[bin], count) + count);
+    }
+  }
+}
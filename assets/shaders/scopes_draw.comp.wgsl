@@ -0,0 +1,124 @@
+// Draws the counts gathered by scopes_accumulate.comp.wgsl into the textures the GUI displays,
+// one invocation per texel. The histogram is linear, while the waveform and vectorscope use a
+// logarithmic scale, so sparse traces stay visible next to dense ones.
+
+const BINS = 256u;
+const WAVEFORM_WIDTH = 256u;
+const VECTORSCOPE_SIZE = 256u;
+
+const BACKGROUND = vec3f(0.06);
+const GRATICULE = vec3f(0.22);
+
+// Must match the layout in scopes_accumulate.comp.wgsl
+struct Counts {
+  histogram: array<u32, 1024>,
+  waveform: array<u32, 196608>,
+  vectorscope: array<u32, 65536>,
+  histogram_max: u32,
+  waveform_max: u32,
+  vectorscope_max: u32,
+}
+
+@group(0) @binding(0)
+var<storage, read> counts: Counts;
+
+@group(0) @binding(1)
+var histogram_texture: texture_storage_2d<rgba8unorm, write>;
+
+@group(0) @binding(2)
+var waveform_texture: texture_storage_2d<rgba8unorm, write>;
+
+@group(0) @binding(3)
+var vectorscope_texture: texture_storage_2d<rgba8unorm, write>;
+
+fn log_scale(count: u32, max_count: u32) -> f32 {
+  return log2(1.0 + f32(count)) / log2(1.0 + f32(max(max_count, 1u)));
+}
+
+// Rows from the top of a texture, turned into the level they show, from 0 at the bottom to 1
+fn row_level(y: u32, height: u32) -> f32 {
+  return f32(height - 1u - y) / f32(height - 1u);
+}
+
+@compute @workgroup_size(8, 8)
+fn draw_histogram(@builtin(global_invocation_id) id: vec3u) {
+  let size = textureDimensions(histogram_texture);
+
+  if (any(id.xy >= size)) {
+    return;
+  }
+
+  let bin = id.x * BINS / size.x;
+  let level = row_level(id.y, size.y);
+  let max_count = f32(max(counts.histogram_max, 1u));
+
+  let heights = vec4f(f32(counts.histogram[bin]), f32(counts.histogram[BINS + bin]),
+      f32(counts.histogram[2u * BINS + bin]), f32(counts.histogram[3u * BINS + bin]))
+      / max_count;
+  let covered = vec4f(heights > vec4f(level));
+
+  // Luma is a gray fill behind the channels, which add up to white where they overlap
+  let color = max(BACKGROUND + 0.25 * covered.w, 0.8 * covered.rgb);
+  textureStore(histogram_texture, id.xy, vec4f(color, 1.0));
+}
+
+@compute @workgroup_size(8, 8)
+fn draw_waveform(@builtin(global_invocation_id) id: vec3u) {
+  let size = textureDimensions(waveform_texture);
+
+  if (any(id.xy >= size)) {
+    return;
+  }
+
+  let column = id.x * WAVEFORM_WIDTH / size.x;
+  let bin = u32(row_level(id.y, size.y) * f32(BINS - 1u) + 0.5);
+
+  var color = BACKGROUND;
+
+  // Lines at every 10%
+  if ((bin * 10u) % (BINS - 1u) < 10u) {
+    color = GRATICULE;
+  }
+
+  for (var channel = 0u; channel < 3u; channel++) {
+    let count = counts.waveform[(channel * BINS + bin) * WAVEFORM_WIDTH + column];
+    var channel_color = vec3f(0.0);
+    channel_color[channel] = 1.0;
+
+    color += channel_color * log_scale(count, counts.waveform_max);
+  }
+
+  textureStore(waveform_texture, id.xy, vec4f(min(color, vec3f(1.0)), 1.0));
+}
+
+@compute @workgroup_size(8, 8)
+fn draw_vectorscope(@builtin(global_invocation_id) id: vec3u) {
+  let size = textureDimensions(vectorscope_texture);
+
+  if (any(id.xy >= size)) {
+    return;
+  }
+
+  let position = id.xy * VECTORSCOPE_SIZE / size;
+  let count = counts.vectorscope[position.y * VECTORSCOPE_SIZE + position.x];
+
+  // Blue and red color differences at this texel, like the accumulate pass computes them
+  let uv = (vec2f(id.xy) + 0.5) / vec2f(size);
+  let cb = uv.x - 0.5;
+  let cr = 0.5 - uv.y;
+  let radius = length(vec2f(cb, cr));
+
+  var color = BACKGROUND;
+
+  // Outer circle at full saturation, inner at half, and the axes
+  if (abs(radius - 0.5) < 0.004 || abs(radius - 0.25) < 0.004 || min(abs(cb), abs(cr)) < 0.002) {
+    color = GRATICULE;
+  }
+
+  // Traces take the hue of where they are, at a fixed luma
+  let hue = clamp(vec3f(0.5 + 1.5748 * cr, 0.5 - 0.1873 * cb - 0.4681 * cr, 0.5 + 1.8556 * cb),
+      vec3f(0.0), vec3f(1.0));
+  color = mix(color, 0.3 + 0.7 * hue, log_scale(count, counts.vectorscope_max));
+
+  textureStore(vectorscope_texture, id.xy, vec4f(color, 1.0));
+}
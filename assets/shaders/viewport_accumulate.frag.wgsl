@@ -0,0 +1,32 @@
+// Blends the latest sample into the running average of every sample since the last reset.
+// Each one ends up weighted equally, so the history converges to the shader's expected value.
+
+struct Uniforms {
+  time: f32,
+  resolution: vec2f,
+  mouse: vec4f,
+  sample_count: u32,
+};
+
+@group(0) @binding(0)
+var sample_texture: texture_2d<f32>;
+
+@group(0) @binding(1)
+var history_texture: texture_2d<f32>;
+
+@group(0) @binding(2)
+var<uniform> mw: Uniforms;
+
+@fragment
+fn main(@builtin(position) position: vec4f) -> @location(0) vec4f {
+  let texel = vec2u(position.xy);
+  let new_sample = textureLoad(sample_texture, texel, 0);
+
+  // History is stale right after a reset, and must not leak into the first sample
+  if (mw.sample_count == 0u) {
+    return new_sample;
+  }
+
+  let history = textureLoad(history_texture, texel, 0);
+  return mix(history, new_sample, 1.0 / f32(mw.sample_count + 1u));
+}
@@ -0,0 +1,17 @@
+// Renders one mip level of the displayed texture from the level above it. Each destination
+// texel covers a 2×2 block of the source, and bilinear filtering at the block's center averages
+// it in one sample. Odd sizes drop their last row or column, which isn't visible at that scale.
+
+@group(0) @binding(0)
+var source_texture: texture_2d<f32>;
+
+@group(0) @binding(1)
+var source_sampler: sampler;
+
+@fragment
+fn main(@builtin(position) position: vec4f) -> @location(0) vec4f {
+  let destination_size = max(textureDimensions(source_texture) / 2u, vec2u(1u));
+  let uv = position.xy / vec2f(destination_size);
+
+  return textureSampleLevel(source_texture, source_sampler, uv, 0.0);
+}
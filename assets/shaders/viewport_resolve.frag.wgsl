@@ -0,0 +1,21 @@
+// Averages each SCALE×SCALE block of the render target into one displayed pixel. Texels are
+// loaded instead of sampled, because 32-bit float textures aren't filterable by default.
+
+override SCALE: u32 = 1;
+
+@group(0) @binding(0)
+var target_texture: texture_2d<f32>;
+
+@fragment
+fn main(@builtin(position) position: vec4f) -> @location(0) vec4f {
+  let origin = vec2u(position.xy) * SCALE;
+  var sum = vec4f(0.0);
+
+  for (var y = 0u; y < SCALE; y++) {
+    for (var x = 0u; x < SCALE; x++) {
+      sum += textureLoad(target_texture, origin + vec2u(x, y), 0);
+    }
+  }
+
+  return sum / f32(SCALE * SCALE);
+}
@@ -0,0 +1,57 @@
+#include "allocation.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <new>
+
+namespace mewo::allocation {
+
+/// Per thread, so job workers don't show up in the main thread's counts, and counting needs
+/// no synchronization.
+static thread_local uint64_t tls_count = 0;
+
+uint64_t thread_count() { return tls_count; }
+
+void* allocate(size_t size)
+{
+  ++tls_count;
+  return std::malloc(size);
+}
+
+void deallocate(void* ptr) { std::free(ptr); }
+
+CountingScope::CountingScope()
+    : start_(thread_count())
+{
+}
+
+uint64_t CountingScope::count() const { return thread_count() - start_; }
+
+}
+
+// Replaces the global allocation functions. The array and non-throwing forms call these, and
+// over-aligned allocations aren't made often enough to be worth counting.
+
+void* operator new(std::size_t size)
+{
+  // Zero-sized allocations still need a unique address
+  size = size == 0 ? 1 : size;
+  void* ptr = mewo::allocation::allocate(size);
+
+  while (ptr == nullptr) {
+    std::new_handler handler = std::get_new_handler();
+
+    if (handler == nullptr)
+      throw std::bad_alloc();
+
+    handler();
+    ptr = std::malloc(size);
+  }
+
+  return ptr;
+}
+
+void operator delete(void* ptr) noexcept { mewo::allocation::deallocate(ptr); }
+
+void operator delete(void* ptr, std::size_t) noexcept { mewo::allocation::deallocate(ptr); }
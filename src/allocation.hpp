@@ -0,0 +1,29 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+/// Counts heap allocations made on each thread. Every `operator new` in the program goes
+/// through here, and so does Dear ImGui. Used to keep the frame loop from allocating once it
+/// has warmed up, since allocations are slow and take locks shared with other threads.
+namespace mewo::allocation {
+
+/// Allocations made on the calling thread since it started.
+uint64_t thread_count();
+
+/// Counted replacements for `malloc` and `free`.
+void* allocate(size_t size);
+void deallocate(void* ptr);
+
+/// Counts the calling thread's allocations from construction on.
+class CountingScope {
+  public:
+  CountingScope();
+
+  uint64_t count() const;
+
+  private:
+  uint64_t start_ = 0;
+};
+
+}
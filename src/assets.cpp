@@ -1,6 +1,7 @@
 #include "assets.hpp"
 
 #include "exception.hpp"
+#include "fs.hpp"
 
 #include <SDL3/SDL.h>
 
@@ -8,48 +9,10 @@
 #include <filesystem>
 #include <print>
 
-#if defined(SDL_PLATFORM_MACOS)
-#include <mach-o/dyld.h>
-#include <vector>
-#elif defined(SDL_PLATFORM_WIN32)
-#include <windows.h>
-#endif
-
 namespace mewo {
 
-static std::filesystem::path get_executable_path()
-{
-  static constexpr size_t MAX_FILE_PATH_LENGTH = 1024;
-
-#if defined(SDL_PLATFORM_MACOS)
-  uint32_t buf_size = MAX_FILE_PATH_LENGTH;
-  std::vector<char> path_vec(buf_size);
-
-  if (_NSGetExecutablePath(path_vec.data(), &buf_size) == -1) {
-    path_vec.resize(buf_size);
-
-    // Resize and try again. If it fails again, then we're in big trouble
-    if (_NSGetExecutablePath(path_vec.data(), &buf_size) == -1)
-      throw Exception("Call to _NSGetExecutablePath failed: buffer size not large enough");
-  }
-
-  // `_NSGetExecutablePath` needs to be resolved
-  return std::filesystem::canonical(path_vec.data()).parent_path();
-#elif defined(SDL_PLATFORM_WIN32)
-  std::array<wchar_t, MAX_FILE_PATH_LENGTH> path_arr = {};
-
-  if (GetModuleFileNameW(nullptr, path_arr.data(), MAX_FILE_PATH_LENGTH) == 0)
-    throw Exception("Call to GetModuleFileNameW failed");
-
-  return std::filesystem::path(path_arr.data()).parent_path();
-#else
-#error "Unsupported platform. Supported platforms are macOS and Windows"
-  throw Exception("Unsupported platform. Supported platforms are macOS and Windows");
-#endif
-}
-
 Assets::Assets()
-    : executable_path_(get_executable_path())
+    : executable_path_(fs::get_executable_path().parent_path())
 {
   using namespace std::string_view_literals;
 
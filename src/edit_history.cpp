@@ -0,0 +1,174 @@
+#include "edit_history.hpp"
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <utility>
+
+namespace mewo {
+
+TextChange find_change(std::string_view from, std::string_view to)
+{
+  const size_t common_length = std::min(from.size(), to.size());
+  size_t prefix_length = 0;
+  size_t suffix_length = 0;
+
+  while (prefix_length < common_length && from[prefix_length] == to[prefix_length])
+    ++prefix_length;
+
+  while (suffix_length < common_length - prefix_length
+      && from[from.size() - 1 - suffix_length] == to[to.size() - 1 - suffix_length]) {
+    ++suffix_length;
+  }
+
+  return {
+    .offset = prefix_length,
+    .removed_length = from.size() - prefix_length - suffix_length,
+    .inserted_length = to.size() - prefix_length - suffix_length,
+  };
+}
+
+EditHistory::EditHistory(std::string_view text, size_t memory_cap)
+    : memory_cap_(memory_cap)
+{
+  reset(text);
+}
+
+const std::string& EditHistory::text() const { return text_; }
+
+size_t EditHistory::version_count() const { return versions_.size(); }
+
+size_t EditHistory::memory_usage() const { return memory_usage_; }
+
+bool EditHistory::can_undo() const { return current_ > 0; }
+
+bool EditHistory::can_redo() const { return current_ + 1 < versions_.size(); }
+
+std::optional<uint64_t> EditHistory::shader_key() const { return versions_[current_].shader_key; }
+
+void EditHistory::reset(std::string_view text)
+{
+  versions_.clear();
+  memory_usage_ = 0;
+  current_ = 0;
+  text_ = text;
+
+  add({ .text = std::string(text), .is_keyframe = true });
+}
+
+void EditHistory::push(std::string_view text)
+{
+  if (text == text_)
+    return;
+
+  // Undone versions can't be reached anymore
+  while (can_redo()) {
+    memory_usage_ -= get_memory_usage(versions_.back());
+    versions_.pop_back();
+  }
+
+  const TextChange change = find_change(text_, text);
+  const bool is_keyframe = current_ + 1 - find_keyframe(current_) >= KEYFRAME_INTERVAL
+      || change.inserted_length == text.size();
+
+  // Not linked until the new text itself is compiled
+  Version version;
+
+  if (is_keyframe) {
+    version.text = text;
+    version.is_keyframe = true;
+  } else {
+    version.text = text.substr(change.offset, change.inserted_length);
+    version.offset = change.offset;
+    version.removed_length = change.removed_length;
+  }
+
+  text_ = text;
+  add(std::move(version));
+  ++current_;
+
+  // Versions up to the current one's keyframe are needed to get back to it
+  while (memory_usage_ > memory_cap_ && find_keyframe(current_) > 0)
+    drop_oldest();
+}
+
+bool EditHistory::undo()
+{
+  if (!can_undo())
+    return false;
+
+  --current_;
+  text_ = reconstruct(current_);
+
+  return true;
+}
+
+bool EditHistory::redo()
+{
+  if (!can_redo())
+    return false;
+
+  const Version& next = versions_[++current_];
+
+  if (next.is_keyframe)
+    text_ = next.text;
+  else
+    text_.replace(next.offset, next.removed_length, next.text);
+
+  return true;
+}
+
+void EditHistory::set_shader_key(uint64_t key) { versions_[current_].shader_key = key; }
+
+size_t EditHistory::get_memory_usage(const Version& version)
+{
+  return sizeof(Version) + version.text.capacity();
+}
+
+size_t EditHistory::find_keyframe(size_t idx) const
+{
+  while (!versions_[idx].is_keyframe)
+    --idx;
+
+  return idx;
+}
+
+std::string EditHistory::reconstruct(size_t idx) const
+{
+  const size_t keyframe_idx = find_keyframe(idx);
+  std::string text = versions_[keyframe_idx].text;
+
+  for (size_t change_idx = keyframe_idx + 1; change_idx <= idx; ++change_idx) {
+    const Version& change = versions_[change_idx];
+    text.replace(change.offset, change.removed_length, change.text);
+  }
+
+  return text;
+}
+
+void EditHistory::add(Version version)
+{
+  memory_usage_ += get_memory_usage(version);
+  versions_.push_back(std::move(version));
+}
+
+void EditHistory::drop_oldest()
+{
+  // Changes after the oldest keyframe depend on it, so they're dropped along with it
+  size_t dropped_count = 1;
+
+  while (!versions_[dropped_count].is_keyframe)
+    ++dropped_count;
+
+  for (size_t idx = 0; idx < dropped_count; ++idx) {
+    memory_usage_ -= get_memory_usage(versions_.front());
+    versions_.pop_front();
+  }
+
+  current_ -= dropped_count;
+}
+
+}
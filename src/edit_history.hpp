@@ -0,0 +1,87 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <optional>
+#include <string>
+#include <string_view>
+
+namespace mewo {
+
+/// Range that differs between two versions of a text. Edits between versions are usually in
+/// one place, so a single range is enough to store them compactly.
+struct TextChange {
+  size_t offset = 0;
+  size_t removed_length = 0;
+  /// Length of what replaced the removed range, at the same offset in the newer text.
+  size_t inserted_length = 0;
+};
+
+/// Found by trimming what both texts start and end with.
+TextChange find_change(std::string_view from, std::string_view to);
+
+/// Every version of a text, for undo and redo. Versions are stored as the range that changed
+/// since the previous one, with the whole text kept every `KEYFRAME_INTERVAL` versions, so
+/// getting any version back never replays more than a few changes.
+///
+/// Once the history grows past its memory cap, the oldest versions are dropped a keyframe at a
+/// time. The current version is always kept.
+class EditHistory {
+  public:
+  static constexpr size_t KEYFRAME_INTERVAL = 32;
+  static constexpr size_t DEFAULT_MEMORY_CAP = 16 << 20;
+
+  explicit EditHistory(std::string_view text = {}, size_t memory_cap = DEFAULT_MEMORY_CAP);
+
+  /// Text of the current version.
+  const std::string& text() const;
+  size_t version_count() const;
+  /// Counts the stored changes and keyframes, along with their bookkeeping.
+  size_t memory_usage() const;
+  bool can_undo() const;
+  bool can_redo() const;
+  /// Cache key of the shader compiled from this version, if it compiled successfully.
+  std::optional<uint64_t> shader_key() const;
+
+  /// Starts over with a single version.
+  void reset(std::string_view text);
+  /// Adds a version after the current one, dropping any that were undone. Does nothing if
+  /// the text didn't change. The new version isn't linked to any shader yet.
+  void push(std::string_view text);
+  /// Moves to the previous version. Returns false if there isn't one.
+  bool undo();
+  /// Moves to the next version. Returns false if there isn't one.
+  bool redo();
+  void set_shader_key(uint64_t key);
+
+  private:
+  struct Version {
+    /// Whole text for keyframes. Otherwise, what replaced the removed range.
+    std::string text;
+    bool is_keyframe = false;
+    size_t offset = 0;
+    size_t removed_length = 0;
+    std::optional<uint64_t> shader_key;
+  };
+
+  static size_t get_memory_usage(const Version& version);
+
+  /// Index of the closest keyframe at or before the version.
+  size_t find_keyframe(size_t idx) const;
+  std::string reconstruct(size_t idx) const;
+  void add(Version version);
+  /// Drops the oldest keyframe and its changes. Only call if the current version's keyframe
+  /// is a later one.
+  void drop_oldest();
+
+  std::deque<Version> versions_;
+  size_t current_ = 0;
+  /// Text of the current version, so only undo has to reconstruct anything.
+  std::string text_;
+
+  size_t memory_usage_ = 0;
+  size_t memory_cap_ = 0;
+};
+
+}
@@ -1,23 +1,162 @@
 #include "editor.hpp"
 
 #include "fs.hpp"
+#include "hash.hpp"
+
+#include <chrono>
+#include <cstdint>
+#include <filesystem>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <utility>
 
 namespace mewo {
 
-Editor::Editor(const Assets& assets)
-    : prefix_(fs::read_file(assets.get("shaders/snippets/default_frag_prefix.txt")))
-    // TODO: when projects are added, it should load its fragment shader and not this default
-    , visible_code_(fs::read_wgsl_shader(assets.get("shaders/viewport.frag.wgsl")))
+static std::string get_prefix(const Assets& assets, const Project& project)
 {
+  if (auto snippet = project.snippet(Project::PREFIX_SNIPPET_NAME); snippet.has_value())
+    return std::string(snippet.value());
+
+  return fs::read_file(assets.get("shaders/snippets/default_frag_prefix.txt"));
+}
+
+Editor::Editor(const Assets& assets, const Project& project,
+    const std::optional<std::filesystem::path>& watch_path)
+    : prefix_(get_prefix(assets, project))
+{
+  if (watch_path.has_value()) {
+    // Start watching before reading, so a change in between isn't missed
+    watcher_.emplace(watch_path.value());
+    visible_code_ = fs::read_wgsl_shader(watch_path.value());
+  } else {
+    visible_code_ = project.source_code(project.active_source());
+  }
+
+  history_.reset(visible_code_);
 }
 
 std::string& Editor::visible_code() { return visible_code_; }
 
+const EditHistory& Editor::history() const { return history_; }
+
+uint64_t Editor::change_count() const { return change_count_; }
+
+bool Editor::is_watching() const { return watcher_.has_value(); }
+
 std::string Editor::combined_code() const
 {
   // TODO: cache combined code so function isn't allocating a new string
   //       every time it's called?
-  return prefix_ + "\n\n" + visible_code_;
+  return combined_code(visible_code_);
+}
+
+std::string Editor::combined_code(std::string_view code) const
+{
+  return prefix_ + "\n\n" + std::string(code);
+}
+
+void Editor::store(Project& project) const
+{
+  if (is_watching())
+    return;
+
+  project.set_source_code(project.active_source(), visible_code_);
+}
+
+void Editor::open_source(Project& project, size_t idx)
+{
+  store(project);
+  watcher_ = std::nullopt;
+  project.set_active_source(idx);
+  visible_code_ = project.source_code(idx);
+
+  history_.reset(visible_code_);
+  edited_at_ = std::nullopt;
+  ++change_count_;
+}
+
+std::optional<std::chrono::steady_clock::time_point> Editor::apply_external_change()
+{
+  if (!watcher_.has_value())
+    return std::nullopt;
+
+  auto change = watcher_->take_change();
+
+  // Editors often touch a file without changing it, which isn't worth recompiling for
+  if (!change.has_value() || change->contents == visible_code_)
+    return std::nullopt;
+
+  // Kept separate from edits before it, so it can be undone on its own
+  replace_code(std::move(change->contents));
+
+  return change->noticed_at;
+}
+
+void Editor::replace_code(std::string code)
+{
+  if (code == visible_code_)
+    return;
+
+  commit_edits();
+  visible_code_ = std::move(code);
+  history_.push(visible_code_);
+  ++change_count_;
+}
+
+void Editor::mark_edited() { edited_at_ = std::chrono::steady_clock::now(); }
+
+void Editor::commit_edits()
+{
+  if (!edited_at_.has_value())
+    return;
+
+  history_.push(visible_code_);
+  edited_at_ = std::nullopt;
+  ++change_count_;
+}
+
+void Editor::prepare_new_frame()
+{
+  if (edited_at_.has_value()
+      && std::chrono::steady_clock::now() - edited_at_.value() >= HISTORY_IDLE_TIME) {
+    commit_edits();
+  }
+}
+
+bool Editor::undo()
+{
+  // Edits that aren't in the history yet are what gets undone first
+  commit_edits();
+
+  if (!history_.undo())
+    return false;
+
+  visible_code_ = history_.text();
+  ++change_count_;
+
+  return true;
+}
+
+bool Editor::redo()
+{
+  // Editing after undoing drops the versions that could be redone
+  commit_edits();
+
+  if (!history_.redo())
+    return false;
+
+  visible_code_ = history_.text();
+  ++change_count_;
+
+  return true;
+}
+
+void Editor::link_shader(uint64_t module_key)
+{
+  // Module keys are hashes of the combined code they were compiled from
+  if (module_key == hash::fnv1a(combined_code(history_.text())))
+    history_.set_shader_key(module_key);
 }
 
 }
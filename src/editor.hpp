@@ -1,22 +1,81 @@
 #pragma once
 
 #include "assets.hpp"
+#include "edit_history.hpp"
+#include "file_watcher.hpp"
+#include "project.hpp"
 
+#include <chrono>
+#include <cstdint>
+#include <filesystem>
+#include <optional>
 #include <string>
+#include <string_view>
 
 namespace mewo {
 
 class Editor {
   public:
-  Editor(const Assets& assets);
+  /// Edits are grouped into one history version until typing pauses for this long.
+  static constexpr auto HISTORY_IDLE_TIME = std::chrono::milliseconds(500);
+
+  /// Opens the project's active source. The prefix is taken from the project too, falling
+  /// back to the default one if the project doesn't have it.
+  ///
+  /// If a file to watch is given, its contents are opened instead and reloaded whenever another
+  /// program changes it. The watched file isn't part of the project, so it's never stored into
+  /// the active source.
+  Editor(const Assets& assets, const Project& project,
+      const std::optional<std::filesystem::path>& watch_path);
 
   std::string& visible_code();
+  const EditHistory& history() const;
+  /// Incremented whenever the visible code changes, except while typing, where it's only
+  /// incremented once the edits are added to the history.
+  uint64_t change_count() const;
+  /// Until another source is opened, the visible code is the watched file's.
+  bool is_watching() const;
 
   std::string combined_code() const;
+  /// Prepends the same prefix to arbitrary code, e.g. shaders that aren't currently open.
+  std::string combined_code(std::string_view code) const;
+
+  /// Writes the visible code back into the project's active source. Does nothing while
+  /// watching.
+  void store(Project& project) const;
+  /// Stores the current source first, so switching back and forth doesn't lose edits. Stops
+  /// watching, since the visible code is then the project's again.
+  void open_source(Project& project, size_t idx);
+  /// Replaces the visible code if the watched file changed since the last call. Returns when
+  /// the change was first noticed, so the caller can measure how long it takes to show up.
+  std::optional<std::chrono::steady_clock::time_point> apply_external_change();
+
+  /// Replaces the visible code as an edit of its own, which can be undone separately. Does
+  /// nothing if the code is the same.
+  void replace_code(std::string code);
+  /// Call whenever the visible code is changed through `visible_code`.
+  void mark_edited();
+  /// Adds pending edits to the history right away, like before running the code.
+  void commit_edits();
+  /// Adds pending edits to the history once typing has paused.
+  void prepare_new_frame();
+  /// Replaces the visible code with the previous or next version in the history. Returns
+  /// false if there isn't one.
+  bool undo();
+  bool redo();
+  /// Links the current version to the module compiled from it. Modules compiled from other code,
+  /// like a version that was current when compiling started, are ignored.
+  void link_shader(uint64_t module_key);
 
   private:
   std::string prefix_;
   std::string visible_code_;
+  std::optional<fs::FileWatcher> watcher_;
+  /// Versions of the visible code. Starts over when another source is opened.
+  EditHistory history_;
+  /// Set while there are edits that aren't in the history yet.
+  std::optional<std::chrono::steady_clock::time_point> edited_at_;
+  uint64_t change_count_ = 0;
 };
 
 }
@@ -0,0 +1,176 @@
+#include "file_watcher.hpp"
+
+#include "exception.hpp"
+#include "fs.hpp"
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <exception>
+#include <filesystem>
+#include <mutex>
+#include <optional>
+#include <print>
+#include <string>
+#include <utility>
+
+#if defined(SDL_PLATFORM_LINUX)
+#include <cerrno>
+#include <poll.h>
+#include <sys/eventfd.h>
+#include <sys/inotify.h>
+#include <unistd.h>
+#endif
+
+namespace mewo::fs {
+
+FileWatcher::FileWatcher(const std::filesystem::path& file_path)
+    : file_path_(std::filesystem::weakly_canonical(file_path))
+{
+#if defined(SDL_PLATFORM_LINUX)
+  inotify_fd_ = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+
+  if (inotify_fd_ == -1)
+    throw Exception("Failed to initialize inotify");
+
+  // Many editors save by writing a temporary file and renaming it over the original, which
+  // replaces the inode. Watching the directory keeps working across that
+  auto dir_str = file_path_.parent_path().string();
+
+  if (inotify_add_watch(inotify_fd_, dir_str.c_str(), IN_CLOSE_WRITE | IN_MOVED_TO | IN_CREATE)
+      == -1) {
+    ::close(inotify_fd_);
+    throw Exception("Failed to watch \"{}\"", dir_str);
+  }
+
+  stop_fd_ = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+
+  if (stop_fd_ == -1) {
+    ::close(inotify_fd_);
+    throw Exception("Failed to create event for stopping the file watcher");
+  }
+
+  thread_ = std::thread(&FileWatcher::watch, this);
+#else
+  throw Exception("Cannot watch \"{}\", file watching is only supported on Linux",
+      file_path_.string());
+#endif
+}
+
+FileWatcher::~FileWatcher()
+{
+#if defined(SDL_PLATFORM_LINUX)
+  uint64_t stop = 1;
+
+  // Can only fail if the event's counter overflows, which a single write never does
+  [[maybe_unused]] ssize_t written = write(stop_fd_, &stop, sizeof(stop));
+  thread_.join();
+
+  ::close(stop_fd_);
+  ::close(inotify_fd_);
+#endif
+}
+
+const std::filesystem::path& FileWatcher::path() const { return file_path_; }
+
+std::optional<FileWatcher::Change> FileWatcher::take_change()
+{
+  std::scoped_lock lock(mutex_);
+  return std::exchange(change_, std::nullopt);
+}
+
+void FileWatcher::publish(std::chrono::steady_clock::time_point noticed_at)
+{
+  std::string contents;
+
+  // The file may have been deleted again by the time the burst ended
+  try {
+    contents = read_file(file_path_);
+  } catch (const std::exception& ex) {
+    std::println("Failed to read watched file. {}", ex.what());
+    return;
+  }
+
+  std::scoped_lock lock(mutex_);
+
+  if (change_.has_value())
+    noticed_at = std::min(noticed_at, change_->noticed_at);
+
+  change_ = Change { .contents = std::move(contents), .noticed_at = noticed_at };
+}
+
+#if defined(SDL_PLATFORM_LINUX)
+void FileWatcher::watch()
+{
+  using Clock = std::chrono::steady_clock;
+
+  std::array<pollfd, 2> poll_fds = { {
+      { .fd = inotify_fd_, .events = POLLIN, .revents = 0 },
+      { .fd = stop_fd_, .events = POLLIN, .revents = 0 },
+  } };
+
+  const auto file_name = file_path_.filename();
+  alignas(inotify_event) std::array<char, 4096> buffer;
+
+  std::optional<Clock::time_point> first_event;
+  Clock::time_point last_event;
+
+  while (true) {
+    // Sleep until something happens. While a burst is in progress, only sleep until the
+    // debounce window after its latest event closes
+    int timeout_ms = -1;
+
+    if (first_event.has_value()) {
+      auto remaining = std::chrono::ceil<std::chrono::milliseconds>(
+          last_event + DEBOUNCE_WINDOW - Clock::now());
+      timeout_ms = static_cast<int>(std::max<int64_t>(remaining.count(), 0));
+    }
+
+    int ready_count = poll(poll_fds.data(), poll_fds.size(), timeout_ms);
+
+    if (ready_count == -1) {
+      if (errno == EINTR)
+        continue;
+
+      std::println("Polling for file changes failed, no longer watching \"{}\"",
+          file_path_.string());
+      return;
+    }
+
+    if (poll_fds[1].revents & POLLIN)
+      return;
+
+    if (ready_count == 0) {
+      publish(first_event.value());
+      first_event = std::nullopt;
+      continue;
+    }
+
+    bool was_file_changed = false;
+    ssize_t read_size = 0;
+
+    // Drain every queued event, since other files in the same directory generate them too
+    while ((read_size = read(inotify_fd_, buffer.data(), buffer.size())) > 0) {
+      for (size_t offset = 0; offset < static_cast<size_t>(read_size);) {
+        const auto* event = reinterpret_cast<const inotify_event*>(buffer.data() + offset);
+
+        if (event->len > 0 && file_name == event->name)
+          was_file_changed = true;
+
+        offset += sizeof(inotify_event) + event->len;
+      }
+    }
+
+    if (!was_file_changed)
+      continue;
+
+    last_event = Clock::now();
+
+    if (!first_event.has_value())
+      first_event = last_event;
+  }
+}
+#endif
+
+}
@@ -0,0 +1,65 @@
+#pragma once
+
+#include <SDL3/SDL_platform.h>
+
+#include <chrono>
+#include <filesystem>
+#include <mutex>
+#include <optional>
+#include <string>
+
+#if defined(SDL_PLATFORM_LINUX)
+#include <thread>
+#endif
+
+namespace mewo::fs {
+
+/// Watches a single file for changes made by other programs, using inotify on a background
+/// thread. Bursts of events, like an editor truncating and then writing a file, are coalesced
+/// into one change once the file has been quiet for the debounce window.
+///
+/// Only supported on Linux. Constructing one elsewhere throws.
+class FileWatcher {
+  public:
+  static constexpr auto DEBOUNCE_WINDOW = std::chrono::milliseconds(30);
+
+  struct Change {
+    std::string contents;
+    /// When the first event of the coalesced burst was received.
+    std::chrono::steady_clock::time_point noticed_at;
+  };
+
+  explicit FileWatcher(const std::filesystem::path& file_path);
+  ~FileWatcher();
+
+  FileWatcher(const FileWatcher&) = delete;
+  FileWatcher& operator=(const FileWatcher&) = delete;
+
+  const std::filesystem::path& path() const;
+
+  /// Returns the latest contents if the file changed since the last call. Never touches the
+  /// filesystem, so it's cheap enough to call every frame.
+  std::optional<Change> take_change();
+
+  private:
+  /// Publishes the file's current contents, keeping the earliest time if the previous change
+  /// wasn't taken yet.
+  void publish(std::chrono::steady_clock::time_point noticed_at);
+
+  std::filesystem::path file_path_;
+
+  std::mutex mutex_;
+  std::optional<Change> change_;
+
+#if defined(SDL_PLATFORM_LINUX)
+  /// Body of the background thread. Returns once the stop event is signaled.
+  void watch();
+
+  int inotify_fd_ = -1;
+  /// Written to by the destructor so the background thread wakes up and exits.
+  int stop_fd_ = -1;
+  std::thread thread_;
+#endif
+};
+
+}
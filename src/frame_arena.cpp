@@ -0,0 +1,84 @@
+#include "frame_arena.hpp"
+
+#include "query.hpp"
+
+#include <algorithm>
+#include <bit>
+#include <cstddef>
+#include <memory>
+#include <memory_resource>
+#include <new>
+#include <print>
+#include <utility>
+
+namespace mewo {
+
+FrameArena::FrameArena(size_t capacity)
+    : buffer_(std::make_unique_for_overwrite<std::byte[]>(capacity))
+    , capacity_(capacity)
+{
+}
+
+FrameArena::~FrameArena() { release_overflow(); }
+
+size_t FrameArena::capacity() const { return capacity_; }
+
+size_t FrameArena::peak() const { return peak_; }
+
+void FrameArena::reset()
+{
+  const size_t used = offset_ + overflow_size_;
+  peak_ = std::max(peak_, used);
+
+  if (overflow_ != nullptr) {
+    release_overflow();
+
+    capacity_ = std::bit_ceil(used);
+    buffer_ = std::make_unique_for_overwrite<std::byte[]>(capacity_);
+
+    if constexpr (query::is_debug())
+      std::println("Frame arena grew to {} KiB", capacity_ / 1024);
+  }
+
+  offset_ = 0;
+  overflow_size_ = 0;
+}
+
+void* FrameArena::do_allocate(size_t bytes, size_t alignment)
+{
+  void* ptr = buffer_.get() + offset_;
+  size_t space = capacity_ - offset_;
+
+  if (std::align(alignment, bytes, ptr, space) != nullptr) {
+    offset_ = static_cast<size_t>(static_cast<std::byte*>(ptr) - buffer_.get()) + bytes;
+    return ptr;
+  }
+
+  // Header is padded, so the memory after it keeps the requested alignment
+  alignment = std::max(alignment, alignof(Overflow));
+  const size_t header_size = (sizeof(Overflow) + alignment - 1) / alignment * alignment;
+  const size_t size = header_size + bytes;
+
+  auto* block = static_cast<std::byte*>(::operator new(size, std::align_val_t(alignment)));
+  overflow_ = ::new (block) Overflow { .next = overflow_, .size = size, .alignment = alignment };
+  overflow_size_ += size;
+
+  return block + header_size;
+}
+
+void FrameArena::do_deallocate(void*, size_t, size_t) { }
+
+bool FrameArena::do_is_equal(const std::pmr::memory_resource& other) const noexcept
+{
+  return this == &other;
+}
+
+void FrameArena::release_overflow()
+{
+  while (overflow_ != nullptr) {
+    Overflow* block = std::exchange(overflow_, overflow_->next);
+    ::operator delete(block, block->size, std::align_val_t(block->alignment));
+  }
+}
+
+}
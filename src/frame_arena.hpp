@@ -0,0 +1,72 @@
+#pragma once
+
+#include <cstddef>
+#include <format>
+#include <memory>
+#include <memory_resource>
+
+namespace mewo {
+
+/// Bump allocator for data that only lives until the end of the frame, like text built for
+/// the GUI. Everything is released at once when the next frame starts, so allocating is a
+/// pointer increment and freeing does nothing. Works with `std::pmr` containers.
+///
+/// Frames needing more than its capacity get extra blocks from the heap. Once those are
+/// released, the capacity grows to fit the whole frame, so the heap is only touched until the
+/// largest frame has been seen.
+class FrameArena : public std::pmr::memory_resource {
+  public:
+  static constexpr size_t DEFAULT_CAPACITY = 64 * 1024;
+
+  explicit FrameArena(size_t capacity = DEFAULT_CAPACITY);
+  ~FrameArena() override;
+
+  FrameArena(const FrameArena&) = delete;
+  FrameArena& operator=(const FrameArena&) = delete;
+
+  size_t capacity() const;
+  /// Most bytes used by a single frame so far.
+  size_t peak() const;
+
+  /// Invalidates everything allocated since the previous reset.
+  void reset();
+
+  /// Null-terminated, so it can be passed straight to ImGui.
+  template <typename... Args>
+  const char* format(std::format_string<Args...> fmt, Args&&... args);
+
+  private:
+  /// Header of a block taken from the heap, in front of the memory handed out.
+  struct Overflow {
+    Overflow* next = nullptr;
+    size_t size = 0;
+    size_t alignment = 0;
+  };
+
+  void* do_allocate(size_t bytes, size_t alignment) override;
+  void do_deallocate(void* ptr, size_t bytes, size_t alignment) override;
+  bool do_is_equal(const std::pmr::memory_resource& other) const noexcept override;
+
+  void release_overflow();
+
+  std::unique_ptr<std::byte[]> buffer_;
+  size_t capacity_ = 0;
+  size_t offset_ = 0;
+  size_t peak_ = 0;
+
+  Overflow* overflow_ = nullptr;
+  size_t overflow_size_ = 0;
+};
+
+template <typename... Args>
+const char* FrameArena::format(std::format_string<Args...> fmt, Args&&... args)
+{
+  const size_t size = std::formatted_size(fmt, args...);
+  auto* text = static_cast<char*>(allocate(size + 1, alignof(char)));
+
+  *std::format_to_n(text, static_cast<std::ptrdiff_t>(size), fmt, args...).out = '\0';
+
+  return text;
+}
+
+}
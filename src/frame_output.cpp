@@ -0,0 +1,315 @@
+#include "frame_output.hpp"
+
+#include "gfx/create.hpp"
+#include "metrics.hpp"
+#include "query.hpp"
+#include "shared_memory.hpp"
+
+#include <webgpu/webgpu_cpp.h>
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <exception>
+#include <format>
+#include <new>
+#include <optional>
+#include <print>
+#include <string>
+#include <string_view>
+#include <utility>
+
+namespace mewo::frame_output {
+
+/// Rows copied from a texture into a buffer have to be aligned to this many bytes.
+static constexpr uint32_t COPY_BYTES_PER_ROW_ALIGNMENT = 256;
+
+static Format get_format(wgpu::TextureFormat format)
+{
+  // clang-format off
+  switch (format) {
+  case wgpu::TextureFormat::RGBA8Unorm: return Format::RGBA8Unorm;
+  case wgpu::TextureFormat::RGBA8UnormSrgb: return Format::RGBA8UnormSrgb;
+  case wgpu::TextureFormat::BGRA8Unorm: return Format::BGRA8Unorm;
+  case wgpu::TextureFormat::BGRA8UnormSrgb: return Format::BGRA8UnormSrgb;
+  default: return Format::Unknown;
+  }
+  // clang-format on
+}
+
+std::string get_shared_memory_name(uint32_t process_id)
+{
+  return std::format("mewo-frames-{}", process_id);
+}
+
+Publisher::Publisher(const gfx::Renderer& renderer)
+    : renderer_(renderer)
+{
+  const std::string name = get_shared_memory_name(ipc::get_process_id());
+
+  try {
+    memory_ = ipc::SharedMemory::create(name, REGION_SIZE);
+  } catch (const std::exception& ex) {
+    std::println("Frames won't be published. {}", ex.what());
+    return;
+  }
+
+  std::println("Frames are published to shared memory \"{}\"", name);
+
+  // Begins the lifetime of the atomics inside the zeroed region
+  Header* header = new (memory_.data()) Header();
+
+  header->version = SCHEMA_VERSION;
+  header->slot_count = SLOT_COUNT;
+  header->pixels_offset = PIXELS_OFFSET;
+  header->slot_size = SLOT_SIZE;
+
+  // Written last, so consumers that check it see a fully initialized header
+  std::atomic_ref(header->magic).store(MAGIC, std::memory_order_release);
+
+  create_slot_buffers();
+}
+
+Publisher::~Publisher()
+{
+  if (!is_reading_back_ || !slot_buffers_[0])
+    return;
+
+  renderer_.instance().WaitAny(renderer_.queue().OnSubmittedWorkDone(
+                                   wgpu::CallbackMode::WaitAnyOnly,
+                                   [](wgpu::QueueWorkDoneStatus, wgpu::StringView) {}),
+      gfx::Renderer::WAIT_TIMEOUT_MAX);
+
+  for (wgpu::Buffer& slot_buffer : slot_buffers_)
+    slot_buffer.Destroy();
+}
+
+bool Publisher::is_reader_attached() const
+{
+  if (!memory_.is_open())
+    return false;
+
+  uint64_t heartbeat_ns = header()->reader_heartbeat_ns.load(std::memory_order_relaxed);
+  auto timeout_ns = std::chrono::duration_cast<std::chrono::nanoseconds>(READER_TIMEOUT);
+
+  return heartbeat_ns != 0
+      && metrics::get_now_ns() - heartbeat_ns < static_cast<uint64_t>(timeout_ns.count());
+}
+
+void Publisher::record(
+    const gfx::FrameContext& frame_ctx, const wgpu::Texture& texture, uint64_t frame_index)
+{
+  // Skipping while the previous frame is still in flight is what bounds the latency
+  if (is_reading_back_ || is_checking_slot_buffers_ || !is_reader_attached())
+    return;
+
+  const uint32_t width = texture.GetWidth();
+  const uint32_t height = texture.GetHeight();
+  const Format format = get_format(texture.GetFormat());
+
+  if (width > MAX_FRAME_WIDTH || height > MAX_FRAME_HEIGHT || format == Format::Unknown)
+    return;
+
+  const uint32_t bytes_per_row
+      = (width * BYTES_PER_PIXEL + COPY_BYTES_PER_ROW_ALIGNMENT - 1)
+      / COPY_BYTES_PER_ROW_ALIGNMENT * COPY_BYTES_PER_ROW_ALIGNMENT;
+
+  PendingFrame frame = {
+    .publish_idx = header()->publish_count.load(std::memory_order_relaxed),
+    .info = {
+        .frame_index = frame_index,
+        .rendered_at_ns = metrics::get_now_ns(),
+        .width = width,
+        .height = height,
+        .bytes_per_row = bytes_per_row,
+        .format = format,
+    },
+  };
+
+  const wgpu::Buffer* destination = &slot_buffers_[frame.publish_idx % SLOT_COUNT];
+
+  if (*destination) {
+    // Consumers may still be reading an older frame from this slot, and the GPU starts
+    // overwriting it as soon as the frame is submitted
+    begin_write(frame);
+  } else {
+    uint64_t size = uint64_t { bytes_per_row } * height;
+
+    if (!staging_buf_.get() || staging_buf_.get().GetSize() != size) {
+      wgpu::BufferDescriptor staging_buf_desc = {
+        .label = "frame-output-staging-buffer",
+        .usage = wgpu::BufferUsage::MapRead | wgpu::BufferUsage::CopyDst,
+        .size = size,
+      };
+
+      staging_buf_ = gfx::create::buffer(
+          renderer_, staging_buf_desc, gfx::MemoryTracker::Category::Readback);
+    }
+
+    destination = &staging_buf_.get();
+  }
+
+  const wgpu::TexelCopyTextureInfo source_copy = { .texture = texture };
+
+  const wgpu::TexelCopyBufferInfo destination_copy = {
+    .layout = { .bytesPerRow = bytes_per_row, .rowsPerImage = height },
+    .buffer = *destination,
+  };
+
+  const wgpu::Extent3D extent = { .width = width, .height = height };
+
+  frame_ctx.encoder.CopyTextureToBuffer(&source_copy, &destination_copy, &extent);
+
+  recorded_ = frame;
+}
+
+void Publisher::watch_submitted()
+{
+  if (!recorded_.has_value())
+    return;
+
+  const PendingFrame frame = std::exchange(recorded_, std::nullopt).value();
+  is_reading_back_ = true;
+
+  // Callbacks are invoked during `wgpu::Instance::ProcessEvents` in the main loop
+  if (slot_buffers_[frame.publish_idx % SLOT_COUNT]) {
+    renderer_.queue().OnSubmittedWorkDone(wgpu::CallbackMode::AllowProcessEvents,
+        [this, frame](wgpu::QueueWorkDoneStatus status, wgpu::StringView message) {
+          // Also invoked when the instance is destroyed, at which point `this` may be gone
+          if (status == wgpu::QueueWorkDoneStatus::CallbackCancelled)
+            return;
+
+          is_reading_back_ = false;
+
+          // Leaves the slot marked as being written, so consumers skip it
+          if (status != wgpu::QueueWorkDoneStatus::Success) {
+            std::println("Failed to read back frame: {}", std::string_view(message));
+            return;
+          }
+
+          finish_write(frame);
+        });
+
+    return;
+  }
+
+  const wgpu::Buffer& staging_buf = staging_buf_;
+  const size_t size = size_t { frame.info.bytes_per_row } * frame.info.height;
+
+  staging_buf.MapAsync(wgpu::MapMode::Read, 0, size, wgpu::CallbackMode::AllowProcessEvents,
+      [this, staging_buf, frame, size](wgpu::MapAsyncStatus status, wgpu::StringView message) {
+        // Also invoked when the instance is destroyed, at which point `this` may be gone
+        if (status == wgpu::MapAsyncStatus::CallbackCancelled)
+          return;
+
+        is_reading_back_ = false;
+
+        if (status != wgpu::MapAsyncStatus::Success) {
+          std::println("Failed to read back frame: {}", std::string_view(message));
+          return;
+        }
+
+        begin_write(frame);
+        std::memcpy(slot_pixels(frame.publish_idx % SLOT_COUNT),
+            staging_buf.GetConstMappedRange(0, size), size);
+        finish_write(frame);
+
+        staging_buf.Unmap();
+      });
+}
+
+Header* Publisher::header() const
+{
+  return std::launder(reinterpret_cast<Header*>(memory_.data()));
+}
+
+std::byte* Publisher::slot_pixels(size_t slot) const
+{
+  return memory_.data() + PIXELS_OFFSET + slot * SLOT_SIZE;
+}
+
+void Publisher::create_slot_buffers()
+{
+  const wgpu::Device& device = renderer_.device();
+
+  if (!device.HasFeature(wgpu::FeatureName::HostMappedPointer))
+    return;
+
+  wgpu::DawnHostMappedPointerLimits host_mapped_limits = {};
+  wgpu::Limits limits = { .nextInChain = &host_mapped_limits };
+
+  if (device.GetLimits(&limits) != wgpu::Status::Success)
+    return;
+
+  const uint32_t alignment = host_mapped_limits.hostMappedPointerAlignment;
+
+  if (alignment == 0 || alignment == wgpu::kLimitU32Undefined || PIXEL_ALIGNMENT % alignment != 0)
+    return;
+
+  // The driver decides whether it can import shared memory, so errors are captured and the
+  // staging buffer is used instead if it can't
+  device.PushErrorScope(wgpu::ErrorFilter::Validation);
+
+  for (size_t slot = 0; slot < SLOT_COUNT; ++slot) {
+    wgpu::BufferHostMappedPointer host_mapped_pointer = { {
+        .pointer = slot_pixels(slot),
+        // The memory belongs to the shared region, which outlives the buffer
+        .disposeCallback = [](void*) {},
+    } };
+
+    wgpu::BufferDescriptor slot_buf_desc = {
+      .nextInChain = &host_mapped_pointer,
+      .label = "frame-output-slot-buffer",
+      .usage = wgpu::BufferUsage::CopyDst,
+      .size = SLOT_SIZE,
+    };
+
+    // Not counted by the memory tracker, since the memory is shared with the host
+    slot_buffers_[slot] = device.CreateBuffer(&slot_buf_desc);
+  }
+
+  is_checking_slot_buffers_ = true;
+
+  device.PopErrorScope(wgpu::CallbackMode::AllowProcessEvents,
+      [this](wgpu::PopErrorScopeStatus status, wgpu::ErrorType type, wgpu::StringView message) {
+        if (status == wgpu::PopErrorScopeStatus::CallbackCancelled)
+          return;
+
+        is_checking_slot_buffers_ = false;
+
+        if (status == wgpu::PopErrorScopeStatus::Success && type == wgpu::ErrorType::NoError) {
+          if constexpr (query::is_debug())
+            std::println("Frames are read back straight into shared memory");
+
+          return;
+        }
+
+        std::println("Frames will be read back through a staging buffer: {}",
+            std::string_view(message));
+        slot_buffers_ = {};
+      });
+}
+
+void Publisher::begin_write(const PendingFrame& frame)
+{
+  SlotHeader& slot = header()->slots[frame.publish_idx % SLOT_COUNT];
+
+  // Odd while writing. The fence keeps the frame's stores from becoming visible before it
+  slot.sequence.store(get_written_sequence(frame.publish_idx) - 1, std::memory_order_relaxed);
+  std::atomic_thread_fence(std::memory_order_release);
+}
+
+void Publisher::finish_write(const PendingFrame& frame)
+{
+  Header* header = this->header();
+  SlotHeader& slot = header->slots[frame.publish_idx % SLOT_COUNT];
+
+  slot.info = frame.info;
+
+  slot.sequence.store(get_written_sequence(frame.publish_idx), std::memory_order_release);
+  header->publish_count.store(frame.publish_idx + 1, std::memory_order_release);
+}
+
+}
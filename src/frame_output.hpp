@@ -0,0 +1,153 @@
+#pragma once
+
+#include "gfx/frame_context.hpp"
+#include "gfx/memory_tracker.hpp"
+#include "gfx/renderer.hpp"
+#include "shared_memory.hpp"
+
+#include <webgpu/webgpu_cpp.h>
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <type_traits>
+
+/// Viewport frames published to other processes on the same machine, like compositors, through
+/// a shared memory ring. The layout below is the schema, versioned the same way as metrics.
+///
+/// Each slot is guarded by a sequence number, which is odd while its frame is being written.
+/// Consumers read the newest slot in place, and check that its sequence is the same before and
+/// after they're done with it. If it isn't, the frame was overwritten and should be dropped.
+namespace mewo::frame_output {
+
+/// "MEWOFRMS" in little-endian.
+inline constexpr uint64_t MAGIC = 0x534D52464F57454D;
+inline constexpr uint32_t SCHEMA_VERSION = 1;
+/// One being written, one being read, and one spare so consumers have a full frame to finish.
+inline constexpr uint32_t SLOT_COUNT = 3;
+/// Frames larger than the viewport's biggest fixed resolution aren't published.
+inline constexpr uint32_t MAX_FRAME_WIDTH = 2048;
+inline constexpr uint32_t MAX_FRAME_HEIGHT = 2048;
+inline constexpr uint32_t BYTES_PER_PIXEL = 4;
+/// Pixels of each slot start at a multiple of this, which satisfies any alignment the GPU
+/// needs to write into them directly.
+inline constexpr size_t PIXEL_ALIGNMENT = 64 * 1024;
+/// Publishing stops when no consumer has refreshed its heartbeat for this long.
+inline constexpr std::chrono::seconds READER_TIMEOUT { 2 };
+
+/// Stable values, independent of WebGPU's own enum.
+enum class Format : uint32_t {
+  Unknown,
+  RGBA8Unorm,
+  RGBA8UnormSrgb,
+  BGRA8Unorm,
+  BGRA8UnormSrgb,
+};
+
+struct FrameInfo {
+  uint64_t frame_index = 0;
+  /// From the steady clock, taken when the frame was recorded.
+  uint64_t rendered_at_ns = 0;
+  uint32_t width = 0;
+  uint32_t height = 0;
+  /// Rows are padded to a multiple of 256 bytes, as required by the GPU copy.
+  uint32_t bytes_per_row = 0;
+  Format format = Format::Unknown;
+};
+
+static_assert(sizeof(FrameInfo) == 32 && std::is_trivially_copyable_v<FrameInfo>);
+
+struct SlotHeader {
+  std::atomic<uint64_t> sequence = 0;
+  FrameInfo info;
+};
+
+struct alignas(64) Header {
+  uint64_t magic = 0;
+  uint32_t version = 0;
+  uint32_t slot_count = 0;
+  /// Offset of the first slot's pixels from the start of the region.
+  uint64_t pixels_offset = 0;
+  /// Distance between the pixels of consecutive slots.
+  uint64_t slot_size = 0;
+  /// Frames published since launch. The newest is in slot `(publish_count - 1) % slot_count`.
+  std::atomic<uint64_t> publish_count = 0;
+  /// Steady clock time of the last time a consumer checked in.
+  std::atomic<uint64_t> reader_heartbeat_ns = 0;
+  std::array<SlotHeader, SLOT_COUNT> slots;
+};
+
+static_assert(std::is_standard_layout_v<Header>);
+
+/// Largest padded frame, and therefore the size of each slot's pixels.
+inline constexpr size_t SLOT_SIZE
+    = size_t { MAX_FRAME_WIDTH } * BYTES_PER_PIXEL * MAX_FRAME_HEIGHT;
+inline constexpr size_t PIXELS_OFFSET = PIXEL_ALIGNMENT;
+inline constexpr size_t REGION_SIZE = PIXELS_OFFSET + SLOT_COUNT * SLOT_SIZE;
+
+static_assert(sizeof(Header) <= PIXELS_OFFSET && SLOT_SIZE % PIXEL_ALIGNMENT == 0);
+
+/// Named after the publishing process, like metrics.
+std::string get_shared_memory_name(uint32_t process_id);
+
+/// Sequence number a slot has once the frame with the given publish index is fully written.
+constexpr uint64_t get_written_sequence(uint64_t publish_idx) { return 2 * publish_idx + 2; }
+
+/// Copies the viewport into the shared ring while a consumer is attached. Only one readback is
+/// ever in flight, and frames are skipped rather than queued while it is, so consumers are never
+/// more than a frame behind and the render loop never waits on the GPU or on consumers.
+///
+/// If the device can wrap host memory in a buffer, the GPU copies straight into the slot.
+/// Otherwise the frame goes through a mapped readback buffer, costing one more copy on the CPU.
+class Publisher {
+  public:
+  explicit Publisher(const gfx::Renderer& renderer);
+  /// Waits for a copy into the shared region that's still in flight, since the GPU may be
+  /// writing straight into it.
+  ~Publisher();
+
+  Publisher(const Publisher&) = delete;
+  Publisher& operator=(const Publisher&) = delete;
+
+  bool is_reader_attached() const;
+
+  /// Copies the texture into the next slot, unless no consumer is attached, the previous
+  /// readback hasn't finished, or the texture is too large. Texture must allow `CopySrc`.
+  void record(const gfx::FrameContext& frame_ctx, const wgpu::Texture& texture,
+      uint64_t frame_index);
+  /// Starts waiting for the copy recorded this frame. Call after the frame is submitted.
+  void watch_submitted();
+
+  private:
+  struct PendingFrame {
+    uint64_t publish_idx = 0;
+    FrameInfo info;
+  };
+
+  Header* header() const;
+  std::byte* slot_pixels(size_t slot) const;
+
+  /// Wraps each slot in a buffer if the device supports it. Checked asynchronously, since the
+  /// driver may still refuse shared memory.
+  void create_slot_buffers();
+  void begin_write(const PendingFrame& frame);
+  void finish_write(const PendingFrame& frame);
+
+  const gfx::Renderer& renderer_;
+  ipc::SharedMemory memory_;
+
+  /// Empty if host memory can't be wrapped, in which case the staging buffer is used.
+  std::array<wgpu::Buffer, SLOT_COUNT> slot_buffers_;
+  bool is_checking_slot_buffers_ = false;
+  gfx::Tracked<wgpu::Buffer> staging_buf_;
+
+  /// Recorded this frame, and not yet watched.
+  std::optional<PendingFrame> recorded_;
+  bool is_reading_back_ = false;
+};
+
+}
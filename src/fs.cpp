@@ -2,15 +2,36 @@
 
 #include "exception.hpp"
 
+#include <SDL3/SDL.h>
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
 #include <filesystem>
 #include <fstream>
+#include <functional>
 #include <ios>
 #include <string>
 #include <string_view>
+#include <system_error>
+
+#if defined(SDL_PLATFORM_MACOS)
+#include <mach-o/dyld.h>
+#include <vector>
+#elif defined(SDL_PLATFORM_WIN32)
+#include <io.h>
+#include <windows.h>
+#endif
+
+#if !defined(SDL_PLATFORM_WIN32)
+#include <unistd.h>
+#endif
 
 namespace mewo::fs {
 
 static constexpr std::string_view WGSL_FILE_EXTENSION = ".wgsl";
+static constexpr std::string_view TEMP_FILE_EXTENSION = ".tmp";
 
 std::string read_file(const std::filesystem::path& file_path)
 {
@@ -50,4 +71,105 @@ std::string read_wgsl_shader(const std::filesystem::path& file_path)
   return source;
 }
 
+void write_file(const std::filesystem::path& file_path, std::string_view contents)
+{
+  auto temp_path = file_path;
+  temp_path += TEMP_FILE_EXTENSION;
+
+  {
+    std::ofstream file(temp_path, std::ios::out | std::ios::binary | std::ios::trunc);
+
+    if (!file || !file.is_open())
+      throw Exception("Failed to open \"{}\" for writing", temp_path.string());
+
+    file.write(contents.data(), static_cast<std::streamsize>(contents.size()));
+
+    if (!file)
+      throw Exception("Failed to write to \"{}\"", temp_path.string());
+  }
+
+  std::filesystem::rename(temp_path, file_path);
+}
+
+std::filesystem::path get_data_path(std::string_view subdir)
+{
+  static const std::filesystem::path PREF_PATH = std::invoke([] -> std::filesystem::path {
+    char* pref_path = SDL_GetPrefPath("czw", "mewo");
+
+    if (!pref_path)
+      throw Exception("Failed to get SDL preferences path: {}", SDL_GetError());
+
+    std::filesystem::path path(pref_path);
+    SDL_free(pref_path);
+
+    return path;
+  });
+
+  auto data_path = PREF_PATH / subdir;
+
+  if (std::error_code error; !std::filesystem::create_directories(data_path, error) && error)
+    throw Exception("Failed to create data directory \"{}\"", data_path.string());
+
+  return data_path;
+}
+
+std::filesystem::path get_cache_path(std::string_view subdir)
+{
+  return get_data_path((std::filesystem::path("cache") / subdir).string());
+}
+
+void sync_file(std::FILE* file, const std::filesystem::path& file_path)
+{
+  bool is_synced = std::fflush(file) == 0;
+
+#if defined(SDL_PLATFORM_WIN32)
+  is_synced = is_synced && _commit(_fileno(file)) == 0;
+#else
+  is_synced = is_synced && fsync(fileno(file)) == 0;
+#endif
+
+  if (!is_synced)
+    throw Exception("Failed to flush \"{}\" to disk", file_path.string());
+}
+
+std::filesystem::path get_executable_path()
+{
+  [[maybe_unused]] static constexpr size_t MAX_FILE_PATH_LENGTH = 1024;
+
+#if defined(SDL_PLATFORM_MACOS)
+  uint32_t buf_size = MAX_FILE_PATH_LENGTH;
+  std::vector<char> path_vec(buf_size);
+
+  if (_NSGetExecutablePath(path_vec.data(), &buf_size) == -1) {
+    path_vec.resize(buf_size);
+
+    // Resize and try again. If it fails again, then we're in big trouble
+    if (_NSGetExecutablePath(path_vec.data(), &buf_size) == -1)
+      throw Exception("Call to _NSGetExecutablePath failed: buffer size not large enough");
+  }
+
+  // `_NSGetExecutablePath` needs to be resolved
+  return std::filesystem::canonical(path_vec.data());
+#elif defined(SDL_PLATFORM_WIN32)
+  std::array<wchar_t, MAX_FILE_PATH_LENGTH> path_arr = {};
+
+  if (GetModuleFileNameW(nullptr, path_arr.data(), MAX_FILE_PATH_LENGTH) == 0)
+    throw Exception("Call to GetModuleFileNameW failed");
+
+  return std::filesystem::path(path_arr.data());
+#elif defined(SDL_PLATFORM_LINUX)
+  // Symbolic link to the executable, maintained by the kernel
+  std::error_code error;
+  auto exe_path = std::filesystem::read_symlink("/proc/self/exe", error);
+
+  if (error)
+    throw Exception("Reading /proc/self/exe failed: {}", error.message());
+
+  return exe_path;
+#else
+#error "Unsupported platform. Supported platforms are macOS, Windows, and Linux"
+  throw Exception("Unsupported platform. Supported platforms are macOS, Windows, and Linux");
+#endif
+}
+
 }
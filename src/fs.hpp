@@ -1,7 +1,9 @@
 #pragma once
 
+#include <cstdio>
 #include <filesystem>
 #include <string>
+#include <string_view>
 
 namespace mewo::fs {
 
@@ -10,4 +12,20 @@ std::string read_file(const std::filesystem::path& file_path);
 /// Reads a plain text WGSL shader from disk.
 std::string read_wgsl_shader(const std::filesystem::path& file_path);
 
+/// Writes to a temporary file first and then renames it, so readers never observe
+/// a partially written file.
+void write_file(const std::filesystem::path& file_path, std::string_view contents);
+
+/// Makes sure everything written to the file so far is on the disk, not just in the OS's cache.
+void sync_file(std::FILE* file, const std::filesystem::path& file_path);
+
+/// Full path of the running executable, with symbolic links resolved.
+std::filesystem::path get_executable_path();
+
+/// Returns a writable, per-user directory for application data, creating it if needed.
+std::filesystem::path get_data_path(std::string_view subdir);
+
+/// Same as `get_data_path`, but for data that can be safely deleted at any time.
+std::filesystem::path get_cache_path(std::string_view subdir);
+
 }
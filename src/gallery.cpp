@@ -0,0 +1,474 @@
+#include "gallery.hpp"
+
+#include "fs.hpp"
+#include "gfx/create.hpp"
+#include "hash.hpp"
+#include "query.hpp"
+
+#include <webgpu/webgpu_cpp.h>
+
+#include <algorithm>
+#include <exception>
+#include <filesystem>
+#include <iterator>
+#include <format>
+#include <optional>
+#include <print>
+#include <string>
+#include <string_view>
+#include <unordered_set>
+#include <utility>
+#include <vector>
+
+namespace mewo {
+
+static constexpr std::string_view CACHE_SUBDIR = "thumbnails";
+static constexpr uint32_t BYTES_PER_PIXEL = 4;
+static constexpr uint32_t THUMBNAIL_BYTES_PER_ROW = Gallery::THUMBNAIL_WIDTH * BYTES_PER_PIXEL;
+static constexpr uint64_t THUMBNAIL_BYTE_SIZE
+    = static_cast<uint64_t>(THUMBNAIL_BYTES_PER_ROW) * Gallery::THUMBNAIL_HEIGHT;
+/// Thumbnails are a still frame, so every shader is rendered at the same point in time.
+static constexpr float THUMBNAIL_TIME = 1.f;
+
+static_assert(THUMBNAIL_BYTES_PER_ROW % 256 == 0, "Row size must be aligned for buffer copies");
+
+static const wgpu::Extent3D THUMBNAIL_EXTENT = {
+  .width = Gallery::THUMBNAIL_WIDTH,
+  .height = Gallery::THUMBNAIL_HEIGHT,
+};
+
+static std::string get_cache_file_name(uint64_t source_hash)
+{
+  // Size is part of the name so changing the thumbnail size invalidates old files
+  return std::format("{}-{}x{}.rgba", hash::to_hex(source_hash), Gallery::THUMBNAIL_WIDTH,
+      Gallery::THUMBNAIL_HEIGHT);
+}
+
+static wgpu::Origin3D get_tile_origin(uint32_t tile)
+{
+  return {
+    .x = (tile % Gallery::ATLAS_COLUMNS) * Gallery::THUMBNAIL_WIDTH,
+    .y = (tile / Gallery::ATLAS_COLUMNS) * Gallery::THUMBNAIL_HEIGHT,
+  };
+}
+
+Gallery::Gallery(const gfx::Renderer& renderer, const gfx::NoiseTextures& noise,
+    const gfx::LiteralScrub& scrub, const Viewport& viewport, const Editor& editor,
+    const Project& project, jobs::System& jobs)
+    : cache_path_(fs::get_cache_path(CACHE_SUBDIR))
+    , editor_(editor)
+    , project_(project)
+    , jobs_(jobs)
+{
+  const wgpu::Device& device = renderer.device();
+
+  wgpu::BufferDescriptor unif_buf_desc = {
+    .label = "gallery-uniform-buffer",
+    .usage = wgpu::BufferUsage::CopyDst | wgpu::BufferUsage::Uniform,
+    .size = sizeof(Viewport::Uniforms),
+  };
+
+  unif_buf_ = gfx::create::buffer(renderer, unif_buf_desc, gfx::MemoryTracker::Category::Uniforms);
+
+  // Every thumbnail has the same size and time, so uniforms only need to be written once
+  Viewport::Uniforms unif = {
+    .time = THUMBNAIL_TIME,
+    .resolution = { static_cast<float>(THUMBNAIL_WIDTH), static_cast<float>(THUMBNAIL_HEIGHT) },
+  };
+  renderer.queue().WriteBuffer(unif_buf_, 0, &unif, sizeof(Viewport::Uniforms));
+
+  std::vector<wgpu::BindGroupEntry> bg_entries = { {
+      .binding = 0,
+      .buffer = unif_buf_,
+      .size = sizeof(Viewport::Uniforms),
+  } };
+  std::ranges::copy(noise.bind_group_entries(), std::back_inserter(bg_entries));
+  bg_entries.push_back(scrub.bind_group_entry());
+
+  wgpu::BindGroupDescriptor bg_desc = {
+    .label = "gallery-bind-group",
+    .layout = viewport.bind_group_layout(),
+    .entryCount = bg_entries.size(),
+    .entries = bg_entries.data(),
+  };
+
+  bg_ = device.CreateBindGroup(&bg_desc);
+
+  color_target_state_ = { .format = ATLAS_FORMAT };
+
+  // Shares the pipeline layout and vertex state. Fragment state is filled in per shader
+  render_pipeline_desc_ = viewport.render_pipeline_desc();
+  render_pipeline_desc_.label = "gallery-render-pipeline";
+  render_pipeline_desc_.fragment = nullptr;
+
+  wgpu::TextureDescriptor atlas_desc = {
+    .label = "gallery-atlas-texture",
+    .usage = wgpu::TextureUsage::TextureBinding | wgpu::TextureUsage::CopyDst,
+    .size = { .width = THUMBNAIL_WIDTH * ATLAS_COLUMNS, .height = THUMBNAIL_HEIGHT * ATLAS_ROWS },
+    .format = ATLAS_FORMAT,
+  };
+
+  atlas_ = gfx::create::texture(renderer, atlas_desc, gfx::MemoryTracker::Category::Thumbnails);
+  atlas_view_ = atlas_.get().CreateView();
+
+  wgpu::TextureDescriptor scratch_desc = {
+    .label = "gallery-scratch-texture",
+    .usage = wgpu::TextureUsage::RenderAttachment | wgpu::TextureUsage::CopySrc,
+    .size = THUMBNAIL_EXTENT,
+    .format = ATLAS_FORMAT,
+  };
+
+  scratch_
+      = gfx::create::texture(renderer, scratch_desc, gfx::MemoryTracker::Category::Thumbnails);
+  scratch_view_ = scratch_.get().CreateView();
+}
+
+Gallery::~Gallery() { jobs_token_.cancel(); }
+
+const wgpu::TextureView& Gallery::view() const { return atlas_view_; }
+
+const std::vector<Gallery::Entry>& Gallery::entries() const { return entries_; }
+
+Gallery::UvRect Gallery::uv_rect(const Entry& entry) const
+{
+  static constexpr float TILE_U = 1.f / static_cast<float>(ATLAS_COLUMNS);
+  static constexpr float TILE_V = 1.f / static_cast<float>(ATLAS_ROWS);
+
+  float u = static_cast<float>(entry.tile % ATLAS_COLUMNS) * TILE_U;
+  float v = static_cast<float>(entry.tile / ATLAS_COLUMNS) * TILE_V;
+
+  return { .min = { u, v }, .max = { u + TILE_U, v + TILE_V } };
+}
+
+void Gallery::set_pending_refresh() { pending_refresh_ = true; }
+
+void Gallery::export_thumbnails(Project& project) const
+{
+  // Hashed again, since sources may have been stored after the last scan
+  std::unordered_set<uint64_t> source_hashes;
+
+  for (size_t idx = 0; idx < project.source_count(); ++idx)
+    source_hashes.insert(hash::fnv1a(editor_.combined_code(project.source_code(idx))));
+
+  project.retain_thumbnails(source_hashes);
+
+  for (const Entry& entry : entries_) {
+    if (entry.status != Status::Ready || project.thumbnail(entry.source_hash).has_value())
+      continue;
+
+    auto file_path = cache_path_ / get_cache_file_name(entry.source_hash);
+
+    if (std::filesystem::exists(file_path))
+      project.set_thumbnail(entry.source_hash, fs::read_file(file_path));
+  }
+}
+
+void Gallery::prepare_new_frame(const gfx::Renderer& renderer, const gfx::ShaderWarmup& warmup)
+{
+  if (!pending_refresh_ || is_reading_back_)
+    return;
+
+  pending_refresh_ = false;
+  scan();
+
+  std::vector<std::pair<size_t, wgpu::RenderPipeline>> stale;
+
+  for (size_t idx = 0; idx < entries_.size(); ++idx) {
+    Entry& entry = entries_[idx];
+
+    if (entry.status != Status::Stale)
+      continue;
+
+    if (auto project_pixels = project_.thumbnail(entry.source_hash);
+        project_pixels.has_value() && upload(renderer, entry.tile, project_pixels.value())) {
+      entry.status = Status::Ready;
+      continue;
+    }
+
+    // Only rendered once the disk cache turns out not to have it
+    if (!entry.has_checked_cache) {
+      load_cached(renderer, entry);
+      continue;
+    }
+
+    std::string combined_code = editor_.combined_code(entry.code);
+
+    // Stays stale, so it's picked up by a later refresh instead of being compiled twice
+    if (warmup.is_pending(combined_code)) {
+      pending_refresh_ = true;
+      continue;
+    }
+
+    if (const gfx::ShaderWarmup::Shader* warm = warmup.find(combined_code); warm != nullptr) {
+      if (!warm->module.has_value()) {
+        std::println("Gallery shader \"{}\" failed to compile, {} diagnostic(s) reported",
+            entry.name, warm->diagnostics.size());
+        entry.status = Status::Failed;
+        continue;
+      }
+
+      if (wgpu::RenderPipeline pipeline = warm->find_pipeline(ATLAS_FORMAT); pipeline) {
+        stale.emplace_back(idx, std::move(pipeline));
+        continue;
+      }
+    }
+
+    const auto& [frag_module_opt, frag_diagnostics]
+        = gfx::create::shader_module_from_wgsl(renderer, combined_code, "gallery-frag-shader");
+
+    if (!frag_module_opt.has_value()) {
+      std::println("Gallery shader \"{}\" failed to compile, {} diagnostic(s) reported",
+          entry.name, frag_diagnostics.size());
+      entry.status = Status::Failed;
+      continue;
+    }
+
+    wgpu::FragmentState fragment_state = {
+      .module = frag_module_opt.value(),
+      .entryPoint = "main",
+      .targetCount = 1,
+      .targets = &color_target_state_,
+    };
+
+    render_pipeline_desc_.fragment = &fragment_state;
+    stale.emplace_back(idx, renderer.device().CreateRenderPipeline(&render_pipeline_desc_));
+  }
+
+  // Don't leave a dangling pointer to the fragment state behind
+  render_pipeline_desc_.fragment = nullptr;
+
+  if (!stale.empty())
+    render(renderer, stale);
+}
+
+void Gallery::scan()
+{
+  size_t source_count = project_.source_count();
+
+  if (source_count > MAX_THUMBNAILS) {
+    std::println("Gallery only has room for {} thumbnails, skipping {} shader(s)", MAX_THUMBNAILS,
+        source_count - MAX_THUMBNAILS);
+    source_count = MAX_THUMBNAILS;
+  }
+
+  std::vector<Entry> scanned;
+  scanned.reserve(source_count);
+
+  for (uint32_t tile = 0; tile < source_count; ++tile) {
+    std::string code(project_.source_code(tile));
+    uint64_t source_hash = hash::fnv1a(editor_.combined_code(code));
+
+    // Tiles follow source order, so an unchanged shader in the same tile is still valid
+    Status status = Status::Stale;
+    bool has_checked_cache = false;
+
+    if (tile < entries_.size() && entries_[tile].source_hash == source_hash) {
+      status = entries_[tile].status;
+      has_checked_cache = entries_[tile].has_checked_cache;
+    }
+
+    scanned.push_back({
+        .name = std::string(project_.source_name(tile)),
+        .source = tile,
+        .code = std::move(code),
+        .source_hash = source_hash,
+        .tile = tile,
+        .status = status,
+        .has_checked_cache = has_checked_cache,
+    });
+  }
+
+  entries_ = std::move(scanned);
+}
+
+bool Gallery::upload(const gfx::Renderer& renderer, uint32_t tile, std::string_view pixels) const
+{
+  // Truncated or otherwise corrupted, so it'll be rendered and overwritten instead
+  if (pixels.size() != THUMBNAIL_BYTE_SIZE)
+    return false;
+
+  wgpu::TexelCopyTextureInfo atlas_copy = {
+    .texture = atlas_,
+    .origin = get_tile_origin(tile),
+  };
+
+  wgpu::TexelCopyBufferLayout pixels_layout = {
+    .bytesPerRow = THUMBNAIL_BYTES_PER_ROW,
+    .rowsPerImage = THUMBNAIL_HEIGHT,
+  };
+
+  renderer.queue().WriteTexture(
+      &atlas_copy, pixels.data(), pixels.size(), &pixels_layout, &THUMBNAIL_EXTENT);
+
+  return true;
+}
+
+void Gallery::load_cached(const gfx::Renderer& renderer, Entry& entry)
+{
+  entry.status = Status::Loading;
+
+  auto read_pixels = [file_path = cache_path_ / get_cache_file_name(entry.source_hash)](
+                         const jobs::CancellationToken&) -> std::optional<std::string> {
+    // Treated like a missing file, since the thumbnail can always be rendered again
+    try {
+      if (!std::filesystem::exists(file_path))
+        return std::nullopt;
+
+      return fs::read_file(file_path);
+    } catch (const std::exception& ex) {
+      std::println("Failed to read cached gallery thumbnail. {}", ex.what());
+      return std::nullopt;
+    }
+  };
+
+  auto upload_pixels = [this, &renderer, tile = entry.tile, source_hash = entry.source_hash](
+                           std::optional<std::string> pixels) {
+    // A refresh may have given the tile to another shader in the meantime
+    if (tile >= entries_.size() || entries_[tile].source_hash != source_hash
+        || entries_[tile].status != Status::Loading) {
+      return;
+    }
+
+    Entry& loaded = entries_[tile];
+    loaded.has_checked_cache = true;
+
+    if (pixels.has_value() && upload(renderer, tile, pixels.value())) {
+      loaded.status = Status::Ready;
+      return;
+    }
+
+    loaded.status = Status::Stale;
+    pending_refresh_ = true;
+  };
+
+  jobs_.submit(jobs::Priority::High, jobs_token_, std::move(read_pixels), std::move(upload_pixels));
+}
+
+void Gallery::render(const gfx::Renderer& renderer,
+    const std::vector<std::pair<size_t, wgpu::RenderPipeline>>& stale)
+{
+  const wgpu::Device& device = renderer.device();
+
+  wgpu::BufferDescriptor readback_buf_desc = {
+    .label = "gallery-readback-buffer",
+    .usage = wgpu::BufferUsage::MapRead | wgpu::BufferUsage::CopyDst,
+    .size = stale.size() * THUMBNAIL_BYTE_SIZE,
+  };
+
+  readback_buf_
+      = gfx::create::buffer(renderer, readback_buf_desc, gfx::MemoryTracker::Category::Readback);
+
+  static const wgpu::CommandEncoderDescriptor ENCODER_DESC = { .label = "gallery-command-encoder" };
+  wgpu::CommandEncoder encoder = device.CreateCommandEncoder(&ENCODER_DESC);
+
+  wgpu::RenderPassColorAttachment color_attachment = {
+    .view = scratch_view_,
+    .loadOp = wgpu::LoadOp::Clear,
+    .storeOp = wgpu::StoreOp::Store,
+  };
+
+  wgpu::RenderPassDescriptor pass_desc = {
+    .label = "gallery-render-pass",
+    .colorAttachmentCount = 1,
+    .colorAttachments = &color_attachment,
+  };
+
+  const wgpu::TexelCopyTextureInfo scratch_copy = { .texture = scratch_ };
+
+  // Source hash for each slot in the readback buffer
+  std::vector<uint64_t> slot_hashes;
+  slot_hashes.reserve(stale.size());
+
+  for (size_t slot = 0; slot < stale.size(); ++slot) {
+    const auto& [entry_idx, pipeline] = stale[slot];
+    Entry& entry = entries_[entry_idx];
+
+    wgpu::RenderPassEncoder render_pass = encoder.BeginRenderPass(&pass_desc);
+    render_pass.SetPipeline(pipeline);
+    render_pass.SetBindGroup(0, bg_);
+    render_pass.Draw(6);
+    render_pass.End();
+
+    wgpu::TexelCopyTextureInfo atlas_copy = {
+      .texture = atlas_,
+      .origin = get_tile_origin(entry.tile),
+    };
+
+    encoder.CopyTextureToTexture(&scratch_copy, &atlas_copy, &THUMBNAIL_EXTENT);
+
+    wgpu::TexelCopyBufferInfo readback_copy = {
+      .layout = {
+        .offset = slot * THUMBNAIL_BYTE_SIZE,
+        .bytesPerRow = THUMBNAIL_BYTES_PER_ROW,
+        .rowsPerImage = THUMBNAIL_HEIGHT,
+      },
+      .buffer = readback_buf_,
+    };
+
+    encoder.CopyTextureToBuffer(&scratch_copy, &readback_copy, &THUMBNAIL_EXTENT);
+
+    slot_hashes.push_back(entry.source_hash);
+    entry.status = Status::Ready;
+  }
+
+  static const wgpu::CommandBufferDescriptor CMD_BUF_DESC = { .label = "gallery-command-buffer" };
+  wgpu::CommandBuffer cmd_buf = encoder.Finish(&CMD_BUF_DESC);
+  renderer.queue().Submit(1, &cmd_buf);
+
+  if constexpr (query::is_debug())
+    std::println("Rendered {} gallery thumbnail(s) in one submit", stale.size());
+
+  is_reading_back_ = true;
+
+  // Callback is invoked during `wgpu::Instance::ProcessEvents` in the main loop
+  const wgpu::Buffer& readback_buf = readback_buf_;
+
+  readback_buf.MapAsync(wgpu::MapMode::Read, 0, readback_buf.GetSize(),
+      wgpu::CallbackMode::AllowProcessEvents,
+      [this, readback_buf, slot_hashes = std::move(slot_hashes)](
+          wgpu::MapAsyncStatus status, wgpu::StringView message) {
+        // Also invoked when the instance is destroyed, at which point `this` may be gone
+        if (status == wgpu::MapAsyncStatus::CallbackCancelled)
+          return;
+
+        is_reading_back_ = false;
+
+        if (status != wgpu::MapAsyncStatus::Success) {
+          std::println("Failed to read back gallery thumbnails: {}", std::string_view(message));
+          readback_buf_ = {};
+          return;
+        }
+
+        const auto* pixels
+            = static_cast<const char*>(readback_buf.GetConstMappedRange(0, readback_buf.GetSize()));
+
+        // Copied out, so the buffer can be released before a job writes the files
+        std::vector<std::pair<std::filesystem::path, std::string>> files;
+        files.reserve(slot_hashes.size());
+
+        for (size_t slot = 0; slot < slot_hashes.size(); ++slot) {
+          files.emplace_back(cache_path_ / get_cache_file_name(slot_hashes[slot]),
+              std::string(pixels + slot * THUMBNAIL_BYTE_SIZE, THUMBNAIL_BYTE_SIZE));
+        }
+
+        readback_buf.Unmap();
+        readback_buf_ = {};
+
+        jobs_.submit(jobs::Priority::Low, jobs_token_,
+            [files = std::move(files)](const jobs::CancellationToken& token) {
+              // A missed cache write is harmless, the thumbnail is just rendered again
+              try {
+                for (const auto& [file_path, contents] : files) {
+                  if (token.is_cancelled())
+                    return;
+
+                  fs::write_file(file_path, contents);
+                }
+              } catch (const std::exception& ex) {
+                std::println("Failed to cache gallery thumbnails. {}", ex.what());
+              }
+            });
+      });
+}
+
+}
@@ -0,0 +1,135 @@
+#pragma once
+
+#include "editor.hpp"
+#include "gfx/literal_scrub.hpp"
+#include "gfx/memory_tracker.hpp"
+#include "gfx/noise_textures.hpp"
+#include "gfx/renderer.hpp"
+#include "gfx/shader_warmup.hpp"
+#include "jobs.hpp"
+#include "project.hpp"
+#include "viewport.hpp"
+
+#include <webgpu/webgpu_cpp.h>
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+namespace mewo {
+
+/// Low resolution previews of every shader in the project, all packed into a single atlas
+/// texture. Stale thumbnails are rendered together using one command buffer and one submit,
+/// and are then read back and cached on disk, keyed by a hash of their source. Thumbnails
+/// saved inside the project are preferred over the disk cache. Reading and writing the disk
+/// cache happens in jobs, so the frame loop never waits on the disk.
+///
+/// Reuses the viewport's vertex shader and bind group layout, so any shader that runs in the
+/// viewport also works here.
+class Gallery {
+  public:
+  /// Row size in bytes must be a multiple of 256 for texture to buffer copies, which is
+  /// why the width isn't a rounder number.
+  static constexpr uint32_t THUMBNAIL_WIDTH = 192;
+  static constexpr uint32_t THUMBNAIL_HEIGHT = 108;
+  static constexpr uint32_t ATLAS_COLUMNS = 8;
+  static constexpr uint32_t ATLAS_ROWS = 8;
+  static constexpr uint32_t MAX_THUMBNAILS = ATLAS_COLUMNS * ATLAS_ROWS;
+  static constexpr auto ATLAS_FORMAT = wgpu::TextureFormat::RGBA8Unorm;
+
+  enum class Status {
+    /// Not yet rendered, or its source changed since it was last rendered.
+    Stale,
+    /// Being read from the disk cache.
+    Loading,
+    /// Currently in the atlas, either rendered this session or loaded from disk.
+    Ready,
+    /// Shader failed to compile, so its tile is left empty.
+    Failed,
+  };
+
+  struct Entry {
+    std::string name;
+    /// Index of the source in the project.
+    size_t source = 0;
+    /// Excludes the fragment shader prefix.
+    std::string code;
+    uint64_t source_hash = 0;
+    uint32_t tile = 0;
+    Status status = Status::Stale;
+    /// Set once the disk cache turned out to be missing or corrupted, so it's rendered instead.
+    bool has_checked_cache = false;
+  };
+
+  /// Normalized texture coordinates of a tile, for displaying through the GUI.
+  struct UvRect {
+    std::array<float, 2> min = {};
+    std::array<float, 2> max = {};
+  };
+
+  Gallery(const gfx::Renderer& renderer, const gfx::NoiseTextures& noise,
+      const gfx::LiteralScrub& scrub, const Viewport& viewport, const Editor& editor,
+      const Project& project, jobs::System& jobs);
+  /// Drops cache reads that haven't completed, since their completions refer to the gallery.
+  ~Gallery();
+
+  Gallery(const Gallery&) = delete;
+  Gallery& operator=(const Gallery&) = delete;
+
+  const wgpu::TextureView& view() const;
+  const std::vector<Entry>& entries() const;
+  UvRect uv_rect(const Entry& entry) const;
+
+  /// Rereads project sources next frame and re-renders thumbnails whose source changed.
+  void set_pending_refresh();
+  /// Copies thumbnails from the disk cache into the project, so they're saved with it, and drops
+  /// those of sources that changed.
+  void export_thumbnails(Project& project) const;
+
+  /// Applies a pending refresh. Does nothing while a previous batch is still being read back.
+  /// Shaders that are still warming up are rendered once they're done.
+  void prepare_new_frame(const gfx::Renderer& renderer, const gfx::ShaderWarmup& warmup);
+
+  private:
+  /// Reads project sources, keeping the existing tile and status of unchanged entries.
+  void scan();
+  /// Returns false if the pixels are truncated or otherwise corrupted.
+  bool upload(const gfx::Renderer& renderer, uint32_t tile, std::string_view pixels) const;
+  /// Reads the entry's thumbnail from the disk cache in a job, and uploads it once it's read.
+  void load_cached(const gfx::Renderer& renderer, Entry& entry);
+  /// Renders all given entries in one submit and schedules a readback to the disk cache.
+  void render(const gfx::Renderer& renderer,
+      const std::vector<std::pair<size_t, wgpu::RenderPipeline>>& stale);
+
+  std::filesystem::path cache_path_;
+  const Editor& editor_;
+  const Project& project_;
+  jobs::System& jobs_;
+  jobs::CancellationToken jobs_token_;
+
+  gfx::Tracked<wgpu::Buffer> unif_buf_;
+  wgpu::BindGroup bg_;
+  wgpu::ColorTargetState color_target_state_;
+  wgpu::RenderPipelineDescriptor render_pipeline_desc_;
+
+  gfx::Tracked<wgpu::Texture> atlas_;
+  wgpu::TextureView atlas_view_;
+  /// Single tile-sized render target, copied into the atlas after each draw. Shaders use
+  /// framebuffer coordinates, so drawing straight into an atlas tile would offset them.
+  gfx::Tracked<wgpu::Texture> scratch_;
+  wgpu::TextureView scratch_view_;
+
+  /// Only exists while a batch is being read back.
+  gfx::Tracked<wgpu::Buffer> readback_buf_;
+
+  std::vector<Entry> entries_;
+  bool pending_refresh_ = true;
+  bool is_reading_back_ = false;
+};
+
+}
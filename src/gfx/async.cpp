@@ -0,0 +1,50 @@
+#include "async.hpp"
+
+#include "exception.hpp"
+#include "gfx/create.hpp"
+#include "gfx/renderer.hpp"
+
+#include <webgpu/webgpu_cpp.h>
+
+#include <exception>
+#include <optional>
+#include <print>
+#include <string>
+#include <utility>
+
+namespace mewo::gfx::async {
+
+void detail::report_detached(const std::exception_ptr& exception)
+{
+  try {
+    std::rethrow_exception(exception);
+  } catch (const std::exception& ex) {
+    std::println("Detached task failed. {}", ex.what());
+  } catch (...) {
+    std::println("Detached task failed with an unknown exception");
+  }
+}
+
+Task<create::ShaderCompilationResult> shader_module_from_wgsl(
+    const Renderer& renderer, std::string code, std::string label)
+{
+  wgpu::ShaderSourceWGSL shader_source_wgsl = { { .code = code } };
+
+  wgpu::ShaderModuleDescriptor shader_module_desc = {
+    .nextInChain = &shader_source_wgsl,
+    .label = label,
+  };
+
+  wgpu::ShaderModule shader = renderer.device().CreateShaderModule(&shader_module_desc);
+  CompilationInfoResult info = co_await get_compilation_info(shader, code);
+
+  if (info.status != wgpu::CompilationInfoRequestStatus::Success)
+    throw Exception("Failed to request shader compilation info");
+
+  co_return create::ShaderCompilationResult {
+    info.has_error ? std::nullopt : std::optional(shader),
+    std::move(info.diagnostics),
+  };
+}
+
+}
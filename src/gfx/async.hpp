@@ -0,0 +1,271 @@
+#pragma once
+
+#include "gfx/compilation_diagnostic.hpp"
+#include "gfx/create.hpp"
+#include "gfx/renderer.hpp"
+
+#include <webgpu/webgpu_cpp.h>
+
+#include <coroutine>
+#include <cstddef>
+#include <exception>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include <utility>
+
+/// Coroutines over WebGPU's asynchronous operations, so work that waits on the driver can be
+/// written linearly without blocking the frame. Operations are started with
+/// `wgpu::CallbackMode::AllowProcessEvents`, so coroutines only ever resume on the main thread,
+/// during the `wgpu::Instance::ProcessEvents` the main loop calls once per frame.
+///
+/// Operations cancelled because the instance is being destroyed never resume their coroutine,
+/// since whatever it refers to may already be gone. Its frame is leaked instead, which only
+/// happens on shutdown.
+namespace mewo::gfx::async {
+
+template <typename T = void>
+class Task;
+
+namespace detail {
+
+/// Prints the exception of a task nobody holds anymore, since it can't be rethrown.
+void report_detached(const std::exception_ptr& exception);
+
+struct PromiseBase {
+  struct FinalAwaiter {
+    bool await_ready() const noexcept { return false; }
+
+    template <typename Promise>
+    std::coroutine_handle<> await_suspend(std::coroutine_handle<Promise> handle) const noexcept
+    {
+      PromiseBase& promise = handle.promise();
+
+      if (promise.continuation)
+        return promise.continuation;
+
+      // Nothing refers to the frame anymore, so it has to clean up after itself
+      if (promise.is_detached) {
+        if (promise.exception)
+          report_detached(promise.exception);
+
+        handle.destroy();
+      }
+
+      return std::noop_coroutine();
+    }
+
+    void await_resume() const noexcept { }
+  };
+
+  /// Tasks start right away, and run until their first suspension before returning.
+  std::suspend_never initial_suspend() const noexcept { return {}; }
+  FinalAwaiter final_suspend() const noexcept { return {}; }
+  void unhandled_exception() { exception = std::current_exception(); }
+
+  /// Resumed once the task finishes, if another coroutine is awaiting it.
+  std::coroutine_handle<> continuation;
+  /// Set once the task object is gone, so the frame is destroyed when it finishes.
+  bool is_detached = false;
+  std::exception_ptr exception;
+};
+
+template <typename T>
+struct Promise : PromiseBase {
+  Task<T> get_return_object();
+  void return_value(T returned) { value = std::move(returned); }
+
+  std::optional<T> value;
+};
+
+template <>
+struct Promise<void> : PromiseBase {
+  Task<void> get_return_object();
+  void return_void() const { }
+};
+
+}
+
+/// Coroutine that can be awaited by another one, or held and polled from regular code.
+/// Dropping a task that hasn't finished detaches it rather than cancelling it.
+template <typename T>
+class Task {
+  public:
+  using promise_type = detail::Promise<T>;
+
+  Task() = default;
+  explicit Task(std::coroutine_handle<promise_type> handle)
+      : handle_(handle)
+  {
+  }
+  ~Task() { release(); }
+
+  Task(Task&& other) noexcept
+      : handle_(std::exchange(other.handle_, nullptr))
+  {
+  }
+
+  Task& operator=(Task&& other) noexcept
+  {
+    if (this != &other) {
+      release();
+      handle_ = std::exchange(other.handle_, nullptr);
+    }
+
+    return *this;
+  }
+
+  Task(const Task&) = delete;
+  Task& operator=(const Task&) = delete;
+
+  bool is_done() const { return !handle_ || handle_.done(); }
+
+  /// Only call once done. Rethrows the exception the task ended with, if any.
+  T get()
+  {
+    promise_type& promise = handle_.promise();
+
+    if (promise.exception)
+      std::rethrow_exception(promise.exception);
+
+    if constexpr (!std::is_void_v<T>)
+      return std::move(promise.value).value();
+  }
+
+  bool await_ready() const noexcept { return handle_.done(); }
+  void await_suspend(std::coroutine_handle<> awaiting) noexcept
+  {
+    handle_.promise().continuation = awaiting;
+  }
+  T await_resume() { return get(); }
+
+  private:
+  void release()
+  {
+    if (!handle_)
+      return;
+
+    if (handle_.done())
+      handle_.destroy();
+    else
+      handle_.promise().is_detached = true;
+
+    handle_ = nullptr;
+  }
+
+  std::coroutine_handle<promise_type> handle_;
+};
+
+template <typename T>
+Task<T> detail::Promise<T>::get_return_object()
+{
+  return Task<T>(std::coroutine_handle<Promise>::from_promise(*this));
+}
+
+inline Task<void> detail::Promise<void>::get_return_object()
+{
+  return Task<void>(std::coroutine_handle<Promise>::from_promise(*this));
+}
+
+/// Suspends the awaiting coroutine, starts the operation, and resumes with whatever the
+/// operation's callback completes it with. Lives in the coroutine's frame while suspended, so
+/// callbacks can refer to it.
+template <typename Result, typename Start>
+class Operation {
+  public:
+  explicit Operation(Start start)
+      : start_(std::move(start))
+  {
+  }
+
+  bool await_ready() const noexcept { return false; }
+  void await_suspend(std::coroutine_handle<> handle)
+  {
+    handle_ = handle;
+    start_(*this);
+  }
+  Result await_resume() { return std::move(result_).value(); }
+
+  /// Called by the operation's callback, never from within `start_` itself.
+  void complete(Result result)
+  {
+    result_ = std::move(result);
+    handle_.resume();
+  }
+
+  private:
+  Start start_;
+  std::coroutine_handle<> handle_;
+  std::optional<Result> result_;
+};
+
+template <typename Result, typename Start>
+Operation<Result, Start> make_operation(Start start)
+{
+  return Operation<Result, Start>(std::move(start));
+}
+
+struct CompilationInfoResult {
+  wgpu::CompilationInfoRequestStatus status = wgpu::CompilationInfoRequestStatus::Success;
+  CompilationLog diagnostics;
+  /// Errors mean the module is invalid, and no pipeline can be created from it.
+  bool has_error = false;
+};
+
+struct PipelineResult {
+  wgpu::CreatePipelineAsyncStatus status = wgpu::CreatePipelineAsyncStatus::InternalError;
+  wgpu::RenderPipeline pipeline;
+  std::string message;
+};
+
+/// The code is copied into the diagnostics, so highlights can refer to it.
+inline auto get_compilation_info(const wgpu::ShaderModule& module, std::string_view code)
+{
+  return make_operation<CompilationInfoResult>([module, code](auto& operation) {
+    module.GetCompilationInfo(wgpu::CallbackMode::AllowProcessEvents,
+        [&operation, code](
+            wgpu::CompilationInfoRequestStatus status, const wgpu::CompilationInfo* info) {
+          if (status == wgpu::CompilationInfoRequestStatus::CallbackCancelled)
+            return;
+
+          CompilationInfoResult result = { .status = status, .diagnostics = CompilationLog(code) };
+
+          // The info only lives as long as the callback
+          if (status == wgpu::CompilationInfoRequestStatus::Success) {
+            for (size_t idx = 0; idx < info->messageCount; ++idx) {
+              const wgpu::CompilationMessage& msg = info->messages[idx];
+
+              result.has_error |= msg.type == wgpu::CompilationMessageType::Error;
+              create::add_diagnostic(result.diagnostics, msg);
+            }
+          }
+
+          operation.complete(std::move(result));
+        });
+  });
+}
+
+/// The descriptor is only read when the operation starts, which happens within the `co_await`
+/// expression, so pointing to the caller's is safe.
+inline auto create_render_pipeline(
+    const wgpu::Device& device, const wgpu::RenderPipelineDescriptor& desc)
+{
+  return make_operation<PipelineResult>([device, desc = &desc](auto& operation) {
+    device.CreateRenderPipelineAsync(desc, wgpu::CallbackMode::AllowProcessEvents,
+        [&operation](wgpu::CreatePipelineAsyncStatus status, wgpu::RenderPipeline pipeline,
+            wgpu::StringView message) {
+          if (status == wgpu::CreatePipelineAsyncStatus::CallbackCancelled)
+            return;
+
+          operation.complete({ status, std::move(pipeline), std::string(message) });
+        });
+  });
+}
+
+/// Same as `create::shader_module_from_wgsl`, but doesn't block while compilation info is
+/// being gathered.
+Task<create::ShaderCompilationResult> shader_module_from_wgsl(
+    const Renderer& renderer, std::string code, std::string label);
+
+}
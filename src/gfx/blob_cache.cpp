@@ -0,0 +1,73 @@
+#include "blob_cache.hpp"
+
+#include "hash.hpp"
+
+#include <cstring>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <unordered_set>
+#include <utility>
+
+namespace mewo::gfx {
+
+uint64_t BlobCache::hash_key(const void* key, size_t key_size)
+{
+  return hash::fnv1a(std::string_view(static_cast<const char*>(key), key_size));
+}
+
+void BlobCache::set_mapped(std::unordered_map<uint64_t, std::string_view> entries)
+{
+  std::scoped_lock lock(mutex_);
+  mapped_ = std::move(entries);
+}
+
+std::unordered_map<uint64_t, std::string> BlobCache::take_stored()
+{
+  std::scoped_lock lock(mutex_);
+  return std::exchange(stored_, {});
+}
+
+std::unordered_set<uint64_t> BlobCache::used_keys()
+{
+  std::scoped_lock lock(mutex_);
+  return used_;
+}
+
+size_t BlobCache::load(uint64_t key, void* value, size_t value_size)
+{
+  std::scoped_lock lock(mutex_);
+
+  std::string_view blob;
+
+  if (auto stored_it = stored_.find(key); stored_it != stored_.end()) {
+    blob = stored_it->second;
+  } else if (auto mapped_it = mapped_.find(key); mapped_it != mapped_.end()) {
+    blob = mapped_it->second;
+  } else {
+    return 0;
+  }
+
+  used_.insert(key);
+
+  if (!value)
+    return blob.size();
+
+  // Dawn always asks for the size first, so a mismatch means something went wrong
+  if (value_size != blob.size())
+    return 0;
+
+  std::memcpy(value, blob.data(), blob.size());
+
+  return blob.size();
+}
+
+void BlobCache::store(uint64_t key, const void* value, size_t value_size)
+{
+  std::scoped_lock lock(mutex_);
+  stored_.insert_or_assign(key, std::string(static_cast<const char*>(value), value_size));
+  used_.insert(key);
+}
+
+}
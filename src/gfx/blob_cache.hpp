@@ -0,0 +1,42 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <unordered_set>
+
+namespace mewo::gfx {
+
+/// Storage for Dawn's cache of backend objects, like shaders and pipelines already translated
+/// for the GPU driver. Hitting this cache lets pipeline creation skip most of the compilation.
+///
+/// Dawn may call into this from any thread, so every function locks.
+class BlobCache {
+  public:
+  static uint64_t hash_key(const void* key, size_t key_size);
+
+  /// Entries that point into memory owned by someone else, like a memory-mapped project
+  /// file. Replaces any previously set entries, so pass an empty map before unmapping.
+  void set_mapped(std::unordered_map<uint64_t, std::string_view> entries);
+  /// Returns entries that Dawn stored since the last call.
+  std::unordered_map<uint64_t, std::string> take_stored();
+  /// Keys of entries that Dawn loaded or stored this session. Others are left over from shaders
+  /// that were since changed or removed.
+  std::unordered_set<uint64_t> used_keys();
+
+  /// Follows the semantics of `wgpu::DawnLoadCacheDataFunction`. If `value` is null, only
+  /// the size of the entry is returned. Returns zero on a cache miss.
+  size_t load(uint64_t key, void* value, size_t value_size);
+  void store(uint64_t key, const void* value, size_t value_size);
+
+  private:
+  std::mutex mutex_;
+  std::unordered_map<uint64_t, std::string_view> mapped_;
+  std::unordered_map<uint64_t, std::string> stored_;
+  std::unordered_set<uint64_t> used_;
+};
+
+}
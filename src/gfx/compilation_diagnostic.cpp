@@ -0,0 +1,80 @@
+#include "compilation_diagnostic.hpp"
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <memory_resource>
+#include <span>
+#include <string_view>
+
+namespace mewo::gfx {
+
+/// Arena block size of logs with few messages, which fits most compiles in one block.
+static constexpr size_t MESSAGE_BLOCK_SIZE = 4096;
+
+/// Copies the string into the arena, which owns it from then on.
+static std::string_view store(std::pmr::memory_resource& arena, std::string_view str)
+{
+  if (str.empty())
+    return {};
+
+  auto* stored = static_cast<char*>(arena.allocate(str.size(), alignof(char)));
+  std::ranges::copy(str, stored);
+
+  return { stored, str.size() };
+}
+
+CompilationLog::Storage::Storage(size_t initial_size)
+    : arena(initial_size)
+    , diagnostics(&arena)
+{
+}
+
+CompilationLog::CompilationLog(std::string_view code)
+    : storage_(std::make_shared<Storage>(code.size() + MESSAGE_BLOCK_SIZE))
+{
+  storage_->code = store(storage_->arena, code);
+}
+
+bool CompilationLog::empty() const { return size() == 0; }
+
+size_t CompilationLog::size() const { return storage_ ? storage_->diagnostics.size() : 0; }
+
+std::span<const CompilationDiagnostic> CompilationLog::diagnostics() const
+{
+  if (!storage_)
+    return {};
+
+  return storage_->diagnostics;
+}
+
+std::string_view CompilationLog::highlight(const CompilationDiagnostic& diag) const
+{
+  if (!storage_)
+    return {};
+
+  const std::string_view code = storage_->code;
+  const size_t offset = static_cast<size_t>(std::min<uint64_t>(diag.highlight_offset, code.size()));
+
+  return code.substr(offset, static_cast<size_t>(diag.highlight_length));
+}
+
+void CompilationLog::add(std::string_view message, std::string_view type_name, uint64_t line_num,
+    uint64_t line_pos, uint64_t highlight_offset, uint64_t highlight_length)
+{
+  // Also covers default-constructed logs, which have no code to highlight
+  if (!storage_)
+    storage_ = std::make_shared<Storage>(MESSAGE_BLOCK_SIZE);
+
+  storage_->diagnostics.push_back({
+      .message = store(storage_->arena, message),
+      .type_name = type_name,
+      .line_num = line_num,
+      .line_pos = line_pos,
+      .highlight_offset = highlight_offset,
+      .highlight_length = highlight_length,
+  });
+}
+
+}
@@ -1,17 +1,59 @@
 #pragma once
 
+#include <cstddef>
 #include <cstdint>
-#include <string>
+#include <memory>
+#include <memory_resource>
+#include <span>
 #include <string_view>
+#include <vector>
 
 namespace mewo::gfx {
 
 struct CompilationDiagnostic {
-  std::string message;
+  std::string_view message; ///< Stored in the arena of the log it belongs to.
   std::string_view type_name; ///< Will reference statically-allocated string.
   uint64_t line_num = {};
   uint64_t line_pos = {};
-  std::string highlight;
+  /// Part of the compiled code the message is about. Resolved through the log, which keeps
+  /// the code, instead of being copied out for every diagnostic.
+  uint64_t highlight_offset = {};
+  uint64_t highlight_length = {};
+};
+
+/// Every diagnostic of one compile. The code, messages and diagnostics are all stored in one
+/// arena, so building a log with thousands of diagnostics is a handful of allocations, and
+/// replacing it releases everything at once.
+///
+/// Copies share the same storage, which makes handing a log from warm-up to the viewport
+/// free. Only add to a log before it's copied.
+class CompilationLog {
+  public:
+  /// Empty, like a compile that reported nothing.
+  CompilationLog() = default;
+  /// Keeps a copy of the code, which highlights refer to.
+  explicit CompilationLog(std::string_view code);
+
+  bool empty() const;
+  size_t size() const;
+  std::span<const CompilationDiagnostic> diagnostics() const;
+  /// Offsets come from the compiler, so they're clamped to the code.
+  std::string_view highlight(const CompilationDiagnostic& diag) const;
+
+  /// Copies the message into the arena.
+  void add(std::string_view message, std::string_view type_name, uint64_t line_num,
+      uint64_t line_pos, uint64_t highlight_offset, uint64_t highlight_length);
+
+  private:
+  struct Storage {
+    explicit Storage(size_t initial_size);
+
+    std::pmr::monotonic_buffer_resource arena;
+    std::string_view code;
+    std::pmr::vector<CompilationDiagnostic> diagnostics;
+  };
+
+  std::shared_ptr<Storage> storage_;
 };
 
 }
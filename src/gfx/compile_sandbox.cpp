@@ -0,0 +1,636 @@
+#include "compile_sandbox.hpp"
+
+#include "exception.hpp"
+#include "fs.hpp"
+#include "gfx/compilation_diagnostic.hpp"
+#include "gfx/create.hpp"
+#include "gfx/renderer.hpp"
+#include "query.hpp"
+#include "shared_memory.hpp"
+
+#include <SDL3/SDL_platform.h>
+#include <webgpu/webgpu_cpp.h>
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <exception>
+#include <format>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <print>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <type_traits>
+#include <utility>
+
+#if !defined(SDL_PLATFORM_WIN32)
+#include <cerrno>
+#include <csignal>
+#include <fcntl.h>
+#include <poll.h>
+#include <spawn.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+extern char** environ;
+#endif
+
+namespace mewo::gfx {
+
+#if !defined(SDL_PLATFORM_WIN32)
+/// Start of each helper's region. Followed by the code, which the helper then replaces with
+/// its diagnostics.
+struct RegionHeader {
+  uint64_t code_size = 0;
+  uint32_t diagnostic_count = 0;
+  uint32_t has_error = 0;
+};
+
+/// Followed by the message.
+struct DiagnosticHeader {
+  uint32_t type = 0;
+  uint32_t message_size = 0;
+  uint64_t line_num = 0;
+  uint64_t line_pos = 0;
+  uint64_t offset = 0;
+  uint64_t length = 0;
+};
+
+static_assert(std::is_trivially_copyable_v<RegionHeader>);
+static_assert(std::is_trivially_copyable_v<DiagnosticHeader>);
+
+static constexpr size_t PAYLOAD_CAPACITY = CompileSandbox::REGION_SIZE - sizeof(RegionHeader);
+
+static CompilationLog make_error_log(std::string_view code, std::string_view message)
+{
+  CompilationLog log(code);
+  log.add(message, "error", 0, 0, 0, 0);
+
+  return log;
+}
+
+/// Runs in the helper.
+static void write_diagnostics(std::byte* region, const wgpu::CompilationInfo& info)
+{
+  RegionHeader header;
+  size_t offset = sizeof(RegionHeader);
+
+  for (size_t idx = 0; idx < info.messageCount; ++idx) {
+    const wgpu::CompilationMessage& msg = info.messages[idx];
+    std::string_view message = msg.message;
+
+    // Counted even if its diagnostic doesn't fit, since the shader is invalid either way
+    header.has_error |= msg.type == wgpu::CompilationMessageType::Error ? 1 : 0;
+
+    if (sizeof(DiagnosticHeader) + message.size() > CompileSandbox::REGION_SIZE - offset)
+      continue;
+
+    DiagnosticHeader diag = {
+      .type = static_cast<uint32_t>(msg.type),
+      .message_size = static_cast<uint32_t>(message.size()),
+      .line_num = msg.lineNum,
+      .line_pos = msg.linePos,
+      .offset = msg.offset,
+      .length = msg.length,
+    };
+
+    std::memcpy(region + offset, &diag, sizeof(DiagnosticHeader));
+    offset += sizeof(DiagnosticHeader);
+    std::memcpy(region + offset, message.data(), message.size());
+    offset += message.size();
+    ++header.diagnostic_count;
+  }
+
+  std::memcpy(region, &header, sizeof(RegionHeader));
+}
+
+/// Runs in the app. The region is written by another process, so nothing in it is trusted.
+static CompileSandbox::Result read_diagnostics(std::string_view code, const std::byte* region)
+{
+  RegionHeader header;
+  std::memcpy(&header, region, sizeof(RegionHeader));
+
+  CompileSandbox::Result result = {
+    .status = header.has_error != 0 ? CompileSandbox::Result::Status::Invalid
+                                    : CompileSandbox::Result::Status::Valid,
+    .diagnostics = CompilationLog(code),
+  };
+
+  size_t offset = sizeof(RegionHeader);
+
+  for (uint32_t idx = 0; idx < header.diagnostic_count; ++idx) {
+    DiagnosticHeader diag;
+
+    if (CompileSandbox::REGION_SIZE - offset < sizeof(DiagnosticHeader))
+      break;
+
+    std::memcpy(&diag, region + offset, sizeof(DiagnosticHeader));
+    offset += sizeof(DiagnosticHeader);
+
+    auto type = static_cast<wgpu::CompilationMessageType>(diag.type);
+
+    if (diag.message_size > CompileSandbox::REGION_SIZE - offset
+        || (type != wgpu::CompilationMessageType::Error
+            && type != wgpu::CompilationMessageType::Warning
+            && type != wgpu::CompilationMessageType::Info)) {
+      break;
+    }
+
+    wgpu::CompilationMessage msg = {
+      .message = { reinterpret_cast<const char*>(region + offset), diag.message_size },
+      .type = type,
+      .lineNum = diag.line_num,
+      .linePos = diag.line_pos,
+      .offset = diag.offset,
+      .length = diag.length,
+    };
+
+    create::add_diagnostic(result.diagnostics, msg);
+    offset += diag.message_size;
+  }
+
+  return result;
+}
+
+/// Runs in the helper.
+static wgpu::Device acquire_worker_device(const wgpu::Instance& instance)
+{
+  wgpu::Adapter adapter;
+
+  // The front-end doesn't depend on the adapter, and a software one keeps every helper from
+  // holding a context on the GPU. Any adapter will do if there's no software one
+  for (bool force_fallback : { true, false }) {
+    wgpu::RequestAdapterOptions adapter_opts = {
+      .featureLevel = wgpu::FeatureLevel::Core,
+      .forceFallbackAdapter = force_fallback,
+    };
+
+    instance.WaitAny(instance.RequestAdapter(&adapter_opts, wgpu::CallbackMode::WaitAnyOnly,
+                         [&adapter](wgpu::RequestAdapterStatus status,
+                             wgpu::Adapter acquired_adapter, wgpu::StringView) {
+                           if (status == wgpu::RequestAdapterStatus::Success)
+                             adapter = std::move(acquired_adapter);
+                         }),
+        Renderer::WAIT_TIMEOUT_MAX);
+
+    if (adapter)
+      break;
+  }
+
+  if (!adapter)
+    throw Exception("No WebGPU adapter is available to compile helpers");
+
+  wgpu::DeviceDescriptor device_desc;
+
+  // Invalid shaders are expected, and their errors are reported as diagnostics instead
+  device_desc.SetUncapturedErrorCallback(
+      [](const wgpu::Device&, wgpu::ErrorType, wgpu::StringView) { });
+
+  wgpu::Device device;
+
+  instance.WaitAny(adapter.RequestDevice(&device_desc, wgpu::CallbackMode::WaitAnyOnly,
+                       [&device](wgpu::RequestDeviceStatus status, wgpu::Device acquired_device,
+                           wgpu::StringView) {
+                         if (status == wgpu::RequestDeviceStatus::Success)
+                           device = std::move(acquired_device);
+                       }),
+      Renderer::WAIT_TIMEOUT_MAX);
+
+  if (!device)
+    throw Exception("Compile helper failed to acquire a WebGPU device");
+
+  return device;
+}
+
+/// Pipes are only marked close-on-exec after they're created, so another supervisor spawning
+/// in between would leak them into its helper. A helper would then never see its requests end.
+static std::mutex spawn_mutex;
+
+enum class WaitStatus {
+  Ready,
+  /// Nothing is left to read, since the helper exited.
+  Exited,
+  TimedOut,
+  /// The sandbox is being destroyed.
+  Stopped,
+};
+
+/// Waits for the helper to write a byte.
+static WaitStatus wait_for(int fd, int stop_fd, std::chrono::steady_clock::duration timeout)
+{
+  const auto deadline = std::chrono::steady_clock::now() + timeout;
+
+  while (true) {
+    auto remaining = std::chrono::ceil<std::chrono::milliseconds>(
+        deadline - std::chrono::steady_clock::now());
+
+    if (remaining.count() <= 0)
+      return WaitStatus::TimedOut;
+
+    std::array<pollfd, 2> fds = { {
+        { .fd = fd, .events = POLLIN, .revents = 0 },
+        { .fd = stop_fd, .events = POLLIN, .revents = 0 },
+    } };
+
+    if (poll(fds.data(), fds.size(), static_cast<int>(remaining.count())) < 0) {
+      if (errno == EINTR)
+        continue;
+
+      return WaitStatus::Exited;
+    }
+
+    if (fds[1].revents != 0)
+      return WaitStatus::Stopped;
+
+    if (fds[0].revents != 0) {
+      char byte = 0;
+      return read(fd, &byte, 1) == 1 ? WaitStatus::Ready : WaitStatus::Exited;
+    }
+  }
+}
+
+/// Helper process, along with its region and both pipes. Killed once destroyed.
+class WorkerProcess {
+  public:
+  WorkerProcess() = default;
+  ~WorkerProcess();
+
+  WorkerProcess(const WorkerProcess&) = delete;
+  WorkerProcess& operator=(const WorkerProcess&) = delete;
+
+  /// Returns null if the helper didn't become ready within `STARTUP_TIMEOUT`.
+  static std::unique_ptr<WorkerProcess> start(
+      const std::filesystem::path& executable_path, std::string region_name, int stop_fd);
+
+  CompileSandbox::Result check(std::string_view code, int stop_fd);
+
+  private:
+  ipc::SharedMemory memory_;
+  pid_t pid_ = -1;
+  /// Write end, which the helper reads requests from.
+  int request_fd_ = -1;
+  /// Read end, which the helper writes responses to.
+  int response_fd_ = -1;
+};
+
+WorkerProcess::~WorkerProcess()
+{
+  if (request_fd_ >= 0)
+    close(request_fd_);
+
+  if (response_fd_ >= 0)
+    close(response_fd_);
+
+  // Helpers keep no state, so there's nothing to shut down gracefully, and a hung one wouldn't
+  if (pid_ > 0) {
+    kill(pid_, SIGKILL);
+    waitpid(pid_, nullptr, 0);
+  }
+}
+
+std::unique_ptr<WorkerProcess> WorkerProcess::start(
+    const std::filesystem::path& executable_path, std::string region_name, int stop_fd)
+{
+  auto worker = std::make_unique<WorkerProcess>();
+  worker->memory_ = ipc::SharedMemory::create(region_name, CompileSandbox::REGION_SIZE);
+
+  {
+    std::lock_guard lock(spawn_mutex);
+
+    std::array<int, 2> request_pipe = { -1, -1 };
+    std::array<int, 2> response_pipe = { -1, -1 };
+
+    if (pipe(request_pipe.data()) != 0)
+      throw Exception("Failed to create a pipe: {}", std::strerror(errno));
+
+    worker->request_fd_ = request_pipe[1];
+
+    if (pipe(response_pipe.data()) != 0) {
+      close(request_pipe[0]);
+      throw Exception("Failed to create a pipe: {}", std::strerror(errno));
+    }
+
+    worker->response_fd_ = response_pipe[0];
+
+    for (int fd : { request_pipe[0], request_pipe[1], response_pipe[0], response_pipe[1] })
+      fcntl(fd, F_SETFD, FD_CLOEXEC);
+
+    // Duplicates don't inherit close-on-exec, so the helper keeps its ends as stdin and stdout
+    posix_spawn_file_actions_t file_actions;
+    posix_spawn_file_actions_init(&file_actions);
+    posix_spawn_file_actions_adddup2(&file_actions, request_pipe[0], STDIN_FILENO);
+    posix_spawn_file_actions_adddup2(&file_actions, response_pipe[1], STDOUT_FILENO);
+
+    // Own process group, so signals from the terminal, like Ctrl+C, only reach the app
+    posix_spawnattr_t attributes;
+    posix_spawnattr_init(&attributes);
+    posix_spawnattr_setflags(&attributes, POSIX_SPAWN_SETPGROUP);
+    posix_spawnattr_setpgroup(&attributes, 0);
+
+    std::string executable = executable_path.string();
+    std::string option(CompileSandbox::WORKER_OPTION);
+    std::array<char*, 4> argv = { executable.data(), option.data(), region_name.data(), nullptr };
+
+    int error = posix_spawn(
+        &worker->pid_, executable.c_str(), &file_actions, &attributes, argv.data(), environ);
+
+    posix_spawnattr_destroy(&attributes);
+    posix_spawn_file_actions_destroy(&file_actions);
+    close(request_pipe[0]);
+    close(response_pipe[1]);
+
+    if (error != 0) {
+      worker->pid_ = -1;
+      throw Exception("Failed to launch \"{}\": {}", executable, std::strerror(error));
+    }
+  }
+
+  // Helpers write a byte once their device is ready
+  if (wait_for(worker->response_fd_, stop_fd, CompileSandbox::STARTUP_TIMEOUT)
+      != WaitStatus::Ready) {
+    return nullptr;
+  }
+
+  return worker;
+}
+
+CompileSandbox::Result WorkerProcess::check(std::string_view code, int stop_fd)
+{
+  using Status = CompileSandbox::Result::Status;
+
+  if (code.size() > PAYLOAD_CAPACITY)
+    return {};
+
+  RegionHeader header = { .code_size = code.size() };
+  std::memcpy(memory_.data(), &header, sizeof(RegionHeader));
+  std::memcpy(memory_.data() + sizeof(RegionHeader), code.data(), code.size());
+
+  const char byte = 0;
+
+  if (write(request_fd_, &byte, 1) == 1) {
+    switch (wait_for(response_fd_, stop_fd, CompileSandbox::TIMEOUT)) {
+    case WaitStatus::Ready: return read_diagnostics(code, memory_.data());
+    case WaitStatus::Stopped: return {};
+
+    case WaitStatus::TimedOut:
+      return {
+        .status = Status::TimedOut,
+        .diagnostics = make_error_log(code,
+            std::format("Shader compiler didn't finish within {} s and was stopped, so the "
+                        "shader wasn't compiled",
+                CompileSandbox::TIMEOUT.count())),
+      };
+
+    case WaitStatus::Exited: break;
+    }
+  }
+
+  return {
+    .status = Status::Crashed,
+    .diagnostics = make_error_log(code, "Shader compiler crashed, so the shader wasn't compiled"),
+  };
+}
+#endif
+
+bool CompileSandbox::Result::should_compile() const
+{
+  return status == Status::Valid || status == Status::Unavailable;
+}
+
+const std::string& CompileSandbox::Check::code() const { return code_; }
+
+bool CompileSandbox::Check::is_done() const { return is_done_.load(std::memory_order_acquire); }
+
+void CompileSandbox::Check::wait() const { is_done_.wait(false, std::memory_order_acquire); }
+
+const CompileSandbox::Result& CompileSandbox::Check::result() const { return result_; }
+
+CompileSandbox::CompileSandbox()
+{
+#if !defined(SDL_PLATFORM_WIN32)
+  // Otherwise writing to a helper that just crashed would take the app down with it
+  std::signal(SIGPIPE, SIG_IGN);
+
+  if (pipe(stop_pipe_.data()) != 0) {
+    std::println("Failed to create the compile sandbox, shaders are compiled without it");
+    stop_pipe_ = { -1, -1 };
+    return;
+  }
+
+  for (int fd : stop_pipe_)
+    fcntl(fd, F_SETFD, FD_CLOEXEC);
+
+  executable_path_ = fs::get_executable_path();
+
+  const uint32_t worker_count
+      = std::clamp(std::thread::hardware_concurrency() / 2, 1u, MAX_WORKER_COUNT);
+
+  for (size_t idx = 0; idx < worker_count; ++idx)
+    supervisors_.emplace_back(&CompileSandbox::supervise, this, idx);
+
+  if constexpr (query::is_debug())
+    std::println("Checking shaders in {} sandboxed compile helper(s)", worker_count);
+#endif
+}
+
+CompileSandbox::~CompileSandbox()
+{
+  {
+    std::lock_guard lock(mutex_);
+    is_stopping_ = true;
+  }
+
+  queued_.notify_all();
+
+#if !defined(SDL_PLATFORM_WIN32)
+  if (stop_pipe_[1] >= 0)
+    close(stop_pipe_[1]);
+#endif
+
+  for (std::thread& supervisor : supervisors_)
+    supervisor.join();
+
+  // Someone may still be waiting on these
+  for (const std::shared_ptr<Check>& check : queue_)
+    finish(*check, {});
+
+#if !defined(SDL_PLATFORM_WIN32)
+  if (stop_pipe_[0] >= 0)
+    close(stop_pipe_[0]);
+#endif
+}
+
+size_t CompileSandbox::worker_count() const { return supervisors_.size(); }
+
+std::shared_ptr<const CompileSandbox::Check> CompileSandbox::submit(std::string code)
+{
+  auto check = std::make_shared<Check>();
+  check->code_ = std::move(code);
+
+  if (supervisors_.empty()) {
+    finish(*check, {});
+    return check;
+  }
+
+  {
+    std::lock_guard lock(mutex_);
+    queue_.push_back(check);
+  }
+
+  queued_.notify_one();
+
+  return check;
+}
+
+int CompileSandbox::run_worker([[maybe_unused]] std::string_view region_name)
+{
+#if defined(SDL_PLATFORM_WIN32)
+  std::println("Compile helpers aren't supported on Windows");
+  return EXIT_FAILURE;
+#else
+  // Responses go through the original stdout. Anything printed afterwards, like by Dawn, goes
+  // to stderr instead, so it can't be mistaken for a response
+  const int response_fd = dup(STDOUT_FILENO);
+  dup2(STDERR_FILENO, STDOUT_FILENO);
+
+  ipc::SharedMemory memory = ipc::SharedMemory::open(region_name);
+
+  if (memory.size() < REGION_SIZE)
+    throw Exception("Compile helper region \"{}\" is too small", region_name);
+
+  auto timed_wait_any = wgpu::InstanceFeatureName::TimedWaitAny;
+  wgpu::InstanceDescriptor instance_desc = {
+    .requiredFeatureCount = 1,
+    .requiredFeatures = &timed_wait_any,
+  };
+
+  wgpu::Instance instance = wgpu::CreateInstance(&instance_desc);
+
+  if (!instance)
+    throw Exception("WebGPU instance creation failed");
+
+  wgpu::Device device = acquire_worker_device(instance);
+
+  const char byte = 0;
+
+  if (write(response_fd, &byte, 1) != 1)
+    return EXIT_FAILURE;
+
+  // Requests end once the app closes its end, which also happens if it crashes
+  char request = 0;
+
+  while (read(STDIN_FILENO, &request, 1) == 1) {
+    RegionHeader header;
+    std::memcpy(&header, memory.data(), sizeof(RegionHeader));
+
+    std::string code(reinterpret_cast<const char*>(memory.data() + sizeof(RegionHeader)),
+        std::min<uint64_t>(header.code_size, PAYLOAD_CAPACITY));
+
+    wgpu::ShaderSourceWGSL shader_source_wgsl = { { .code = code } };
+
+    wgpu::ShaderModuleDescriptor shader_module_desc = {
+      .nextInChain = &shader_source_wgsl,
+      .label = "sandboxed-frag-shader",
+    };
+
+    wgpu::ShaderModule shader = device.CreateShaderModule(&shader_module_desc);
+    // Exceptions can't unwind through Dawn, so failures are only thrown once it has returned
+    std::optional<wgpu::CompilationInfoRequestStatus> info_status;
+
+    wgpu::WaitStatus status = instance.WaitAny(
+        shader.GetCompilationInfo(wgpu::CallbackMode::WaitAnyOnly,
+            [&memory, &info_status](
+                wgpu::CompilationInfoRequestStatus status, const wgpu::CompilationInfo* info) {
+              info_status = status;
+
+              if (status == wgpu::CompilationInfoRequestStatus::Success)
+                write_diagnostics(memory.data(), *info);
+            }),
+        Renderer::WAIT_TIMEOUT_MAX);
+
+    if (status != wgpu::WaitStatus::Success)
+      throw Exception("Waiting on wgpu::ShaderModule::GetCompilationInfo failed");
+
+    if (info_status != wgpu::CompilationInfoRequestStatus::Success)
+      throw Exception("Failed to request shader compilation info");
+
+    if (write(response_fd, &byte, 1) != 1)
+      break;
+  }
+
+  return EXIT_SUCCESS;
+#endif
+}
+
+void CompileSandbox::supervise([[maybe_unused]] size_t idx)
+{
+#if !defined(SDL_PLATFORM_WIN32)
+  std::unique_ptr<WorkerProcess> worker;
+  uint32_t generation = 0;
+  uint32_t start_failures = 0;
+
+  while (true) {
+    // Launched before taking the next check, so checks don't have to wait for it to start
+    if (!worker && start_failures < MAX_START_FAILURES) {
+      // Unique per launch, since a killed helper may not have unmapped the previous region
+      std::string region_name = std::format("mewo-compile-{}-{}-{}", getpid(), idx, generation++);
+
+      try {
+        worker = WorkerProcess::start(executable_path_, std::move(region_name), stop_pipe_[0]);
+      } catch (const std::exception& ex) {
+        std::println("Failed to launch compile helper. {}", ex.what());
+      }
+
+      start_failures = worker ? 0 : start_failures + 1;
+
+      if (start_failures == MAX_START_FAILURES) {
+        std::println(
+            "Compile helper {} failed to start {} times, its shaders aren't sandboxed anymore",
+            idx, MAX_START_FAILURES);
+      }
+    }
+
+    std::shared_ptr<Check> next;
+
+    {
+      std::unique_lock lock(mutex_);
+      queued_.wait(lock, [this] { return is_stopping_ || !queue_.empty(); });
+
+      if (is_stopping_)
+        return;
+
+      next = std::move(queue_.front());
+      queue_.pop_front();
+    }
+
+    Result result = worker ? worker->check(next->code_, stop_pipe_[0]) : Result {};
+
+    // Relaunched before the next check
+    if (result.status == Result::Status::TimedOut || result.status == Result::Status::Crashed) {
+      std::println("Compile helper {} {}, relaunching it", idx,
+          result.status == Result::Status::TimedOut ? "timed out" : "crashed");
+      worker.reset();
+    }
+
+    finish(*next, std::move(result));
+  }
+#endif
+}
+
+void CompileSandbox::finish(Check& check, Result result)
+{
+  check.result_ = std::move(result);
+  check.is_done_.store(true, std::memory_order_release);
+  check.is_done_.notify_all();
+}
+
+}
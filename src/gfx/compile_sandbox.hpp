@@ -0,0 +1,118 @@
+#pragma once
+
+#include "gfx/compilation_diagnostic.hpp"
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <filesystem>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+namespace mewo::gfx {
+
+/// Runs the WGSL front-end over shaders in a pool of helper processes before they're compiled
+/// in-process, so code that hangs or crashes the compiler only takes a helper down with it.
+/// Helpers are this same executable, launched with `WORKER_OPTION`. Code and diagnostics are
+/// exchanged through shared memory, and a pipe in each direction signals when they're ready.
+///
+/// Every helper has a thread supervising it, which kills and relaunches the helper once a
+/// check takes longer than `TIMEOUT`. Checks can be submitted from any thread, and are spread
+/// over all helpers, so they run in parallel.
+///
+/// Backend compilation needs the app's own device, so it still happens in-process. There are
+/// no helpers on Windows, or wherever they fail to start, and checks report `Unavailable`.
+class CompileSandbox {
+  public:
+  static constexpr std::string_view WORKER_OPTION = "--compile-worker";
+  static constexpr auto TIMEOUT = std::chrono::seconds(5);
+  /// Helpers acquire a device of their own first, which can take a while.
+  static constexpr auto STARTUP_TIMEOUT = std::chrono::seconds(15);
+  static constexpr uint32_t MAX_WORKER_COUNT = 4;
+  /// A helper that fails to start this many times in a row isn't launched again.
+  static constexpr uint32_t MAX_START_FAILURES = 3;
+  /// Shared with each helper. Code that doesn't fit isn't checked.
+  static constexpr size_t REGION_SIZE = 4 * 1024 * 1024;
+
+  struct Result {
+    enum class Status {
+      /// Passed the front-end, so compiling it in-process is safe.
+      Valid,
+      /// Failed the front-end. Compiling it in-process would only fail the same way.
+      Invalid,
+      /// The helper was killed before it finished.
+      TimedOut,
+      Crashed,
+      /// Couldn't be checked, so it has to be compiled in-process like without a sandbox.
+      Unavailable,
+    };
+
+    Status status = Status::Unavailable;
+    /// Reported by the helper, or a single error saying why it didn't finish.
+    CompilationLog diagnostics;
+
+    /// False if compiling in-process is known to fail or to be unsafe.
+    bool should_compile() const;
+  };
+
+  /// Shared between whoever submitted it and the helper checking it.
+  class Check {
+    public:
+    const std::string& code() const;
+    bool is_done() const;
+    /// Blocks until done, which may take up to `TIMEOUT`, or longer while helpers are starting.
+    void wait() const;
+    /// Only call once done.
+    const Result& result() const;
+
+    private:
+    friend class CompileSandbox;
+
+    std::string code_;
+    Result result_;
+    std::atomic<bool> is_done_ = false;
+  };
+
+  /// Starts launching helpers in the background.
+  CompileSandbox();
+  /// Stops every helper. Checks that haven't finished report `Unavailable`.
+  ~CompileSandbox();
+
+  CompileSandbox(const CompileSandbox&) = delete;
+  CompileSandbox& operator=(const CompileSandbox&) = delete;
+
+  size_t worker_count() const;
+
+  /// Queues the code for the next free helper. Poll the check until it's done.
+  std::shared_ptr<const Check> submit(std::string code);
+
+  /// Entry point of helper processes, given the shared memory region to use. Returns the
+  /// process' exit status.
+  static int run_worker(std::string_view region_name);
+
+  private:
+  /// Body of each supervising thread.
+  void supervise(size_t idx);
+  static void finish(Check& check, Result result);
+
+  std::filesystem::path executable_path_;
+
+  std::mutex mutex_;
+  std::condition_variable queued_;
+  std::deque<std::shared_ptr<Check>> queue_;
+  bool is_stopping_ = false;
+
+  /// Closing the write end wakes supervisors that are waiting on their helper.
+  std::array<int, 2> stop_pipe_ = { -1, -1 };
+  std::vector<std::thread> supervisors_;
+};
+
+}
@@ -2,6 +2,7 @@
 
 #include "exception.hpp"
 #include "gfx/compilation_diagnostic.hpp"
+#include "gfx/memory_tracker.hpp"
 #include "gfx/renderer.hpp"
 #include "utility.hpp"
 
@@ -9,9 +10,8 @@
 
 #include <cstddef>
 #include <optional>
-#include <string>
 #include <string_view>
-#include <vector>
+#include <utility>
 
 namespace mewo::gfx::create {
 
@@ -29,6 +29,13 @@ static std::string_view get_compilation_mesage_type(wgpu::CompilationMessageType
   }
 }
 
+void add_diagnostic(CompilationLog& log, const wgpu::CompilationMessage& msg)
+{
+  // TODO: subtract line number by the number of lines in the frag prefix
+  log.add(msg.message, get_compilation_mesage_type(msg.type), msg.lineNum, msg.linePos,
+      msg.offset, msg.length);
+}
+
 ShaderCompilationResult shader_module_from_wgsl(
     const Renderer& renderer, std::string_view code, std::string_view label)
 {
@@ -40,31 +47,21 @@ ShaderCompilationResult shader_module_from_wgsl(
   };
 
   wgpu::ShaderModule shader = renderer.device().CreateShaderModule(&shader_module_desc);
-  std::vector<CompilationDiagnostic> diagnostics;
+  CompilationLog diagnostics(code);
   bool did_error_occur = false;
 
   wgpu::WaitStatus shader_status = renderer.instance().WaitAny(
       shader.GetCompilationInfo(wgpu::CallbackMode::WaitAnyOnly,
-          [&diagnostics, &did_error_occur, &code](
+          [&diagnostics, &did_error_occur](
               wgpu::CompilationInfoRequestStatus status, const wgpu::CompilationInfo* info) {
             if (status != wgpu::CompilationInfoRequestStatus::Success)
               throw Exception("Failed to request shader compilation info");
 
-            auto count = info->messageCount;
-            diagnostics.reserve(count);
-
-            for (size_t idx = 0; idx < count; ++idx) {
+            for (size_t idx = 0; idx < info->messageCount; ++idx) {
               const wgpu::CompilationMessage& msg = info->messages[idx];
 
               did_error_occur |= msg.type == wgpu::CompilationMessageType::Error;
-              diagnostics.push_back({
-                  .message = std::string(msg.message),
-                  .type_name = get_compilation_mesage_type(msg.type),
-                  // TODO: subtract line number by the number of lines in the frag prefix
-                  .line_num = msg.lineNum,
-                  .line_pos = msg.linePos,
-                  .highlight = std::string(code.substr(msg.offset, msg.length)),
-              });
+              add_diagnostic(diagnostics, msg);
             }
           }),
       Renderer::WAIT_TIMEOUT_MAX);
@@ -72,7 +69,38 @@ ShaderCompilationResult shader_module_from_wgsl(
   if (shader_status != wgpu::WaitStatus::Success)
     throw Exception("Waiting on wgpu::ShaderModule::GetCompilationInfo failed");
 
-  return { did_error_occur ? std::nullopt : std::optional(shader), diagnostics };
+  return { did_error_occur ? std::nullopt : std::optional(shader), std::move(diagnostics) };
+}
+
+wgpu::ShaderModule shader_module_from_checked_wgsl(
+    const Renderer& renderer, std::string_view code, std::string_view label)
+{
+  wgpu::ShaderSourceWGSL shader_source_wgsl = { { .code = code } };
+
+  wgpu::ShaderModuleDescriptor shader_module_desc = {
+    .nextInChain = &shader_source_wgsl,
+    .label = label,
+  };
+
+  return renderer.device().CreateShaderModule(&shader_module_desc);
+}
+
+Tracked<wgpu::Buffer> buffer(
+    const Renderer& renderer, const wgpu::BufferDescriptor& desc, MemoryTracker::Category category)
+{
+  return {
+    renderer.device().CreateBuffer(&desc),
+    renderer.memory_tracker().track(category, desc.size),
+  };
+}
+
+Tracked<wgpu::Texture> texture(const Renderer& renderer, const wgpu::TextureDescriptor& desc,
+    MemoryTracker::Category category)
+{
+  return {
+    renderer.device().CreateTexture(&desc),
+    renderer.memory_tracker().track(category, MemoryTracker::get_texture_size(desc)),
+  };
 }
 
 }
@@ -1,6 +1,7 @@
 #pragma once
 
 #include "gfx/compilation_diagnostic.hpp"
+#include "gfx/memory_tracker.hpp"
 #include "gfx/renderer.hpp"
 
 #include <webgpu/webgpu_cpp.h>
@@ -8,14 +9,30 @@
 #include <optional>
 #include <string_view>
 #include <utility>
-#include <vector>
 
 namespace mewo::gfx::create {
 
-using ShaderCompilationResult
-    = std::pair<std::optional<wgpu::ShaderModule>, std::vector<CompilationDiagnostic>>;
+using ShaderCompilationResult = std::pair<std::optional<wgpu::ShaderModule>, CompilationLog>;
 
+/// Adds the message to a log made with the code it refers to.
+void add_diagnostic(CompilationLog& log, const wgpu::CompilationMessage& msg);
+
+/// Blocks until compilation info is available. Prefer `async::shader_module_from_wgsl` on the
+/// main thread.
 ShaderCompilationResult shader_module_from_wgsl(
     const Renderer& renderer, std::string_view code, std::string_view label);
+/// For code the compile sandbox found valid, whose diagnostics are already known. Doesn't wait
+/// for compilation info, since the helpers' devices have no features the app's lacks, so the
+/// front-end can't come to a different conclusion.
+wgpu::ShaderModule shader_module_from_checked_wgsl(
+    const Renderer& renderer, std::string_view code, std::string_view label);
+
+/// Creates a buffer whose size is counted by the renderer's memory tracker.
+Tracked<wgpu::Buffer> buffer(
+    const Renderer& renderer, const wgpu::BufferDescriptor& desc, MemoryTracker::Category category);
+
+/// Creates a texture whose size is counted by the renderer's memory tracker.
+Tracked<wgpu::Texture> texture(const Renderer& renderer, const wgpu::TextureDescriptor& desc,
+    MemoryTracker::Category category);
 
 }
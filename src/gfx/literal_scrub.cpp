@@ -0,0 +1,318 @@
+#include "literal_scrub.hpp"
+
+#include "gfx/create.hpp"
+
+#include <cctype>
+#include <charconv>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <format>
+#include <iterator>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <system_error>
+#include <vector>
+
+namespace mewo::gfx {
+
+static constexpr uint64_t BUFFER_SIZE = LiteralScrub::MAX_LITERAL_COUNT * sizeof(float);
+
+static bool is_word_char(char c) { return std::isalnum(static_cast<unsigned char>(c)) || c == '_'; }
+
+static bool is_digit(char c) { return std::isdigit(static_cast<unsigned char>(c)); }
+
+/// Returns the index right after the comment. Block comments nest in WGSL.
+static size_t skip_block_comment(std::string_view code, size_t idx)
+{
+  size_t depth = 0;
+
+  for (; idx < code.size(); ++idx) {
+    char next = idx + 1 < code.size() ? code[idx + 1] : '\0';
+
+    if (code[idx] == '/' && next == '*') {
+      ++depth;
+      ++idx;
+    } else if (code[idx] == '*' && next == '/') {
+      ++idx;
+
+      if (--depth == 0)
+        return idx + 1;
+    }
+  }
+
+  return code.size();
+}
+
+/// Starts right after the `@`, and returns the index right after the attribute's arguments.
+static size_t skip_attribute(std::string_view code, size_t idx)
+{
+  while (idx < code.size() && is_word_char(code[idx]))
+    ++idx;
+
+  while (idx < code.size() && std::isspace(static_cast<unsigned char>(code[idx])))
+    ++idx;
+
+  if (idx >= code.size() || code[idx] != '(')
+    return idx;
+
+  for (size_t paren_depth = 0; idx < code.size(); ++idx) {
+    if (code[idx] == '(')
+      ++paren_depth;
+    else if (code[idx] == ')' && --paren_depth == 0)
+      return idx + 1;
+  }
+
+  return code.size();
+}
+
+/// Numbers may contain a decimal point and a signed exponent, like `1.5e-3`.
+static size_t skip_number(std::string_view code, size_t idx)
+{
+  for (++idx; idx < code.size(); ++idx) {
+    char curr = code[idx];
+    char prev = code[idx - 1];
+
+    bool is_exponent_sign = (curr == '+' || curr == '-')
+        && (prev == 'e' || prev == 'E' || prev == 'p' || prev == 'P');
+
+    if (!is_word_char(curr) && curr != '.' && !is_exponent_sign)
+      break;
+  }
+
+  return idx;
+}
+
+/// Only decimal literals that are floats, either abstract or `f32`. Integers and `f16` aren't
+/// scrubbed.
+static std::optional<float> parse_float(std::string_view token)
+{
+  if (token.starts_with("0x") || token.starts_with("0X"))
+    return std::nullopt;
+
+  const bool has_suffix = token.ends_with('f');
+
+  if (has_suffix)
+    token.remove_suffix(1);
+  else if (token.find_first_of(".eE") == std::string_view::npos)
+    return std::nullopt;
+
+  float value = 0.f;
+  auto [end, error] = std::from_chars(token.data(), token.data() + token.size(), value);
+
+  if (error != std::errc() || end != token.data() + token.size())
+    return std::nullopt;
+
+  return value;
+}
+
+/// Skips comments, module scope, attributes, and `const` declarations and assertions, which all
+/// need constant expressions.
+static std::vector<LiteralScrub::Literal> find_literals(std::string_view code)
+{
+  std::vector<LiteralScrub::Literal> literals;
+  size_t brace_depth = 0;
+  bool is_constant = false;
+  size_t idx = 0;
+
+  while (idx < code.size() && literals.size() < LiteralScrub::MAX_LITERAL_COUNT) {
+    char curr = code[idx];
+    char next = idx + 1 < code.size() ? code[idx + 1] : '\0';
+
+    if (curr == '/' && next == '/') {
+      idx = code.find('\n', idx);
+      continue;
+    }
+
+    if (curr == '/' && next == '*') {
+      idx = skip_block_comment(code, idx);
+      continue;
+    }
+
+    if (curr == '@') {
+      idx = skip_attribute(code, idx + 1);
+      continue;
+    }
+
+    // Member accesses start with a dot too, but never continue with a digit
+    if (is_digit(curr)
+        || (curr == '.' && is_digit(next) && (idx == 0 || !is_word_char(code[idx - 1])))) {
+      size_t end = skip_number(code, idx);
+
+      if (brace_depth > 0 && !is_constant) {
+        if (auto value = parse_float(code.substr(idx, end - idx)); value.has_value()) {
+          literals.push_back({
+              .offset = idx,
+              .length = end - idx,
+              .initial_value = value.value(),
+              .value = value.value(),
+          });
+        }
+      }
+
+      idx = end;
+      continue;
+    }
+
+    // Identifiers can contain digits, which aren't literals
+    if (is_word_char(curr)) {
+      size_t end = idx;
+
+      while (end < code.size() && is_word_char(code[end]))
+        ++end;
+
+      if (std::string_view word = code.substr(idx, end - idx);
+          word == "const" || word == "const_assert") {
+        is_constant = true;
+      }
+
+      idx = end;
+      continue;
+    }
+
+    if (curr == '{')
+      ++brace_depth;
+    else if (curr == '}')
+      brace_depth -= brace_depth > 0 ? 1 : 0;
+    else if (curr == ';')
+      is_constant = false;
+
+    ++idx;
+  }
+
+  return literals;
+}
+
+static std::string format_literal(std::string_view original, float value)
+{
+  if (!std::isfinite(value))
+    return std::string(original);
+
+  std::string text = std::format("{}", value);
+
+  // Whole numbers are formatted without a decimal point, which would make them integers
+  if (text.find_first_of(".e") == std::string::npos)
+    text += ".0";
+
+  if (original.ends_with('f'))
+    text += 'f';
+
+  // Otherwise the sign could merge with a minus before it into a decrement
+  if (std::signbit(value))
+    text = std::format("({})", text);
+
+  return text;
+}
+
+LiteralScrub::LiteralScrub(const Renderer& renderer)
+    : queue_(renderer.queue())
+{
+  wgpu::BufferDescriptor buf_desc = {
+    .label = "literal-scrub-buffer",
+    .usage = wgpu::BufferUsage::Storage | wgpu::BufferUsage::CopyDst,
+    .size = BUFFER_SIZE,
+  };
+
+  buf_ = create::buffer(renderer, buf_desc, MemoryTracker::Category::Uniforms);
+}
+
+bool LiteralScrub::is_active() const { return is_active_; }
+
+const std::string& LiteralScrub::code() const { return code_; }
+
+const std::vector<LiteralScrub::Literal>& LiteralScrub::literals() const { return literals_; }
+
+wgpu::BindGroupLayoutEntry LiteralScrub::bind_group_layout_entry() const
+{
+  return {
+    .binding = BINDING,
+    .visibility = wgpu::ShaderStage::Fragment,
+    .buffer = { .type = wgpu::BufferBindingType::ReadOnlyStorage },
+  };
+}
+
+wgpu::BindGroupEntry LiteralScrub::bind_group_entry() const
+{
+  return { .binding = BINDING, .buffer = buf_, .size = BUFFER_SIZE };
+}
+
+std::optional<std::string> LiteralScrub::start(std::string_view code)
+{
+  std::vector<Literal> literals = find_literals(code);
+
+  if (literals.empty())
+    return std::nullopt;
+
+  std::vector<float> values;
+  values.reserve(literals.size());
+
+  std::string hoisted;
+  hoisted.reserve(code.size() + literals.size() * (BUFFER_NAME.size() + 6));
+  size_t prev_end = 0;
+
+  for (size_t idx = 0; idx < literals.size(); ++idx) {
+    const Literal& literal = literals[idx];
+
+    hoisted.append(code.substr(prev_end, literal.offset - prev_end));
+    std::format_to(std::back_inserter(hoisted), "{}[{}]", BUFFER_NAME, idx);
+    prev_end = literal.offset + literal.length;
+
+    values.push_back(literal.value);
+  }
+
+  hoisted.append(code.substr(prev_end));
+
+  // Declared after the code, so diagnostics keep their line numbers
+  std::format_to(std::back_inserter(hoisted),
+      "\n\n@group(0) @binding({})\nvar<storage, read> {}: array<f32>;\n", BINDING, BUFFER_NAME);
+
+  queue_.WriteBuffer(buf_, 0, values.data(), values.size() * sizeof(float));
+
+  code_ = std::string(code);
+  literals_ = std::move(literals);
+  is_active_ = true;
+
+  return hoisted;
+}
+
+void LiteralScrub::set_value(size_t idx, float value)
+{
+  if (idx >= literals_.size())
+    return;
+
+  literals_[idx].value = value;
+  queue_.WriteBuffer(buf_, idx * sizeof(float), &value, sizeof(float));
+}
+
+std::string LiteralScrub::finish()
+{
+  std::string baked;
+  baked.reserve(code_.size());
+  size_t prev_end = 0;
+
+  // Literals that weren't dragged keep how they were written
+  for (const Literal& literal : literals_) {
+    if (literal.value == literal.initial_value)
+      continue;
+
+    baked.append(code_, prev_end, literal.offset - prev_end);
+    baked += format_literal(
+        std::string_view(code_).substr(literal.offset, literal.length), literal.value);
+    prev_end = literal.offset + literal.length;
+  }
+
+  baked.append(code_, prev_end);
+  cancel();
+
+  return baked;
+}
+
+void LiteralScrub::cancel()
+{
+  code_.clear();
+  literals_.clear();
+  is_active_ = false;
+}
+
+}
@@ -0,0 +1,73 @@
+#pragma once
+
+#include "gfx/memory_tracker.hpp"
+#include "gfx/noise_textures.hpp"
+#include "gfx/renderer.hpp"
+
+#include <webgpu/webgpu_cpp.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace mewo::gfx {
+
+/// Lets float literals in the visible code be dragged while the viewport follows along, without
+/// compiling anything per step. Starting to scrub hoists the literals out of the code into a
+/// storage buffer, each read back by its ID, and only that code is compiled. Dragging a literal
+/// then just writes its entry of the buffer. Finishing bakes the final values into the code.
+///
+/// Only float literals inside functions are hoisted. Everything else is either an integer, which
+/// often has to stay a constant expression, or part of a `const` or `override` declaration.
+///
+/// Bound to every user fragment shader after the noise textures, whether or not the shader reads
+/// it. Only hoisted code declares it.
+class LiteralScrub {
+  public:
+  static constexpr uint32_t BINDING = NoiseTextures::FIRST_BINDING + NoiseTextures::BINDING_COUNT;
+  /// Literals past this many are left in the code.
+  static constexpr uint32_t MAX_LITERAL_COUNT = 1024;
+  static constexpr std::string_view BUFFER_NAME = "mw_literals";
+
+  struct Literal {
+    /// Into the code scrubbing started with.
+    size_t offset = 0;
+    size_t length = 0;
+    float initial_value = 0.f;
+    float value = 0.f;
+  };
+
+  explicit LiteralScrub(const Renderer& renderer);
+
+  bool is_active() const;
+  /// Code scrubbing started with. Literals point into it, so it doesn't change until finished.
+  const std::string& code() const;
+  /// Ordered by their offset, which is also their ID.
+  const std::vector<Literal>& literals() const;
+
+  wgpu::BindGroupLayoutEntry bind_group_layout_entry() const;
+  wgpu::BindGroupEntry bind_group_entry() const;
+
+  /// Finds the literals and uploads their values. Returns the code with every literal replaced
+  /// by a read from the buffer, or nothing if there's no literal to scrub.
+  std::optional<std::string> start(std::string_view code);
+  /// Writes the one entry of the buffer, which the next frame reads.
+  void set_value(size_t idx, float value);
+  /// Returns the code scrubbing started with, with changed literals replaced by their values.
+  std::string finish();
+  /// Like finishing, for when the code is replaced anyway.
+  void cancel();
+
+  private:
+  wgpu::Queue queue_;
+  Tracked<wgpu::Buffer> buf_;
+
+  std::string code_;
+  std::vector<Literal> literals_;
+  bool is_active_ = false;
+};
+
+}
@@ -0,0 +1,200 @@
+#include "memory_tracker.hpp"
+
+#include "utility.hpp"
+
+#include <webgpu/webgpu_cpp.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <print>
+#include <string_view>
+#include <utility>
+
+namespace mewo::gfx {
+
+static uint64_t get_texel_size(wgpu::TextureFormat format)
+{
+  switch (format) {
+    // clang-format off
+  case wgpu::TextureFormat::R8Unorm: return 1;
+  case wgpu::TextureFormat::RG8Unorm: return 2;
+  case wgpu::TextureFormat::R16Float: return 2;
+  case wgpu::TextureFormat::RGBA8Unorm: return 4;
+  case wgpu::TextureFormat::RGBA8UnormSrgb: return 4;
+  case wgpu::TextureFormat::BGRA8Unorm: return 4;
+  case wgpu::TextureFormat::BGRA8UnormSrgb: return 4;
+  case wgpu::TextureFormat::RGB10A2Unorm: return 4;
+  case wgpu::TextureFormat::RG11B10Ufloat: return 4;
+  case wgpu::TextureFormat::R32Float: return 4;
+  case wgpu::TextureFormat::RG16Float: return 4;
+  case wgpu::TextureFormat::RGBA16Float: return 8;
+  case wgpu::TextureFormat::RG32Float: return 8;
+  case wgpu::TextureFormat::RGBA32Float: return 16;
+    // clang-format on
+
+  // Surfaces use whatever format the platform prefers, which is almost always 4 bytes per
+  // texel. Only an estimate either way
+  default:
+    return 4;
+  }
+}
+
+MemoryTracker::Allocation::Allocation(MemoryTracker& tracker, Category category, uint64_t size)
+    : tracker_(&tracker)
+    , category_(category)
+    , size_(size)
+{
+}
+
+MemoryTracker::Allocation::~Allocation() { release(); }
+
+MemoryTracker::Allocation::Allocation(Allocation&& other) noexcept
+    : tracker_(std::exchange(other.tracker_, nullptr))
+    , category_(other.category_)
+    , size_(std::exchange(other.size_, 0))
+{
+}
+
+MemoryTracker::Allocation& MemoryTracker::Allocation::operator=(Allocation&& other) noexcept
+{
+  if (this != &other) {
+    release();
+
+    tracker_ = std::exchange(other.tracker_, nullptr);
+    category_ = other.category_;
+    size_ = std::exchange(other.size_, 0);
+  }
+
+  return *this;
+}
+
+void MemoryTracker::Allocation::release()
+{
+  if (!tracker_)
+    return;
+
+  tracker_->subtract(category_, size_);
+
+  tracker_ = nullptr;
+  size_ = 0;
+}
+
+uint64_t MemoryTracker::Counter::add(uint64_t size)
+{
+  uint64_t new_live = live.fetch_add(size, std::memory_order_relaxed) + size;
+  uint64_t prev_peak = peak.load(std::memory_order_relaxed);
+
+  // Another thread may raise the peak in between, in which case try again
+  while (new_live > prev_peak
+      && !peak.compare_exchange_weak(prev_peak, new_live, std::memory_order_relaxed)) { }
+
+  return new_live;
+}
+
+void MemoryTracker::Counter::subtract(uint64_t size)
+{
+  live.fetch_sub(size, std::memory_order_relaxed);
+}
+
+MemoryTracker::MemoryTracker(uint64_t budget)
+    : budget_(budget)
+{
+}
+
+std::string_view MemoryTracker::get_category_name(Category category)
+{
+  switch (category) {
+    // clang-format off
+  case Category::RenderTargets: return "Render targets";
+  case Category::Surface: return "Surface";
+  case Category::Thumbnails: return "Thumbnails";
+  case Category::Noise: return "Noise";
+  case Category::Scopes: return "Scopes";
+  case Category::Uniforms: return "Uniforms";
+  case Category::Readback: return "Readback";
+  case Category::Gui: return "GUI";
+    // clang-format on
+
+  default:
+    utility::enum_unreachable("MemoryTracker::Category", category);
+  }
+}
+
+uint64_t MemoryTracker::get_texture_size(const wgpu::TextureDescriptor& desc)
+{
+  uint64_t texel_size = get_texel_size(desc.format);
+  uint64_t size = 0;
+
+  for (uint32_t level = 0; level < desc.mipLevelCount; ++level) {
+    uint64_t width = std::max(desc.size.width >> level, 1u);
+    uint64_t height = std::max(desc.size.height >> level, 1u);
+
+    size += width * height * desc.size.depthOrArrayLayers * texel_size;
+  }
+
+  return size * desc.sampleCount;
+}
+
+uint64_t MemoryTracker::budget() const { return budget_; }
+
+MemoryTracker::Usage MemoryTracker::usage(Category category) const
+{
+  const Counter& counter = counters_[static_cast<size_t>(category)];
+
+  return {
+    .live = counter.live.load(std::memory_order_relaxed),
+    .peak = counter.peak.load(std::memory_order_relaxed),
+  };
+}
+
+MemoryTracker::Usage MemoryTracker::total() const
+{
+  return {
+    .live = total_.live.load(std::memory_order_relaxed),
+    .peak = total_.peak.load(std::memory_order_relaxed),
+  };
+}
+
+MemoryTracker::Allocation MemoryTracker::track(Category category, uint64_t size)
+{
+  add(category, size);
+  return Allocation(*this, category, size);
+}
+
+void MemoryTracker::set_sampled(Category category, uint64_t size)
+{
+  Counter& counter = counters_[static_cast<size_t>(category)];
+
+  // Sampled categories are only ever set from one thread, so the swap doesn't need to be
+  // atomic with the following updates
+  uint64_t prev_size = counter.live.load(std::memory_order_relaxed);
+
+  if (size > prev_size)
+    add(category, size - prev_size);
+  else if (size < prev_size)
+    subtract(category, prev_size - size);
+}
+
+void MemoryTracker::add(Category category, uint64_t size)
+{
+  counters_[static_cast<size_t>(category)].add(size);
+  uint64_t new_total = total_.add(size);
+
+  // Only warn when crossing the budget, not on every allocation while over it
+  if (new_total > budget_ && !is_over_budget_.exchange(true, std::memory_order_relaxed)) {
+    std::println("Warning: GPU memory use of {} MiB is over the budget of {} MiB",
+        new_total >> 20, budget_ >> 20);
+  }
+}
+
+void MemoryTracker::subtract(Category category, uint64_t size)
+{
+  counters_[static_cast<size_t>(category)].subtract(size);
+  total_.subtract(size);
+
+  if (total_.live.load(std::memory_order_relaxed) <= budget_)
+    is_over_budget_.store(false, std::memory_order_relaxed);
+}
+
+}
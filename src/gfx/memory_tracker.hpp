@@ -0,0 +1,128 @@
+#pragma once
+
+#include <webgpu/webgpu_cpp.h>
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+#include <utility>
+
+namespace mewo::gfx {
+
+/// Keeps count of how much GPU memory the app holds, split into categories. Sizes are
+/// estimated from descriptors, since WebGPU doesn't expose the driver's actual allocations.
+///
+/// Counters are atomics updated only when objects are created or released, so this is
+/// cheap enough to always leave on.
+class MemoryTracker {
+  public:
+  enum class Category : size_t {
+    /// Textures the app renders into, like the viewport's.
+    RenderTargets,
+    /// Textures owned by the surface. Estimated, since the driver decides how many there are.
+    Surface,
+    Thumbnails,
+    /// Precomputed noise bound to every user shader.
+    Noise,
+    /// Counts and textures of the viewport's scopes.
+    Scopes,
+    Uniforms,
+    /// Short-lived buffers for reading data back from the GPU.
+    Readback,
+    /// Textures and buffers owned by Dear ImGui's backend. Sampled once per frame.
+    Gui,
+    Count,
+  };
+
+  static constexpr size_t CATEGORY_COUNT = static_cast<size_t>(Category::Count);
+
+  struct Usage {
+    uint64_t live = 0;
+    /// Highest `live` has been since launch.
+    uint64_t peak = 0;
+  };
+
+  /// Releases its bytes from the tracker once destroyed, so it should live exactly as long
+  /// as the object it was created for.
+  class Allocation {
+    public:
+    Allocation() = default;
+    ~Allocation();
+
+    Allocation(const Allocation&) = delete;
+    Allocation& operator=(const Allocation&) = delete;
+    Allocation(Allocation&& other) noexcept;
+    Allocation& operator=(Allocation&& other) noexcept;
+
+    private:
+    friend class MemoryTracker;
+
+    Allocation(MemoryTracker& tracker, Category category, uint64_t size);
+    void release();
+
+    MemoryTracker* tracker_ = nullptr;
+    Category category_ = Category::RenderTargets;
+    uint64_t size_ = 0;
+  };
+
+  /// A warning is printed every time the total goes over the budget.
+  explicit MemoryTracker(uint64_t budget);
+
+  MemoryTracker(const MemoryTracker&) = delete;
+  MemoryTracker& operator=(const MemoryTracker&) = delete;
+
+  static std::string_view get_category_name(Category category);
+  /// Includes every mip level and sample.
+  static uint64_t get_texture_size(const wgpu::TextureDescriptor& desc);
+
+  uint64_t budget() const;
+  Usage usage(Category category) const;
+  Usage total() const;
+
+  Allocation track(Category category, uint64_t size);
+  /// For memory that's owned by someone else and can only be sampled, like Dear ImGui's.
+  /// Replaces the previous size of the category.
+  void set_sampled(Category category, uint64_t size);
+
+  private:
+  struct Counter {
+    std::atomic<uint64_t> live = 0;
+    std::atomic<uint64_t> peak = 0;
+
+    /// Returns the new live value.
+    uint64_t add(uint64_t size);
+    void subtract(uint64_t size);
+  };
+
+  void add(Category category, uint64_t size);
+  void subtract(Category category, uint64_t size);
+
+  uint64_t budget_ = 0;
+  std::array<Counter, CATEGORY_COUNT> counters_;
+  Counter total_;
+  std::atomic<bool> is_over_budget_ = false;
+};
+
+/// Pairs a WebGPU object with its tracked allocation, so both are released together.
+/// Converts to the underlying object, so it can be used directly in descriptors.
+template <typename T>
+class Tracked {
+  public:
+  Tracked() = default;
+  Tracked(T object, MemoryTracker::Allocation allocation)
+      : object_(std::move(object))
+      , allocation_(std::move(allocation))
+  {
+  }
+
+  const T& get() const { return object_; }
+  operator const T&() const { return object_; }
+
+  private:
+  T object_;
+  MemoryTracker::Allocation allocation_;
+};
+
+}
@@ -0,0 +1,498 @@
+#include "noise_textures.hpp"
+
+#include "fs.hpp"
+#include "gfx/create.hpp"
+
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <chrono>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <exception>
+#include <filesystem>
+#include <limits>
+#include <numbers>
+#include <optional>
+#include <print>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace mewo::gfx {
+
+static constexpr std::string_view CACHE_SUBDIR = "noise";
+static constexpr std::string_view CACHE_FILE_NAME = "noise.bin";
+static constexpr std::array<char, 8> MAGIC = { 'M', 'E', 'W', 'O', 'N', 'O', 'I', 'S' };
+/// Bumped whenever the generated contents change, so outdated caches are generated again.
+static constexpr uint32_t GENERATOR_VERSION = 1;
+
+static constexpr uint32_t BLUE_NOISE_BYTE_SIZE
+    = NoiseTextures::BLUE_NOISE_SIZE * NoiseTextures::BLUE_NOISE_SIZE;
+static constexpr uint32_t VOLUME_BYTE_SIZE
+    = NoiseTextures::VOLUME_SIZE * NoiseTextures::VOLUME_SIZE * NoiseTextures::VOLUME_SIZE * 4;
+static constexpr uint32_t ROTATION_TABLE_BYTE_SIZE
+    = NoiseTextures::ROTATION_TABLE_SIZE * NoiseTextures::ROTATION_TABLE_SIZE * 4;
+
+/// Independent sequences of random numbers, one for each generated channel.
+enum class Stream : uint32_t {
+  BlueNoise,
+  ValueNoise0,
+  ValueNoise1,
+  Perlin0,
+  Perlin1,
+  Rotation,
+  Jitter0,
+  Jitter1,
+};
+
+struct CacheHeader {
+  std::array<char, 8> magic = MAGIC;
+  uint32_t version = GENERATOR_VERSION;
+  uint32_t reserved = 0;
+};
+
+static_assert(std::is_trivially_copyable_v<CacheHeader>);
+
+/// PCG hash. Unlike the standard library's distributions, it gives the same results on
+/// every platform.
+static constexpr uint32_t get_random(uint32_t seed)
+{
+  uint32_t state = seed * 747796405u + 2891336453u;
+  uint32_t word = ((state >> ((state >> 28u) + 4u)) ^ state) * 277803737u;
+
+  return (word >> 22u) ^ word;
+}
+
+static uint32_t get_random(Stream stream, uint32_t idx)
+{
+  return get_random(idx + get_random(std::to_underlying(stream)));
+}
+
+/// In [0, 1).
+static float get_random_unit(Stream stream, uint32_t idx)
+{
+  return static_cast<float>(get_random(stream, idx) >> 8) / static_cast<float>(1 << 24);
+}
+
+static char to_unorm8(float value)
+{
+  return static_cast<char>(
+      static_cast<uint8_t>(std::lround(std::clamp(value, 0.f, 1.f) * 255.f)));
+}
+
+/// Void-and-cluster, which ranks every pixel so that the first pixels of any rank are spread
+/// as evenly as possible, wrapping around the edges.
+static std::string generate_blue_noise()
+{
+  constexpr uint32_t SIZE = NoiseTextures::BLUE_NOISE_SIZE;
+  constexpr uint32_t PIXEL_COUNT = SIZE * SIZE;
+  constexpr uint32_t MASK = SIZE - 1;
+  constexpr float SIGMA = 1.5f;
+
+  static_assert(std::has_single_bit(SIZE), "Offsets wrap around with a mask");
+
+  // Energy a point adds at each offset from it
+  std::vector<float> kernel(PIXEL_COUNT);
+
+  for (uint32_t y = 0; y < SIZE; ++y) {
+    for (uint32_t x = 0; x < SIZE; ++x) {
+      auto dx = static_cast<float>(std::min(x, SIZE - x));
+      auto dy = static_cast<float>(std::min(y, SIZE - y));
+
+      kernel[y * SIZE + x] = std::exp(-(dx * dx + dy * dy) / (2.f * SIGMA * SIGMA));
+    }
+  }
+
+  std::vector<bool> is_set(PIXEL_COUNT);
+  std::vector<float> energy(PIXEL_COUNT);
+
+  auto toggle = [&](uint32_t idx) {
+    const float sign = is_set[idx] ? -1.f : 1.f;
+    const uint32_t px = idx % SIZE;
+    const uint32_t py = idx / SIZE;
+
+    is_set[idx] = !is_set[idx];
+
+    for (uint32_t y = 0; y < SIZE; ++y) {
+      for (uint32_t x = 0; x < SIZE; ++x)
+        energy[y * SIZE + x] += sign * kernel[((y - py) & MASK) * SIZE + ((x - px) & MASK)];
+    }
+  };
+
+  // Most crowded set pixel, or emptiest unset one
+  auto find = [&](bool is_cluster) {
+    uint32_t found_idx = 0;
+    float found_energy = is_cluster ? -1.f : std::numeric_limits<float>::infinity();
+
+    for (uint32_t idx = 0; idx < PIXEL_COUNT; ++idx) {
+      if (is_set[idx] != is_cluster)
+        continue;
+
+      if (is_cluster ? energy[idx] > found_energy : energy[idx] < found_energy) {
+        found_idx = idx;
+        found_energy = energy[idx];
+      }
+    }
+
+    return found_idx;
+  };
+
+  // Starts from a tenth of the pixels placed at random
+  constexpr uint32_t INITIAL_COUNT = PIXEL_COUNT / 10;
+
+  for (uint32_t placed_count = 0, attempt = 0; placed_count < INITIAL_COUNT; ++attempt) {
+    if (uint32_t idx = get_random(Stream::BlueNoise, attempt) % PIXEL_COUNT; !is_set[idx]) {
+      toggle(idx);
+      ++placed_count;
+    }
+  }
+
+  // Moves the most crowded point into the emptiest spot, until it would go right back.
+  // Bounded in case it ends up cycling between a few spots
+  for (uint32_t step = 0; step < PIXEL_COUNT; ++step) {
+    const uint32_t cluster_idx = find(true);
+    toggle(cluster_idx);
+
+    const uint32_t void_idx = find(false);
+    toggle(void_idx);
+
+    if (void_idx == cluster_idx)
+      break;
+  }
+
+  const std::vector<bool> initial_is_set = is_set;
+  const std::vector<float> initial_energy = energy;
+  std::vector<uint32_t> ranks(PIXEL_COUNT);
+
+  // Initial points are ranked by removing the most crowded one each time
+  for (uint32_t rank = INITIAL_COUNT; rank-- > 0;) {
+    const uint32_t cluster_idx = find(true);
+    toggle(cluster_idx);
+    ranks[cluster_idx] = rank;
+  }
+
+  is_set = initial_is_set;
+  energy = initial_energy;
+
+  // Every other pixel is ranked by filling the emptiest spot each time
+  for (uint32_t rank = INITIAL_COUNT; rank < PIXEL_COUNT; ++rank) {
+    const uint32_t void_idx = find(false);
+    toggle(void_idx);
+    ranks[void_idx] = rank;
+  }
+
+  std::string pixels(PIXEL_COUNT, '\0');
+
+  for (uint32_t idx = 0; idx < PIXEL_COUNT; ++idx)
+    pixels[idx] = static_cast<char>(static_cast<uint8_t>(ranks[idx] * 256 / PIXEL_COUNT));
+
+  return pixels;
+}
+
+/// Gradient noise whose lattice repeats every `period` cells, so it tiles. Roughly in [-1, 1].
+static float get_perlin(const std::array<float, 3>& p, uint32_t period, Stream stream)
+{
+  // Edges of a cube, which avoid the directional bias of random gradients
+  static constexpr std::array<std::array<float, 3>, 12> GRADIENTS = { {
+      { 1, 1, 0 },
+      { -1, 1, 0 },
+      { 1, -1, 0 },
+      { -1, -1, 0 },
+      { 1, 0, 1 },
+      { -1, 0, 1 },
+      { 1, 0, -1 },
+      { -1, 0, -1 },
+      { 0, 1, 1 },
+      { 0, -1, 1 },
+      { 0, 1, -1 },
+      { 0, -1, -1 },
+  } };
+
+  std::array<uint32_t, 3> cell = {};
+  std::array<float, 3> offset = {};
+  std::array<float, 3> fade = {};
+
+  for (size_t axis = 0; axis < 3; ++axis) {
+    const float cell_start = std::floor(p[axis]);
+    const float t = p[axis] - cell_start;
+
+    cell[axis] = static_cast<uint32_t>(cell_start);
+    offset[axis] = t;
+    fade[axis] = t * t * t * (t * (t * 6.f - 15.f) + 10.f);
+  }
+
+  std::array<float, 8> corner_values = {};
+
+  for (uint32_t corner = 0; corner < 8; ++corner) {
+    uint32_t lattice_idx = 0;
+    float value = 0.f;
+
+    for (size_t axis = 0; axis < 3; ++axis) {
+      const uint32_t step = (corner >> axis) & 1;
+      lattice_idx = lattice_idx * period + (cell[axis] + step) % period;
+    }
+
+    const auto& gradient = GRADIENTS[get_random(stream, lattice_idx) % GRADIENTS.size()];
+
+    for (size_t axis = 0; axis < 3; ++axis)
+      value += gradient[axis] * (offset[axis] - static_cast<float>((corner >> axis) & 1));
+
+    corner_values[corner] = value;
+  }
+
+  // Collapses one axis at a time
+  for (size_t axis = 0, count = 8; axis < 3; ++axis, count /= 2) {
+    for (size_t idx = 0; idx < count / 2; ++idx) {
+      corner_values[idx]
+          = std::lerp(corner_values[idx * 2], corner_values[idx * 2 + 1], fade[axis]);
+    }
+  }
+
+  return corner_values[0];
+}
+
+static std::string generate_volume()
+{
+  constexpr uint32_t SIZE = NoiseTextures::VOLUME_SIZE;
+  constexpr float TEXELS_PER_CELL
+      = static_cast<float>(SIZE) / static_cast<float>(NoiseTextures::PERLIN_PERIOD);
+
+  std::string texels(VOLUME_BYTE_SIZE, '\0');
+
+  for (uint32_t idx = 0; idx < SIZE * SIZE * SIZE; ++idx) {
+    // Evaluated at texel centers, which is where sampling hits them exactly
+    const std::array<float, 3> p = {
+      (static_cast<float>(idx % SIZE) + 0.5f) / TEXELS_PER_CELL,
+      (static_cast<float>(idx / SIZE % SIZE) + 0.5f) / TEXELS_PER_CELL,
+      (static_cast<float>(idx / (SIZE * SIZE)) + 0.5f) / TEXELS_PER_CELL,
+    };
+
+    const float perlin0 = get_perlin(p, NoiseTextures::PERLIN_PERIOD, Stream::Perlin0);
+    const float perlin1 = get_perlin(p, NoiseTextures::PERLIN_PERIOD, Stream::Perlin1);
+
+    char* texel = texels.data() + idx * 4;
+    texel[0] = to_unorm8(get_random_unit(Stream::ValueNoise0, idx));
+    texel[1] = to_unorm8(get_random_unit(Stream::ValueNoise1, idx));
+    texel[2] = to_unorm8(0.5f + 0.5f * perlin0);
+    texel[3] = to_unorm8(0.5f + 0.5f * perlin1);
+  }
+
+  return texels;
+}
+
+static std::string generate_rotation_table()
+{
+  constexpr uint32_t SIZE = NoiseTextures::ROTATION_TABLE_SIZE;
+
+  std::string texels(ROTATION_TABLE_BYTE_SIZE, '\0');
+
+  for (uint32_t idx = 0; idx < SIZE * SIZE; ++idx) {
+    const float angle = 2.f * std::numbers::pi_v<float> * get_random_unit(Stream::Rotation, idx);
+
+    char* texel = texels.data() + idx * 4;
+    texel[0] = to_unorm8(0.5f + 0.5f * std::cos(angle));
+    texel[1] = to_unorm8(0.5f + 0.5f * std::sin(angle));
+    texel[2] = to_unorm8(get_random_unit(Stream::Jitter0, idx));
+    texel[3] = to_unorm8(get_random_unit(Stream::Jitter1, idx));
+  }
+
+  return texels;
+}
+
+NoiseTextures::NoiseTextures(const Renderer& renderer, jobs::System& jobs)
+{
+  const wgpu::Device& device = renderer.device();
+
+  // Repeats, so noise tiles without the shader having to wrap coordinates
+  wgpu::SamplerDescriptor sampler_desc = {
+    .label = "noise-sampler",
+    .addressModeU = wgpu::AddressMode::Repeat,
+    .addressModeV = wgpu::AddressMode::Repeat,
+    .addressModeW = wgpu::AddressMode::Repeat,
+    .magFilter = wgpu::FilterMode::Linear,
+    .minFilter = wgpu::FilterMode::Linear,
+  };
+
+  sampler_ = device.CreateSampler(&sampler_desc);
+
+  wgpu::TextureDescriptor blue_noise_desc = {
+    .label = "noise-blue-noise-texture",
+    .usage = wgpu::TextureUsage::TextureBinding | wgpu::TextureUsage::CopyDst,
+    .size = { .width = BLUE_NOISE_SIZE, .height = BLUE_NOISE_SIZE },
+    .format = wgpu::TextureFormat::R8Unorm,
+  };
+
+  wgpu::TextureDescriptor volume_desc = {
+    .label = "noise-volume-texture",
+    .usage = wgpu::TextureUsage::TextureBinding | wgpu::TextureUsage::CopyDst,
+    .dimension = wgpu::TextureDimension::e3D,
+    .size = { .width = VOLUME_SIZE, .height = VOLUME_SIZE, .depthOrArrayLayers = VOLUME_SIZE },
+    .format = wgpu::TextureFormat::RGBA8Unorm,
+  };
+
+  wgpu::TextureDescriptor rotation_table_desc = {
+    .label = "noise-rotation-table-texture",
+    .usage = wgpu::TextureUsage::TextureBinding | wgpu::TextureUsage::CopyDst,
+    .size = { .width = ROTATION_TABLE_SIZE, .height = ROTATION_TABLE_SIZE },
+    .format = wgpu::TextureFormat::RGBA8Unorm,
+  };
+
+  blue_noise_ = create::texture(renderer, blue_noise_desc, MemoryTracker::Category::Noise);
+  blue_noise_view_ = blue_noise_.get().CreateView();
+  volume_ = create::texture(renderer, volume_desc, MemoryTracker::Category::Noise);
+  volume_view_ = volume_.get().CreateView();
+  rotation_table_ = create::texture(renderer, rotation_table_desc, MemoryTracker::Category::Noise);
+  rotation_table_view_ = rotation_table_.get().CreateView();
+
+  auto load = [file_path = fs::get_cache_path(CACHE_SUBDIR) / CACHE_FILE_NAME](
+                  const jobs::CancellationToken&) -> Contents {
+    // Missing, truncated, and outdated caches are all generated again
+    try {
+      if (std::filesystem::exists(file_path)) {
+        if (std::optional<Contents> contents = parse(fs::read_file(file_path)))
+          return std::move(contents.value());
+      }
+    } catch (const std::exception& ex) {
+      std::println("Failed to read noise texture cache. {}", ex.what());
+    }
+
+    auto start = std::chrono::steady_clock::now();
+    Contents contents = generate();
+    std::chrono::duration<double, std::milli> duration = std::chrono::steady_clock::now() - start;
+
+    std::println("Generated noise textures in {:.2f} ms", duration.count());
+
+    try {
+      fs::write_file(file_path, serialize(contents));
+    } catch (const std::exception& ex) {
+      std::println("Failed to cache noise textures. {}", ex.what());
+    }
+
+    return contents;
+  };
+
+  auto finish = [this, &renderer](Contents contents) {
+    upload(renderer, contents);
+    is_ready_ = true;
+  };
+
+  jobs.submit(jobs::Priority::High, jobs_token_, std::move(load), std::move(finish));
+}
+
+NoiseTextures::~NoiseTextures() { jobs_token_.cancel(); }
+
+bool NoiseTextures::is_ready() const { return is_ready_; }
+
+std::array<wgpu::BindGroupLayoutEntry, NoiseTextures::BINDING_COUNT>
+NoiseTextures::bind_group_layout_entries() const
+{
+  return { {
+      {
+          .binding = FIRST_BINDING,
+          .visibility = wgpu::ShaderStage::Fragment,
+          .sampler = { .type = wgpu::SamplerBindingType::Filtering },
+      },
+      {
+          .binding = FIRST_BINDING + 1,
+          .visibility = wgpu::ShaderStage::Fragment,
+          .texture = { .sampleType = wgpu::TextureSampleType::Float },
+      },
+      {
+          .binding = FIRST_BINDING + 2,
+          .visibility = wgpu::ShaderStage::Fragment,
+          .texture = {
+              .sampleType = wgpu::TextureSampleType::Float,
+              .viewDimension = wgpu::TextureViewDimension::e3D,
+          },
+      },
+      {
+          .binding = FIRST_BINDING + 3,
+          .visibility = wgpu::ShaderStage::Fragment,
+          .texture = { .sampleType = wgpu::TextureSampleType::Float },
+      },
+  } };
+}
+
+std::array<wgpu::BindGroupEntry, NoiseTextures::BINDING_COUNT>
+NoiseTextures::bind_group_entries() const
+{
+  return { {
+      { .binding = FIRST_BINDING, .sampler = sampler_ },
+      { .binding = FIRST_BINDING + 1, .textureView = blue_noise_view_ },
+      { .binding = FIRST_BINDING + 2, .textureView = volume_view_ },
+      { .binding = FIRST_BINDING + 3, .textureView = rotation_table_view_ },
+  } };
+}
+
+NoiseTextures::Contents NoiseTextures::generate()
+{
+  return {
+    .blue_noise = generate_blue_noise(),
+    .volume = generate_volume(),
+    .rotation_table = generate_rotation_table(),
+  };
+}
+
+std::optional<NoiseTextures::Contents> NoiseTextures::parse(std::string_view data)
+{
+  if (data.size() != sizeof(CacheHeader) + BLUE_NOISE_BYTE_SIZE + VOLUME_BYTE_SIZE
+          + ROTATION_TABLE_BYTE_SIZE) {
+    return std::nullopt;
+  }
+
+  CacheHeader header;
+  std::memcpy(&header, data.data(), sizeof(CacheHeader));
+
+  if (header.magic != MAGIC || header.version != GENERATOR_VERSION)
+    return std::nullopt;
+
+  data.remove_prefix(sizeof(CacheHeader));
+
+  return Contents {
+    .blue_noise = std::string(data.substr(0, BLUE_NOISE_BYTE_SIZE)),
+    .volume = std::string(data.substr(BLUE_NOISE_BYTE_SIZE, VOLUME_BYTE_SIZE)),
+    .rotation_table = std::string(data.substr(BLUE_NOISE_BYTE_SIZE + VOLUME_BYTE_SIZE)),
+  };
+}
+
+std::string NoiseTextures::serialize(const Contents& contents)
+{
+  CacheHeader header;
+  std::string data(sizeof(CacheHeader), '\0');
+  std::memcpy(data.data(), &header, sizeof(CacheHeader));
+
+  data += contents.blue_noise;
+  data += contents.volume;
+  data += contents.rotation_table;
+
+  return data;
+}
+
+void NoiseTextures::upload(const Renderer& renderer, const Contents& contents) const
+{
+  const wgpu::Queue& queue = renderer.queue();
+
+  auto write = [&queue](const wgpu::Texture& texture, std::string_view texels,
+                   uint32_t bytes_per_texel, const wgpu::Extent3D& extent) {
+    wgpu::TexelCopyTextureInfo destination = { .texture = texture };
+
+    wgpu::TexelCopyBufferLayout layout = {
+      .bytesPerRow = extent.width * bytes_per_texel,
+      .rowsPerImage = extent.height,
+    };
+
+    queue.WriteTexture(&destination, texels.data(), texels.size(), &layout, &extent);
+  };
+
+  write(blue_noise_, contents.blue_noise, 1, { BLUE_NOISE_SIZE, BLUE_NOISE_SIZE });
+  write(volume_, contents.volume, 4, { VOLUME_SIZE, VOLUME_SIZE, VOLUME_SIZE });
+  write(
+      rotation_table_, contents.rotation_table, 4, { ROTATION_TABLE_SIZE, ROTATION_TABLE_SIZE });
+}
+
+}
@@ -0,0 +1,82 @@
+#pragma once
+
+#include "gfx/memory_tracker.hpp"
+#include "gfx/renderer.hpp"
+#include "jobs.hpp"
+
+#include <webgpu/webgpu_cpp.h>
+
+#include <array>
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <string_view>
+
+namespace mewo::gfx {
+
+/// Noise and lookup textures bound to every user fragment shader, next to the uniforms, so
+/// shaders can sample noise instead of computing it from hashes. The fragment shader prefix
+/// declares them along with helper functions.
+///
+/// Generating them takes a while, blue noise especially, so it's only done the first time
+/// and then cached on disk. Either happens in a job. The textures exist right away so they
+/// can be bound, but read as zero until their contents are uploaded.
+class NoiseTextures {
+  public:
+  /// Follows the uniform buffer in group 0.
+  static constexpr uint32_t FIRST_BINDING = 1;
+  /// Sampler, blue noise, noise volume, and rotation table.
+  static constexpr uint32_t BINDING_COUNT = 4;
+
+  /// Tiles over the screen in pixels. One channel, with every value appearing equally often.
+  static constexpr uint32_t BLUE_NOISE_SIZE = 64;
+  /// Red and green hold random values per texel, for value noise. Blue and alpha hold
+  /// Perlin noise with `PERLIN_PERIOD` cells across the volume.
+  static constexpr uint32_t VOLUME_SIZE = 32;
+  static constexpr uint32_t PERLIN_PERIOD = 8;
+  /// Red and green hold the cosine and sine of a random angle, blue and alpha two more
+  /// random values.
+  static constexpr uint32_t ROTATION_TABLE_SIZE = 64;
+
+  /// Starts reading the textures from the disk cache, or generating them if they aren't
+  /// cached yet.
+  NoiseTextures(const Renderer& renderer, jobs::System& jobs);
+  ~NoiseTextures();
+
+  NoiseTextures(const NoiseTextures&) = delete;
+  NoiseTextures& operator=(const NoiseTextures&) = delete;
+
+  bool is_ready() const;
+
+  std::array<wgpu::BindGroupLayoutEntry, BINDING_COUNT> bind_group_layout_entries() const;
+  std::array<wgpu::BindGroupEntry, BINDING_COUNT> bind_group_entries() const;
+
+  private:
+  /// Tightly packed, in each texture's format.
+  struct Contents {
+    std::string blue_noise;
+    std::string volume;
+    std::string rotation_table;
+  };
+
+  static Contents generate();
+  /// Empty if the file was written by a different version of the generator.
+  static std::optional<Contents> parse(std::string_view data);
+  static std::string serialize(const Contents& contents);
+
+  void upload(const Renderer& renderer, const Contents& contents) const;
+
+  jobs::CancellationToken jobs_token_;
+
+  wgpu::Sampler sampler_;
+  Tracked<wgpu::Texture> blue_noise_;
+  wgpu::TextureView blue_noise_view_;
+  Tracked<wgpu::Texture> volume_;
+  wgpu::TextureView volume_view_;
+  Tracked<wgpu::Texture> rotation_table_;
+  wgpu::TextureView rotation_table_view_;
+
+  bool is_ready_ = false;
+};
+
+}
@@ -1,5 +1,6 @@
 #include "renderer.hpp"
 
+#include "create.hpp"
 #include "exception.hpp"
 #include "query.hpp"
 #include "utility.hpp"
@@ -10,10 +11,16 @@
 #include <webgpu/webgpu_cpp.h>
 
 #include <array>
+#include <cstdint>
 #include <functional>
+#include <future>
 #include <optional>
 #include <print>
+#include <string>
 #include <string_view>
+#include <tuple>
+#include <utility>
+#include <vector>
 
 #if defined(SDL_PLATFORM_WIN32)
 #include <windows.h>
@@ -28,7 +35,7 @@ static std::string_view get_surface_texture_status(wgpu::SurfaceGetCurrentTextur
   case wgpu::SurfaceGetCurrentTextureStatus::SuccessOptimal: return "SuccessOptimal";
   case wgpu::SurfaceGetCurrentTextureStatus::SuccessSuboptimal: return "SuccessSuboptimal";
   case wgpu::SurfaceGetCurrentTextureStatus::Timeout: return "Timeout";
-  case wgpu::SurfaceGetCurrentTextureStatus::Outdated: return "Viewportdated";
+  case wgpu::SurfaceGetCurrentTextureStatus::Outdated: return "Outdated";
   case wgpu::SurfaceGetCurrentTextureStatus::Lost: return "Lost";
   case wgpu::SurfaceGetCurrentTextureStatus::Error: return "Error";
     // clang-format on
@@ -38,7 +45,65 @@ static std::string_view get_surface_texture_status(wgpu::SurfaceGetCurrentTextur
   }
 }
 
-Renderer::Renderer(const sdl::Window& window)
+/// Describes the native window, so Dear ImGui's helper can create a WebGPU surface for it.
+static ImGui_ImplWGPU_CreateSurfaceInfo get_create_surface_info(
+    const wgpu::Instance& instance, SDL_PropertiesID properties_id)
+{
+#if defined(SDL_PLATFORM_MACOS)
+  return {
+    .Instance = instance.Get(),
+    .System = "cocoa",
+    .RawWindow = static_cast<void*>(
+        SDL_GetPointerProperty(properties_id, SDL_PROP_WINDOW_COCOA_WINDOW_POINTER, nullptr)),
+  };
+#elif defined(SDL_PLATFORM_WIN32)
+  return {
+    .Instance = instance.Get(),
+    .System = "win32",
+    .RawWindow = static_cast<void*>(
+        SDL_GetPointerProperty(properties_id, SDL_PROP_WINDOW_WIN32_HWND_POINTER, nullptr)),
+    .RawInstance = static_cast<void*>(GetModuleHandle(nullptr)),
+  };
+#elif defined(SDL_PLATFORM_LINUX)
+  // Either display server may be in use, depending on which one SDL picked at runtime
+  const char* video_driver_raw = SDL_GetCurrentVideoDriver();
+  std::string_view video_driver = video_driver_raw ? video_driver_raw : "";
+
+  if (video_driver == "wayland") {
+    return {
+      .Instance = instance.Get(),
+      .System = "wayland",
+      .RawDisplay = SDL_GetPointerProperty(
+          properties_id, SDL_PROP_WINDOW_WAYLAND_DISPLAY_POINTER, nullptr),
+      .RawSurface = SDL_GetPointerProperty(
+          properties_id, SDL_PROP_WINDOW_WAYLAND_SURFACE_POINTER, nullptr),
+    };
+  }
+
+  if (video_driver == "x11") {
+    Sint64 x11_window = SDL_GetNumberProperty(properties_id, SDL_PROP_WINDOW_X11_WINDOW_NUMBER, 0);
+
+    return {
+      .Instance = instance.Get(),
+      .System = "x11",
+      // X11 windows are integer IDs rather than pointers
+      .RawWindow = reinterpret_cast<void*>(static_cast<uintptr_t>(x11_window)),
+      .RawDisplay
+      = SDL_GetPointerProperty(properties_id, SDL_PROP_WINDOW_X11_DISPLAY_POINTER, nullptr),
+    };
+  }
+
+  throw Exception("Unsupported SDL video driver \"{}\". Supported drivers are x11 and wayland",
+      video_driver);
+#else
+#error "Unsupported platform. Supported platforms are macOS, Windows, and Linux"
+#endif
+}
+
+Renderer::Renderer(const sdl::Window& window, BlobCache& blob_cache,
+    MemoryTracker& memory_tracker, Timeline& timeline, bool is_headless)
+    : is_headless_(is_headless)
+    , memory_tracker_(memory_tracker)
 {
   auto timed_wait_any = wgpu::InstanceFeatureName::TimedWaitAny;
   wgpu::InstanceDescriptor instance_desc = {
@@ -51,35 +116,153 @@ Renderer::Renderer(const sdl::Window& window)
   if (!instance_)
     throw Exception("WebGPU instance creation failed");
 
-  wgpu::Adapter adapter;
-  wgpu::RequestAdapterOptions adapter_opts = {
-    .featureLevel = wgpu::FeatureLevel::Core,
-    .powerPreference = wgpu::PowerPreference::HighPerformance,
-  };
+  // Only needs the instance, so it can be created while the device is being acquired. There
+  // is no native window to present to when headless
+  if (!is_headless_) {
+    SDL_PropertiesID properties_id = SDL_GetWindowProperties(window.get());
 
-  wgpu::WaitStatus adapter_status = instance_.WaitAny(
-      instance_.RequestAdapter(&adapter_opts, wgpu::CallbackMode::WaitAnyOnly,
-          [&adapter](wgpu::RequestAdapterStatus status, wgpu::Adapter acquired_adapter,
-              wgpu::StringView message) {
-            // Throwing here is safe because we wait on callback execution in the current thread
-            if (status != wgpu::RequestAdapterStatus::Success)
-              throw Exception("Failed to request WebGPU adapter: {}", message.data);
+    if (properties_id == 0)
+      throw Exception("Failed to get SDL window properties: {}", SDL_GetError());
 
-            adapter = std::move(acquired_adapter);
-          }),
-      WAIT_TIMEOUT_MAX);
+    ImGui_ImplWGPU_CreateSurfaceInfo create_surface_info
+        = get_create_surface_info(instance_, properties_id);
+
+    if (WGPUSurface raw_surface = ImGui_ImplWGPU_CreateWGPUSurfaceHelper(&create_surface_info);
+        !raw_surface) {
+      throw Exception("Failed to create WebGPU surface");
+    } else {
+      surface_ = wgpu::Surface(raw_surface);
+      surface_.SetLabel("surface");
+    }
 
-  if (!adapter || adapter_status != wgpu::WaitStatus::Success)
-    throw Exception("Waiting on wgpu::Instance::RequestAdapter failed");
+    timeline.mark("Surface created");
+  }
+
+  // The instance is thread-safe, so waiting on it in another thread is fine. Meanwhile, the
+  // main thread can continue with work that doesn't need the device, like loading fonts
+  device_future_ = std::async(std::launch::async,
+      [this, &blob_cache, &timeline] { acquire_device(blob_cache, timeline); });
+}
+
+Renderer::~Renderer()
+{
+  // Can't tear anything down while the background task might still be writing to it
+  if (device_future_.valid())
+    device_future_.wait();
+
+  if (surface_ && surface_config_.device)
+    surface_.Unconfigure();
+}
+
+void Renderer::wait_until_ready(const sdl::Window& window)
+{
+  if (!device_future_.valid())
+    return;
+
+  device_future_.get();
+
+  // Queue is created at the same time as the device so it must exist at this call
+  queue_ = device_.GetQueue();
+
+  auto [width, height] = window.size_in_pixels();
+
+  if (is_headless_) {
+    surface_config_ = {
+      .device = device_,
+      .format = OFFSCREEN_FORMAT,
+      .width = width,
+      .height = height,
+    };
+
+    configure_surface();
+    return;
+  }
+
+  surface_config_ = std::invoke([this, width, height] -> wgpu::SurfaceConfiguration {
+    wgpu::SurfaceCapabilities surface_capabilities;
+
+    if (!surface_.GetCapabilities(adapter_, &surface_capabilities))
+      throw Exception("Failed to get WebGPU surface capabilities");
+
+    return {
+      .device = device_,
+      // There is always at least 1 format if `wgpu::Surface::GetCapabilities` was successful
+      .format = surface_capabilities.formats[0],
+      .width = width,
+      .height = height,
+      // Essentially enables VSync and is supported on all platforms
+      .presentMode = wgpu::PresentMode::Fifo,
+    };
+  });
+
+  configure_surface();
+}
+
+void Renderer::acquire_device(BlobCache& blob_cache, Timeline& timeline)
+{
+  auto [adapter, message] = request_adapter(false);
+
+  // Machines without a GPU, like CI runners, can still run headless on the CPU. This relies
+  // on Dawn being built with SwiftShader
+  if (!adapter && is_headless_) {
+    std::println("No GPU adapter available ({}), trying the fallback adapter", message);
+    std::tie(adapter, message) = request_adapter(true);
+  }
+
+  if (!adapter)
+    throw Exception("Failed to request WebGPU adapter: {}", message);
+
+  adapter_ = std::move(adapter);
+
+  timeline.mark("Adapter acquired");
 
   if constexpr (query::is_debug())
-    ImGui_ImplWGPU_DebugPrintAdapterInfo(adapter.Get());
+    ImGui_ImplWGPU_DebugPrintAdapterInfo(adapter_.Get());
 
   wgpu::DeviceDescriptor device_desc = { {
       .label = "device",
       .defaultQueue = { .label = "default-queue" },
   } };
 
+  // Dawn-specific functionality to load and store compiled shaders and pipelines ourselves,
+  // so they can be persisted across launches
+  wgpu::DawnCacheDeviceDescriptor cache_desc = { {
+      .isolationKey = "mewo",
+      .loadDataFunction = [](const void* key, size_t key_size, void* value, size_t value_size,
+                              void* userdata) -> size_t {
+        auto* cache = static_cast<BlobCache*>(userdata);
+        return cache->load(BlobCache::hash_key(key, key_size), value, value_size);
+      },
+      .storeDataFunction = [](const void* key, size_t key_size, const void* value,
+                               size_t value_size, void* userdata) {
+        auto* cache = static_cast<BlobCache*>(userdata);
+        cache->store(BlobCache::hash_key(key, key_size), value, value_size);
+      },
+      .functionUserdata = &blob_cache,
+  } };
+
+  device_desc.nextInChain = &cache_desc;
+
+  // All are optional, and whatever uses them falls back to something slower without them
+  std::vector<wgpu::FeatureName> required_features;
+
+  // Lets the viewport measure what its quality tiers cost on the GPU
+  if (adapter_.HasFeature(wgpu::FeatureName::TimestampQuery))
+    required_features.push_back(wgpu::FeatureName::TimestampQuery);
+
+  // Dawn-specific functionality that makes the device usable from multiple threads, which
+  // shader warm-up needs
+  if (adapter_.HasFeature(wgpu::FeatureName::ImplicitDeviceSynchronization))
+    required_features.push_back(wgpu::FeatureName::ImplicitDeviceSynchronization);
+
+  // Dawn-specific functionality that lets buffers wrap host memory, which frame output uses
+  // to read the viewport back straight into shared memory
+  if (adapter_.HasFeature(wgpu::FeatureName::HostMappedPointer))
+    required_features.push_back(wgpu::FeatureName::HostMappedPointer);
+
+  device_desc.requiredFeatureCount = required_features.size();
+  device_desc.requiredFeatures = required_features.data();
+
   // Dawn-specific functionality to enable/disable certain runtime features
   if constexpr (query::is_debug()) {
     static constexpr std::array DAWN_ENABLED_TOGGLES = { "enable_immediate_error_handling" };
@@ -89,7 +272,7 @@ Renderer::Renderer(const sdl::Window& window)
         .enabledToggles = DAWN_ENABLED_TOGGLES.data(),
     } };
 
-    device_desc.nextInChain = &DAWN_TOGGLES_DESC;
+    cache_desc.nextInChain = &DAWN_TOGGLES_DESC;
   }
 
   device_desc.SetDeviceLostCallback(
@@ -118,7 +301,7 @@ Renderer::Renderer(const sdl::Window& window)
       &uncaptured_error_);
 
   wgpu::WaitStatus device_status = instance_.WaitAny(
-      adapter.RequestDevice(&device_desc, wgpu::CallbackMode::WaitAnyOnly,
+      adapter_.RequestDevice(&device_desc, wgpu::CallbackMode::WaitAnyOnly,
           [this](wgpu::RequestDeviceStatus status, wgpu::Device acquired_device,
               wgpu::StringView message) {
             // Throwing here is safe because we wait on callback execution in the current thread
@@ -132,73 +315,77 @@ Renderer::Renderer(const sdl::Window& window)
   if (!device_ || device_status != wgpu::WaitStatus::Success)
     throw Exception("Waiting on wgpu::Adapter::RequestDevice failed");
 
-  SDL_PropertiesID properties_id = SDL_GetWindowProperties(window.get());
+  timeline.mark("Device acquired");
+}
 
-  if (properties_id == 0)
-    throw Exception("Failed to get SDL window properties: {}", SDL_GetError());
+const wgpu::Instance& Renderer::instance() const { return instance_; }
 
-  ImGui_ImplWGPU_CreateSurfaceInfo create_surface_info = {
-    .Instance = instance_.Get(),
-#if defined(SDL_PLATFORM_MACOS)
-    .System = "cocoa",
-    .RawWindow = static_cast<void*>(
-        SDL_GetPointerProperty(properties_id, SDL_PROP_WINDOW_COCOA_WINDOW_POINTER, nullptr)),
-#elif defined(SDL_PLATFORM_WIN32)
-    .System = "win32",
-    .RawWindow = static_cast<void*>(
-        SDL_GetPointerProperty(properties_id, SDL_PROP_WINDOW_WIN32_HWND_POINTER, nullptr)),
-    .RawInstance = static_cast<void*>(GetModuleHandle(nullptr)),
-#else
-#error "Unsupported platform. Supported platforms are macOS and Windows"
-#endif
-  };
+const wgpu::Device& Renderer::device() const { return device_; }
 
-  if (WGPUSurface raw_surface = ImGui_ImplWGPU_CreateWGPUSurfaceHelper(&create_surface_info);
-      !raw_surface) {
-    throw Exception("Failed to create WebGPU surface");
-  } else {
-    surface_ = wgpu::Surface(raw_surface);
-    surface_.SetLabel("surface");
-  }
+const wgpu::SurfaceConfiguration& Renderer::surface_config() const { return surface_config_; }
 
-  surface_config_ = std::invoke([this, &window, &adapter] -> wgpu::SurfaceConfiguration {
-    wgpu::SurfaceCapabilities surface_capabilities;
+const wgpu::Queue& Renderer::queue() const { return queue_; }
 
-    if (!surface_.GetCapabilities(adapter, &surface_capabilities))
-      throw Exception("Failed to get WebGPU surface capabilities");
+MemoryTracker& Renderer::memory_tracker() const { return memory_tracker_; }
 
-    auto [width, height] = window.size_in_pixels();
+const Renderer::SurfaceStats& Renderer::surface_stats() const { return surface_stats_; }
 
-    return {
-      .device = device_,
-      // There is always at least 1 format if `wgpu::Surface::GetCapabilities` was successful
-      .format = surface_capabilities.formats[0],
-      .width = width,
-      .height = height,
-      // Essentially enables VSync and is supported on all platforms
-      .presentMode = wgpu::PresentMode::Fifo,
-    };
-  });
+std::pair<wgpu::Adapter, std::string> Renderer::request_adapter(bool force_fallback) const
+{
+  wgpu::RequestAdapterOptions adapter_opts = {
+    .featureLevel = wgpu::FeatureLevel::Core,
+    .powerPreference = wgpu::PowerPreference::HighPerformance,
+    .forceFallbackAdapter = force_fallback,
+  };
 
-  surface_.Configure(&surface_config_);
+  wgpu::Adapter adapter;
+  std::string message;
 
-  // Queue is created at the same time as the device so it must exist at this call
-  queue_ = device_.GetQueue();
-}
+  wgpu::WaitStatus status = instance_.WaitAny(
+      instance_.RequestAdapter(&adapter_opts, wgpu::CallbackMode::WaitAnyOnly,
+          [&adapter, &message](wgpu::RequestAdapterStatus status, wgpu::Adapter acquired_adapter,
+              wgpu::StringView acquired_message) {
+            if (status == wgpu::RequestAdapterStatus::Success)
+              adapter = std::move(acquired_adapter);
+            else
+              message = std::string(acquired_message);
+          }),
+      WAIT_TIMEOUT_MAX);
 
-Renderer::~Renderer() { surface_.Unconfigure(); }
+  if (status != wgpu::WaitStatus::Success)
+    return { nullptr, "Waiting on wgpu::Instance::RequestAdapter failed" };
 
-const wgpu::Instance& Renderer::instance() const { return instance_; }
+  return { adapter, message };
+}
 
-const wgpu::Device& Renderer::device() const { return device_; }
+void Renderer::create_offscreen_texture()
+{
+  wgpu::TextureDescriptor offscreen_desc = {
+    .label = "offscreen-texture",
+    .usage = wgpu::TextureUsage::RenderAttachment | wgpu::TextureUsage::CopySrc,
+    .size = { .width = surface_config_.width, .height = surface_config_.height },
+    .format = surface_config_.format,
+  };
 
-const wgpu::Surface& Renderer::surface() const { return surface_; }
+  offscreen_texture_
+      = create::texture(*this, offscreen_desc, MemoryTracker::Category::RenderTargets);
 
-const wgpu::SurfaceConfiguration& Renderer::surface_config() const { return surface_config_; }
+  static const wgpu::TextureViewDescriptor OFFSCREEN_VIEW_DESC = { .label = "offscreen-view" };
+  offscreen_view_ = offscreen_texture_.get().CreateView(&OFFSCREEN_VIEW_DESC);
+}
 
-const wgpu::Queue& Renderer::queue() const { return queue_; }
+void Renderer::update_surface_memory() const
+{
+  wgpu::TextureDescriptor surface_texture_desc = {
+    .size = { .width = surface_config_.width, .height = surface_config_.height },
+    .format = surface_config_.format,
+  };
+
+  memory_tracker_.set_sampled(MemoryTracker::Category::Surface,
+      SURFACE_TEXTURE_COUNT_ESTIMATE * MemoryTracker::get_texture_size(surface_texture_desc));
+}
 
-FrameContext Renderer::prepare_new_frame()
+std::optional<FrameContext> Renderer::prepare_new_frame()
 {
   if (device_lost_error_.has_value()) {
     const Error& error = device_lost_error_.value();
@@ -213,15 +400,76 @@ FrameContext Renderer::prepare_new_frame()
     uncaptured_error_ = std::nullopt;
   }
 
+  if (pending_size_.has_value()) {
+    auto [new_width, new_height] = pending_size_.value();
+
+    // Minimized windows have no area, and surfaces can't be configured without one
+    if (new_width == 0 || new_height == 0) {
+      ++surface_stats_.skipped_frame_count;
+      return std::nullopt;
+    }
+
+    surface_config_.width = new_width;
+    surface_config_.height = new_height;
+    pending_size_ = std::nullopt;
+    has_handled_suboptimal_ = false;
+
+    configure_surface();
+    ++surface_stats_.reconfigure_count;
+  }
+
+  static const wgpu::CommandEncoderDescriptor COMMAND_ENCODER_DESC = { .label = "command-encoder" };
+
+  if (is_headless_) {
+    return {
+      .surface_view = offscreen_view_,
+      .encoder = device_.CreateCommandEncoder(&COMMAND_ENCODER_DESC),
+    };
+  }
+
   wgpu::SurfaceTexture surface_texture;
   surface_.GetCurrentTexture(&surface_texture);
 
-  if (auto status = surface_texture.status;
-      status != wgpu::SurfaceGetCurrentTextureStatus::SuccessOptimal
-      && status != wgpu::SurfaceGetCurrentTextureStatus::SuccessSuboptimal) {
-    throw Exception("WebGPU surface texture status: {}", get_surface_texture_status(status));
+  switch (surface_texture.status) {
+  case wgpu::SurfaceGetCurrentTextureStatus::SuccessOptimal:
+    break;
+
+  case wgpu::SurfaceGetCurrentTextureStatus::SuccessSuboptimal:
+    if (has_handled_suboptimal_)
+      break;
+
+    has_handled_suboptimal_ = true;
+    [[fallthrough]];
+
+  // The window changed in a way the surface no longer matches, usually from a resize that
+  // hasn't been picked up yet
+  case wgpu::SurfaceGetCurrentTextureStatus::Outdated:
+  case wgpu::SurfaceGetCurrentTextureStatus::Lost: {
+    if constexpr (query::is_debug()) {
+      std::println("Surface texture status was {}, reconfiguring",
+          get_surface_texture_status(surface_texture.status));
+    }
+
+    configure_surface();
+    ++surface_stats_.reconfigure_count;
+    ++surface_stats_.skipped_frame_count;
+
+    return std::nullopt;
+  }
+
+  // Presentation is running behind, which usually sorts itself out by the next frame
+  case wgpu::SurfaceGetCurrentTextureStatus::Timeout: {
+    ++surface_stats_.skipped_frame_count;
+    return std::nullopt;
+  }
+
+  default:
+    throw Exception("WebGPU surface texture status: {}",
+        get_surface_texture_status(surface_texture.status));
   }
 
+  // Surfaces may hand out a new texture object every frame, so unlike the offscreen texture's,
+  // its view can't be cached
   static const wgpu::TextureViewDescriptor SURFACE_VIEW_DESC = {
     .label = "surface-view",
     .format = surface_config_.format,
@@ -229,20 +477,42 @@ FrameContext Renderer::prepare_new_frame()
     .aspect = wgpu::TextureAspect::All,
   };
 
-  static const wgpu::CommandEncoderDescriptor COMMAND_ENCODER_DESC = { .label = "command-encoder" };
-
   return {
     .surface_view = surface_texture.texture.CreateView(&SURFACE_VIEW_DESC),
     .encoder = device_.CreateCommandEncoder(&COMMAND_ENCODER_DESC),
   };
 }
 
+void Renderer::present()
+{
+  if (!is_headless_) {
+    surface_.Present();
+    return;
+  }
+
+  // Without presentation there's nothing pacing the frame loop, so wait here to keep the
+  // CPU from running ahead and to make frame times reflect the GPU work
+  instance_.WaitAny(queue_.OnSubmittedWorkDone(wgpu::CallbackMode::WaitAnyOnly,
+                        [](wgpu::QueueWorkDoneStatus, wgpu::StringView) {}),
+      WAIT_TIMEOUT_MAX);
+}
+
 void Renderer::resize(uint32_t new_width, uint32_t new_height)
 {
-  surface_config_.width = new_width;
-  surface_config_.height = new_height;
+  if (pending_size_.has_value())
+    ++surface_stats_.coalesced_resize_count;
 
-  surface_.Configure(&surface_config_);
+  pending_size_ = { new_width, new_height };
+}
+
+void Renderer::configure_surface()
+{
+  if (is_headless_) {
+    create_offscreen_texture();
+  } else {
+    surface_.Configure(&surface_config_);
+    update_surface_memory();
+  }
 }
 
 }
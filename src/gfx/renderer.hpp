@@ -1,13 +1,19 @@
 #pragma once
 
+#include "blob_cache.hpp"
 #include "error.hpp"
 #include "frame_context.hpp"
+#include "memory_tracker.hpp"
 #include "sdl/window.hpp"
+#include "timeline.hpp"
 
 #include <webgpu/webgpu_cpp.h>
 
+#include <future>
 #include <limits>
 #include <optional>
+#include <string>
+#include <utility>
 
 namespace mewo::gfx {
 
@@ -15,33 +21,100 @@ class Renderer {
   public:
   static constexpr auto WAIT_TIMEOUT_MAX = std::numeric_limits<uint64_t>::max();
 
-  Renderer(const sdl::Window& window);
+  /// Format of the offscreen texture that replaces the surface in headless mode.
+  static constexpr auto OFFSCREEN_FORMAT = wgpu::TextureFormat::RGBA8Unorm;
+  /// Only used to estimate the surface's memory use. The driver decides the actual count.
+  static constexpr uint64_t SURFACE_TEXTURE_COUNT_ESTIMATE = 3;
+
+  /// Counted since launch.
+  struct SurfaceStats {
+    /// Times the surface (or offscreen texture) was configured again, for any reason.
+    uint64_t reconfigure_count = 0;
+    /// Resizes replaced by a later one before they were applied.
+    uint64_t coalesced_resize_count = 0;
+    /// Frames skipped because no surface texture was available.
+    uint64_t skipped_frame_count = 0;
+  };
+
+  /// Creates the surface, and starts acquiring the adapter and device in the background
+  /// because it blocks on the GPU driver. Call `wait_until_ready` before using the device.
+  ///
+  /// Dawn will load and store compiled backend objects through the given cache. GPU memory
+  /// created through `gfx::create` is counted by the given tracker.
+  ///
+  /// When headless, frames are rendered into an offscreen texture instead of a surface, so no
+  /// display is needed. If no GPU is available either, a CPU fallback adapter is used.
+  Renderer(const sdl::Window& window, BlobCache& blob_cache, MemoryTracker& memory_tracker,
+      Timeline& timeline, bool is_headless);
   ~Renderer();
 
   Renderer(const Renderer&) = delete;
   Renderer& operator=(const Renderer&) = delete;
 
+  /// Blocks until the device has been acquired, then configures the surface (or creates the
+  /// offscreen texture). Rethrows any exception that occurred in the background. Does nothing
+  /// if already ready.
+  void wait_until_ready(const sdl::Window& window);
+
   const wgpu::Instance& instance() const;
   const wgpu::Device& device() const;
-  const wgpu::Surface& surface() const;
+  /// In headless mode, describes the offscreen texture instead.
   const wgpu::SurfaceConfiguration& surface_config() const;
   const wgpu::Queue& queue() const;
+  /// Not owned by the renderer, so it can be updated through a const reference.
+  MemoryTracker& memory_tracker() const;
+  const SurfaceStats& surface_stats() const;
 
   /// Checks if any errors have occurred in the graphics context, and throws accordingly.
-  /// Otherwise, it returns a texture view of the current surface and a new command encoder.
-  FrameContext prepare_new_frame();
+  /// Otherwise, applies the latest resize and returns a texture view of the current surface
+  /// along with a new command encoder.
+  ///
+  /// Returns nothing if the frame should be skipped, like when the window is minimized or the
+  /// surface is outdated. The surface is reconfigured if needed, so the next frame can go on.
+  std::optional<FrameContext> prepare_new_frame();
+  /// Presents the surface. In headless mode, waits for the frame's work to finish instead,
+  /// so frame times still include the GPU.
+  void present();
+  /// Only takes effect next frame, so a burst of resize events, like while dragging the
+  /// window's edge, reconfigures the surface once.
   void resize(uint32_t new_width, uint32_t new_height);
 
   private:
+  /// Runs in the background. Blocks until both the adapter and device are acquired.
+  void acquire_device(BlobCache& blob_cache, Timeline& timeline);
+  /// Returns a null adapter if none matched the options, along with the reason.
+  std::pair<wgpu::Adapter, std::string> request_adapter(bool force_fallback) const;
+  void create_offscreen_texture();
+  /// Applies `surface_config_` to the surface, or recreates the offscreen texture.
+  void configure_surface();
+  void update_surface_memory() const;
+
   wgpu::Instance instance_;
+  wgpu::Adapter adapter_;
   wgpu::Device device_;
   wgpu::Surface surface_;
   wgpu::SurfaceConfiguration surface_config_;
   wgpu::Queue queue_;
 
+  bool is_headless_ = false;
+  Tracked<wgpu::Texture> offscreen_texture_;
+  /// Only changes along with the texture, so it isn't created every frame.
+  wgpu::TextureView offscreen_view_;
+
+  std::optional<std::pair<uint32_t, uint32_t>> pending_size_;
+  /// Suboptimal surfaces still work, so they're only reconfigured once per size. Some
+  /// platforms keep reporting them as suboptimal, and skipping every frame would be worse.
+  bool has_handled_suboptimal_ = false;
+  SurfaceStats surface_stats_;
+
+  MemoryTracker& memory_tracker_;
+
   // TODO: move these two fields to `State` struct?
   std::optional<Error> device_lost_error_;
   std::optional<Error> uncaptured_error_;
+
+  /// Declared last so it's destroyed first, as the background task writes to other members.
+  std::future<void> device_future_;
 };
 
 }
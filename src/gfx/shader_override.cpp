@@ -0,0 +1,286 @@
+#include "shader_override.hpp"
+
+#include <cctype>
+#include <charconv>
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <system_error>
+#include <utility>
+#include <vector>
+
+namespace mewo::gfx {
+
+using Type = ShaderOverride::Type;
+
+struct Literal {
+  double value = 0.0;
+  Type type = Type::F32;
+};
+
+static bool is_word_char(char c) { return std::isalnum(static_cast<unsigned char>(c)) || c == '_'; }
+
+static bool is_digit(char c) { return std::isdigit(static_cast<unsigned char>(c)); }
+
+/// Keeps newlines of line comments, so tokens on different lines never merge.
+static std::string strip_comments(std::string_view code)
+{
+  std::string result;
+  result.reserve(code.size());
+
+  // Block comments nest in WGSL
+  size_t block_depth = 0;
+
+  for (size_t idx = 0; idx < code.size(); ++idx) {
+    char curr = code[idx];
+    char next = idx + 1 < code.size() ? code[idx + 1] : '\0';
+
+    if (block_depth > 0) {
+      if (curr == '/' && next == '*') {
+        ++block_depth;
+        ++idx;
+      } else if (curr == '*' && next == '/') {
+        --block_depth;
+        ++idx;
+      }
+
+      continue;
+    }
+
+    if (curr == '/' && next == '/') {
+      idx = code.find('\n', idx);
+
+      if (idx == std::string_view::npos)
+        break;
+
+      result.push_back('\n');
+    } else if (curr == '/' && next == '*') {
+      block_depth = 1;
+      ++idx;
+      result.push_back(' ');
+    } else {
+      result.push_back(curr);
+    }
+  }
+
+  return result;
+}
+
+/// Splits into identifiers, numeric literals, and single punctuation characters.
+static std::vector<std::string_view> tokenize(std::string_view code)
+{
+  std::vector<std::string_view> tokens;
+  size_t idx = 0;
+
+  while (idx < code.size()) {
+    char c = code[idx];
+
+    if (std::isspace(static_cast<unsigned char>(c))) {
+      ++idx;
+      continue;
+    }
+
+    size_t begin = idx++;
+    const bool is_number = is_digit(c) || (c == '.' && idx < code.size() && is_digit(code[idx]));
+
+    if (!is_word_char(c) && !is_number) {
+      tokens.push_back(code.substr(begin, 1));
+      continue;
+    }
+
+    while (idx < code.size()) {
+      char curr = code[idx];
+      char prev = code[idx - 1];
+
+      // Numbers may contain a decimal point and a signed exponent, like `1.5e-3`
+      bool is_exponent_sign = (curr == '+' || curr == '-')
+          && (prev == 'e' || prev == 'E' || prev == 'p' || prev == 'P');
+
+      if (!is_word_char(curr) && !(is_number && (curr == '.' || is_exponent_sign)))
+        break;
+
+      ++idx;
+    }
+
+    tokens.push_back(code.substr(begin, idx - begin));
+  }
+
+  return tokens;
+}
+
+static std::optional<Type> parse_type(std::string_view token)
+{
+  if (token == "bool")
+    return Type::Bool;
+  if (token == "i32")
+    return Type::I32;
+  if (token == "u32")
+    return Type::U32;
+  if (token == "f32")
+    return Type::F32;
+  if (token == "f16")
+    return Type::F16;
+
+  return std::nullopt;
+}
+
+static std::optional<Literal> parse_number(std::string_view token)
+{
+  std::optional<Type> suffix_type;
+  const bool is_hex = token.starts_with("0x") || token.starts_with("0X");
+
+  // Hexadecimal digits include `f`, so only integer suffixes apply to them
+  if (token.ends_with('i'))
+    suffix_type = Type::I32;
+  else if (token.ends_with('u'))
+    suffix_type = Type::U32;
+  else if (!is_hex && token.ends_with('f'))
+    suffix_type = Type::F32;
+  else if (!is_hex && token.ends_with('h'))
+    suffix_type = Type::F16;
+
+  if (suffix_type.has_value())
+    token.remove_suffix(1);
+
+  Literal literal;
+
+  if (is_hex) {
+    token.remove_prefix(2);
+
+    // Hexadecimal floats are rare enough that they're left to the shader
+    uint64_t parsed = 0;
+    auto [end, error] = std::from_chars(token.data(), token.data() + token.size(), parsed, 16);
+
+    if (error != std::errc() || end != token.data() + token.size())
+      return std::nullopt;
+
+    literal = { .value = static_cast<double>(parsed), .type = suffix_type.value_or(Type::I32) };
+    return literal;
+  }
+
+  auto [end, error] = std::from_chars(token.data(), token.data() + token.size(), literal.value);
+
+  if (error != std::errc() || end != token.data() + token.size())
+    return std::nullopt;
+
+  // Unsuffixed literals are abstract, and concretize to i32 or f32
+  const bool is_float = token.find_first_of(".eE") != std::string_view::npos;
+  literal.type = suffix_type.value_or(is_float ? Type::F32 : Type::I32);
+
+  return literal;
+}
+
+/// Only handles a single literal, optionally negated. Anything else is an expression.
+static std::optional<Literal> parse_literal(const std::vector<std::string_view>& tokens)
+{
+  if (tokens.size() == 1 && tokens[0] == "true")
+    return Literal { .value = 1.0, .type = Type::Bool };
+
+  if (tokens.size() == 1 && tokens[0] == "false")
+    return Literal { .value = 0.0, .type = Type::Bool };
+
+  if (tokens.size() == 1 && is_digit(tokens[0].front()))
+    return parse_number(tokens[0]);
+
+  if (tokens.size() == 2 && tokens[0] == "-" && is_digit(tokens[1].front())) {
+    auto literal = parse_number(tokens[1]);
+
+    if (literal.has_value())
+      literal->value = -literal->value;
+
+    return literal;
+  }
+
+  return std::nullopt;
+}
+
+double ShaderOverride::get_effective_value() const
+{
+  return value.value_or(initial_value.value_or(0.0));
+}
+
+std::vector<ShaderOverride> find_shader_overrides(std::string_view code)
+{
+  const std::string stripped = strip_comments(code);
+  const std::vector<std::string_view> tokens = tokenize(stripped);
+
+  std::vector<ShaderOverride> overrides;
+  size_t brace_depth = 0;
+  std::optional<std::string_view> pending_id;
+
+  for (size_t idx = 0; idx < tokens.size(); ++idx) {
+    std::string_view token = tokens[idx];
+
+    if (token == "{") {
+      ++brace_depth;
+      continue;
+    }
+
+    if (token == "}") {
+      brace_depth -= brace_depth > 0 ? 1 : 0;
+      continue;
+    }
+
+    // Overrides can only be declared at module scope
+    if (brace_depth > 0)
+      continue;
+
+    // Attributes come before the declaration they apply to
+    if (token == "@" && idx + 4 < tokens.size() && tokens[idx + 1] == "id"
+        && tokens[idx + 2] == "(" && tokens[idx + 4] == ")") {
+      pending_id = tokens[idx + 3];
+      idx += 4;
+      continue;
+    }
+
+    if (token != "override" || idx + 1 >= tokens.size()) {
+      if (token == ";")
+        pending_id = std::nullopt;
+
+      continue;
+    }
+
+    std::string_view name = tokens[++idx];
+    std::optional<Type> type;
+    bool has_unknown_type = false;
+
+    if (idx + 2 < tokens.size() && tokens[idx + 1] == ":") {
+      type = parse_type(tokens[idx + 2]);
+      has_unknown_type = !type.has_value();
+      idx += 2;
+    }
+
+    std::vector<std::string_view> initializer;
+
+    if (idx + 1 < tokens.size() && tokens[idx + 1] == "=") {
+      for (idx += 2; idx < tokens.size() && tokens[idx] != ";"; ++idx)
+        initializer.push_back(tokens[idx]);
+    }
+
+    std::optional<std::string_view> id = std::exchange(pending_id, std::nullopt);
+    std::optional<Literal> literal = parse_literal(initializer);
+
+    // Without a known type there's no way to pick a fitting control for it
+    if (has_unknown_type || (!type.has_value() && !literal.has_value()))
+      continue;
+
+    ShaderOverride override_decl = {
+      .key = std::string(id.value_or(name)),
+      .name = std::string(name),
+      .type = type.value_or(literal.has_value() ? literal->type : Type::F32),
+    };
+
+    if (literal.has_value())
+      override_decl.initial_value = literal->value;
+    else if (initializer.empty())
+      override_decl.value = 0.0;
+
+    overrides.push_back(std::move(override_decl));
+  }
+
+  return overrides;
+}
+
+}
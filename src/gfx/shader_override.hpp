@@ -0,0 +1,43 @@
+#pragma once
+
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace mewo::gfx {
+
+/// A pipeline-overridable constant declared in WGSL, like `override STEPS: u32 = 64;`.
+/// Changing its value only needs a new pipeline, the shader module can be reused as is.
+struct ShaderOverride {
+  enum class Type : int {
+    Bool,
+    I32,
+    U32,
+    F32,
+    F16,
+  };
+
+  /// What the pipeline's `constants` field identifies it by. Either the name, or the
+  /// number given with `@id`.
+  std::string key;
+  std::string name;
+  Type type = Type::F32;
+  /// Only set if the declaration is initialized with a literal. Initializers that are
+  /// expressions are left for the shader to evaluate.
+  std::optional<double> initial_value;
+  /// Passed to the pipeline if set, otherwise the shader's own initializer is used.
+  std::optional<double> value;
+
+  /// Returns the value the pipeline will actually see, or zero if it can't be known here.
+  double get_effective_value() const;
+};
+
+/// Finds every `override` declaration at module scope. This is a lightweight scan over
+/// tokens instead of a full parse, and is meant to run on code that already compiled.
+///
+/// Declarations without an initializer are required by WebGPU, so they're given a value of
+/// zero to keep the pipeline valid.
+std::vector<ShaderOverride> find_shader_overrides(std::string_view code);
+
+}
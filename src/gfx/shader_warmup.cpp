@@ -0,0 +1,229 @@
+#include "shader_warmup.hpp"
+
+#include "gfx/create.hpp"
+#include "hash.hpp"
+#include "query.hpp"
+
+#include <webgpu/webgpu_cpp.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <exception>
+#include <memory>
+#include <print>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+namespace mewo::gfx {
+
+wgpu::RenderPipeline ShaderWarmup::Shader::find_pipeline(wgpu::TextureFormat format) const
+{
+  auto it = std::ranges::find(pipelines, format, &decltype(pipelines)::value_type::first);
+  return it != pipelines.end() ? it->second : wgpu::RenderPipeline();
+}
+
+ShaderWarmup::ShaderWarmup(const Renderer& renderer,
+    const wgpu::RenderPipelineDescriptor& pipeline_desc,
+    std::vector<wgpu::TextureFormat> target_formats, std::vector<std::string> codes,
+    CompileSandbox& sandbox, jobs::System& jobs, Timeline& timeline)
+    : renderer_(renderer)
+    , sandbox_(sandbox)
+    , pipeline_desc_(pipeline_desc)
+    , target_formats_(std::move(target_formats))
+    , timeline_(timeline)
+    , is_parallel_(renderer.device().HasFeature(wgpu::FeatureName::ImplicitDeviceSynchronization))
+    , start_(std::chrono::steady_clock::now())
+{
+  pipeline_desc_.label = "warmup-render-pipeline";
+  pipeline_desc_.fragment = nullptr;
+
+  // Projects may contain the same shader more than once, which only needs warming up once
+  std::vector<std::string> unique_codes;
+
+  for (std::string& code : codes) {
+    if (entry_indices_.try_emplace(hash::fnv1a(code), unique_codes.size()).second)
+      unique_codes.push_back(std::move(code));
+  }
+
+  // Entries hold atomics so they can't be moved, but the vector itself can be
+  entries_ = std::vector<Entry>(unique_codes.size());
+
+  for (size_t idx = 0; idx < unique_codes.size(); ++idx)
+    entries_[idx].code = std::move(unique_codes[idx]);
+
+  if (entries_.empty()) {
+    duration_ns_ = 0;
+    return;
+  }
+
+  if (!is_parallel_) {
+    std::println("Device can't be used from other threads, warming up shaders one at a time");
+    return;
+  }
+
+  // Nothing on screen waits for warm-up, but opening a shader soon will. Jobs can wait for
+  // helpers to start, since the main thread doesn't depend on them
+  for (Entry& entry : entries_) {
+    jobs.submit(jobs::Priority::Normal, jobs_token_,
+        [this, &entry](const jobs::CancellationToken&) {
+          std::shared_ptr<const CompileSandbox::Check> pending = sandbox_.submit(entry.code);
+          pending->wait();
+          compile(entry, pending->result());
+        });
+  }
+
+  if constexpr (query::is_debug()) {
+    std::println(
+        "Warming up {} shader(s) on {} job worker(s)", entries_.size(), jobs.worker_count());
+  }
+}
+
+ShaderWarmup::~ShaderWarmup()
+{
+  // Skips shaders no job has picked up yet, so shutting down doesn't wait for all of them
+  jobs_token_.cancel();
+  jobs_token_.wait();
+}
+
+ShaderWarmup::Progress ShaderWarmup::progress() const
+{
+  return { .finished = finished_count_.load(std::memory_order_acquire), .total = entries_.size() };
+}
+
+bool ShaderWarmup::is_finished() const { return duration_ns_.load(std::memory_order_acquire) >= 0; }
+
+std::optional<double> ShaderWarmup::duration_ms() const
+{
+  int64_t duration_ns = duration_ns_.load(std::memory_order_acquire);
+
+  if (duration_ns < 0)
+    return std::nullopt;
+
+  return static_cast<double>(duration_ns) / 1'000'000.0;
+}
+
+const ShaderWarmup::Shader* ShaderWarmup::find(std::string_view code) const
+{
+  const Entry* entry = find_entry(code);
+
+  if (entry == nullptr || !entry->is_ready.load(std::memory_order_acquire))
+    return nullptr;
+
+  // Failed compiles always report an error, so this means warm-up itself went wrong and the
+  // caller should compile the shader on its own
+  if (!entry->shader.module.has_value() && entry->shader.diagnostics.empty())
+    return nullptr;
+
+  return &entry->shader;
+}
+
+bool ShaderWarmup::is_pending(std::string_view code) const
+{
+  const Entry* entry = find_entry(code);
+  return entry != nullptr && !entry->is_ready.load(std::memory_order_acquire);
+}
+
+void ShaderWarmup::prepare_new_frame()
+{
+  if (is_parallel_)
+    return;
+
+  if (pending_check_ && pending_check_->is_done())
+    compile(entries_[next_entry_++], std::exchange(pending_check_, nullptr)->result());
+
+  if (!pending_check_ && next_entry_ < entries_.size())
+    pending_check_ = sandbox_.submit(entries_[next_entry_].code);
+}
+
+void ShaderWarmup::compile(Entry& entry, const CompileSandbox::Result& checked)
+{
+  // Can't let an exception escape a worker thread, a failed shader is compiled again on use
+  try {
+    if (!checked.should_compile()) {
+      entry.shader.diagnostics = checked.diagnostics;
+    } else if (checked.status == CompileSandbox::Result::Status::Valid) {
+      entry.shader.diagnostics = checked.diagnostics;
+      entry.shader.module
+          = create::shader_module_from_checked_wgsl(renderer_, entry.code, "warmup-frag-shader");
+    } else {
+      auto [module_opt, diagnostics]
+          = create::shader_module_from_wgsl(renderer_, entry.code, "warmup-frag-shader");
+
+      entry.shader.diagnostics = std::move(diagnostics);
+      entry.shader.module = std::move(module_opt);
+    }
+  } catch (const std::exception& ex) {
+    std::println("Failed to warm up shader. {}", ex.what());
+  }
+
+  if (!entry.shader.module.has_value() || target_formats_.empty()) {
+    finish(entry);
+    return;
+  }
+
+  entry.shader.pipelines.reserve(target_formats_.size());
+
+  for (wgpu::TextureFormat format : target_formats_)
+    entry.shader.pipelines.emplace_back(format, nullptr);
+
+  // Every callback has to see the full count, so it's set before any pipeline is started
+  entry.remaining_pipelines = target_formats_.size();
+
+  for (size_t idx = 0; idx < target_formats_.size(); ++idx) {
+    wgpu::ColorTargetState color_target_state = { .format = target_formats_[idx] };
+
+    wgpu::FragmentState fragment_state = {
+      .module = entry.shader.module.value(),
+      .entryPoint = "main",
+      .targetCount = 1,
+      .targets = &color_target_state,
+    };
+
+    wgpu::RenderPipelineDescriptor pipeline_desc = pipeline_desc_;
+    pipeline_desc.fragment = &fragment_state;
+
+    // Callback is invoked during `wgpu::Instance::ProcessEvents` in the main loop
+    renderer_.device().CreateRenderPipelineAsync(&pipeline_desc,
+        wgpu::CallbackMode::AllowProcessEvents,
+        [this, &entry, idx](wgpu::CreatePipelineAsyncStatus status, wgpu::RenderPipeline pipeline,
+            wgpu::StringView message) {
+          // Also invoked when the instance is destroyed, at which point `this` may be gone
+          if (status == wgpu::CreatePipelineAsyncStatus::CallbackCancelled)
+            return;
+
+          if (status == wgpu::CreatePipelineAsyncStatus::Success)
+            entry.shader.pipelines[idx].second = std::move(pipeline);
+          else
+            std::println("Failed to warm up render pipeline: {}", std::string_view(message));
+
+          if (entry.remaining_pipelines.fetch_sub(1, std::memory_order_acq_rel) == 1)
+            finish(entry);
+        });
+  }
+}
+
+void ShaderWarmup::finish(Entry& entry)
+{
+  entry.is_ready.store(true, std::memory_order_release);
+
+  if (finished_count_.fetch_add(1, std::memory_order_acq_rel) + 1 != entries_.size())
+    return;
+
+  auto duration = std::chrono::duration_cast<std::chrono::nanoseconds>(
+      std::chrono::steady_clock::now() - start_);
+  duration_ns_.store(duration.count(), std::memory_order_release);
+
+  timeline_.mark("Shaders warmed up");
+}
+
+const ShaderWarmup::Entry* ShaderWarmup::find_entry(std::string_view code) const
+{
+  auto it = entry_indices_.find(hash::fnv1a(code));
+  return it != entry_indices_.end() ? &entries_[it->second] : nullptr;
+}
+
+}
@@ -0,0 +1,115 @@
+#pragma once
+
+#include "gfx/compilation_diagnostic.hpp"
+#include "gfx/compile_sandbox.hpp"
+#include "gfx/renderer.hpp"
+#include "jobs.hpp"
+#include "timeline.hpp"
+
+#include <webgpu/webgpu_cpp.h>
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace mewo::gfx {
+
+/// Compiles every shader of a project ahead of time, so opening one later doesn't block on
+/// the WGSL front-end or the backend compiler. Shader modules are created by jobs, and each
+/// one immediately starts creating its pipelines asynchronously. All shaders are in flight at
+/// once, so warm-up takes about as long as the slowest shader.
+///
+/// Every shader is checked by the compile sandbox before it's compiled, so a project with a
+/// shader that crashes the compiler can still be opened.
+///
+/// Using the device from other threads needs Dawn's implicit device synchronization. If the
+/// adapter doesn't support it, shaders are compiled on the main thread instead, one at a time.
+/// Their checks are polled every frame, so the main thread never waits for a helper.
+class ShaderWarmup {
+  public:
+  struct Shader {
+    std::optional<wgpu::ShaderModule> module;
+    CompilationLog diagnostics;
+    /// One for every target format given to warm-up. Null if its creation failed.
+    std::vector<std::pair<wgpu::TextureFormat, wgpu::RenderPipeline>> pipelines;
+
+    /// Returns null if no pipeline was warmed up for the format.
+    wgpu::RenderPipeline find_pipeline(wgpu::TextureFormat format) const;
+  };
+
+  struct Progress {
+    size_t finished = 0;
+    size_t total = 0;
+  };
+
+  /// Pipelines are created from the given descriptor, with its fragment state replaced for
+  /// every combination of shader and target format. Codes must be complete fragment shaders,
+  /// including the prefix.
+  ShaderWarmup(const Renderer& renderer, const wgpu::RenderPipelineDescriptor& pipeline_desc,
+      std::vector<wgpu::TextureFormat> target_formats, std::vector<std::string> codes,
+      CompileSandbox& sandbox, jobs::System& jobs, Timeline& timeline);
+  /// Waits for shaders that jobs are still compiling, skipping the ones that haven't started.
+  ~ShaderWarmup();
+
+  ShaderWarmup(const ShaderWarmup&) = delete;
+  ShaderWarmup& operator=(const ShaderWarmup&) = delete;
+
+  Progress progress() const;
+  bool is_finished() const;
+  /// Only set once every shader has finished, successfully or not.
+  std::optional<double> duration_ms() const;
+
+  /// Returns null if the code wasn't warmed up, or hasn't finished warming up yet.
+  const Shader* find(std::string_view code) const;
+  /// True if the code is part of warm-up and hasn't finished yet. Compiling it separately
+  /// in the meantime would only duplicate work.
+  bool is_pending(std::string_view code) const;
+
+  /// Compiles the next checked shader if warm-up can't use worker threads. Otherwise does
+  /// nothing.
+  void prepare_new_frame();
+
+  private:
+  struct Entry {
+    std::string code;
+    Shader shader;
+    std::atomic<size_t> remaining_pipelines = 0;
+    std::atomic<bool> is_ready = false;
+  };
+
+  /// Creates the module if the check allows it, and starts creating its pipelines. Safe to call
+  /// from any thread.
+  void compile(Entry& entry, const CompileSandbox::Result& checked);
+  void finish(Entry& entry);
+  const Entry* find_entry(std::string_view code) const;
+
+  const Renderer& renderer_;
+  CompileSandbox& sandbox_;
+  wgpu::RenderPipelineDescriptor pipeline_desc_;
+  std::vector<wgpu::TextureFormat> target_formats_;
+  Timeline& timeline_;
+
+  /// Never resized after construction, since workers hold references into it.
+  std::vector<Entry> entries_;
+  /// Maps the hash of each code to its entry.
+  std::unordered_map<uint64_t, size_t> entry_indices_;
+
+  bool is_parallel_ = false;
+  jobs::CancellationToken jobs_token_;
+  /// Only used when compiling on the main thread.
+  size_t next_entry_ = 0;
+  std::shared_ptr<const CompileSandbox::Check> pending_check_;
+  std::atomic<size_t> finished_count_ = 0;
+  std::chrono::steady_clock::time_point start_;
+  std::atomic<int64_t> duration_ns_ = -1;
+};
+
+}
@@ -1,23 +1,62 @@
 #include "context.hpp"
 
+#include "allocation.hpp"
+
 #include <imgui_impl_sdl3.h>
 #include <imgui_impl_wgpu.h>
 #include <webgpu/webgpu_cpp.h>
 
+#include <cstddef>
+#include <cstdint>
+#include <optional>
 #include <string>
+#include <string_view>
 
 namespace mewo::gui {
 
-Context::Context(const Assets& assets, const sdl::Window& window, const gfx::Renderer& renderer)
+/// Dear ImGui's backend keeps a set of vertex and index buffers for each frame in flight.
+static constexpr int FRAMES_IN_FLIGHT = 3;
+
+/// Textures are counted exactly. The backend rounds buffer sizes up when growing them, so
+/// buffers are a lower bound.
+static uint64_t get_backend_memory_size(const ImDrawData& draw_data)
+{
+  uint64_t size = 0;
+
+  for (const ImTextureData* tex : ImGui::GetPlatformIO().Textures) {
+    if (tex->Status != ImTextureStatus_Destroyed) {
+      size += static_cast<uint64_t>(tex->Width) * static_cast<uint64_t>(tex->Height)
+          * static_cast<uint64_t>(tex->BytesPerPixel);
+    }
+  }
+
+  uint64_t buffer_size = static_cast<uint64_t>(draw_data.TotalVtxCount) * sizeof(ImDrawVert)
+      + static_cast<uint64_t>(draw_data.TotalIdxCount) * sizeof(ImDrawIdx);
+
+  return size + buffer_size * FRAMES_IN_FLIGHT;
+}
+
+Context::Context(
+    const Assets& assets, const sdl::Window& window, gfx::Renderer& renderer, Timeline& timeline)
+    : memory_tracker_(&renderer.memory_tracker())
 {
   IMGUI_CHECKVERSION();
+
+  // Counted like every other allocation, so the GUI is held to the same steady state
+  ImGui::SetAllocatorFunctions([](size_t size, void*) { return allocation::allocate(size); },
+      [](void* ptr, void*) { allocation::deallocate(ptr); });
   ImGui::CreateContext();
 
   ImGuiIO& io = ImGui::GetIO();
   io.ConfigFlags |= ImGuiConfigFlags_NavEnableKeyboard;
   io.ConfigFlags |= ImGuiConfigFlags_DockingEnable;
+  // Settings are journaled instead, which never blocks a frame on the disk
   io.IniFilename = nullptr;
 
+  // Glyphs are rasterized on first use, at each size and DPI scale they're drawn at. The
+  // cache lets later launches skip rasterizing glyphs that were already seen
+  glyph_cache_.install(*io.Fonts);
+
   auto inter_path = assets.get("fonts/inter_4.1/Inter-Regular.ttf").string();
   auto geist_mono_path = assets.get("fonts/geist_mono_1.7/GeistMono-Regular.ttf").string();
 
@@ -33,7 +72,13 @@ Context::Context(const Assets& assets, const sdl::Window& window, const gfx::Ren
   ImGuiStyle& style = ImGui::GetStyle();
   style.FontSizeBase = 15.f;
 
+  timeline.mark("Fonts loaded");
+
+  // Everything above overlapped with acquiring the device
+  renderer.wait_until_ready(window);
+
   ImGui_ImplWGPU_InitInfo wgpu_init_info;
+  wgpu_init_info.NumFramesInFlight = FRAMES_IN_FLIGHT;
   wgpu_init_info.Device = renderer.device().Get();
   wgpu_init_info.RenderTargetFormat
       = static_cast<WGPUTextureFormat>(renderer.surface_config().format);
@@ -43,6 +88,8 @@ Context::Context(const Assets& assets, const sdl::Window& window, const gfx::Ren
 
   // Can be set once upfront because there's only one viewport
   viewport_ = ImGui::GetMainViewport();
+
+  timeline.mark("GUI initialized");
 }
 
 Context::~Context()
@@ -56,6 +103,26 @@ const ImGuiViewport* Context::viewport() const { return viewport_; }
 
 const Context::Fonts& Context::fonts() const { return fonts_; }
 
+void Context::load_settings(std::string_view settings) const
+{
+  ImGui::LoadIniSettingsFromMemory(settings.data(), settings.size());
+}
+
+std::optional<std::string> Context::take_changed_settings() const
+{
+  ImGuiIO& io = ImGui::GetIO();
+
+  if (!io.WantSaveIniSettings)
+    return std::nullopt;
+
+  io.WantSaveIniSettings = false;
+
+  size_t size = 0;
+  const char* settings = ImGui::SaveIniSettingsToMemory(&size);
+
+  return std::string(settings, size);
+}
+
 void Context::prepare_new_frame() const
 {
   ImGui_ImplWGPU_NewFrame();
@@ -84,6 +151,9 @@ void Context::record(const gfx::FrameContext& frame_ctx) const
   wgpu::RenderPassEncoder render_pass = encoder.BeginRenderPass(&render_pass_desc);
   ImGui_ImplWGPU_RenderDrawData(ImGui::GetDrawData(), render_pass.Get());
   render_pass.End();
+
+  memory_tracker_->set_sampled(
+      gfx::MemoryTracker::Category::Gui, get_backend_memory_size(*ImGui::GetDrawData()));
 }
 
 }
@@ -3,11 +3,17 @@
 #include "assets.hpp"
 #include "gfx/frame_context.hpp"
 #include "gfx/renderer.hpp"
+#include "gui/glyph_cache.hpp"
 #include "sdl/window.hpp"
+#include "timeline.hpp"
 
 #include <imgui.h>
 #include <webgpu/webgpu_cpp.h>
 
+#include <optional>
+#include <string>
+#include <string_view>
+
 namespace mewo::gui {
 
 /// Immediate mode GUI rendering using Dear ImGui.
@@ -18,7 +24,9 @@ class Context {
     ImFont* geist_mono = nullptr;
   };
 
-  Context(const Assets& assets, const sdl::Window& window, const gfx::Renderer& renderer);
+  /// Loads fonts before waiting for the renderer, which is the only part that needs the device.
+  Context(const Assets& assets, const sdl::Window& window, gfx::Renderer& renderer,
+      Timeline& timeline);
   ~Context();
 
   Context(const Context&) = delete;
@@ -27,12 +35,23 @@ class Context {
   const ImGuiViewport* viewport() const;
   const Fonts& fonts() const;
 
+  /// Restores settings like the layout of windows, saved by `take_changed_settings`. Must be
+  /// called before the first frame.
+  void load_settings(std::string_view settings) const;
+  /// Dear ImGui's settings in its ini format, if they changed since the last call. It doesn't
+  /// write them to disk itself, and only reports changes every few seconds.
+  std::optional<std::string> take_changed_settings() const;
+
   void prepare_new_frame() const;
+  /// Also reports the memory held by Dear ImGui's backend, since it creates its own objects.
   void record(const gfx::FrameContext& frame_ctx) const;
 
   private:
+  /// Destroyed after the ImGui context, which still calls into it during shutdown.
+  GlyphCache glyph_cache_;
   ImGuiViewport* viewport_ = nullptr;
   Fonts fonts_;
+  gfx::MemoryTracker* memory_tracker_ = nullptr;
 };
 
 }
@@ -0,0 +1,354 @@
+#include "glyph_cache.hpp"
+
+#include "exception.hpp"
+#include "fs.hpp"
+#include "hash.hpp"
+#include "query.hpp"
+
+#include <imgui.h>
+#include <imgui_internal.h>
+#include <misc/freetype/imgui_freetype.h>
+
+#include <array>
+#include <bit>
+#include <cstring>
+#include <exception>
+#include <filesystem>
+#include <format>
+#include <print>
+#include <string>
+#include <string_view>
+#include <type_traits>
+
+namespace mewo::gui {
+
+static constexpr std::string_view CACHE_SUBDIR = "fonts";
+static constexpr std::array<char, 8> MAGIC = { 'M', 'E', 'W', 'O', 'G', 'L', 'Y', 'F' };
+static constexpr uint32_t FORMAT_VERSION = 1;
+
+struct Header {
+  std::array<char, 8> magic = MAGIC;
+  uint32_t version = FORMAT_VERSION;
+  /// Rasterization may change between Dear ImGui versions, which invalidates the cache.
+  uint32_t imgui_version = IMGUI_VERSION_NUM;
+  uint32_t glyph_count = 0;
+  uint32_t reserved = 0;
+};
+
+/// Followed by `pixel_size` bytes of pixel data.
+struct Record {
+  uint64_t key = 0;
+  float advance_x = 0.f;
+  float x0 = 0.f;
+  float y0 = 0.f;
+  float x1 = 0.f;
+  float y1 = 0.f;
+  uint16_t width = 0;
+  uint16_t height = 0;
+  uint32_t is_colored = 0;
+  uint32_t pixel_size = 0;
+};
+
+static_assert(std::is_trivially_copyable_v<Header>);
+static_assert(std::is_trivially_copyable_v<Record>);
+static_assert(sizeof(Header) == 24);
+static_assert(sizeof(Record) == 40);
+
+/// Font loader callbacks have no user data, so they reach the cache through this.
+static GlyphCache* active_cache = nullptr;
+
+static std::string get_cache_file_name(uint64_t font_hash)
+{
+  return std::format("{}.glyphs", hash::to_hex(font_hash));
+}
+
+GlyphCache::GlyphCache()
+    : cache_path_(fs::get_cache_path(CACHE_SUBDIR))
+{
+  if (active_cache != nullptr)
+    throw Exception("Only one glyph cache can exist at a time");
+
+  active_cache = this;
+}
+
+GlyphCache::~GlyphCache()
+{
+  for (const auto& [font_hash, font] : fonts_) {
+    if (!font.is_dirty)
+      continue;
+
+    // Losing the cache only costs rasterization time next launch, so never fail over it
+    try {
+      save_font(font_hash, font);
+    } catch (const std::exception& ex) {
+      std::println("Failed to save glyph cache. {}", ex.what());
+    }
+  }
+
+  active_cache = nullptr;
+}
+
+void GlyphCache::install(ImFontAtlas& atlas)
+{
+  freetype_loader_ = ImGuiFreeType::GetFontLoader();
+
+  // Everything else is forwarded to FreeType as is
+  loader_ = *freetype_loader_;
+  loader_.Name = "mewo-glyph-cache";
+  loader_.FontSrcInit = font_src_init;
+  loader_.FontSrcDestroy = font_src_destroy;
+  loader_.FontBakedLoadGlyph = font_baked_load_glyph;
+
+  atlas.SetFontLoader(&loader_);
+}
+
+bool GlyphCache::font_src_init(ImFontAtlas* atlas, ImFontConfig* src)
+{
+  if (!active_cache->freetype_loader_->FontSrcInit(atlas, src))
+    return false;
+
+  std::string_view font_data(
+      static_cast<const char*>(src->FontData), static_cast<size_t>(src->FontDataSize));
+  uint64_t font_hash = hash::fnv1a(font_data);
+
+  active_cache->font_hashes_[src] = font_hash;
+  active_cache->load_font(font_hash);
+
+  return true;
+}
+
+void GlyphCache::font_src_destroy(ImFontAtlas* atlas, ImFontConfig* src)
+{
+  active_cache->font_hashes_.erase(src);
+  active_cache->freetype_loader_->FontSrcDestroy(atlas, src);
+}
+
+bool GlyphCache::font_baked_load_glyph(ImFontAtlas* atlas, ImFontConfig* src, ImFontBaked* baked,
+    void* loader_data, ImWchar codepoint, ImFontGlyph* out_glyph, float* out_advance_x)
+{
+  const ImFontLoader& freetype_loader = *active_cache->freetype_loader_;
+  auto hash_it = active_cache->font_hashes_.find(src);
+
+  if (hash_it == active_cache->font_hashes_.end()) {
+    return freetype_loader.FontBakedLoadGlyph(
+        atlas, src, baked, loader_data, codepoint, out_glyph, out_advance_x);
+  }
+
+  Font& font = active_cache->fonts_[hash_it->second];
+  uint64_t key = get_glyph_key(*src, *baked, codepoint);
+
+  if (auto glyph_it = font.glyphs.find(key); glyph_it != font.glyphs.end()) {
+    const Glyph& glyph = glyph_it->second;
+
+    if (out_advance_x != nullptr)
+      *out_advance_x = glyph.advance_x;
+
+    // Only the advance was asked for, which is used to measure text without drawing it
+    if (out_glyph == nullptr)
+      return true;
+
+    if (upload(*atlas, *src, *baked, glyph, codepoint, *out_glyph))
+      return true;
+
+    // Cached pixels don't match the atlas format, so replace them with freshly rasterized ones
+    font.glyphs.erase(glyph_it);
+  }
+
+  if (!freetype_loader.FontBakedLoadGlyph(
+          atlas, src, baked, loader_data, codepoint, out_glyph, out_advance_x)) {
+    return false;
+  }
+
+  // Nothing was rasterized, so there's nothing worth caching yet
+  if (out_glyph == nullptr)
+    return true;
+
+  font.glyphs[key] = read_back(*atlas, *out_glyph);
+  font.is_dirty = true;
+
+  return true;
+}
+
+uint64_t GlyphCache::get_glyph_key(
+    const ImFontConfig& src, const ImFontBaked& baked, ImWchar codepoint)
+{
+  // Every input that changes the rasterized output has to be part of the key
+  std::array<uint32_t, 5> inputs = {
+    std::bit_cast<uint32_t>(baked.Size),
+    std::bit_cast<uint32_t>(baked.RasterizerDensity),
+    std::bit_cast<uint32_t>(src.RasterizerMultiply),
+    src.FontLoaderFlags,
+    codepoint,
+  };
+
+  return hash::fnv1a(std::string_view(reinterpret_cast<const char*>(inputs.data()),
+      inputs.size() * sizeof(uint32_t)));
+}
+
+bool GlyphCache::upload(ImFontAtlas& atlas, ImFontConfig& src, ImFontBaked& baked,
+    const Glyph& glyph, ImWchar codepoint, ImFontGlyph& out_glyph)
+{
+  out_glyph.Codepoint = codepoint;
+  out_glyph.AdvanceX = glyph.advance_x;
+
+  // Glyphs like spaces have no pixels and don't take up room in the atlas
+  if (glyph.width == 0 || glyph.height == 0) {
+    out_glyph.Visible = false;
+    return true;
+  }
+
+  ImTextureData& tex = *atlas.TexData;
+  size_t expected_size = static_cast<size_t>(glyph.width) * glyph.height
+      * static_cast<size_t>(tex.BytesPerPixel);
+
+  if (glyph.pixels.size() != expected_size)
+    return false;
+
+  ImFontAtlasRectId pack_id = ImFontAtlasPackAddRect(&atlas, glyph.width, glyph.height);
+
+  if (pack_id == ImFontAtlasRectId_Invalid)
+    return false;
+
+  out_glyph.X0 = glyph.x0;
+  out_glyph.Y0 = glyph.y0;
+  out_glyph.X1 = glyph.x1;
+  out_glyph.Y1 = glyph.y1;
+  out_glyph.Visible = true;
+  out_glyph.Colored = glyph.is_colored;
+  out_glyph.PackId = pack_id;
+
+  ImTextureRect* rect = ImFontAtlasPackGetRect(&atlas, pack_id);
+  ImFontAtlasBakedSetFontGlyphBitmap(&atlas, &baked, &src, &out_glyph, rect,
+      reinterpret_cast<const unsigned char*>(glyph.pixels.data()), tex.Format,
+      glyph.width * tex.BytesPerPixel);
+
+  return true;
+}
+
+GlyphCache::Glyph GlyphCache::read_back(ImFontAtlas& atlas, const ImFontGlyph& glyph)
+{
+  Glyph result = {
+    .advance_x = glyph.AdvanceX,
+    .x0 = glyph.X0,
+    .y0 = glyph.Y0,
+    .x1 = glyph.X1,
+    .y1 = glyph.Y1,
+    .is_colored = glyph.Colored != 0,
+  };
+
+  if (!glyph.Visible || glyph.PackId == ImFontAtlasRectId_Invalid)
+    return result;
+
+  const ImTextureRect* rect = ImFontAtlasPackGetRect(&atlas, glyph.PackId);
+  ImTextureData& tex = *atlas.TexData;
+  auto row_size = static_cast<size_t>(rect->w) * static_cast<size_t>(tex.BytesPerPixel);
+
+  result.width = rect->w;
+  result.height = rect->h;
+  result.pixels.resize(row_size * rect->h);
+
+  for (uint16_t row = 0; row < rect->h; ++row) {
+    const auto* src_row = static_cast<const char*>(tex.GetPixelsAt(rect->x, rect->y + row));
+    std::memcpy(result.pixels.data() + row_size * row, src_row, row_size);
+  }
+
+  return result;
+}
+
+GlyphCache::Font& GlyphCache::load_font(uint64_t font_hash)
+{
+  if (auto it = fonts_.find(font_hash); it != fonts_.end())
+    return it->second;
+
+  Font& font = fonts_[font_hash];
+  auto file_path = cache_path_ / get_cache_file_name(font_hash);
+
+  if (!std::filesystem::exists(file_path))
+    return font;
+
+  std::string contents;
+
+  try {
+    contents = fs::read_file(file_path);
+  } catch (const std::exception& ex) {
+    std::println("Failed to read glyph cache. {}", ex.what());
+    return font;
+  }
+
+  Header header;
+
+  if (contents.size() < sizeof(Header))
+    return font;
+
+  std::memcpy(&header, contents.data(), sizeof(Header));
+
+  if (header.magic != MAGIC || header.version != FORMAT_VERSION
+      || header.imgui_version != IMGUI_VERSION_NUM) {
+    return font;
+  }
+
+  size_t offset = sizeof(Header);
+
+  for (uint32_t idx = 0; idx < header.glyph_count; ++idx) {
+    Record record;
+
+    if (contents.size() - offset < sizeof(Record))
+      break;
+
+    std::memcpy(&record, contents.data() + offset, sizeof(Record));
+    offset += sizeof(Record);
+
+    // Truncated file, keep whatever was read in full
+    if (contents.size() - offset < record.pixel_size)
+      break;
+
+    font.glyphs[record.key] = {
+      .advance_x = record.advance_x,
+      .x0 = record.x0,
+      .y0 = record.y0,
+      .x1 = record.x1,
+      .y1 = record.y1,
+      .width = record.width,
+      .height = record.height,
+      .is_colored = record.is_colored != 0,
+      .pixels = contents.substr(offset, record.pixel_size),
+    };
+
+    offset += record.pixel_size;
+  }
+
+  if constexpr (query::is_debug())
+    std::println("Loaded {} cached glyph(s) for font {}", font.glyphs.size(),
+        hash::to_hex(font_hash));
+
+  return font;
+}
+
+void GlyphCache::save_font(uint64_t font_hash, const Font& font) const
+{
+  Header header = { .glyph_count = static_cast<uint32_t>(font.glyphs.size()) };
+
+  std::string contents(reinterpret_cast<const char*>(&header), sizeof(Header));
+
+  for (const auto& [key, glyph] : font.glyphs) {
+    Record record = {
+      .key = key,
+      .advance_x = glyph.advance_x,
+      .x0 = glyph.x0,
+      .y0 = glyph.y0,
+      .x1 = glyph.x1,
+      .y1 = glyph.y1,
+      .width = glyph.width,
+      .height = glyph.height,
+      .is_colored = glyph.is_colored ? 1u : 0u,
+      .pixel_size = static_cast<uint32_t>(glyph.pixels.size()),
+    };
+
+    contents.append(reinterpret_cast<const char*>(&record), sizeof(Record));
+    contents.append(glyph.pixels);
+  }
+
+  fs::write_file(cache_path_ / get_cache_file_name(font_hash), contents);
+}
+
+}
@@ -0,0 +1,81 @@
+#pragma once
+
+#include <imgui.h>
+
+#include <cstdint>
+#include <filesystem>
+#include <string>
+#include <unordered_map>
+
+namespace mewo::gui {
+
+/// Persists rasterized glyphs across launches, so fonts are only rasterized by FreeType the
+/// first time a glyph is seen at a given size and DPI scale.
+///
+/// Dear ImGui already bakes glyphs lazily, one size at a time, as text is drawn. This wraps
+/// its FreeType font loader: cached bitmaps are copied straight into the atlas texture, and
+/// anything missing falls through to FreeType and is remembered for next time. Caches live
+/// on disk as one file per font, keyed by a hash of the font file.
+///
+/// Only one instance can exist at a time, because font loader callbacks have no user data.
+class GlyphCache {
+  public:
+  GlyphCache();
+  /// Writes out fonts that gained new glyphs. Must outlive the ImGui context.
+  ~GlyphCache();
+
+  GlyphCache(const GlyphCache&) = delete;
+  GlyphCache& operator=(const GlyphCache&) = delete;
+
+  /// Must be called before any fonts are added.
+  void install(ImFontAtlas& atlas);
+
+  private:
+  struct Glyph {
+    float advance_x = 0.f;
+    float x0 = 0.f;
+    float y0 = 0.f;
+    float x1 = 0.f;
+    float y1 = 0.f;
+    uint16_t width = 0;
+    uint16_t height = 0;
+    bool is_colored = false;
+    /// Rows are tightly packed, in the atlas texture's format.
+    std::string pixels;
+  };
+
+  struct Font {
+    std::unordered_map<uint64_t, Glyph> glyphs;
+    bool is_dirty = false;
+  };
+
+  static bool font_src_init(ImFontAtlas* atlas, ImFontConfig* src);
+  static void font_src_destroy(ImFontAtlas* atlas, ImFontConfig* src);
+  static bool font_baked_load_glyph(ImFontAtlas* atlas, ImFontConfig* src, ImFontBaked* baked,
+      void* loader_data, ImWchar codepoint, ImFontGlyph* out_glyph, float* out_advance_x);
+
+  static uint64_t get_glyph_key(const ImFontConfig& src, const ImFontBaked& baked,
+      ImWchar codepoint);
+
+  /// Copies a cached glyph into the atlas. Returns false if there was no room.
+  static bool upload(ImFontAtlas& atlas, ImFontConfig& src, ImFontBaked& baked,
+      const Glyph& glyph, ImWchar codepoint, ImFontGlyph& out_glyph);
+  /// Reads back a glyph that was just rasterized into the atlas.
+  static Glyph read_back(ImFontAtlas& atlas, const ImFontGlyph& glyph);
+
+  /// Reads the font's cache file the first time it's seen. Missing or outdated files are
+  /// treated as empty.
+  Font& load_font(uint64_t font_hash);
+  void save_font(uint64_t font_hash, const Font& font) const;
+
+  std::filesystem::path cache_path_;
+  ImFontLoader loader_ = {};
+  const ImFontLoader* freetype_loader_ = nullptr;
+
+  std::unordered_map<uint64_t, Font> fonts_;
+  /// Fonts are identified by their file contents rather than by their config, which only
+  /// lives as long as the atlas.
+  std::unordered_map<const ImFontConfig*, uint64_t> font_hashes_;
+};
+
+}
@@ -1,6 +1,11 @@
 #include "layout.hpp"
 
 #include "aspect_ratio.hpp"
+#include "frame_arena.hpp"
+#include "gfx/compilation_diagnostic.hpp"
+#include "gfx/literal_scrub.hpp"
+#include "gfx/shader_override.hpp"
+#include "hash.hpp"
 #include "utility.hpp"
 
 #include <imgui.h>
@@ -8,18 +13,32 @@
 #include <imgui_stdlib.h>
 #include <webgpu/webgpu.h>
 
+#include <algorithm>
 #include <array>
+#include <cfloat>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
 #include <functional>
+#include <memory_resource>
+#include <optional>
+#include <string>
 #include <string_view>
 #include <utility>
+#include <vector>
 
 namespace mewo::gui {
 
 static constexpr std::string_view EDITOR_WINDOW_NAME = "Editor";
 static constexpr std::string_view DIAGNOSTICS_WINDOW_NAME = "Diagnostics";
 static constexpr std::string_view VIEWPORT_WINDOW_NAME = "Viewport";
+static constexpr std::string_view GALLERY_WINDOW_NAME = "Gallery";
+static constexpr std::string_view STATISTICS_WINDOW_NAME = "Statistics";
+static constexpr std::string_view SCOPES_WINDOW_NAME = "Scopes";
 
-void Layout::build(State& state, const Context& gui_ctx, Editor& editor, Viewport& viewport)
+void Layout::build(State& state, FrameArena& arena, const Context& gui_ctx,
+    const gfx::Renderer& renderer, const gfx::ShaderWarmup& warmup, Editor& editor,
+    gfx::LiteralScrub& scrub, Viewport& viewport, Gallery& gallery, Scopes& scopes)
 {
   // Once the layout is created, the ID remains constant.
   if (const ImGuiID dockspace_id = ImGui::GetID("main-dockspace");
@@ -30,23 +49,87 @@ void Layout::build(State& state, const Context& gui_ctx, Editor& editor, Viewpor
         dockspace_id, gui_ctx.viewport(), ImGuiDockNodeFlags_PassthruCentralNode);
   }
 
+  if (ImGui::Shortcut(ImGuiMod_Ctrl | ImGuiKey_S, ImGuiInputFlags_RouteGlobal))
+    state.should_save_project = true;
+
+  // The editor's own undo is disabled, so these have to win over it while it's focused
+  constexpr ImGuiInputFlags history_flags = ImGuiInputFlags_RouteGlobal
+      | ImGuiInputFlags_RouteOverFocused | ImGuiInputFlags_Repeat;
+  bool should_undo = ImGui::Shortcut(ImGuiMod_Ctrl | ImGuiKey_Z, history_flags);
+  bool should_redo = ImGui::Shortcut(ImGuiMod_Ctrl | ImGuiMod_Shift | ImGuiKey_Z, history_flags)
+      || ImGui::Shortcut(ImGuiMod_Ctrl | ImGuiKey_Y, history_flags);
+
   if (ImGui::BeginMainMenuBar()) {
     if (ImGui::BeginMenu("File")) {
+      if (ImGui::MenuItem("Save", "Ctrl+S"))
+        state.should_save_project = true;
+
       if (ImGui::MenuItem("Quit"))
         state.should_quit = true;
 
       ImGui::EndMenu();
     }
 
+    if (ImGui::BeginMenu("Edit")) {
+      if (ImGui::MenuItem("Undo", "Ctrl+Z", false, editor.history().can_undo()))
+        should_undo = true;
+
+      if (ImGui::MenuItem("Redo", "Ctrl+Shift+Z", false, editor.history().can_redo()))
+        should_redo = true;
+
+      ImGui::EndMenu();
+    }
+
     ImGui::EndMainMenuBar();
   }
 
   {
     ImGui::Begin(EDITOR_WINDOW_NAME.data());
 
+    // Scrubbed values become an edit of their own first, so undoing takes them back
+    if (should_undo || should_redo)
+      finish_scrubbing(scrub, editor, viewport);
+
+    if ((should_undo && editor.undo()) || (should_redo && editor.redo())) {
+      // While the editor is active it edits its own copy of the text, which is now stale
+      if (ImGuiInputTextState* input_state = ImGui::GetInputTextState(ImGui::GetID("##editor")))
+        input_state->ReloadUserBufAndKeepSelection();
+
+      // Stepping back to code that compiled before swaps its shader back in without
+      // recompiling. Otherwise, the restored code is run like any other
+      const std::optional<uint64_t> shader_key = editor.history().shader_key();
+      std::string combined_code = editor.combined_code();
+
+      if (shader_key != hash::fnv1a(combined_code)
+          || !viewport.set_pending_restore(shader_key.value())) {
+        viewport.set_pending_run_request(std::move(combined_code));
+      }
+    }
+
+    if (bool is_scrubbing = scrub.is_active(); ImGui::Checkbox("Scrub literals", &is_scrubbing)) {
+      if (!is_scrubbing) {
+        finish_scrubbing(scrub, editor, viewport);
+      } else {
+        // So baking the values later is an edit of its own
+        editor.commit_edits();
+
+        // Only the hoisted code is compiled, every drag after that just writes a value
+        if (auto hoisted = scrub.start(editor.visible_code()); hoisted.has_value())
+          viewport.set_pending_run_request(editor.combined_code(hoisted.value()));
+      }
+    }
+
+    ImGui::SetItemTooltip("Drag float literals in the code to see the viewport change right away,\n"
+                          "without compiling. Unchecking writes the values into the code");
+
     ImGui::PushFont(gui_ctx.fonts().geist_mono, 0.f);
     ImVec2 window_size = ImGui::GetContentRegionAvail();
-    ImGui::InputTextMultiline("##editor", &editor.visible_code(), window_size);
+    if (scrub.is_active()) {
+      build_scrub_view(arena, scrub, viewport, window_size);
+    } else if (ImGui::InputTextMultiline("##editor", &editor.visible_code(), window_size,
+                   ImGuiInputTextFlags_NoUndoRedo)) {
+      editor.mark_edited();
+    }
     ImGui::PopFont();
 
     ImGui::End();
@@ -56,15 +139,15 @@ void Layout::build(State& state, const Context& gui_ctx, Editor& editor, Viewpor
     ImGui::Begin(DIAGNOSTICS_WINDOW_NAME.data());
 
     ImGui::PushFont(gui_ctx.fonts().geist_mono, 0.f);
-    if (const auto& diagnostics = viewport.diagnostics(); diagnostics.size() > 0) {
-      for (const auto& diag : diagnostics) {
-        ImGui::Text("(%llu:%llu) %s: %s", diag.line_num, diag.line_pos, diag.type_name.data(),
-            diag.message.c_str());
-        ImGui::Text("%s", diag.highlight.c_str());
-
-        std::string indicators;
-        for (size_t i = 0; i < diag.highlight.size(); ++i)
-          indicators += '^';
+    if (const gfx::CompilationLog& log = viewport.diagnostics(); !log.empty()) {
+      for (const gfx::CompilationDiagnostic& diag : log.diagnostics()) {
+        const std::string_view highlight = log.highlight(diag);
+
+        ImGui::Text("(%llu:%llu) %s: %.*s", diag.line_num, diag.line_pos, diag.type_name.data(),
+            static_cast<int>(diag.message.size()), diag.message.data());
+        ImGui::Text("%.*s", static_cast<int>(highlight.size()), highlight.data());
+
+        std::pmr::string indicators(highlight.size(), '^', &arena);
         ImGui::Text("%s", indicators.c_str());
 
         // TODO: don't include spacing if it's the last diagnostic
@@ -100,6 +183,10 @@ void Layout::build(State& state, const Context& gui_ctx, Editor& editor, Viewpor
     }
 
     {
+      // Resolution mode can render far more pixels than fit in the panel, so a smaller mip
+      // level is displayed instead
+      viewport.set_displayed_width(window_size.x * ImGui::GetIO().DisplayFramebufferScale.x);
+
       WGPUTextureView view_raw = viewport.view().Get();
       auto texture_id = static_cast<ImTextureID>(reinterpret_cast<intptr_t>(view_raw));
 
@@ -119,10 +206,26 @@ void Layout::build(State& state, const Context& gui_ctx, Editor& editor, Viewpor
 
       // Height of image is always derived from the width, because we horizontally fill the GUI
       ImGui::Image(texture_id, ImVec2(window_size.x, window_size.x * inverse_ratio));
+
+      if (ImGui::IsItemHovered() && ImGui::IsMouseDown(ImGuiMouseButton_Left)) {
+        const ImVec2 image_min = ImGui::GetItemRectMin();
+        const ImVec2 image_size = ImGui::GetItemRectSize();
+        const ImVec2 mouse_pos = ImGui::GetMousePos();
+
+        viewport.set_mouse(std::array {
+            (mouse_pos.x - image_min.x) / image_size.x,
+            (mouse_pos.y - image_min.y) / image_size.y,
+        });
+      } else {
+        viewport.set_mouse(std::nullopt);
+      }
     }
 
-    if (ImGui::Button("Run"))
+    if (ImGui::Button("Run")) {
+      // So the version being run is the one its shader gets linked to
+      editor.commit_edits();
       viewport.set_pending_run_request(editor.combined_code());
+    }
 
     {
       using Mode = Viewport::Mode;
@@ -202,10 +305,347 @@ void Layout::build(State& state, const Context& gui_ctx, Editor& editor, Viewpor
       utility::enum_unreachable("Viewport::Mode", prev_mode);
     }
 
+    {
+      static constexpr double MIB = 1024.0 * 1024.0;
+
+      const Viewport::Quality prev_quality = viewport.quality();
+
+      auto get_quality_label = [&viewport, &arena](Viewport::Quality quality) -> const char* {
+        const Viewport::QualityTier& tier = Viewport::QUALITY_TIERS[std::to_underlying(quality)];
+        const Viewport::QualityCost cost = viewport.quality_cost(quality);
+        const double target_mib = static_cast<double>(cost.target_size) / MIB;
+
+        if (!cost.gpu_ms.has_value()) {
+          return arena.format(
+              "{} ({}) - not measured, +{:.1f} MiB", tier.name, tier.description, target_mib);
+        }
+
+        return arena.format("{} ({}) - {:.2f} ms, +{:.1f} MiB", tier.name, tier.description,
+            cost.gpu_ms.value(), target_mib);
+      };
+
+      if (ImGui::BeginCombo("Quality", get_quality_label(prev_quality))) {
+        for (size_t idx = 0; idx < Viewport::QUALITY_COUNT; ++idx) {
+          auto quality = static_cast<Viewport::Quality>(idx);
+          const bool is_selected = quality == prev_quality;
+
+          if (ImGui::Selectable(get_quality_label(quality), is_selected) && !is_selected)
+            viewport.set_pending_quality(quality);
+
+          if (is_selected)
+            ImGui::SetItemDefaultFocus();
+        }
+
+        ImGui::EndCombo();
+      }
+
+      ImGui::SetItemTooltip("GPU times are measured while a tier is in use. Memory is for the\n"
+                            "intermediate target, on top of the displayed texture");
+    }
+
+    {
+      static constexpr uint32_t ACCUMULATION_TARGET_MIN = 1;
+
+      bool is_accumulating = viewport.is_accumulating();
+
+      if (ImGui::Checkbox("Accumulate", &is_accumulating))
+        viewport.set_pending_accumulation(is_accumulating);
+
+      ImGui::SetItemTooltip("Blends every frame into a running average, for progressive renderers\n"
+                            "like path tracers. Starts over when the code, size, overrides or\n"
+                            "mouse change");
+
+      if (viewport.is_accumulating()) {
+        uint32_t target = viewport.accumulation_target();
+
+        if (ImGui::DragScalar("Target samples", ImGuiDataType_U32, &target, 1.f,
+                &ACCUMULATION_TARGET_MIN, nullptr, "%u", ImGuiSliderFlags_AlwaysClamp)) {
+          viewport.set_accumulation_target(target);
+        }
+
+        const uint32_t sample_count = viewport.sample_count();
+        const float progress
+            = static_cast<float>(sample_count) / static_cast<float>(viewport.accumulation_target());
+
+        ImGui::ProgressBar(std::min(progress, 1.f), ImVec2(-FLT_MIN, 0.f),
+            arena.format("{} / {} samples", sample_count, viewport.accumulation_target()));
+
+        if (ImGui::Button("Restart"))
+          viewport.set_pending_accumulation_reset();
+      }
+    }
+
+    if (const auto& overrides = viewport.overrides(); !overrides.empty()) {
+      using Type = gfx::ShaderOverride::Type;
+
+      ImGui::SeparatorText("Overrides");
+
+      for (size_t idx = 0; idx < overrides.size(); ++idx) {
+        const gfx::ShaderOverride& override_decl = overrides[idx];
+        const double prev_value = override_decl.get_effective_value();
+        // Initializers that are expressions are only known to the shader
+        const bool is_value_known
+            = override_decl.value.has_value() || override_decl.initial_value.has_value();
+        std::optional<double> curr_value;
+
+        ImGui::PushID(static_cast<int>(idx));
+
+        switch (override_decl.type) {
+        case Type::Bool: {
+          bool is_checked = prev_value != 0.0;
+
+          if (ImGui::Checkbox(override_decl.name.c_str(), &is_checked))
+            curr_value = is_checked ? 1.0 : 0.0;
+
+          break;
+        }
+
+        case Type::I32: {
+          auto value = static_cast<int32_t>(prev_value);
+
+          if (ImGui::DragScalar(override_decl.name.c_str(), ImGuiDataType_S32, &value, 0.1f,
+                  nullptr, nullptr, is_value_known ? "%d" : "(from shader)")) {
+            curr_value = value;
+          }
+
+          break;
+        }
+
+        case Type::U32: {
+          auto value = static_cast<uint32_t>(std::max(prev_value, 0.0));
+
+          if (ImGui::DragScalar(override_decl.name.c_str(), ImGuiDataType_U32, &value, 0.1f,
+                  nullptr, nullptr, is_value_known ? "%u" : "(from shader)")) {
+            curr_value = value;
+          }
+
+          break;
+        }
+
+        case Type::F32:
+        case Type::F16: {
+          auto value = static_cast<float>(prev_value);
+
+          if (ImGui::DragFloat(override_decl.name.c_str(), &value, 0.01f, 0.f, 0.f,
+                  is_value_known ? "%.3f" : "(from shader)")) {
+            curr_value = value;
+          }
+
+          break;
+        }
+
+        default:
+          utility::enum_unreachable("gfx::ShaderOverride::Type", override_decl.type);
+        }
+
+        if (curr_value.has_value())
+          viewport.set_override_value(idx, curr_value);
+
+        // Going back to the initializer is only possible if it's been overridden at all
+        if (override_decl.value.has_value() && override_decl.initial_value.has_value()) {
+          ImGui::SameLine();
+
+          if (ImGui::SmallButton("Reset"))
+            viewport.set_override_value(idx, std::nullopt);
+        }
+
+        ImGui::PopID();
+      }
+    }
+
     prev_viewport_window_width_ = curr_viewport_window_width;
 
     ImGui::End();
   }
+
+  {
+    ImGui::Begin(GALLERY_WINDOW_NAME.data());
+
+    if (ImGui::Button("Refresh"))
+      gallery.set_pending_refresh();
+
+    WGPUTextureView atlas_view_raw = gallery.view().Get();
+    auto atlas_texture_id = static_cast<ImTextureID>(reinterpret_cast<intptr_t>(atlas_view_raw));
+
+    static constexpr float THUMBNAIL_DISPLAY_SCALE = 0.5f;
+    const ImVec2 thumbnail_size(
+        THUMBNAIL_DISPLAY_SCALE * static_cast<float>(Gallery::THUMBNAIL_WIDTH),
+        THUMBNAIL_DISPLAY_SCALE * static_cast<float>(Gallery::THUMBNAIL_HEIGHT));
+    const float max_x = ImGui::GetCursorScreenPos().x + ImGui::GetContentRegionAvail().x;
+
+    for (const auto& entry : gallery.entries()) {
+      ImGui::PushID(static_cast<int>(entry.tile));
+
+      bool was_clicked = false;
+
+      if (entry.status == Gallery::Status::Ready) {
+        auto [uv_min, uv_max] = gallery.uv_rect(entry);
+        was_clicked = ImGui::ImageButton("##thumbnail", atlas_texture_id, thumbnail_size,
+            ImVec2(uv_min[0], uv_min[1]), ImVec2(uv_max[0], uv_max[1]));
+      } else {
+        // Placeholder with the same size, so the grid doesn't shift around
+        was_clicked = ImGui::Button(
+            entry.status == Gallery::Status::Failed ? "Error" : "...", thumbnail_size);
+      }
+
+      if (ImGui::IsItemHovered())
+        ImGui::SetTooltip("%s", entry.name.c_str());
+
+      if (was_clicked)
+        state.pending_open_source = entry.source;
+
+      // Wrap to the next row when the following thumbnail wouldn't fit
+      if (ImGui::GetItemRectMax().x + ImGui::GetStyle().ItemSpacing.x + thumbnail_size.x < max_x)
+        ImGui::SameLine();
+
+      ImGui::PopID();
+    }
+
+    ImGui::End();
+  }
+
+  {
+    // Begin returns false while the window is collapsed or its tab isn't selected
+    const bool are_scopes_visible = ImGui::Begin(SCOPES_WINDOW_NAME.data());
+    scopes.set_is_visible(are_scopes_visible);
+
+    if (are_scopes_visible) {
+      auto show_scope = [](std::string_view label, const wgpu::TextureView& view, float width,
+                            float height) {
+        ImGui::SeparatorText(label.data());
+
+        // Scaled to fill the window's width, keeping the texture's aspect ratio
+        const float display_width = ImGui::GetContentRegionAvail().x;
+        WGPUTextureView view_raw = view.Get();
+        ImGui::Image(static_cast<ImTextureID>(reinterpret_cast<intptr_t>(view_raw)),
+            ImVec2(display_width, display_width * height / width));
+      };
+
+      show_scope("Histogram", scopes.histogram_view(),
+          static_cast<float>(Scopes::HISTOGRAM_TEXTURE_WIDTH),
+          static_cast<float>(Scopes::HISTOGRAM_TEXTURE_HEIGHT));
+      show_scope("Waveform", scopes.waveform_view(),
+          static_cast<float>(Scopes::WAVEFORM_TEXTURE_WIDTH),
+          static_cast<float>(Scopes::WAVEFORM_TEXTURE_HEIGHT));
+      show_scope("Vectorscope", scopes.vectorscope_view(),
+          static_cast<float>(Scopes::VECTORSCOPE_TEXTURE_SIZE),
+          static_cast<float>(Scopes::VECTORSCOPE_TEXTURE_SIZE));
+    }
+
+    ImGui::End();
+  }
+
+  {
+    ImGui::Begin(STATISTICS_WINDOW_NAME.data());
+
+    ImGui::SeparatorText("Startup");
+
+    // Marks are added from the renderer's background thread too, so this takes a copy
+    if (ImGui::BeginTable("startup-timeline", 2, ImGuiTableFlags_RowBg)) {
+      for (const auto& [label, elapsed_ns] : state.startup.marks(&arena)) {
+        ImGui::TableNextRow();
+        ImGui::TableNextColumn();
+        ImGui::Text("%.2f ms", static_cast<double>(elapsed_ns) / 1'000'000.0);
+        ImGui::TableNextColumn();
+        ImGui::Text("%.*s", static_cast<int>(label.size()), label.data());
+      }
+
+      ImGui::EndTable();
+    }
+
+    ImGui::SeparatorText("GPU memory");
+
+    const gfx::MemoryTracker& memory_tracker = renderer.memory_tracker();
+
+    static constexpr double MIB = 1024.0 * 1024.0;
+
+    if (ImGui::BeginTable("gpu-memory", 3, ImGuiTableFlags_RowBg)) {
+      ImGui::TableSetupColumn("Category");
+      ImGui::TableSetupColumn("Live");
+      ImGui::TableSetupColumn("Peak");
+      ImGui::TableHeadersRow();
+
+      auto add_row = [](std::string_view name, gfx::MemoryTracker::Usage usage) {
+        ImGui::TableNextRow();
+        ImGui::TableNextColumn();
+        ImGui::Text("%.*s", static_cast<int>(name.size()), name.data());
+        ImGui::TableNextColumn();
+        ImGui::Text("%.2f MiB", static_cast<double>(usage.live) / MIB);
+        ImGui::TableNextColumn();
+        ImGui::Text("%.2f MiB", static_cast<double>(usage.peak) / MIB);
+      };
+
+      for (size_t idx = 0; idx < gfx::MemoryTracker::CATEGORY_COUNT; ++idx) {
+        auto category = static_cast<gfx::MemoryTracker::Category>(idx);
+        add_row(gfx::MemoryTracker::get_category_name(category), memory_tracker.usage(category));
+      }
+
+      add_row("Total", memory_tracker.total());
+
+      ImGui::EndTable();
+    }
+
+    const auto total_live = static_cast<double>(memory_tracker.total().live);
+    const auto budget = static_cast<double>(memory_tracker.budget());
+
+    ImGui::ProgressBar(static_cast<float>(total_live / budget), ImVec2(-1.f, 0.f),
+        arena.format("{:.1f} / {:.0f} MiB", total_live / MIB, budget / MIB));
+
+    if (total_live > budget)
+      ImGui::TextColored(ImVec4(1.f, 0.4f, 0.4f, 1.f), "Over budget!");
+
+    ImGui::SeparatorText("Shader warm-up");
+
+    if (auto duration_ms = warmup.duration_ms(); duration_ms.has_value()) {
+      ImGui::Text("%zu shader(s) in %.2f ms", warmup.progress().total, duration_ms.value());
+    } else {
+      auto [finished, total] = warmup.progress();
+      ImGui::ProgressBar(static_cast<float>(finished) / static_cast<float>(total),
+          ImVec2(-1.f, 0.f), arena.format("{} / {} shader(s)", finished, total));
+    }
+
+    ImGui::SeparatorText("Surface");
+
+    const gfx::Renderer::SurfaceStats& surface_stats = renderer.surface_stats();
+
+    // Fixed-width integers don't map to the same `printf` specifier on every platform
+    auto add_count = [](const char* label, uint64_t count) {
+      ImGui::Text("%s: %llu", label, static_cast<unsigned long long>(count));
+    };
+
+    add_count("Reconfigured", surface_stats.reconfigure_count);
+    ImGui::SetItemTooltip("From resizes, and from surfaces that became outdated or suboptimal.");
+    add_count("Coalesced resizes", surface_stats.coalesced_resize_count);
+    add_count("Skipped frames", surface_stats.skipped_frame_count);
+
+    ImGui::SeparatorText("CPU memory");
+
+    add_count("Heap allocations last frame", state.frame_allocation_count);
+    ImGui::SetItemTooltip("Made on the main thread while building the frame, including by the\n"
+                          "GUI. Should stay at zero unless something changed.");
+    ImGui::Text("Frame arena: %.1f KiB peak of %.1f KiB",
+        static_cast<double>(arena.peak()) / 1024.0, static_cast<double>(arena.capacity()) / 1024.0);
+    ImGui::Text("Edit history: %zu versions in %.1f KiB", editor.history().version_count(),
+        static_cast<double>(editor.history().memory_usage()) / 1024.0);
+
+    ImGui::SeparatorText("Hot reload");
+
+    if (auto latency_ms = state.reload_latency_ms; latency_ms.has_value())
+      ImGui::Text("Save to present: %.2f ms", latency_ms.value());
+    else
+      ImGui::TextDisabled("No external changes yet.");
+
+    ImGui::End();
+  }
+}
+
+void Layout::finish_scrubbing(gfx::LiteralScrub& scrub, Editor& editor, Viewport& viewport)
+{
+  if (!scrub.is_active())
+    return;
+
+  editor.replace_code(scrub.finish());
+  viewport.set_pending_run_request(editor.combined_code());
 }
 
 void Layout::set_up_initial_layout(const Context& gui_ctx, ImGuiID dockspace_id) const
@@ -223,9 +663,80 @@ void Layout::set_up_initial_layout(const Context& gui_ctx, ImGuiID dockspace_id)
 
   ImGui::DockBuilderDockWindow(EDITOR_WINDOW_NAME.data(), left_up_id);
   ImGui::DockBuilderDockWindow(DIAGNOSTICS_WINDOW_NAME.data(), left_down_id);
+  ImGui::DockBuilderDockWindow(GALLERY_WINDOW_NAME.data(), left_down_id);
+  ImGui::DockBuilderDockWindow(STATISTICS_WINDOW_NAME.data(), left_down_id);
+  ImGui::DockBuilderDockWindow(SCOPES_WINDOW_NAME.data(), left_down_id);
   ImGui::DockBuilderDockWindow(VIEWPORT_WINDOW_NAME.data(), right_id);
 
   ImGui::DockBuilderFinish(dockspace_id);
 }
 
+void Layout::build_scrub_view(FrameArena& arena, gfx::LiteralScrub& scrub, Viewport& viewport,
+    const ImVec2& size) const
+{
+  using Literal = gfx::LiteralScrub::Literal;
+
+  const std::string& code = scrub.code();
+  const std::vector<Literal>& literals = scrub.literals();
+
+  std::pmr::vector<size_t> line_begins({ 0 }, &arena);
+
+  for (size_t idx = code.find('\n'); idx != std::string::npos; idx = code.find('\n', idx + 1))
+    line_begins.push_back(idx + 1);
+
+  ImGui::BeginChild("##scrub", size, ImGuiChildFlags_FrameStyle,
+      ImGuiWindowFlags_HorizontalScrollbar);
+
+  // Drags are as tall as a line of text and sit right next to it, so the code reads as usual
+  ImGui::PushStyleVar(ImGuiStyleVar_ItemSpacing, ImVec2(0.f, 0.f));
+  ImGui::PushStyleVar(ImGuiStyleVar_FramePadding, ImVec2(0.f, 0.f));
+
+  // Every line has the same height, so only visible ones are built
+  ImGuiListClipper clipper;
+  clipper.Begin(static_cast<int>(line_begins.size()));
+
+  while (clipper.Step()) {
+    for (auto line = static_cast<size_t>(clipper.DisplayStart);
+        line < static_cast<size_t>(clipper.DisplayEnd); ++line) {
+      size_t begin = line_begins[line];
+      const size_t end = line + 1 < line_begins.size() ? line_begins[line + 1] - 1 : code.size();
+
+      auto literal_it = std::ranges::lower_bound(literals, begin, {}, &Literal::offset);
+
+      for (auto idx = static_cast<size_t>(literal_it - literals.begin());
+          idx < literals.size() && literals[idx].offset < end; ++idx) {
+        const Literal& literal = literals[idx];
+
+        ImGui::TextUnformatted(code.data() + begin, code.data() + literal.offset);
+        ImGui::SameLine(0.f, 0.f);
+
+        std::array<char, 32> text = {};
+        ImFormatString(text.data(), text.size(), "%g", literal.value);
+
+        // Steps follow the literal's magnitude, so tiny and large ones are as easy to drag
+        const float speed = 0.01f * std::max(std::abs(literal.initial_value), 0.1f);
+        float value = literal.value;
+
+        ImGui::PushID(static_cast<int>(idx));
+        ImGui::SetNextItemWidth(ImGui::CalcTextSize(text.data()).x);
+
+        if (ImGui::DragFloat("##literal", &value, speed, 0.f, 0.f, "%g")) {
+          scrub.set_value(idx, value);
+          viewport.set_pending_accumulation_reset();
+        }
+
+        ImGui::PopID();
+        ImGui::SameLine(0.f, 0.f);
+
+        begin = literal.offset + literal.length;
+      }
+
+      ImGui::TextUnformatted(code.data() + begin, code.data() + end);
+    }
+  }
+
+  ImGui::PopStyleVar(2);
+  ImGui::EndChild();
+}
+
 }
@@ -1,7 +1,13 @@
 #pragma once
 
 #include "editor.hpp"
+#include "frame_arena.hpp"
+#include "gallery.hpp"
+#include "gfx/literal_scrub.hpp"
+#include "gfx/renderer.hpp"
+#include "gfx/shader_warmup.hpp"
 #include "gui/context.hpp"
+#include "scopes.hpp"
 #include "state.hpp"
 #include "viewport.hpp"
 
@@ -15,12 +21,21 @@ class Layout {
   static constexpr float SPLIT_LEFT_RATIO = 0.5f;
 
   /// Builds the GUI and records additional data into respective classes. Called every frame.
-  void build(State& state, const Context& gui_ctx, Editor& editor, Viewport& viewport);
+  /// Text that's only shown this frame is allocated from the arena.
+  void build(State& state, FrameArena& arena, const Context& gui_ctx,
+      const gfx::Renderer& renderer, const gfx::ShaderWarmup& warmup, Editor& editor,
+      gfx::LiteralScrub& scrub, Viewport& viewport, Gallery& gallery, Scopes& scopes);
+  /// Bakes scrubbed literals into the visible code and runs it. Does nothing if not scrubbing.
+  static void finish_scrubbing(gfx::LiteralScrub& scrub, Editor& editor, Viewport& viewport);
 
   private:
   /// Sets up the overall docking layout. Only needs to be called once. Can only
   /// be called after a new frame is initiated, so it's not possible in the constructor.
   void set_up_initial_layout(const Context& gui_ctx, ImGuiID dockspace_id) const;
+  /// Shows the code being scrubbed in place of the editor, with a drag for every literal.
+  /// Dragging writes the literal's value right away.
+  void build_scrub_view(FrameArena& arena, gfx::LiteralScrub& scrub, Viewport& viewport,
+      const ImVec2& size) const;
 
   /// Needs to be cached every frame. Will be checked to see if the viewport texture
   /// needs to be resized. Only relevant when the viewport mode is `AspectRatio`.
@@ -0,0 +1,30 @@
+#pragma once
+
+#include <cstdint>
+#include <format>
+#include <string>
+#include <string_view>
+
+namespace mewo::hash {
+
+inline constexpr uint64_t FNV_OFFSET_BASIS = 0xcbf29ce484222325;
+inline constexpr uint64_t FNV_PRIME = 0x100000001b3;
+
+/// 64-bit FNV-1a. Not cryptographically secure, only meant for cache keys. Passing
+/// a previous result as the seed lets multiple pieces of data be hashed together.
+constexpr uint64_t fnv1a(std::string_view data, uint64_t seed = FNV_OFFSET_BASIS)
+{
+  uint64_t hash = seed;
+
+  for (char c : data) {
+    hash ^= static_cast<uint8_t>(c);
+    hash *= FNV_PRIME;
+  }
+
+  return hash;
+}
+
+/// Fixed width, lowercase hexadecimal representation. Suitable for file names.
+inline std::string to_hex(uint64_t hash) { return std::format("{:016x}", hash); }
+
+}
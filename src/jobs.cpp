@@ -0,0 +1,226 @@
+#include "jobs.hpp"
+
+#include "query.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <exception>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <print>
+#include <thread>
+#include <utility>
+
+namespace mewo::jobs {
+
+/// Set on worker threads, so jobs submitted from a job go to that worker's own queues.
+static thread_local const System* tls_system = nullptr;
+static thread_local size_t tls_worker_idx = 0;
+
+CancellationToken::CancellationToken()
+    : state_(std::make_shared<State>())
+{
+}
+
+bool CancellationToken::is_cancelled() const
+{
+  return state_->is_cancelled.load(std::memory_order_acquire);
+}
+
+void CancellationToken::cancel() const
+{
+  state_->is_cancelled.store(true, std::memory_order_release);
+}
+
+void CancellationToken::wait() const
+{
+  for (size_t count = state_->job_count.load(std::memory_order_acquire); count != 0;
+      count = state_->job_count.load(std::memory_order_acquire)) {
+    state_->job_count.wait(count, std::memory_order_acquire);
+  }
+}
+
+System::System(size_t worker_count)
+{
+  if (worker_count == 0) {
+    size_t hardware_thread_count = std::max<size_t>(std::thread::hardware_concurrency(), 2);
+    worker_count = hardware_thread_count - 1;
+  }
+
+  workers_.reserve(worker_count);
+
+  for (size_t idx = 0; idx < worker_count; ++idx)
+    workers_.push_back(std::make_unique<Worker>());
+
+  // Started only once every worker exists, since any of them can be stolen from
+  threads_.reserve(worker_count);
+
+  for (size_t idx = 0; idx < worker_count; ++idx)
+    threads_.emplace_back([this, idx] { run_worker(idx); });
+
+  if constexpr (query::is_debug())
+    std::println("Started {} job worker(s)", worker_count);
+}
+
+System::~System()
+{
+  {
+    std::lock_guard lock(sleep_mutex_);
+    is_stopping_.store(true, std::memory_order_relaxed);
+  }
+
+  wake_.notify_all();
+
+  for (std::thread& thread : threads_)
+    thread.join();
+
+  // Whoever is waiting on a dropped job's token would otherwise never wake up
+  for (std::unique_ptr<Worker>& worker : workers_) {
+    for (std::deque<QueuedJob>& queue : worker->queues) {
+      for (QueuedJob& queued : queue) {
+        if (queued.token.state_->job_count.fetch_sub(1, std::memory_order_acq_rel) == 1)
+          queued.token.state_->job_count.notify_all();
+      }
+    }
+  }
+
+  PostedCompletion* node = completions_.exchange(nullptr, std::memory_order_acquire);
+
+  while (node != nullptr)
+    delete std::exchange(node, node->next);
+}
+
+size_t System::worker_count() const { return workers_.size(); }
+
+void System::submit(Priority priority, const CancellationToken& token, Job job)
+{
+  token.state_->job_count.fetch_add(1, std::memory_order_relaxed);
+
+  const size_t worker_idx = tls_system == this
+      ? tls_worker_idx
+      : next_worker_.fetch_add(1, std::memory_order_relaxed) % workers_.size();
+
+  {
+    Worker& worker = *workers_[worker_idx];
+    std::lock_guard lock(worker.mutex);
+
+    worker.queues[std::to_underlying(priority)].push_back({ std::move(job), token });
+  }
+
+  // Counted under the lock, so a worker can't check for jobs and go to sleep in between
+  {
+    std::lock_guard lock(sleep_mutex_);
+    queued_count_.fetch_add(1, std::memory_order_release);
+  }
+
+  wake_.notify_one();
+}
+
+void System::post(const CancellationToken& token, Completion completion)
+{
+  auto* node = new PostedCompletion { std::move(completion), token };
+  node->next = completions_.load(std::memory_order_relaxed);
+
+  while (!completions_.compare_exchange_weak(
+      node->next, node, std::memory_order_release, std::memory_order_relaxed)) { }
+}
+
+void System::drain_completions()
+{
+  PostedCompletion* node = completions_.exchange(nullptr, std::memory_order_acquire);
+
+  // Pushed newest first, so the list is reversed to run completions in the order they were
+  // posted
+  PostedCompletion* oldest = nullptr;
+
+  while (node != nullptr) {
+    PostedCompletion* next = node->next;
+    node->next = oldest;
+    oldest = node;
+    node = next;
+  }
+
+  while (oldest != nullptr) {
+    std::unique_ptr<PostedCompletion> posted(std::exchange(oldest, oldest->next));
+
+    if (posted->token.is_cancelled())
+      continue;
+
+    // Keeps the rest of the queue running, like a failed job does
+    try {
+      posted->completion();
+    } catch (const std::exception& ex) {
+      std::println("Job completion failed. {}", ex.what());
+    }
+  }
+}
+
+void System::run_worker(size_t worker_idx)
+{
+  tls_system = this;
+  tls_worker_idx = worker_idx;
+
+  // Queued jobs are left for the destructor to drop once stopping, rather than finished first
+  while (!is_stopping_.load(std::memory_order_relaxed)) {
+    if (std::optional<QueuedJob> queued = take_job(worker_idx); queued.has_value()) {
+      queued_count_.fetch_sub(1, std::memory_order_relaxed);
+      run_job(queued.value());
+
+      continue;
+    }
+
+    std::unique_lock lock(sleep_mutex_);
+
+    wake_.wait(lock, [this] {
+      return is_stopping_.load(std::memory_order_relaxed)
+          || queued_count_.load(std::memory_order_acquire) > 0;
+    });
+  }
+}
+
+std::optional<System::QueuedJob> System::take_job(size_t worker_idx)
+{
+  // Higher priorities are taken from any worker before lower ones are taken from this one
+  for (size_t priority = 0; priority < PRIORITY_COUNT; ++priority) {
+    for (size_t offset = 0; offset < workers_.size(); ++offset) {
+      Worker& worker = *workers_[(worker_idx + offset) % workers_.size()];
+      const bool is_own = offset == 0;
+
+      std::lock_guard lock(worker.mutex);
+      std::deque<QueuedJob>& queue = worker.queues[priority];
+
+      if (queue.empty())
+        continue;
+
+      QueuedJob taken = std::move(is_own ? queue.back() : queue.front());
+
+      if (is_own)
+        queue.pop_back();
+      else
+        queue.pop_front();
+
+      return taken;
+    }
+  }
+
+  return std::nullopt;
+}
+
+void System::run_job(QueuedJob& queued)
+{
+  if (!queued.token.is_cancelled()) {
+    // Can't let an exception escape a worker thread
+    try {
+      queued.job(queued.token);
+    } catch (const std::exception& ex) {
+      std::println("Job failed. {}", ex.what());
+    }
+  }
+
+  if (queued.token.state_->job_count.fetch_sub(1, std::memory_order_acq_rel) == 1)
+    queued.token.state_->job_count.notify_all();
+}
+
+}
@@ -0,0 +1,157 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <thread>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+/// Runs work off the main thread, so subsystems don't have to start threads of their own.
+/// Each worker owns a queue per priority, and steals from the others once its own are empty,
+/// so a burst of jobs submitted together is spread across every worker.
+///
+/// Results come back through a lock-free queue that's drained once per frame on the main
+/// thread, which is the only place completions run. They can therefore touch anything the
+/// main thread owns without locking.
+namespace mewo::jobs {
+
+enum class Priority : int {
+  /// Something on screen is waiting for the result.
+  High,
+  Normal,
+  /// Nothing is waiting for the result, like writing caches to disk.
+  Low,
+  Count,
+};
+
+inline constexpr size_t PRIORITY_COUNT = static_cast<size_t>(Priority::Count);
+
+/// Shared by every job started with it, and cheap to copy. Cancelling drops jobs that haven't
+/// started and completions that haven't run, while running jobs can check it to stop early.
+class CancellationToken {
+  public:
+  CancellationToken();
+
+  bool is_cancelled() const;
+
+  void cancel() const;
+  /// Blocks until no job started with this token is queued or running. Owners call this
+  /// before destroying anything their jobs reference.
+  void wait() const;
+
+  private:
+  friend class System;
+
+  struct State {
+    std::atomic<bool> is_cancelled = false;
+    std::atomic<size_t> job_count = 0;
+  };
+
+  std::shared_ptr<State> state_;
+};
+
+class System {
+  public:
+  using Job = std::function<void(const CancellationToken&)>;
+  using Completion = std::function<void()>;
+
+  /// Zero uses every hardware thread except the main thread's.
+  explicit System(size_t worker_count = 0);
+  /// Drops queued jobs and completions that were never drained. Running jobs are finished
+  /// first, since workers are joined.
+  ~System();
+
+  System(const System&) = delete;
+  System& operator=(const System&) = delete;
+
+  size_t worker_count() const;
+
+  /// Runs the job on a worker. Exceptions are caught and printed, since nothing on the worker
+  /// could handle them. Safe to call from any thread, including from other jobs.
+  void submit(Priority priority, const CancellationToken& token, Job job);
+  /// Runs the job on a worker, then hands its result to `on_complete` on the main thread.
+  /// Both have to be copyable. Neither runs if the token is cancelled first.
+  template <typename Fn, typename OnComplete>
+  void submit(
+      Priority priority, const CancellationToken& token, Fn&& fn, OnComplete&& on_complete);
+
+  /// Runs the completion during the next drain, unless the token is cancelled by then. Safe
+  /// to call from any thread.
+  void post(const CancellationToken& token, Completion completion);
+  /// Runs every completion posted so far, oldest first. Only call from the main thread.
+  /// Completions posted while draining run next time.
+  void drain_completions();
+
+  private:
+  struct QueuedJob {
+    Job job;
+    CancellationToken token;
+  };
+
+  struct Worker {
+    std::mutex mutex;
+    std::array<std::deque<QueuedJob>, PRIORITY_COUNT> queues;
+  };
+
+  /// Node of an intrusive stack that any thread can push onto without locking.
+  struct PostedCompletion {
+    Completion completion;
+    CancellationToken token;
+    PostedCompletion* next = nullptr;
+  };
+
+  void run_worker(size_t worker_idx);
+  /// Takes from the worker's own queues first, newest first since its data is likely still
+  /// in cache. Otherwise steals the oldest job of another worker at the same priority.
+  std::optional<QueuedJob> take_job(size_t worker_idx);
+  void run_job(QueuedJob& queued);
+
+  /// Each worker is behind a pointer, since its mutex can't be moved.
+  std::vector<std::unique_ptr<Worker>> workers_;
+  std::vector<std::thread> threads_;
+  /// Spreads jobs submitted from outside the workers.
+  std::atomic<size_t> next_worker_ = 0;
+
+  /// Workers sleep on this while every queue is empty.
+  std::mutex sleep_mutex_;
+  std::condition_variable wake_;
+  std::atomic<size_t> queued_count_ = 0;
+  /// Set under `sleep_mutex_`, so sleeping workers can't miss it, but also checked before
+  /// taking each job.
+  std::atomic<bool> is_stopping_ = false;
+
+  std::atomic<PostedCompletion*> completions_ = nullptr;
+};
+
+template <typename Fn, typename OnComplete>
+void System::submit(
+    Priority priority, const CancellationToken& token, Fn&& fn, OnComplete&& on_complete)
+{
+  using Result = std::invoke_result_t<Fn&, const CancellationToken&>;
+
+  submit(priority, token,
+      [this, fn = std::forward<Fn>(fn), on_complete = std::forward<OnComplete>(on_complete)](
+          const CancellationToken& job_token) mutable {
+        if constexpr (std::is_void_v<Result>) {
+          fn(job_token);
+          post(job_token, std::move(on_complete));
+        } else {
+          // Shared, since completions have to be copyable even if the result isn't
+          auto result = std::make_shared<Result>(fn(job_token));
+
+          post(job_token, [result, on_complete = std::move(on_complete)]() mutable {
+            on_complete(std::move(*result));
+          });
+        }
+      });
+}
+
+}
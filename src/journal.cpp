@@ -0,0 +1,457 @@
+#include "journal.hpp"
+
+#include "edit_history.hpp"
+#include "exception.hpp"
+#include "fs.hpp"
+#include "hash.hpp"
+#include "query.hpp"
+
+#include <SDL3/SDL.h>
+
+#include <algorithm>
+#include <array>
+#include <cstdio>
+#include <cstring>
+#include <exception>
+#include <filesystem>
+#include <mutex>
+#include <optional>
+#include <print>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace mewo {
+
+static constexpr std::string_view JOURNAL_SUBDIR = "journals";
+static constexpr std::array<char, 8> MAGIC = { 'M', 'E', 'W', 'O', 'J', 'R', 'N', 'L' };
+static constexpr uint32_t FORMAT_VERSION = 1;
+
+struct FileHeader {
+  std::array<char, 8> magic = MAGIC;
+  uint32_t version = FORMAT_VERSION;
+  uint32_t reserved = 0;
+};
+
+struct RecordHeader {
+  uint32_t kind = 0;
+  uint32_t size = 0;
+  /// Of the payload. A crash while appending leaves a record whose checksum doesn't match.
+  uint64_t checksum = 0;
+};
+
+/// Followed by the inserted text.
+struct SourceEditHeader {
+  uint32_t source_idx = 0;
+  uint32_t reserved = 0;
+  uint64_t offset = 0;
+  uint64_t removed_length = 0;
+};
+
+static_assert(std::is_trivially_copyable_v<FileHeader>);
+static_assert(std::is_trivially_copyable_v<RecordHeader>);
+static_assert(std::is_trivially_copyable_v<SourceEditHeader>);
+
+template <typename T> static void append_bytes(std::string& out, const T& value)
+{
+  out.append(reinterpret_cast<const char*>(&value), sizeof(T));
+}
+
+static std::filesystem::path get_journal_path(const std::filesystem::path& project_path)
+{
+  // Keyed by where the project is, since that's all that identifies it before it's saved
+  const uint64_t path_hash = hash::fnv1a(std::filesystem::weakly_canonical(project_path).string());
+  auto file_name = hash::to_hex(path_hash) + std::string(Journal::FILE_EXTENSION);
+
+  return fs::get_data_path(JOURNAL_SUBDIR) / file_name;
+}
+
+Journal::Journal(Project& project)
+    : path_(get_journal_path(project.path()))
+{
+  if (std::filesystem::exists(path_)) {
+    uint64_t start_ns = SDL_GetTicksNS();
+
+    // Losing the previous session is unfortunate, but shouldn't stop this one from starting
+    try {
+      session_ = parse(fs::read_file(path_));
+    } catch (const std::exception& ex) {
+      std::println("Failed to read journal. {}", ex.what());
+    }
+
+    for (auto it = session_.sources.begin(); it != session_.sources.end();) {
+      const auto& [source_idx, code] = *it;
+
+      // Only happens if the project was replaced since
+      if (source_idx >= project.source_count()) {
+        it = session_.sources.erase(it);
+        continue;
+      }
+
+      if (project.source_code(source_idx) != code) {
+        project.set_source_code(source_idx, code);
+        restored_sources_.push_back(source_idx);
+      }
+
+      ++it;
+    }
+
+    if (session_.active_source.has_value()
+        && session_.active_source.value() < project.source_count()) {
+      project.set_active_source(session_.active_source.value());
+    }
+
+    std::println("Restored {} unsaved source(s) from journal in {:.2f} ms",
+        restored_sources_.size(), static_cast<double>(SDL_GetTicksNS() - start_ns) / 1'000'000.0);
+  }
+
+  // Starting from a snapshot also drops a partially written record the crash may have left
+  compact();
+  thread_ = std::thread(&Journal::write_queued, this);
+}
+
+Journal::~Journal()
+{
+  {
+    std::scoped_lock lock(mutex_);
+    is_stopping_ = true;
+  }
+
+  queued_.notify_one();
+  thread_.join();
+
+  if (file_ != nullptr)
+    std::fclose(file_);
+}
+
+std::string_view Journal::layout() const { return session_.layout; }
+
+bool Journal::is_restored(size_t idx) const
+{
+  return std::ranges::find(restored_sources_, idx) != restored_sources_.end();
+}
+
+void Journal::record_source(size_t idx, std::string_view code)
+{
+  const auto source_idx = static_cast<uint32_t>(idx);
+  std::string payload;
+
+  if (auto it = session_.sources.find(source_idx); it != session_.sources.end()) {
+    std::string& prev_code = it->second;
+
+    if (prev_code == code)
+      return;
+
+    const TextChange change = find_change(prev_code, code);
+
+    append_bytes(payload,
+        SourceEditHeader {
+            .source_idx = source_idx,
+            .offset = change.offset,
+            .removed_length = change.removed_length,
+        });
+    payload += code.substr(change.offset, change.inserted_length);
+
+    prev_code = code;
+    append(serialize_record(RecordKind::SourceEdit, payload));
+  } else {
+    append_bytes(payload, source_idx);
+    payload += code;
+
+    session_.sources.emplace(source_idx, code);
+    append(serialize_record(RecordKind::Source, payload));
+  }
+}
+
+void Journal::record_active_source(size_t idx)
+{
+  const auto source_idx = static_cast<uint32_t>(idx);
+
+  if (session_.active_source == source_idx)
+    return;
+
+  std::string payload;
+  append_bytes(payload, source_idx);
+
+  session_.active_source = source_idx;
+  append(serialize_record(RecordKind::ActiveSource, payload));
+}
+
+void Journal::record_layout(std::string_view layout)
+{
+  if (session_.layout == layout)
+    return;
+
+  session_.layout = layout;
+  append(serialize_record(RecordKind::Layout, layout));
+}
+
+void Journal::mark_saved()
+{
+  session_.sources.clear();
+  compact();
+}
+
+std::string Journal::serialize_record(RecordKind kind, std::string_view payload)
+{
+  std::string record;
+  record.reserve(sizeof(RecordHeader) + payload.size());
+
+  append_bytes(record,
+      RecordHeader {
+          .kind = std::to_underlying(kind),
+          .size = static_cast<uint32_t>(payload.size()),
+          .checksum = hash::fnv1a(payload),
+      });
+  record += payload;
+
+  return record;
+}
+
+std::string Journal::serialize_session(const Session& session)
+{
+  std::string snapshot;
+  append_bytes(snapshot, FileHeader {});
+
+  for (const auto& [source_idx, code] : session.sources) {
+    std::string payload;
+    append_bytes(payload, source_idx);
+    payload += code;
+
+    snapshot += serialize_record(RecordKind::Source, payload);
+  }
+
+  if (session.active_source.has_value()) {
+    std::string payload;
+    append_bytes(payload, session.active_source.value());
+
+    snapshot += serialize_record(RecordKind::ActiveSource, payload);
+  }
+
+  if (!session.layout.empty())
+    snapshot += serialize_record(RecordKind::Layout, session.layout);
+
+  return snapshot;
+}
+
+Journal::Session Journal::parse(std::string_view data)
+{
+  Session session;
+
+  if (data.size() < sizeof(FileHeader))
+    return session;
+
+  FileHeader file_header;
+  std::memcpy(&file_header, data.data(), sizeof(FileHeader));
+
+  if (file_header.magic != MAGIC || file_header.version != FORMAT_VERSION) {
+    std::println("Ignoring journal with unsupported format");
+    return session;
+  }
+
+  size_t offset = sizeof(FileHeader);
+
+  while (data.size() - offset >= sizeof(RecordHeader)) {
+    RecordHeader header;
+    std::memcpy(&header, data.data() + offset, sizeof(RecordHeader));
+    offset += sizeof(RecordHeader);
+
+    if (header.size > data.size() - offset)
+      break;
+
+    std::string_view payload = data.substr(offset, header.size);
+    offset += header.size;
+
+    if (hash::fnv1a(payload) != header.checksum)
+      break;
+
+    uint32_t source_idx = 0;
+
+    switch (static_cast<RecordKind>(header.kind)) {
+    case RecordKind::Source:
+      if (payload.size() < sizeof(source_idx))
+        return session;
+
+      std::memcpy(&source_idx, payload.data(), sizeof(source_idx));
+      session.sources.insert_or_assign(source_idx, payload.substr(sizeof(source_idx)));
+      break;
+
+    case RecordKind::SourceEdit: {
+      SourceEditHeader edit;
+      if (payload.size() < sizeof(SourceEditHeader))
+        return session;
+
+      std::memcpy(&edit, payload.data(), sizeof(SourceEditHeader));
+      auto it = session.sources.find(edit.source_idx);
+
+      // Edits always follow the whole code of their source
+      if (it == session.sources.end() || edit.offset > it->second.size()
+          || edit.removed_length > it->second.size() - edit.offset) {
+        return session;
+      }
+
+      it->second.replace(edit.offset, edit.removed_length, payload.substr(sizeof(edit)));
+      break;
+    }
+
+    case RecordKind::ActiveSource:
+      if (payload.size() < sizeof(source_idx))
+        return session;
+
+      std::memcpy(&source_idx, payload.data(), sizeof(source_idx));
+      session.active_source = source_idx;
+      break;
+
+    case RecordKind::Layout:
+      session.layout = payload;
+      break;
+
+    default:
+      // Written by a newer version, so nothing after it can be trusted either
+      return session;
+    }
+  }
+
+  return session;
+}
+
+void Journal::append(std::string records)
+{
+  bool should_compact = false;
+
+  {
+    std::scoped_lock lock(mutex_);
+    should_compact = should_compact_;
+
+    if (!should_compact)
+      queued_records_ += records;
+  }
+
+  record_size_ += records.size();
+
+  if (should_compact || record_size_ > std::max(MIN_COMPACTION_BYTES, snapshot_size_)) {
+    compact();
+    return;
+  }
+
+  queued_.notify_one();
+}
+
+void Journal::compact()
+{
+  std::string snapshot = serialize_session(session_);
+  snapshot_size_ = snapshot.size();
+  record_size_ = 0;
+
+  {
+    std::scoped_lock lock(mutex_);
+
+    // The snapshot already includes everything still queued
+    queued_records_.clear();
+    queued_snapshot_ = std::move(snapshot);
+    should_compact_ = false;
+  }
+
+  queued_.notify_one();
+}
+
+void Journal::write_queued()
+{
+  std::unique_lock lock(mutex_);
+
+  while (true) {
+    queued_.wait(lock, [this] {
+      return is_stopping_ || !queued_records_.empty() || queued_snapshot_.has_value();
+    });
+
+    // Gives records that follow shortly after, like several edits in a row, a chance to be
+    // flushed together
+    if (!is_stopping_)
+      queued_.wait_for(lock, FLUSH_DELAY, [this] { return is_stopping_; });
+
+    std::optional<std::string> snapshot = std::exchange(queued_snapshot_, std::nullopt);
+    std::string records = std::exchange(queued_records_, {});
+    const bool is_stopping = is_stopping_;
+
+    lock.unlock();
+
+    bool has_failed = false;
+
+    try {
+      if (snapshot.has_value())
+        write_snapshot(snapshot.value());
+
+      if (!records.empty())
+        write_records(records);
+    } catch (const std::exception& ex) {
+      std::println("Failed to write journal. {}", ex.what());
+      has_failed = true;
+    }
+
+    lock.lock();
+
+    if (has_failed)
+      should_compact_ = true;
+
+    if (is_stopping && queued_records_.empty() && !queued_snapshot_.has_value())
+      return;
+  }
+}
+
+void Journal::write_snapshot(std::string_view snapshot)
+{
+  if (file_ != nullptr) {
+    std::fclose(file_);
+    file_ = nullptr;
+  }
+
+  // Written in full before replacing the previous journal, so a crash in between leaves one
+  // of them intact
+  auto temp_path = path_;
+  temp_path += ".tmp";
+
+  {
+    std::FILE* temp_file = std::fopen(temp_path.string().c_str(), "wb");
+
+    if (temp_file == nullptr)
+      throw Exception("Failed to open \"{}\" for writing", temp_path.string());
+
+    const size_t written_size = std::fwrite(snapshot.data(), 1, snapshot.size(), temp_file);
+
+    try {
+      if (written_size != snapshot.size())
+        throw Exception("Failed to write to \"{}\"", temp_path.string());
+
+      fs::sync_file(temp_file, temp_path);
+    } catch (...) {
+      std::fclose(temp_file);
+      throw;
+    }
+
+    std::fclose(temp_file);
+  }
+
+  std::filesystem::rename(temp_path, path_);
+
+  if constexpr (query::is_debug())
+    std::println("Compacted journal to {} byte(s)", snapshot.size());
+}
+
+void Journal::write_records(std::string_view records)
+{
+  if (file_ == nullptr) {
+    file_ = std::fopen(path_.string().c_str(), "ab");
+
+    if (file_ == nullptr)
+      throw Exception("Failed to open \"{}\" for appending", path_.string());
+  }
+
+  if (std::fwrite(records.data(), 1, records.size(), file_) != records.size())
+    throw Exception("Failed to append to \"{}\"", path_.string());
+
+  fs::sync_file(file_, path_);
+}
+
+}
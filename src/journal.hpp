@@ -0,0 +1,119 @@
+#pragma once
+
+#include "project.hpp"
+
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <filesystem>
+#include <map>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+namespace mewo {
+
+/// Append-only log of everything the project doesn't save on its own: source edits made since
+/// the last save, and the GUI's layout. Launching again with the same project replays it, so
+/// a crash, like losing the device, doesn't take the session down with it.
+///
+/// Recording only copies the change into a queue. A background thread appends queued records
+/// and flushes them to disk together, so the main thread never waits on the disk, and a burst
+/// of records costs a single flush. Once enough records pile up, the journal is compacted
+/// into a snapshot of the current state.
+class Journal {
+  public:
+  static constexpr std::string_view FILE_EXTENSION = ".journal";
+  /// Records arriving within this long of each other are flushed together.
+  static constexpr auto FLUSH_DELAY = std::chrono::milliseconds(250);
+  /// Records are tolerated up to this size, or the size of the snapshot if it's larger,
+  /// before the journal is compacted.
+  static constexpr size_t MIN_COMPACTION_BYTES = 256 * 1024;
+
+  /// Puts source edits the previous session didn't save back into the project, as unsaved
+  /// changes. The previous layout is kept for `layout`.
+  explicit Journal(Project& project);
+  /// Writes out everything that's still queued.
+  ~Journal();
+
+  Journal(const Journal&) = delete;
+  Journal& operator=(const Journal&) = delete;
+
+  /// Settings of the previous session's GUI, in Dear ImGui's ini format. Empty if there were
+  /// none.
+  std::string_view layout() const;
+  /// Whether the source's code is an unsaved edit the journal put back. The previous session
+  /// may have crashed compiling it.
+  bool is_restored(size_t idx) const;
+
+  /// Only the changed range is recorded, unless the source wasn't recorded since the last
+  /// save.
+  void record_source(size_t idx, std::string_view code);
+  void record_active_source(size_t idx);
+  void record_layout(std::string_view layout);
+  /// Drops recorded sources, since the project has them now.
+  void mark_saved();
+
+  private:
+  enum class RecordKind : uint32_t {
+    /// Whole code of a source.
+    Source,
+    /// Range of a source's code that changed since its previous record.
+    SourceEdit,
+    ActiveSource,
+    Layout,
+  };
+
+  /// Recorded state, as it would be restored.
+  struct Session {
+    std::map<uint32_t, std::string> sources;
+    std::optional<uint32_t> active_source;
+    std::string layout;
+  };
+
+  static std::string serialize_record(RecordKind kind, std::string_view payload);
+  static std::string serialize_session(const Session& session);
+  /// Replays records until the end of the data, or the first one that was only partially
+  /// written.
+  static Session parse(std::string_view data);
+
+  /// Queues serialized records to be appended, or compacts if the journal grew too large.
+  void append(std::string records);
+  /// Replaces whatever is queued with a snapshot of the current state.
+  void compact();
+
+  /// Body of the background thread. Returns once stopped and everything queued is written.
+  void write_queued();
+  void write_snapshot(std::string_view snapshot);
+  void write_records(std::string_view records);
+
+  std::filesystem::path path_;
+
+  /// Only used by the main thread. What replaying the journal would currently restore.
+  Session session_;
+  std::vector<size_t> restored_sources_;
+  /// Bytes of records written since the last snapshot, including queued ones.
+  size_t record_size_ = 0;
+  size_t snapshot_size_ = 0;
+
+  std::mutex mutex_;
+  std::condition_variable queued_;
+  std::string queued_records_;
+  /// Replaces the file before the queued records are appended to it.
+  std::optional<std::string> queued_snapshot_;
+  /// Set when writing failed, so the journal may be left with a partial record. Compacting
+  /// replaces it with a valid file.
+  bool should_compact_ = false;
+  bool is_stopping_ = false;
+
+  /// Only used by the background thread.
+  std::FILE* file_ = nullptr;
+  std::thread thread_;
+};
+
+}
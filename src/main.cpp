@@ -1,16 +1,23 @@
 #include "exception.hpp"
+#include "gfx/compile_sandbox.hpp"
 #include "mewo.hpp"
+#include "options.hpp"
 
 #include <cstdlib>
 #include <exception>
 #include <print>
+#include <string_view>
 
-int main(int, char*[])
+int main(int argc, char* argv[])
 {
   int status = EXIT_SUCCESS;
 
   try {
-    mewo::Mewo mewo;
+    // Helper processes of the compile sandbox only ever run the shader compiler
+    if (argc == 3 && std::string_view(argv[1]) == mewo::gfx::CompileSandbox::WORKER_OPTION)
+      return mewo::gfx::CompileSandbox::run_worker(argv[2]);
+
+    mewo::Mewo mewo(mewo::Options::from_args(argc, argv));
     mewo.run();
   } catch (const mewo::Exception& ex) {
     std::println("Unhandled Mewo exception. {}", ex.what());
@@ -0,0 +1,117 @@
+#include "mapped_file.hpp"
+
+#include "exception.hpp"
+
+#include <SDL3/SDL.h>
+
+#include <filesystem>
+#include <string_view>
+#include <utility>
+
+#if defined(SDL_PLATFORM_WIN32)
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+namespace mewo::fs {
+
+MappedFile::MappedFile(const std::filesystem::path& file_path)
+{
+  auto path_str = file_path.string();
+  auto file_size = std::filesystem::file_size(file_path);
+
+  // Mapping an empty file is an error on every platform, but an empty view is fine
+  if (file_size == 0)
+    return;
+
+  size_ = static_cast<size_t>(file_size);
+
+#if defined(SDL_PLATFORM_WIN32)
+  HANDLE file = CreateFileW(file_path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr,
+      OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+
+  if (file == INVALID_HANDLE_VALUE)
+    throw Exception("Failed to open \"{}\" for mapping", path_str);
+
+  HANDLE mapping = CreateFileMappingW(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+
+  // The mapping object keeps its own reference to the file
+  CloseHandle(file);
+
+  if (!mapping)
+    throw Exception("Failed to create file mapping for \"{}\"", path_str);
+
+  void* view = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+
+  if (!view) {
+    CloseHandle(mapping);
+    throw Exception("Failed to map view of \"{}\"", path_str);
+  }
+
+  mapping_handle_ = mapping;
+  data_ = static_cast<const char*>(view);
+#else
+  int fd = open(path_str.c_str(), O_RDONLY);
+
+  if (fd == -1)
+    throw Exception("Failed to open \"{}\" for mapping", path_str);
+
+  void* view = mmap(nullptr, size_, PROT_READ, MAP_PRIVATE, fd, 0);
+
+  // The mapping stays valid after the descriptor is closed
+  ::close(fd);
+
+  if (view == MAP_FAILED)
+    throw Exception("Failed to map \"{}\"", path_str);
+
+  data_ = static_cast<const char*>(view);
+#endif
+}
+
+MappedFile::~MappedFile() { close(); }
+
+MappedFile::MappedFile(MappedFile&& other) noexcept
+    : data_(std::exchange(other.data_, nullptr))
+    , size_(std::exchange(other.size_, 0))
+    , mapping_handle_(std::exchange(other.mapping_handle_, nullptr))
+{
+}
+
+MappedFile& MappedFile::operator=(MappedFile&& other) noexcept
+{
+  if (this != &other) {
+    close();
+
+    data_ = std::exchange(other.data_, nullptr);
+    size_ = std::exchange(other.size_, 0);
+    mapping_handle_ = std::exchange(other.mapping_handle_, nullptr);
+  }
+
+  return *this;
+}
+
+bool MappedFile::is_open() const { return data_ != nullptr; }
+
+std::string_view MappedFile::data() const { return { data_, size_ }; }
+
+void MappedFile::close()
+{
+  if (!data_)
+    return;
+
+#if defined(SDL_PLATFORM_WIN32)
+  UnmapViewOfFile(data_);
+  CloseHandle(static_cast<HANDLE>(mapping_handle_));
+#else
+  munmap(const_cast<char*>(data_), size_);
+#endif
+
+  data_ = nullptr;
+  size_ = 0;
+  mapping_handle_ = nullptr;
+}
+
+}
@@ -0,0 +1,37 @@
+#pragma once
+
+#include <cstddef>
+#include <filesystem>
+#include <string_view>
+
+namespace mewo::fs {
+
+/// RAII wrapper around a read-only memory mapping of an entire file. Pages are only
+/// read from disk once they're touched, so opening large files is cheap.
+class MappedFile {
+  public:
+  MappedFile() = default;
+  explicit MappedFile(const std::filesystem::path& file_path);
+  ~MappedFile();
+
+  MappedFile(const MappedFile&) = delete;
+  MappedFile& operator=(const MappedFile&) = delete;
+  MappedFile(MappedFile&& other) noexcept;
+  MappedFile& operator=(MappedFile&& other) noexcept;
+
+  bool is_open() const;
+  /// Empty if nothing is mapped. Views into it are invalidated once the file is closed.
+  std::string_view data() const;
+
+  void close();
+
+  private:
+  const char* data_ = nullptr;
+  size_t size_ = 0;
+
+  /// Windows needs the mapping object to stay alive for as long as the view is mapped.
+  /// Stored as an opaque pointer so <windows.h> doesn't leak into this header.
+  void* mapping_handle_ = nullptr;
+};
+
+}
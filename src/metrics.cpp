@@ -0,0 +1,103 @@
+#include "metrics.hpp"
+
+#include "shared_memory.hpp"
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <exception>
+#include <format>
+#include <limits>
+#include <new>
+#include <optional>
+#include <print>
+#include <string>
+
+namespace mewo::metrics {
+
+std::string get_shared_memory_name(uint32_t process_id)
+{
+  return std::format("mewo-metrics-{}", process_id);
+}
+
+uint64_t get_now_ns()
+{
+  auto now = std::chrono::steady_clock::now().time_since_epoch();
+  return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(now).count());
+}
+
+float to_sample_ms(std::optional<double> ms)
+{
+  return ms.has_value() ? static_cast<float>(ms.value()) : std::numeric_limits<float>::quiet_NaN();
+}
+
+Publisher::Publisher()
+{
+  const std::string name = get_shared_memory_name(ipc::get_process_id());
+
+  try {
+    memory_ = ipc::SharedMemory::create(name, REGION_SIZE);
+  } catch (const std::exception& ex) {
+    std::println("Metrics won't be published. {}", ex.what());
+    return;
+  }
+
+  std::println("Metrics are published to shared memory \"{}\"", name);
+
+  // Begins the lifetime of the atomics inside the zeroed region
+  Header* header = new (memory_.data()) Header();
+
+  for (uint32_t idx = 0; idx < RING_CAPACITY; ++idx)
+    new (memory_.data() + sizeof(Header) + idx * sizeof(Slot)) Slot();
+
+  header->version = SCHEMA_VERSION;
+  header->sample_size = sizeof(Sample);
+  header->capacity = RING_CAPACITY;
+
+  // Written last, so readers that check it see a fully initialized header
+  std::atomic_ref(header->magic).store(MAGIC, std::memory_order_release);
+}
+
+bool Publisher::is_reader_attached() const
+{
+  if (!memory_.is_open())
+    return false;
+
+  uint64_t heartbeat_ns = header()->reader_heartbeat_ns.load(std::memory_order_relaxed);
+  auto timeout_ns = std::chrono::duration_cast<std::chrono::nanoseconds>(READER_TIMEOUT);
+
+  return heartbeat_ns != 0
+      && get_now_ns() - heartbeat_ns < static_cast<uint64_t>(timeout_ns.count());
+}
+
+void Publisher::publish(const Sample& sample)
+{
+  if (!is_reader_attached())
+    return;
+
+  Header* header = this->header();
+
+  uint64_t sample_idx = header->write_count.load(std::memory_order_relaxed);
+  Slot& slot = slots()[sample_idx % RING_CAPACITY];
+
+  // Odd while writing. The fence keeps the sample's stores from becoming visible before it
+  slot.sequence.store(get_written_sequence(sample_idx) - 1, std::memory_order_relaxed);
+  std::atomic_thread_fence(std::memory_order_release);
+
+  slot.sample = sample;
+
+  slot.sequence.store(get_written_sequence(sample_idx), std::memory_order_release);
+  header->write_count.store(sample_idx + 1, std::memory_order_release);
+}
+
+Header* Publisher::header() const
+{
+  return std::launder(reinterpret_cast<Header*>(memory_.data()));
+}
+
+Slot* Publisher::slots() const
+{
+  return std::launder(reinterpret_cast<Slot*>(memory_.data() + sizeof(Header)));
+}
+
+}
@@ -0,0 +1,107 @@
+#pragma once
+
+#include "shared_memory.hpp"
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <type_traits>
+
+/// Counters published to other processes on the same machine, like lab dashboards, through a
+/// shared memory ring. The layout below is the schema. Fields are only ever appended, and any
+/// other change bumps `SCHEMA_VERSION`, so readers can reject layouts they don't understand.
+namespace mewo::metrics {
+
+/// "MEWOMTRC" in little-endian.
+inline constexpr uint64_t MAGIC = 0x4352544D4F57454D;
+inline constexpr uint32_t SCHEMA_VERSION = 1;
+/// Holds about four seconds of samples at 60 Hz, so readers can poll at a leisurely pace.
+inline constexpr uint32_t RING_CAPACITY = 256;
+/// Publishing stops when no reader has refreshed its heartbeat for this long.
+inline constexpr std::chrono::seconds READER_TIMEOUT { 2 };
+
+/// One per presented frame. Durations are NaN when they weren't measured that frame.
+struct Sample {
+  uint64_t frame_index = 0;
+  /// From the steady clock, which readers on the same machine share.
+  uint64_t presented_at_ns = 0;
+  /// From the previous frame being presented to this one.
+  float frame_time_ms = 0.f;
+  /// Time the viewport's passes took on the GPU, which arrives a few frames late.
+  float gpu_pass_ms = 0.f;
+  /// From a run request being picked up to its render pipeline being ready.
+  float compile_ms = 0.f;
+  /// Frames that took noticeably longer than the display's refresh interval, since launch.
+  uint32_t dropped_frames = 0;
+  /// Estimated, including render targets, surface and thumbnails.
+  uint64_t texture_bytes = 0;
+  /// Estimated, including every category of the memory tracker.
+  uint64_t gpu_memory_bytes = 0;
+};
+
+static_assert(sizeof(Sample) == 48 && std::is_trivially_copyable_v<Sample>);
+
+/// Guarded by a sequence number per slot, so the writer never waits for readers. The writer
+/// makes the sequence odd while it writes the sample, and even again afterwards. Readers copy
+/// the sample out, and retry or skip it if the sequence changed in the meantime.
+struct Slot {
+  std::atomic<uint64_t> sequence = 0;
+  Sample sample;
+};
+
+struct alignas(64) Header {
+  uint64_t magic = 0;
+  uint32_t version = 0;
+  uint32_t sample_size = 0;
+  uint32_t capacity = 0;
+  /// Samples written since launch. The newest is in slot `(write_count - 1) % capacity`.
+  std::atomic<uint64_t> write_count = 0;
+  /// Steady clock time of the last time a reader checked in. Readers refresh it as they poll.
+  std::atomic<uint64_t> reader_heartbeat_ns = 0;
+};
+
+static_assert(std::atomic<uint64_t>::is_always_lock_free, "Atomics must work across processes");
+
+/// Total size of the shared region.
+inline constexpr size_t REGION_SIZE = sizeof(Header) + RING_CAPACITY * sizeof(Slot);
+
+/// Each instance publishes under its own name, so instances running side by side don't overwrite
+/// each other's samples.
+std::string get_shared_memory_name(uint32_t process_id);
+
+/// Steady clock time in the unit used by the schema.
+uint64_t get_now_ns();
+
+/// Sequence number a slot has once the sample with the given index is fully written.
+constexpr uint64_t get_written_sequence(uint64_t sample_idx) { return 2 * sample_idx + 2; }
+
+/// Owns the shared region and writes samples into it. Failing to create the region only
+/// disables publishing, since metrics aren't essential to the app.
+class Publisher {
+  public:
+  Publisher();
+
+  Publisher(const Publisher&) = delete;
+  Publisher& operator=(const Publisher&) = delete;
+
+  /// Costs an atomic load and a clock read, so it's cheap to check every frame.
+  bool is_reader_attached() const;
+
+  /// Does nothing when no reader is attached.
+  void publish(const Sample& sample);
+
+  private:
+  Header* header() const;
+  Slot* slots() const;
+
+  ipc::SharedMemory memory_;
+};
+
+/// Turns an optional duration into the schema's representation.
+float to_sample_ms(std::optional<double> ms);
+
+}
@@ -1,20 +1,77 @@
 #include "mewo.hpp"
 
+#include "allocation.hpp"
 #include "editor.hpp"
+#include "exception.hpp"
 #include "gfx/frame_context.hpp"
+#include "hash.hpp"
 
 #include <SDL3/SDL.h>
 #include <imgui_impl_sdl3.h>
 #include <webgpu/webgpu_cpp.h>
 
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <exception>
+#include <optional>
+#include <print>
+#include <string>
+#include <vector>
+
 namespace mewo {
 
-Mewo::Mewo()
-    : renderer_(window_)
-    , gui_ctx_(assets_, window_, renderer_)
-    , editor_(assets_)
-    , viewport_(assets_, state_, renderer_, editor_.combined_code())
+/// Every source in the project, combined with the prefix just like when it's compiled.
+static std::vector<std::string> get_combined_sources(const Project& project, const Editor& editor)
 {
+  std::vector<std::string> codes;
+  codes.reserve(project.source_count());
+
+  for (size_t idx = 0; idx < project.source_count(); ++idx)
+    codes.push_back(editor.combined_code(project.source_code(idx)));
+
+  return codes;
+}
+
+/// Empty if the refresh rate of the window's display is unknown.
+static std::optional<double> get_refresh_interval_ms(const sdl::Window& window)
+{
+  const SDL_DisplayMode* mode = SDL_GetCurrentDisplayMode(SDL_GetDisplayForWindow(window.get()));
+
+  if (mode == nullptr || mode->refresh_rate <= 0.f)
+    return std::nullopt;
+
+  return 1000.0 / static_cast<double>(mode->refresh_rate);
+}
+
+Mewo::Mewo(const Options& options)
+    : frame_limit_(options.frame_limit)
+    , is_allocation_test_(options.is_allocation_test)
+    , memory_tracker_(static_cast<uint64_t>(options.gpu_budget_mib) << 20)
+    , sdl_ctx_(options.is_headless)
+    , renderer_(window_, blob_cache_, memory_tracker_, state_.startup, options.is_headless)
+    , project_(assets_, options.project_path, blob_cache_)
+    , journal_(project_)
+    , editor_(assets_, project_, options.watch_path)
+    , gui_ctx_(assets_, window_, renderer_, state_.startup)
+    , noise_(renderer_, jobs_)
+    , scrub_(renderer_)
+    , viewport_(assets_, state_, renderer_, noise_, scrub_, editor_.combined_code(),
+          !editor_.is_watching() && journal_.is_restored(project_.active_source()))
+    , gallery_(renderer_, noise_, scrub_, viewport_, editor_, project_, jobs_)
+    , scopes_(assets_, renderer_)
+    , warmup_(renderer_, viewport_.render_pipeline_desc(),
+          { renderer_.surface_config().format, Gallery::ATLAS_FORMAT },
+          get_combined_sources(project_, editor_), sandbox_, jobs_, state_.startup)
+{
+  viewport_.load_parameters(project_);
+  gui_ctx_.load_settings(journal_.layout());
+  journaled_change_count_ = editor_.change_count();
+
+  if (options.should_share_frames)
+    frame_output_.emplace(renderer_);
+
+  state_.startup.mark("Initialized");
 }
 
 void Mewo::run()
@@ -24,6 +81,12 @@ void Mewo::run()
   const wgpu::Device& device = renderer_.device();
   const wgpu::Queue& queue = renderer_.queue();
 
+  uint32_t frame_count = 0;
+  auto run_start = std::chrono::steady_clock::now();
+  auto last_presented_at = run_start;
+
+  update_dropped_frame_threshold();
+
   while (!state_.should_quit) {
     while (SDL_PollEvent(&event)) {
       ImGui_ImplSDL3_ProcessEvent(&event);
@@ -40,26 +103,279 @@ void Mewo::run()
         renderer_.resize(new_width, new_height);
         break;
       }
+
+      // Displays may have different refresh rates
+      case SDL_EVENT_WINDOW_DISPLAY_CHANGED: {
+        update_dropped_frame_threshold();
+        break;
+      }
       }
     }
 
     device.Tick();
+    // Fires callbacks of asynchronous operations, like buffer mapping, that have completed
+    renderer_.instance().ProcessEvents();
+    // Hands results of jobs that finished since last frame to whoever started them
+    jobs_.drain_completions();
+
+    // Picked up before the viewport prepares its frame, so the change is compiled right away
+    if (auto noticed_at = editor_.apply_external_change(); noticed_at.has_value()) {
+      // Scrubbed literals pointed into the code that was just replaced
+      scrub_.cancel();
+      std::string code = editor_.combined_code();
+      reload_key_ = hash::fnv1a(code);
+      viewport_.set_pending_run_request(std::move(code));
+
+      // Measured from the newest save, which is the one that ends up on the screen
+      reload_noticed_at_ = noticed_at;
+      is_reload_drawn_ = false;
+    }
+
+    const std::optional<gfx::FrameContext> frame_ctx_opt = renderer_.prepare_new_frame();
+
+    // Nothing can be drawn this frame, but the surface has already been fixed up for the next
+    if (!frame_ctx_opt.has_value()) {
+      // Minimized windows skip every frame, so wait for something to happen instead of spinning
+      if (SDL_GetWindowFlags(window_.get()) & SDL_WINDOW_MINIMIZED)
+        SDL_WaitEventTimeout(nullptr, MINIMIZED_WAIT_MS);
+
+      continue;
+    }
+
+    const gfx::FrameContext& frame_ctx = frame_ctx_opt.value();
+
+    // Covers building the frame on the CPU. Recording commands is left out, since the driver
+    // allocates for those on its own terms
+    allocation::CountingScope allocation_scope;
+    frame_arena_.reset();
 
-    const gfx::FrameContext frame_ctx = renderer_.prepare_new_frame();
     gui_ctx_.prepare_new_frame();
-    viewport_.prepare_new_frame(state_, renderer_);
+    warmup_.prepare_new_frame();
+    editor_.prepare_new_frame();
+    viewport_.prepare_new_frame(state_, renderer_, warmup_, sandbox_);
+    gallery_.prepare_new_frame(renderer_, warmup_);
+
+    // Restoring this version later can then reuse the module instead of recompiling it. Modules
+    // with hoisted literals read whatever was scrubbed last, so they're never restored
+    if (std::optional<Viewport::RunResult> run_result = viewport_.take_run_result();
+        run_result.has_value()) {
+      if (run_result->is_compiled && !scrub_.is_active())
+        editor_.link_shader(run_result->module_key);
+
+      // Reloads that fail to compile never reach the screen, so there's nothing to measure
+      if (reload_noticed_at_.has_value() && run_result->module_key == reload_key_) {
+        if (run_result->is_compiled)
+          is_reload_drawn_ = true;
+        else
+          reload_noticed_at_ = std::nullopt;
+      }
+    }
 
-    layout_.build(state_, gui_ctx_, editor_, viewport_);
+    layout_.build(state_, frame_arena_, gui_ctx_, renderer_, warmup_, editor_, scrub_, viewport_,
+        gallery_, scopes_);
+
+    state_.frame_allocation_count = allocation_scope.count();
+
+    if (is_allocation_test_)
+      check_allocations(frame_count + 1, state_.frame_allocation_count);
 
     viewport_.record(frame_ctx);
+    // Before the GUI, which displays this frame's scopes
+    scopes_.record(frame_ctx, viewport_);
     gui_ctx_.record(frame_ctx);
 
+    // Numbered like metrics, so consumers can match frames with their samples
+    if (frame_output_.has_value())
+      frame_output_->record(frame_ctx, viewport_.texture(), frame_count + 1);
+
     static const wgpu::CommandBufferDescriptor CMD_BUF_DESC = { .label = "command-buffer" };
     wgpu::CommandBuffer cmd_buf = frame_ctx.encoder.Finish(&CMD_BUF_DESC);
 
     queue.Submit(1, &cmd_buf);
-    renderer_.surface().Present();
+
+    if (frame_output_.has_value())
+      frame_output_->watch_submitted();
+
+    renderer_.present();
+    ++frame_count;
+
+    auto presented_at = std::chrono::steady_clock::now();
+    std::chrono::duration<double, std::milli> frame_time = presented_at - last_presented_at;
+    last_presented_at = presented_at;
+
+    publish_metrics(frame_count, frame_time.count());
+
+    if (is_starting_up_)
+      finish_startup();
+
+    // This frame is the first drawn with the reloaded module
+    if (reload_noticed_at_.has_value() && is_reload_drawn_) {
+      std::chrono::duration<double, std::milli> latency
+          = std::chrono::steady_clock::now() - reload_noticed_at_.value();
+      state_.reload_latency_ms = latency.count();
+      reload_noticed_at_ = std::nullopt;
+    }
+
+    // Off the frame's critical path, since recording copies the changes
+    update_journal();
+
+    if (auto source_idx = state_.pending_open_source; source_idx.has_value()) {
+      // Typing that hasn't paused yet would otherwise never be journaled, and neither would
+      // scrubbed literals
+      gui::Layout::finish_scrubbing(scrub_, editor_, viewport_);
+      editor_.commit_edits();
+      update_journal();
+
+      editor_.open_source(project_, source_idx.value());
+      journal_.record_active_source(source_idx.value());
+      // Newly opened code is already in the project
+      journaled_change_count_ = editor_.change_count();
+
+      viewport_.set_pending_run_request(editor_.combined_code());
+      // Previously open source may have been edited, so its thumbnail could be outdated
+      gallery_.set_pending_refresh();
+
+      state_.pending_open_source = std::nullopt;
+    }
+
+    if (state_.should_save_project) {
+      save_project();
+      state_.should_save_project = false;
+    }
+
+    if (frame_limit_.has_value() && frame_count >= frame_limit_.value())
+      state_.should_quit = true;
+  }
+
+  // Mostly useful for benchmark runs, which are headless and limited to a number of frames
+  std::chrono::duration<double, std::milli> run_duration
+      = std::chrono::steady_clock::now() - run_start;
+
+  if (frame_count > 0) {
+    std::println("Presented {} frame(s) in {:.2f} ms, averaging {:.3f} ms per frame", frame_count,
+        run_duration.count(), run_duration.count() / frame_count);
+  }
+
+  if (is_allocation_test_)
+    finish_allocation_test();
+}
+
+void Mewo::finish_startup()
+{
+  state_.startup.mark("First frame presented");
+  is_starting_up_ = false;
+
+  auto startup_ms = static_cast<double>(state_.startup.elapsed_ns()) / 1'000'000.0;
+
+  std::println("Startup took {:.2f} ms", startup_ms);
+  state_.startup.print();
+
+  if (startup_ms > STARTUP_BUDGET_MS)
+    std::println("Warning: startup exceeded its budget of {:.0f} ms", STARTUP_BUDGET_MS);
+}
+
+void Mewo::update_dropped_frame_threshold()
+{
+  dropped_frame_threshold_ms_ = get_refresh_interval_ms(window_).transform(
+      [](double interval_ms) { return interval_ms * DROPPED_FRAME_FACTOR; });
+}
+
+void Mewo::publish_metrics(uint64_t frame_index, double frame_time_ms)
+{
+  // The first frame includes startup, which is already covered by its own budget
+  if (!is_starting_up_ && dropped_frame_threshold_ms_.has_value()
+      && frame_time_ms > dropped_frame_threshold_ms_.value()) {
+    ++dropped_frame_count_;
+  }
+
+  // Taken every frame regardless, so a reader attaching later doesn't get stale measurements
+  Viewport::Counters counters = viewport_.take_counters();
+
+  if (!metrics_.is_reader_attached())
+    return;
+
+  using Category = gfx::MemoryTracker::Category;
+
+  metrics_.publish({
+      .frame_index = frame_index,
+      .presented_at_ns = metrics::get_now_ns(),
+      .frame_time_ms = static_cast<float>(frame_time_ms),
+      .gpu_pass_ms = metrics::to_sample_ms(counters.gpu_pass_ms),
+      .compile_ms = metrics::to_sample_ms(counters.compile_ms),
+      .dropped_frames = dropped_frame_count_,
+      .texture_bytes = memory_tracker_.usage(Category::RenderTargets).live
+          + memory_tracker_.usage(Category::Surface).live
+          + memory_tracker_.usage(Category::Thumbnails).live,
+      .gpu_memory_bytes = memory_tracker_.total().live,
+  });
+}
+
+void Mewo::check_allocations(uint64_t frame_index, uint64_t allocation_count)
+{
+  // Finishing warm-up hands out results, and thumbnails of the compiled shaders follow
+  if (!warmup_.is_finished())
+    return;
+
+  if (settle_frame_count_ < ALLOCATION_TEST_SETTLE_FRAMES) {
+    ++settle_frame_count_;
+    return;
+  }
+
+  ++checked_frame_count_;
+
+  if (allocation_count == 0)
+    return;
+
+  if (++allocating_frame_count_ <= ALLOCATION_TEST_PRINT_LIMIT)
+    std::println("Frame {} made {} heap allocation(s)", frame_index, allocation_count);
+}
+
+void Mewo::finish_allocation_test() const
+{
+  if (checked_frame_count_ == 0) {
+    throw Exception("Allocation test ended before any frame was checked. Run more than {} "
+                    "frames past shader warm-up",
+        ALLOCATION_TEST_SETTLE_FRAMES);
+  }
+
+  if (allocating_frame_count_ > 0) {
+    throw Exception("Allocation test failed, {} of {} frame(s) allocated on the heap",
+        allocating_frame_count_, checked_frame_count_);
   }
+
+  std::println(
+      "Allocation test passed, {} frame(s) made no heap allocations", checked_frame_count_);
+}
+
+void Mewo::update_journal()
+{
+  // Watched files aren't part of the project, and the other program keeps them anyway
+  if (editor_.change_count() != journaled_change_count_ && !editor_.is_watching()) {
+    journal_.record_source(project_.active_source(), editor_.visible_code());
+    journaled_change_count_ = editor_.change_count();
+  }
+
+  if (std::optional<std::string> settings = gui_ctx_.take_changed_settings())
+    journal_.record_layout(settings.value());
+}
+
+void Mewo::save_project()
+{
+  gui::Layout::finish_scrubbing(scrub_, editor_, viewport_);
+  editor_.store(project_);
+  viewport_.store_parameters(project_);
+  gallery_.export_thumbnails(project_);
+
+  // Failing to save shouldn't take down the app along with the unsaved work
+  try {
+    project_.save();
+    journal_.mark_saved();
+    std::println("Saved project to \"{}\"", project_.path().string());
+  } catch (const std::exception& ex) {
+    std::println("Failed to save project. {}", ex.what());
+  }
+
+  gallery_.set_pending_refresh();
 }
 
 }
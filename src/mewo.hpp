@@ -2,35 +2,141 @@
 
 #include "assets.hpp"
 #include "editor.hpp"
+#include "frame_arena.hpp"
+#include "frame_output.hpp"
+#include "gallery.hpp"
+#include "gfx/blob_cache.hpp"
+#include "gfx/compile_sandbox.hpp"
+#include "gfx/literal_scrub.hpp"
+#include "gfx/memory_tracker.hpp"
+#include "gfx/noise_textures.hpp"
 #include "gfx/renderer.hpp"
+#include "gfx/shader_warmup.hpp"
 #include "gui/context.hpp"
 #include "gui/layout.hpp"
+#include "jobs.hpp"
+#include "journal.hpp"
+#include "metrics.hpp"
+#include "options.hpp"
+#include "project.hpp"
+#include "scopes.hpp"
 #include "sdl/context.hpp"
 #include "sdl/window.hpp"
+#include "state.hpp"
 #include "viewport.hpp"
 
+#include <chrono>
+#include <cstdint>
+#include <optional>
+
 namespace mewo {
 
 class Mewo {
   public:
-  Mewo();
+  Mewo(const Options& options);
 
   void run();
 
   private:
-  Assets assets_;
+  /// Time from launch until the first frame is presented. Exceeding it only prints a warning.
+  static constexpr double STARTUP_BUDGET_MS = 500.0;
+  /// Frames taking longer than this many refresh intervals count as dropped. Leaves some slack
+  /// for jitter in when frames are presented.
+  static constexpr double DROPPED_FRAME_FACTOR = 1.5;
+  /// Longest time to wait for events while minimized. Still short enough to keep asynchronous
+  /// work, like readbacks, moving.
+  static constexpr int32_t MINIMIZED_WAIT_MS = 100;
+  /// Frames the allocation test lets allocate after shader warm-up finishes, while things that
+  /// settle over a few frames, like the GUI's layout and thumbnails, do so.
+  static constexpr uint32_t ALLOCATION_TEST_SETTLE_FRAMES = 120;
+  /// Offending frames printed by the allocation test, so a leak every frame doesn't flood the
+  /// output.
+  static constexpr uint32_t ALLOCATION_TEST_PRINT_LIMIT = 10;
+
+  /// Collects unsaved state from every part of the app into the project, then saves it.
+  void save_project();
+  /// Records changes to the visible code and the GUI's settings in the journal.
+  void update_journal();
+
+  /// Prints the startup timeline once the first frame has been presented.
+  void finish_startup();
+
+  /// Follows the display the window is currently on.
+  void update_dropped_frame_threshold();
+  /// Counts the frame as dropped if it took too long, and publishes its sample if a reader
+  /// is attached.
+  void publish_metrics(uint64_t frame_index, double frame_time_ms);
+  /// Counts the frame as failing the allocation test if it allocated after settling.
+  void check_allocations(uint64_t frame_index, uint64_t allocation_count);
+  /// Throws if the allocation test failed, or never got to check a frame.
+  void finish_allocation_test() const;
+
+  // Members are initialized in declaration order, which is arranged so that work not needing
+  // the device happens while the renderer acquires it in the background. The state comes
+  // first because it owns the startup timeline.
   State state_;
+  /// Destroyed after everything that submits jobs, which wait for their own running jobs.
+  jobs::System jobs_;
+  /// Only the options that are still needed after construction.
+  std::optional<uint32_t> frame_limit_;
+  bool is_allocation_test_ = false;
+  Assets assets_;
+  gfx::BlobCache blob_cache_;
+  gfx::MemoryTracker memory_tracker_;
+  /// Helpers start acquiring their own devices right away, alongside the renderer. Outlives
+  /// everything that waits on its checks.
+  gfx::CompileSandbox sandbox_;
 
   sdl::Context sdl_ctx_;
   sdl::Window window_;
 
   gfx::Renderer renderer_;
 
+  Project project_;
+  /// Restores unsaved edits into the project, so it has to come before the editor opens it.
+  Journal journal_;
+  Editor editor_;
+
+  // Blocks until the renderer is ready, so everything after this can use the device
   gui::Context gui_ctx_;
   gui::Layout layout_;
 
-  Editor editor_;
+  /// Bound by the viewport and gallery, so it has to outlive both.
+  gfx::NoiseTextures noise_;
+  /// Bound like the noise textures. Scrubbing starts and finishes in the GUI.
+  gfx::LiteralScrub scrub_;
   Viewport viewport_;
+  Gallery gallery_;
+  Scopes scopes_;
+  /// Declared after everything that reads its results, and destroyed before the renderer
+  /// its workers use.
+  gfx::ShaderWarmup warmup_;
+
+  /// Reset at the start of every frame.
+  FrameArena frame_arena_;
+  metrics::Publisher metrics_;
+  /// Only exists if enabled at launch, since its shared region is large.
+  std::optional<frame_output::Publisher> frame_output_;
+  /// Frames slower than this count as dropped. Empty if the display's refresh rate is unknown,
+  /// like when running headless.
+  std::optional<double> dropped_frame_threshold_ms_;
+  uint32_t dropped_frame_count_ = 0;
+
+  /// Frames since shader warm-up finished, in the allocation test.
+  uint32_t settle_frame_count_ = 0;
+  uint32_t checked_frame_count_ = 0;
+  uint32_t allocating_frame_count_ = 0;
+
+  /// Editor's change count when the visible code was last journaled.
+  uint64_t journaled_change_count_ = 0;
+
+  bool is_starting_up_ = true;
+  /// Set when the editor picks up an external change, and cleared once the viewport has drawn
+  /// the reloaded code, or failed to compile it.
+  std::optional<std::chrono::steady_clock::time_point> reload_noticed_at_;
+  /// Key of the module the reloaded code compiles to.
+  uint64_t reload_key_ = 0;
+  bool is_reload_drawn_ = false;
 };
 
 }
@@ -0,0 +1,106 @@
+#include "options.hpp"
+
+#include "exception.hpp"
+#include "fs.hpp"
+#include "project.hpp"
+
+#include <charconv>
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <span>
+#include <string_view>
+#include <system_error>
+
+namespace mewo {
+
+static constexpr std::string_view WGSL_FILE_EXTENSION = ".wgsl";
+
+static uint32_t parse_positive(std::string_view value, std::string_view description)
+{
+  uint32_t parsed = 0;
+  const char* value_end = value.data() + value.size();
+  auto [end, error] = std::from_chars(value.data(), value_end, parsed);
+
+  if (error != std::errc() || end != value_end || parsed == 0)
+    throw Exception("\"{}\" is not a valid {}", value, description);
+
+  return parsed;
+}
+
+Options Options::from_args(int argc, char* argv[])
+{
+  Options options;
+
+  // First argument is the executable itself
+  auto args = std::span(argv, static_cast<size_t>(argc)).subspan(1);
+
+  for (size_t i = 0; i < args.size(); ++i) {
+    std::string_view arg = args[i];
+
+    if (arg == "--watch") {
+      if (i + 1 == args.size())
+        throw Exception("Option \"{}\" expects a path to a WGSL file", arg);
+
+      options.watch_path = std::filesystem::absolute(args[++i]);
+
+      if (options.watch_path->extension() != WGSL_FILE_EXTENSION)
+        throw Exception("\"{}\" is not a WGSL shader (does not end with {})",
+            options.watch_path->string(), WGSL_FILE_EXTENSION);
+
+      continue;
+    }
+
+    if (arg == "--headless") {
+      options.is_headless = true;
+      continue;
+    }
+
+    if (arg == "--share-frames") {
+      options.should_share_frames = true;
+      continue;
+    }
+
+    if (arg == "--alloc-test") {
+      options.is_allocation_test = true;
+      continue;
+    }
+
+    if (arg == "--frames") {
+      if (i + 1 == args.size())
+        throw Exception("Option \"{}\" expects a number of frames", arg);
+
+      options.frame_limit = parse_positive(args[++i], "number of frames");
+      continue;
+    }
+
+    if (arg == "--gpu-budget") {
+      if (i + 1 == args.size())
+        throw Exception("Option \"{}\" expects a size in MiB", arg);
+
+      options.gpu_budget_mib = parse_positive(args[++i], "GPU memory budget");
+      continue;
+    }
+
+    if (arg.starts_with("--"))
+      throw Exception("Unknown option \"{}\"", arg);
+
+    if (!options.project_path.empty())
+      throw Exception("Only one project can be opened at a time");
+
+    options.project_path = std::filesystem::absolute(arg);
+
+    if (options.project_path.extension() != Project::FILE_EXTENSION)
+      throw Exception("\"{}\" is not a project (does not end with {})",
+          options.project_path.string(), Project::FILE_EXTENSION);
+  }
+
+  if (options.project_path.empty()) {
+    options.project_path = fs::get_data_path("projects") / "untitled";
+    options.project_path += Project::FILE_EXTENSION;
+  }
+
+  return options;
+}
+
+}
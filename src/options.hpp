@@ -0,0 +1,30 @@
+#pragma once
+
+#include <cstdint>
+#include <filesystem>
+#include <optional>
+
+namespace mewo {
+
+/// Settings that can only be chosen when launching, i.e. from command line arguments.
+struct Options {
+  /// Project to open. Defaults to an untitled project in the user's data directory.
+  std::filesystem::path project_path;
+  /// WGSL file that's reloaded into the editor whenever it's changed by another program.
+  std::optional<std::filesystem::path> watch_path;
+  /// Renders into an offscreen texture without needing a display, for CI and benchmarks.
+  bool is_headless = false;
+  /// Quits after presenting this many frames. Runs until closed if empty.
+  std::optional<uint32_t> frame_limit;
+  /// Publishes viewport frames to other processes through shared memory.
+  bool should_share_frames = false;
+  /// Fails the run if building a frame allocates on the heap once warm-up is over. Meant to
+  /// be combined with `--headless` and `--frames`.
+  bool is_allocation_test = false;
+  /// A warning is shown when estimated GPU memory use goes over this many mebibytes.
+  uint32_t gpu_budget_mib = 512;
+
+  static Options from_args(int argc, char* argv[]);
+};
+
+}
@@ -0,0 +1,521 @@
+#include "project.hpp"
+
+#include "exception.hpp"
+#include "fs.hpp"
+#include "hash.hpp"
+#include "query.hpp"
+
+#include <SDL3/SDL_timer.h>
+
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <format>
+#include <functional>
+#include <print>
+#include <ranges>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include <unordered_map>
+#include <unordered_set>
+#include <utility>
+#include <vector>
+
+namespace mewo {
+
+static constexpr std::array<char, 8> MAGIC = { 'M', 'E', 'W', 'O', 'P', 'R', 'O', 'J' };
+static constexpr uint32_t FORMAT_VERSION = 1;
+static constexpr uint32_t MIN_INDEX_CAPACITY = 256;
+/// Stale bytes are tolerated up to this amount before the file is compacted.
+static constexpr uint64_t MIN_COMPACTION_STALE_BYTES = 1 << 20;
+
+struct Header {
+  std::array<char, 8> magic = MAGIC;
+  uint32_t version = FORMAT_VERSION;
+  uint32_t index_capacity = 0;
+  uint32_t entry_count = 0;
+  uint32_t active_source = 0;
+  /// One past the last byte of chunk data. Appends start here.
+  uint64_t data_end = 0;
+};
+
+static_assert(std::is_trivially_copyable_v<Header>);
+static_assert(sizeof(Header) == 32);
+
+Project::Project(
+    const Assets& assets, const std::filesystem::path& file_path, gfx::BlobCache& blob_cache)
+    : path_(file_path)
+    , blob_cache_(blob_cache)
+{
+  static_assert(std::is_trivially_copyable_v<IndexEntry>);
+  static_assert(sizeof(IndexEntry) == 80);
+
+  if (std::filesystem::exists(path_)) {
+    uint64_t start_ns = SDL_GetTicksNS();
+    open();
+
+    std::println("Opened project \"{}\" in {:.2f} ms", path_.string(),
+        static_cast<double>(SDL_GetTicksNS() - start_ns) / 1'000'000.0);
+  } else {
+    create_default(assets);
+    std::println("Created new project, will be saved to \"{}\"", path_.string());
+  }
+}
+
+uint64_t Project::get_data_start(uint32_t index_capacity)
+{
+  return sizeof(Header) + static_cast<uint64_t>(index_capacity) * sizeof(IndexEntry);
+}
+
+const std::filesystem::path& Project::path() const { return path_; }
+
+size_t Project::source_count() const { return source_chunks_.size(); }
+
+std::string_view Project::source_name(size_t idx) const
+{
+  return chunks_.at(source_chunks_.at(idx)).entry.name.data();
+}
+
+std::string_view Project::source_code(size_t idx) const
+{
+  return chunk_data(chunks_.at(source_chunks_.at(idx)));
+}
+
+size_t Project::active_source() const { return active_source_; }
+
+std::optional<std::string_view> Project::snippet(std::string_view name) const
+{
+  if (const Chunk* chunk = find_chunk(ChunkKind::Snippet, hash::fnv1a(name)))
+    return chunk_data(*chunk);
+
+  return std::nullopt;
+}
+
+std::optional<std::string_view> Project::parameter(std::string_view key) const
+{
+  if (auto it = parameters_.find(key); it != parameters_.end())
+    return it->second;
+
+  return std::nullopt;
+}
+
+std::optional<std::string_view> Project::thumbnail(uint64_t source_hash) const
+{
+  if (const Chunk* chunk = find_chunk(ChunkKind::Thumbnail, source_hash))
+    return chunk_data(*chunk);
+
+  return std::nullopt;
+}
+
+void Project::set_source_code(size_t idx, std::string_view code)
+{
+  const IndexEntry& entry = chunks_.at(source_chunks_.at(idx)).entry;
+  set_chunk(ChunkKind::Source, entry.key, entry.name.data(), code);
+}
+
+void Project::set_active_source(size_t idx)
+{
+  if (idx >= source_chunks_.size())
+    throw Exception("Source index {} out of range, project has {} source(s)", idx,
+        source_chunks_.size());
+
+  active_source_ = static_cast<uint32_t>(idx);
+}
+
+void Project::set_snippet(std::string_view name, std::string_view code)
+{
+  set_chunk(ChunkKind::Snippet, hash::fnv1a(name), name, code);
+}
+
+void Project::set_parameter(std::string_view key, std::string_view value)
+{
+  if (auto it = parameters_.find(key); it != parameters_.end() && it->second == value)
+    return;
+
+  parameters_.insert_or_assign(std::string(key), std::string(value));
+  are_parameters_dirty_ = true;
+}
+
+void Project::set_thumbnail(uint64_t source_hash, std::string_view pixels)
+{
+  set_chunk(ChunkKind::Thumbnail, source_hash, {}, pixels);
+}
+
+void Project::retain_thumbnails(const std::unordered_set<uint64_t>& source_hashes)
+{
+  drop_chunks([&source_hashes](const Chunk& chunk) {
+    return chunk.entry.kind == ChunkKind::Thumbnail && !source_hashes.contains(chunk.entry.key);
+  });
+}
+
+void Project::save()
+{
+  for (auto& [key, blob] : blob_cache_.take_stored())
+    set_chunk(ChunkKind::BackendBlob, key, {}, blob);
+
+  // Blobs of shaders that were since changed are never loaded again
+  drop_chunks([used_keys = blob_cache_.used_keys()](const Chunk& chunk) {
+    return chunk.entry.kind == ChunkKind::BackendBlob && !used_keys.contains(chunk.entry.key);
+  });
+
+  if (are_parameters_dirty_) {
+    std::string serialized;
+
+    for (const auto& [key, value] : parameters_)
+      serialized += std::format("{}={}\n", key, value);
+
+    set_chunk(ChunkKind::Parameters, 0, {}, serialized);
+    are_parameters_dirty_ = false;
+  }
+
+  // Bytes in the file still referenced by the index. Everything else past the index is stale
+  uint64_t live_bytes = 0;
+  for (const Chunk& chunk : chunks_) {
+    if (!chunk.pending.has_value())
+      live_bytes += chunk.entry.size;
+  }
+
+  uint64_t stale_bytes
+      = mapping_.is_open() ? data_end_ - get_data_start(index_capacity_) - live_bytes : 0;
+
+  // Writing moves chunks, which a failed write has to undo, since the file still has them
+  // where they were
+  const bool was_mapped = mapping_.is_open();
+  const uint32_t prev_index_capacity = index_capacity_;
+  const uint64_t prev_data_end = data_end_;
+  std::vector<uint64_t> prev_offsets;
+  prev_offsets.reserve(chunks_.size());
+
+  for (const Chunk& chunk : chunks_)
+    prev_offsets.push_back(chunk.entry.offset);
+
+  try {
+    if (!was_mapped || chunks_.size() > index_capacity_
+        || stale_bytes > std::max(live_bytes, MIN_COMPACTION_STALE_BYTES)) {
+      rewrite();
+    } else {
+      append_pending();
+    }
+  } catch (...) {
+    index_capacity_ = prev_index_capacity;
+    data_end_ = prev_data_end;
+
+    for (size_t idx = 0; idx < chunks_.size(); ++idx)
+      chunks_[idx].entry.offset = prev_offsets[idx];
+
+    // Pending chunks are kept, so saving again can still write them
+    if (was_mapped)
+      remap();
+
+    throw;
+  }
+
+  for (Chunk& chunk : chunks_)
+    chunk.pending = std::nullopt;
+
+  remap();
+}
+
+void Project::open()
+{
+  mapping_ = fs::MappedFile(path_);
+  std::string_view data = mapping_.data();
+
+  Header header;
+  if (data.size() < sizeof(Header))
+    throw Exception("\"{}\" is too small to be a project", path_.string());
+
+  std::memcpy(&header, data.data(), sizeof(Header));
+
+  if (header.magic != MAGIC)
+    throw Exception("\"{}\" is not a project", path_.string());
+
+  if (header.version != FORMAT_VERSION)
+    throw Exception("\"{}\" has unsupported project format version {}, expected {}",
+        path_.string(), header.version, FORMAT_VERSION);
+
+  if (header.entry_count > header.index_capacity
+      || data.size() < get_data_start(header.index_capacity) || data.size() < header.data_end)
+    throw Exception("\"{}\" is truncated or corrupted", path_.string());
+
+  index_capacity_ = header.index_capacity;
+  data_end_ = header.data_end;
+  active_source_ = header.active_source;
+
+  chunks_.reserve(header.entry_count);
+  std::unordered_map<uint64_t, std::string_view> blobs;
+
+  for (uint32_t idx = 0; idx < header.entry_count; ++idx) {
+    IndexEntry entry;
+    std::memcpy(
+        &entry, data.data() + sizeof(Header) + idx * sizeof(IndexEntry), sizeof(IndexEntry));
+
+    // Written so that a corrupted offset or size can't overflow
+    if (entry.offset < get_data_start(header.index_capacity) || entry.offset > data_end_
+        || entry.size > data_end_ - entry.offset)
+      throw Exception("\"{}\" has a chunk past the end of its data", path_.string());
+
+    // Guarantees the name can be read as a null-terminated string
+    entry.name.back() = '\0';
+
+    const Chunk& chunk = chunks_.emplace_back(Chunk { .entry = entry });
+
+    switch (entry.kind) {
+    case ChunkKind::Source:
+      source_chunks_.push_back(idx);
+      break;
+
+    case ChunkKind::Parameters:
+      for (auto line : std::views::split(chunk_data(chunk), '\n')) {
+        std::string_view line_view(line.begin(), line.end());
+
+        if (auto separator = line_view.find('='); separator != std::string_view::npos)
+          parameters_.emplace(line_view.substr(0, separator), line_view.substr(separator + 1));
+      }
+      break;
+
+    case ChunkKind::BackendBlob:
+      blobs.emplace(entry.key, chunk_data(chunk));
+      break;
+
+    case ChunkKind::Snippet:
+    case ChunkKind::Thumbnail:
+      // Read lazily when they're requested
+      break;
+
+    default:
+      throw Exception("\"{}\" has a chunk of unknown kind {}", path_.string(),
+          std::to_underlying(entry.kind));
+    }
+  }
+
+  if (source_chunks_.empty())
+    throw Exception("\"{}\" doesn't contain any shaders", path_.string());
+
+  active_source_ = std::min(active_source_, static_cast<uint32_t>(source_chunks_.size() - 1));
+
+  blob_cache_.set_mapped(std::move(blobs));
+}
+
+void Project::create_default(const Assets& assets)
+{
+  set_snippet(PREFIX_SNIPPET_NAME,
+      fs::read_file(assets.get("shaders/snippets/default_frag_prefix.txt")));
+  add_source("main", fs::read_wgsl_shader(assets.get("shaders/viewport.frag.wgsl")));
+
+  // Example shaders make the starter project a little more interesting
+  std::vector<std::filesystem::path> example_paths;
+  auto examples_path = assets.get("shaders/examples");
+
+  for (const auto& dir_entry : std::filesystem::directory_iterator(examples_path)) {
+    if (dir_entry.is_regular_file() && dir_entry.path().extension() == ".wgsl")
+      example_paths.push_back(dir_entry.path());
+  }
+
+  std::ranges::sort(example_paths);
+
+  for (const auto& example_path : example_paths)
+    add_source(example_path.stem().string(), fs::read_wgsl_shader(example_path));
+}
+
+void Project::add_source(std::string_view name, std::string_view code)
+{
+  source_chunks_.push_back(chunks_.size());
+  set_chunk(ChunkKind::Source, hash::fnv1a(name), name, code);
+}
+
+void Project::drop_chunks(const std::function<bool(const Chunk&)>& predicate)
+{
+  if (std::erase_if(chunks_, predicate) == 0)
+    return;
+
+  // Sources keep their order, only their indices shift
+  source_chunks_.clear();
+
+  for (size_t idx = 0; idx < chunks_.size(); ++idx) {
+    if (chunks_[idx].entry.kind == ChunkKind::Source)
+      source_chunks_.push_back(idx);
+  }
+}
+
+const Project::Chunk* Project::find_chunk(ChunkKind kind, uint64_t key) const
+{
+  auto it = std::ranges::find_if(chunks_, [kind, key](const Chunk& chunk) {
+    return chunk.entry.kind == kind && chunk.entry.key == key;
+  });
+
+  return it != chunks_.end() ? &*it : nullptr;
+}
+
+Project::Chunk* Project::find_chunk(ChunkKind kind, uint64_t key)
+{
+  return const_cast<Chunk*>(std::as_const(*this).find_chunk(kind, key));
+}
+
+Project::Chunk& Project::set_chunk(
+    ChunkKind kind, uint64_t key, std::string_view name, std::string_view data)
+{
+  uint64_t content_hash = hash::fnv1a(data);
+
+  if (Chunk* existing = find_chunk(kind, key)) {
+    Chunk& chunk = *existing;
+
+    if (chunk.entry.content_hash != content_hash || chunk.entry.size != data.size()) {
+      chunk.pending = std::string(data);
+      chunk.entry.size = data.size();
+      chunk.entry.content_hash = content_hash;
+    }
+
+    return chunk;
+  }
+
+  if (name.size() > MAX_NAME_LENGTH)
+    throw Exception("Name \"{}\" is longer than {} characters", name, MAX_NAME_LENGTH);
+
+  Chunk& chunk = chunks_.emplace_back(Chunk {
+      .entry = {
+          .kind = kind,
+          .key = key,
+          .size = data.size(),
+          .content_hash = content_hash,
+      },
+  });
+
+  std::ranges::copy(name, chunk.entry.name.begin());
+  chunk.pending = std::string(data);
+
+  return chunk;
+}
+
+std::string_view Project::chunk_data(const Chunk& chunk) const
+{
+  if (chunk.pending.has_value())
+    return chunk.pending.value();
+
+  return mapping_.data().substr(chunk.entry.offset, chunk.entry.size);
+}
+
+std::string Project::serialize_head() const
+{
+  Header header = {
+    .index_capacity = index_capacity_,
+    .entry_count = static_cast<uint32_t>(chunks_.size()),
+    .active_source = active_source_,
+    .data_end = data_end_,
+  };
+
+  // Unused index entries are left zeroed
+  std::string head(get_data_start(index_capacity_), '\0');
+  std::memcpy(head.data(), &header, sizeof(Header));
+
+  for (size_t idx = 0; idx < chunks_.size(); ++idx) {
+    std::memcpy(head.data() + sizeof(Header) + idx * sizeof(IndexEntry), &chunks_[idx].entry,
+        sizeof(IndexEntry));
+  }
+
+  return head;
+}
+
+void Project::append_pending()
+{
+  // Views into the mapping are about to become stale
+  blob_cache_.set_mapped({});
+  mapping_.close();
+
+  std::FILE* file = std::fopen(path_.string().c_str(), "r+b");
+
+  if (!file)
+    throw Exception("Failed to open \"{}\" for writing", path_.string());
+
+  size_t appended_count = 0;
+
+  try {
+    bool is_written = std::fseek(file, static_cast<long>(data_end_), SEEK_SET) == 0;
+
+    for (Chunk& chunk : chunks_) {
+      if (!chunk.pending.has_value())
+        continue;
+
+      const std::string& data = chunk.pending.value();
+      is_written = is_written && std::fwrite(data.data(), 1, data.size(), file) == data.size();
+
+      chunk.entry.offset = data_end_;
+      data_end_ += data.size();
+      ++appended_count;
+    }
+
+    if (!is_written)
+      throw Exception("Failed to write to \"{}\"", path_.string());
+
+    // Data is on the disk before the index points at it. The index is overwritten in place,
+    // so a crash while it's being written can still leave it torn
+    fs::sync_file(file, path_);
+
+    std::string head = serialize_head();
+
+    if (std::fseek(file, 0, SEEK_SET) != 0
+        || std::fwrite(head.data(), 1, head.size(), file) != head.size()) {
+      throw Exception("Failed to write to \"{}\"", path_.string());
+    }
+
+    fs::sync_file(file, path_);
+  } catch (...) {
+    std::fclose(file);
+    throw;
+  }
+
+  std::fclose(file);
+
+  if constexpr (query::is_debug())
+    std::println("Appended {} changed chunk(s) to project", appended_count);
+}
+
+void Project::rewrite()
+{
+  index_capacity_ = std::max(
+      MIN_INDEX_CAPACITY, std::bit_ceil(static_cast<uint32_t>(chunks_.size()) * 2));
+
+  // Data has to be gathered before the old mapping is closed
+  std::string image(get_data_start(index_capacity_), '\0');
+  data_end_ = image.size();
+
+  for (Chunk& chunk : chunks_) {
+    image += chunk_data(chunk);
+
+    chunk.entry.offset = data_end_;
+    data_end_ += chunk.entry.size;
+  }
+
+  std::string head = serialize_head();
+  image.replace(0, head.size(), head);
+
+  blob_cache_.set_mapped({});
+  mapping_.close();
+
+  fs::write_file(path_, image);
+
+  if constexpr (query::is_debug())
+    std::println("Rewrote project with {} chunk(s), index capacity {}", chunks_.size(),
+        index_capacity_);
+}
+
+void Project::remap()
+{
+  mapping_ = fs::MappedFile(path_);
+
+  std::unordered_map<uint64_t, std::string_view> blobs;
+
+  // Pending blobs would point at data the file doesn't have yet
+  for (const Chunk& chunk : chunks_) {
+    if (chunk.entry.kind == ChunkKind::BackendBlob && !chunk.pending.has_value())
+      blobs.emplace(chunk.entry.key, chunk_data(chunk));
+  }
+
+  blob_cache_.set_mapped(std::move(blobs));
+}
+
+}
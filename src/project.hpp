@@ -0,0 +1,136 @@
+#pragma once
+
+#include "assets.hpp"
+#include "gfx/blob_cache.hpp"
+#include "mapped_file.hpp"
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <functional>
+#include <map>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <unordered_set>
+#include <vector>
+
+namespace mewo {
+
+/// Single-file bundle holding everything in a project: shader sources, snippets, UI
+/// parameters, and caches of compiled backend objects and thumbnails.
+///
+/// On disk, a header and fixed-capacity index sit at the head of the file, followed by chunk
+/// data. Opening a project maps the file and only parses the index, so chunk data is paged
+/// in as it's used. Saving appends changed chunks and rewrites the index in place. The
+/// whole file is only rewritten once the index is full or too much of the file is stale.
+class Project {
+  public:
+  static constexpr std::string_view FILE_EXTENSION = ".mewo";
+  static constexpr std::string_view PREFIX_SNIPPET_NAME = "default_frag_prefix";
+
+  enum class ChunkKind : uint32_t {
+    Source,
+    Snippet,
+    Parameters,
+    BackendBlob,
+    Thumbnail,
+  };
+
+  /// Opens the bundle at the given path. If it doesn't exist yet, creates an unsaved
+  /// project from the default shaders in the assets directory instead.
+  ///
+  /// Backend blobs stored in the project are handed to the given cache, which the renderer
+  /// may already be using from another thread.
+  Project(const Assets& assets, const std::filesystem::path& file_path,
+      gfx::BlobCache& blob_cache);
+
+  Project(const Project&) = delete;
+  Project& operator=(const Project&) = delete;
+
+  const std::filesystem::path& path() const;
+  size_t source_count() const;
+  std::string_view source_name(size_t idx) const;
+  /// Views may be invalidated by `save`, copy them if they need to live longer.
+  std::string_view source_code(size_t idx) const;
+  size_t active_source() const;
+  std::optional<std::string_view> snippet(std::string_view name) const;
+  std::optional<std::string_view> parameter(std::string_view key) const;
+  /// Raw pixels of a thumbnail previously stored with the same source hash.
+  std::optional<std::string_view> thumbnail(uint64_t source_hash) const;
+
+  void set_source_code(size_t idx, std::string_view code);
+  void set_active_source(size_t idx);
+  void set_snippet(std::string_view name, std::string_view code);
+  void set_parameter(std::string_view key, std::string_view value);
+  void set_thumbnail(uint64_t source_hash, std::string_view pixels);
+  /// Drops thumbnails of every other source hash, like those of shaders that were since edited.
+  void retain_thumbnails(const std::unordered_set<uint64_t>& source_hashes);
+
+  /// Only writes chunks that changed since the last save. Also collects backend blobs that
+  /// were compiled this session, so the next open can skip compiling them again, and drops
+  /// those that weren't used this session. Dropped chunks count as stale until compacted.
+  ///
+  /// If writing fails, the project stays usable and its changes stay pending.
+  void save();
+
+  private:
+  static constexpr size_t MAX_NAME_LENGTH = 39;
+
+  struct IndexEntry {
+    ChunkKind kind = ChunkKind::Source;
+    uint32_t reserved = 0;
+    /// Meaning depends on the kind. Hash of the name for sources and snippets, Dawn's cache
+    /// key hash for backend blobs, and the source hash for thumbnails.
+    uint64_t key = 0;
+    uint64_t offset = 0;
+    uint64_t size = 0;
+    uint64_t content_hash = 0;
+    std::array<char, MAX_NAME_LENGTH + 1> name = {};
+  };
+
+  struct Chunk {
+    IndexEntry entry;
+    /// Holds data that hasn't been saved yet. Otherwise, data is read from the mapping.
+    std::optional<std::string> pending;
+  };
+
+  static uint64_t get_data_start(uint32_t index_capacity);
+
+  void open();
+  void create_default(const Assets& assets);
+
+  void add_source(std::string_view name, std::string_view code);
+  /// Keeps `source_chunks_` pointing at the same sources.
+  void drop_chunks(const std::function<bool(const Chunk&)>& predicate);
+  const Chunk* find_chunk(ChunkKind kind, uint64_t key) const;
+  Chunk* find_chunk(ChunkKind kind, uint64_t key);
+  Chunk& set_chunk(ChunkKind kind, uint64_t key, std::string_view name, std::string_view data);
+  std::string_view chunk_data(const Chunk& chunk) const;
+
+  std::string serialize_head() const;
+  void append_pending();
+  void rewrite();
+  /// Maps the file that was just written, and points the blob cache into it. Chunks that are
+  /// still pending aren't read from the file.
+  void remap();
+
+  std::filesystem::path path_;
+  fs::MappedFile mapping_;
+
+  uint32_t index_capacity_ = 0;
+  uint64_t data_end_ = 0;
+  uint32_t active_source_ = 0;
+
+  std::vector<Chunk> chunks_;
+  /// Indices into `chunks_`, in the order sources were added.
+  std::vector<size_t> source_chunks_;
+
+  std::map<std::string, std::string, std::less<>> parameters_;
+  bool are_parameters_dirty_ = false;
+
+  gfx::BlobCache& blob_cache_;
+};
+
+}
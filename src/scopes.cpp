@@ -0,0 +1,237 @@
+#include "scopes.hpp"
+
+#include "exception.hpp"
+#include "fs.hpp"
+#include "gfx/create.hpp"
+
+#include <webgpu/webgpu_cpp.h>
+
+#include <array>
+#include <cstdint>
+#include <string_view>
+
+namespace mewo {
+
+/// Must match the `Counts` struct in both scope shaders: the histogram's four channels, the
+/// waveform's three, the vectorscope, and the maximum of each.
+static constexpr uint64_t COUNTS_SIZE = sizeof(uint32_t)
+    * (4 * Scopes::BINS + 3 * Scopes::BINS * Scopes::WAVEFORM_WIDTH
+        + Scopes::VECTORSCOPE_SIZE * Scopes::VECTORSCOPE_SIZE + 3);
+
+static wgpu::ShaderModule compile_shader(
+    const Assets& assets, const gfx::Renderer& renderer, std::string_view path)
+{
+  const auto& [module_opt, diagnostics] = gfx::create::shader_module_from_wgsl(
+      renderer, fs::read_wgsl_shader(assets.get(path)), path);
+
+  if (!module_opt.has_value())
+    throw Exception("Compiling {} failed! {} diagnostics reported", path, diagnostics.size());
+
+  return module_opt.value();
+}
+
+static gfx::Tracked<wgpu::Texture> create_scope_texture(
+    const gfx::Renderer& renderer, std::string_view label, uint32_t width, uint32_t height)
+{
+  wgpu::TextureDescriptor desc = {
+    .label = label,
+    .usage = wgpu::TextureUsage::StorageBinding | wgpu::TextureUsage::TextureBinding,
+    .size = { .width = width, .height = height },
+    .format = Scopes::TEXTURE_FORMAT,
+  };
+
+  return gfx::create::texture(renderer, desc, gfx::MemoryTracker::Category::Scopes);
+}
+
+Scopes::Scopes(const Assets& assets, const gfx::Renderer& renderer)
+    : device_(renderer.device())
+{
+  wgpu::BufferDescriptor counts_buf_desc = {
+    .label = "scopes-counts-buffer",
+    .usage = wgpu::BufferUsage::Storage | wgpu::BufferUsage::CopyDst,
+    .size = COUNTS_SIZE,
+  };
+
+  counts_buf_
+      = gfx::create::buffer(renderer, counts_buf_desc, gfx::MemoryTracker::Category::Scopes);
+
+  histogram_ = create_scope_texture(
+      renderer, "scopes-histogram-texture", HISTOGRAM_TEXTURE_WIDTH, HISTOGRAM_TEXTURE_HEIGHT);
+  histogram_view_ = histogram_.get().CreateView();
+  waveform_ = create_scope_texture(
+      renderer, "scopes-waveform-texture", WAVEFORM_TEXTURE_WIDTH, WAVEFORM_TEXTURE_HEIGHT);
+  waveform_view_ = waveform_.get().CreateView();
+  vectorscope_ = create_scope_texture(renderer, "scopes-vectorscope-texture",
+      VECTORSCOPE_TEXTURE_SIZE, VECTORSCOPE_TEXTURE_SIZE);
+  vectorscope_view_ = vectorscope_.get().CreateView();
+
+  // Loading from an sRGB texture decodes it, so the shader has to encode it again
+  const wgpu::TextureFormat surface_format = renderer.surface_config().format;
+  const bool is_srgb = surface_format == wgpu::TextureFormat::RGBA8UnormSrgb
+      || surface_format == wgpu::TextureFormat::BGRA8UnormSrgb;
+
+  wgpu::ConstantEntry is_srgb_constant = {
+    .key = "IS_SRGB",
+    .value = is_srgb ? 1.0 : 0.0,
+  };
+
+  wgpu::ComputePipelineDescriptor accumulate_pipeline_desc = {
+    .label = "scopes-accumulate-pipeline",
+    .compute = {
+      .module = compile_shader(assets, renderer, "shaders/scopes_accumulate.comp.wgsl"),
+      .entryPoint = "main",
+      .constantCount = 1,
+      .constants = &is_srgb_constant,
+    },
+  };
+
+  accumulate_pipeline_ = device_.CreateComputePipeline(&accumulate_pipeline_desc);
+
+  wgpu::ShaderModule draw_module
+      = compile_shader(assets, renderer, "shaders/scopes_draw.comp.wgsl");
+
+  std::array<wgpu::BindGroupLayoutEntry, 4> draw_bgl_entries = { {
+      {
+          .binding = 0,
+          .visibility = wgpu::ShaderStage::Compute,
+          .buffer = {
+            .type = wgpu::BufferBindingType::ReadOnlyStorage,
+            .minBindingSize = COUNTS_SIZE,
+          },
+      },
+      {
+          .binding = 1,
+          .visibility = wgpu::ShaderStage::Compute,
+          .storageTexture = { .access = wgpu::StorageTextureAccess::WriteOnly,
+              .format = TEXTURE_FORMAT },
+      },
+      {
+          .binding = 2,
+          .visibility = wgpu::ShaderStage::Compute,
+          .storageTexture = { .access = wgpu::StorageTextureAccess::WriteOnly,
+              .format = TEXTURE_FORMAT },
+      },
+      {
+          .binding = 3,
+          .visibility = wgpu::ShaderStage::Compute,
+          .storageTexture = { .access = wgpu::StorageTextureAccess::WriteOnly,
+              .format = TEXTURE_FORMAT },
+      },
+  } };
+
+  wgpu::BindGroupLayoutDescriptor draw_bgl_desc = {
+    .label = "scopes-draw-bind-group-layout",
+    .entryCount = draw_bgl_entries.size(),
+    .entries = draw_bgl_entries.data(),
+  };
+  wgpu::BindGroupLayout draw_bgl = device_.CreateBindGroupLayout(&draw_bgl_desc);
+
+  wgpu::PipelineLayoutDescriptor draw_layout_desc = {
+    .label = "scopes-draw-pipeline-layout",
+    .bindGroupLayoutCount = 1,
+    .bindGroupLayouts = &draw_bgl,
+  };
+  wgpu::PipelineLayout draw_layout = device_.CreatePipelineLayout(&draw_layout_desc);
+
+  // All three scopes are drawn by entry points of the same module, sharing one bind group
+  auto create_draw_pipeline = [&](const char* label, const char* entry_point) {
+    wgpu::ComputePipelineDescriptor desc = {
+      .label = label,
+      .layout = draw_layout,
+      .compute = { .module = draw_module, .entryPoint = entry_point },
+    };
+
+    return device_.CreateComputePipeline(&desc);
+  };
+
+  draw_histogram_pipeline_
+      = create_draw_pipeline("scopes-draw-histogram-pipeline", "draw_histogram");
+  draw_waveform_pipeline_ = create_draw_pipeline("scopes-draw-waveform-pipeline", "draw_waveform");
+  draw_vectorscope_pipeline_
+      = create_draw_pipeline("scopes-draw-vectorscope-pipeline", "draw_vectorscope");
+
+  std::array<wgpu::BindGroupEntry, 4> draw_bg_entries = { {
+      { .binding = 0, .buffer = counts_buf_, .size = COUNTS_SIZE },
+      { .binding = 1, .textureView = histogram_view_ },
+      { .binding = 2, .textureView = waveform_view_ },
+      { .binding = 3, .textureView = vectorscope_view_ },
+  } };
+
+  wgpu::BindGroupDescriptor draw_bg_desc = {
+    .label = "scopes-draw-bind-group",
+    .layout = draw_bgl,
+    .entryCount = draw_bg_entries.size(),
+    .entries = draw_bg_entries.data(),
+  };
+
+  draw_bg_ = device_.CreateBindGroup(&draw_bg_desc);
+}
+
+const wgpu::TextureView& Scopes::histogram_view() const
+{
+  return histogram_view_;
+}
+
+const wgpu::TextureView& Scopes::waveform_view() const
+{
+  return waveform_view_;
+}
+
+const wgpu::TextureView& Scopes::vectorscope_view() const
+{
+  return vectorscope_view_;
+}
+
+void Scopes::set_is_visible(bool is_visible)
+{
+  is_visible_ = is_visible;
+}
+
+void Scopes::record(const gfx::FrameContext& frame_ctx, const Viewport& viewport)
+{
+  if (!is_visible_)
+    return;
+
+  if (source_view_.Get() != viewport.view().Get()) {
+    source_view_ = viewport.view();
+
+    std::array<wgpu::BindGroupEntry, 2> accumulate_bg_entries = { {
+        { .binding = 0, .textureView = source_view_ },
+        { .binding = 1, .buffer = counts_buf_, .size = COUNTS_SIZE },
+    } };
+
+    wgpu::BindGroupDescriptor accumulate_bg_desc = {
+      .label = "scopes-accumulate-bind-group",
+      .layout = accumulate_pipeline_.GetBindGroupLayout(0),
+      .entryCount = accumulate_bg_entries.size(),
+      .entries = accumulate_bg_entries.data(),
+    };
+
+    accumulate_bg_ = device_.CreateBindGroup(&accumulate_bg_desc);
+  }
+
+  frame_ctx.encoder.ClearBuffer(counts_buf_);
+
+  // Each dispatch is its own usage scope, so the draws see every count
+  wgpu::ComputePassDescriptor pass_desc = { .label = "scopes-pass" };
+  wgpu::ComputePassEncoder pass = frame_ctx.encoder.BeginComputePass(&pass_desc);
+
+  pass.SetPipeline(accumulate_pipeline_);
+  pass.SetBindGroup(0, accumulate_bg_);
+  pass.DispatchWorkgroups(ACCUMULATE_WORKGROUPS, ACCUMULATE_WORKGROUPS);
+
+  auto draw = [&](const wgpu::ComputePipeline& pipeline, uint32_t width, uint32_t height) {
+    pass.SetPipeline(pipeline);
+    pass.SetBindGroup(0, draw_bg_);
+    pass.DispatchWorkgroups((width + DRAW_WORKGROUP_SIZE - 1) / DRAW_WORKGROUP_SIZE,
+        (height + DRAW_WORKGROUP_SIZE - 1) / DRAW_WORKGROUP_SIZE);
+  };
+
+  draw(draw_histogram_pipeline_, HISTOGRAM_TEXTURE_WIDTH, HISTOGRAM_TEXTURE_HEIGHT);
+  draw(draw_waveform_pipeline_, WAVEFORM_TEXTURE_WIDTH, WAVEFORM_TEXTURE_HEIGHT);
+  draw(draw_vectorscope_pipeline_, VECTORSCOPE_TEXTURE_SIZE, VECTORSCOPE_TEXTURE_SIZE);
+
+  pass.End();
+}
+
+}
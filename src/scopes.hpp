@@ -0,0 +1,78 @@
+#pragma once
+
+#include "assets.hpp"
+#include "gfx/frame_context.hpp"
+#include "gfx/memory_tracker.hpp"
+#include "gfx/renderer.hpp"
+#include "viewport.hpp"
+
+#include <webgpu/webgpu_cpp.h>
+
+#include <cstdint>
+
+namespace mewo {
+
+/// Histogram, waveform and vectorscope of the viewport, for judging exposure and color. All
+/// of it happens on the GPU: one compute pass counts pixels into a storage buffer, and another
+/// draws the counts into small textures that the GUI displays, so nothing is read back.
+///
+/// Counts the mip level the viewport panel displays, so the cost follows the panel's size
+/// rather than the render resolution. Nothing is recorded unless the scopes are visible.
+class Scopes {
+  public:
+  /// Levels per channel in the histogram and waveform.
+  static constexpr uint32_t BINS = 256;
+  /// Slices the viewport's width is divided into for the waveform.
+  static constexpr uint32_t WAVEFORM_WIDTH = 256;
+  static constexpr uint32_t VECTORSCOPE_SIZE = 256;
+
+  static constexpr uint32_t HISTOGRAM_TEXTURE_WIDTH = BINS;
+  static constexpr uint32_t HISTOGRAM_TEXTURE_HEIGHT = 128;
+  static constexpr uint32_t WAVEFORM_TEXTURE_WIDTH = WAVEFORM_WIDTH;
+  static constexpr uint32_t WAVEFORM_TEXTURE_HEIGHT = BINS;
+  static constexpr uint32_t VECTORSCOPE_TEXTURE_SIZE = VECTORSCOPE_SIZE;
+  static constexpr auto TEXTURE_FORMAT = wgpu::TextureFormat::RGBA8Unorm;
+
+  Scopes(const Assets& assets, const gfx::Renderer& renderer);
+
+  const wgpu::TextureView& histogram_view() const;
+  const wgpu::TextureView& waveform_view() const;
+  const wgpu::TextureView& vectorscope_view() const;
+
+  /// Needs to be set every frame. Hidden scopes aren't recorded at all.
+  void set_is_visible(bool is_visible);
+
+  /// Counts the pixels of the viewport's displayed mip level and draws the scopes.
+  void record(const gfx::FrameContext& frame_ctx, const Viewport& viewport);
+
+  private:
+  /// Workgroups along each axis of the counting pass, which strides over the whole texture.
+  static constexpr uint32_t ACCUMULATE_WORKGROUPS = 8;
+  static constexpr uint32_t DRAW_WORKGROUP_SIZE = 8;
+
+  wgpu::Device device_;
+
+  wgpu::ComputePipeline accumulate_pipeline_;
+  wgpu::ComputePipeline draw_histogram_pipeline_;
+  wgpu::ComputePipeline draw_waveform_pipeline_;
+  wgpu::ComputePipeline draw_vectorscope_pipeline_;
+
+  /// Cleared before each count.
+  gfx::Tracked<wgpu::Buffer> counts_buf_;
+  wgpu::BindGroup draw_bg_;
+
+  gfx::Tracked<wgpu::Texture> histogram_;
+  wgpu::TextureView histogram_view_;
+  gfx::Tracked<wgpu::Texture> waveform_;
+  wgpu::TextureView waveform_view_;
+  gfx::Tracked<wgpu::Texture> vectorscope_;
+  wgpu::TextureView vectorscope_view_;
+
+  /// Recreated whenever the viewport displays a different view, like after resizing.
+  wgpu::TextureView source_view_;
+  wgpu::BindGroup accumulate_bg_;
+
+  bool is_visible_ = false;
+};
+
+}
@@ -8,8 +8,11 @@ namespace mewo::sdl {
 
 static constexpr auto SDL_SUBSYSTEMS = SDL_INIT_VIDEO;
 
-Context::Context()
+Context::Context(bool is_headless)
 {
+  if (is_headless && !SDL_SetHint(SDL_HINT_VIDEO_DRIVER, "offscreen"))
+    throw Exception("Failed to select offscreen video driver: {}", SDL_GetError());
+
   if (!SDL_Init(SDL_SUBSYSTEMS))
     throw Exception("Failed to initialize SDL: {}", SDL_GetError());
 }
@@ -5,7 +5,9 @@ namespace mewo::sdl {
 /// Initializes and maintains SDL.
 class Context {
   public:
-  Context();
+  /// When headless, SDL's offscreen video driver is used, so windows can be created without
+  /// a display server.
+  explicit Context(bool is_headless);
   ~Context();
 
   Context(const Context&) = delete;
@@ -0,0 +1,219 @@
+#include "shared_memory.hpp"
+
+#include "exception.hpp"
+
+#include <SDL3/SDL_platform.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <utility>
+
+#if defined(SDL_PLATFORM_WIN32)
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace mewo::ipc {
+
+#if defined(SDL_PLATFORM_WIN32)
+/// Session-local, so no special privileges are needed to create it.
+static std::wstring get_platform_name(std::string_view name)
+{
+  std::wstring platform_name = L"Local\\";
+
+  // Names are ASCII by convention, so widening each character is enough
+  for (char c : name)
+    platform_name.push_back(static_cast<wchar_t>(c));
+
+  return platform_name;
+}
+#else
+/// POSIX requires a single leading slash for portable names.
+static std::string get_platform_name(std::string_view name) { return "/" + std::string(name); }
+#endif
+
+SharedMemory::~SharedMemory() { close(); }
+
+SharedMemory::SharedMemory(SharedMemory&& other) noexcept
+    : data_(std::exchange(other.data_, nullptr))
+    , size_(std::exchange(other.size_, 0))
+    , owned_name_(std::exchange(other.owned_name_, {}))
+    , mapping_handle_(std::exchange(other.mapping_handle_, nullptr))
+{
+}
+
+SharedMemory& SharedMemory::operator=(SharedMemory&& other) noexcept
+{
+  if (this != &other) {
+    close();
+
+    data_ = std::exchange(other.data_, nullptr);
+    size_ = std::exchange(other.size_, 0);
+    owned_name_ = std::exchange(other.owned_name_, {});
+    mapping_handle_ = std::exchange(other.mapping_handle_, nullptr);
+  }
+
+  return *this;
+}
+
+SharedMemory SharedMemory::create(std::string_view name, size_t size)
+{
+  SharedMemory memory;
+  auto platform_name = get_platform_name(name);
+
+#if defined(SDL_PLATFORM_WIN32)
+  auto size_64 = static_cast<uint64_t>(size);
+
+  // Backed by the paging file. The name disappears once every handle to it is closed
+  HANDLE mapping = CreateFileMappingW(INVALID_HANDLE_VALUE, nullptr, PAGE_READWRITE,
+      static_cast<DWORD>(size_64 >> 32), static_cast<DWORD>(size_64), platform_name.c_str());
+
+  if (!mapping)
+    throw Exception("Failed to create shared memory \"{}\"", name);
+
+  // Another process still has a region of a previous process with the same ID open. Its
+  // contents can't be trusted, and it may be too small
+  if (GetLastError() == ERROR_ALREADY_EXISTS) {
+    CloseHandle(mapping);
+    throw Exception("Shared memory \"{}\" is still in use", name);
+  }
+
+  void* view = MapViewOfFile(mapping, FILE_MAP_ALL_ACCESS, 0, 0, size);
+
+  if (!view) {
+    CloseHandle(mapping);
+    throw Exception("Failed to map shared memory \"{}\"", name);
+  }
+
+  memory.mapping_handle_ = mapping;
+#else
+  // A previous process with the same ID may have crashed without removing it, and its contents
+  // can't be trusted anyway
+  shm_unlink(platform_name.c_str());
+
+  int fd = shm_open(platform_name.c_str(), O_RDWR | O_CREAT | O_EXCL, 0600);
+
+  if (fd == -1)
+    throw Exception("Failed to create shared memory \"{}\"", name);
+
+  if (ftruncate(fd, static_cast<off_t>(size)) == -1) {
+    ::close(fd);
+    shm_unlink(platform_name.c_str());
+    throw Exception("Failed to resize shared memory \"{}\" to {} bytes", name, size);
+  }
+
+  void* view = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+
+  // The mapping stays valid after the descriptor is closed
+  ::close(fd);
+
+  if (view == MAP_FAILED) {
+    shm_unlink(platform_name.c_str());
+    throw Exception("Failed to map shared memory \"{}\"", name);
+  }
+
+  memory.owned_name_ = platform_name;
+#endif
+
+  // New mappings are always zeroed. Physical pages are only used once touched, so large regions
+  // are cheap until they're used
+  memory.data_ = static_cast<std::byte*>(view);
+  memory.size_ = size;
+
+  return memory;
+}
+
+SharedMemory SharedMemory::open(std::string_view name)
+{
+  SharedMemory memory;
+  auto platform_name = get_platform_name(name);
+
+#if defined(SDL_PLATFORM_WIN32)
+  HANDLE mapping = OpenFileMappingW(FILE_MAP_ALL_ACCESS, FALSE, platform_name.c_str());
+
+  if (!mapping)
+    throw Exception("Shared memory \"{}\" doesn't exist", name);
+
+  void* view = MapViewOfFile(mapping, FILE_MAP_ALL_ACCESS, 0, 0, 0);
+
+  if (!view) {
+    CloseHandle(mapping);
+    throw Exception("Failed to map shared memory \"{}\"", name);
+  }
+
+  // Views are rounded up to whole pages, so this may be larger than what was created
+  MEMORY_BASIC_INFORMATION info = {};
+  VirtualQuery(view, &info, sizeof(info));
+
+  memory.mapping_handle_ = mapping;
+  memory.size_ = info.RegionSize;
+#else
+  int fd = shm_open(platform_name.c_str(), O_RDWR, 0);
+
+  if (fd == -1)
+    throw Exception("Shared memory \"{}\" doesn't exist", name);
+
+  struct stat info = {};
+
+  if (fstat(fd, &info) == -1 || info.st_size <= 0) {
+    ::close(fd);
+    throw Exception("Failed to get the size of shared memory \"{}\"", name);
+  }
+
+  memory.size_ = static_cast<size_t>(info.st_size);
+
+  void* view = mmap(nullptr, memory.size_, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  ::close(fd);
+
+  if (view == MAP_FAILED)
+    throw Exception("Failed to map shared memory \"{}\"", name);
+#endif
+
+  memory.data_ = static_cast<std::byte*>(view);
+
+  return memory;
+}
+
+bool SharedMemory::is_open() const { return data_ != nullptr; }
+
+std::byte* SharedMemory::data() const { return data_; }
+
+size_t SharedMemory::size() const { return size_; }
+
+void SharedMemory::close()
+{
+  if (!data_)
+    return;
+
+#if defined(SDL_PLATFORM_WIN32)
+  UnmapViewOfFile(data_);
+  CloseHandle(static_cast<HANDLE>(mapping_handle_));
+#else
+  munmap(data_, size_);
+
+  if (!owned_name_.empty())
+    shm_unlink(owned_name_.c_str());
+#endif
+
+  data_ = nullptr;
+  size_ = 0;
+  owned_name_.clear();
+  mapping_handle_ = nullptr;
+}
+
+uint32_t get_process_id()
+{
+#if defined(SDL_PLATFORM_WIN32)
+  return static_cast<uint32_t>(GetCurrentProcessId());
+#else
+  return static_cast<uint32_t>(getpid());
+#endif
+}
+
+}
@@ -0,0 +1,55 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+
+namespace mewo::ipc {
+
+/// RAII wrapper around a named region of memory that other processes on the same machine can
+/// map too. Uses POSIX shared memory, or a named file mapping on Windows.
+///
+/// Contents are shared as is, so anything placed in the region must be trivially copyable,
+/// and any atomics in it must be lock-free.
+class SharedMemory {
+  public:
+  SharedMemory() = default;
+  ~SharedMemory();
+
+  SharedMemory(const SharedMemory&) = delete;
+  SharedMemory& operator=(const SharedMemory&) = delete;
+  SharedMemory(SharedMemory&& other) noexcept;
+  SharedMemory& operator=(SharedMemory&& other) noexcept;
+
+  /// Creates a zeroed region. Names must include the creator's process ID, so anything left
+  /// under the name can only be from a process that's gone, and is replaced. Processes that
+  /// already mapped that region keep their mapping. The name is removed again once the creator
+  /// closes the region.
+  static SharedMemory create(std::string_view name, size_t size);
+  /// Maps an existing region for reading and writing. Throws if it doesn't exist.
+  static SharedMemory open(std::string_view name);
+
+  bool is_open() const;
+  /// Null if nothing is mapped.
+  std::byte* data() const;
+  size_t size() const;
+
+  void close();
+
+  private:
+  std::byte* data_ = nullptr;
+  size_t size_ = 0;
+
+  /// Only the creator removes the name, so readers can come and go.
+  std::string owned_name_;
+  /// Windows needs the mapping object to stay alive for as long as the view is mapped.
+  /// Stored as an opaque pointer so <windows.h> doesn't leak into this header.
+  void* mapping_handle_ = nullptr;
+};
+
+/// Makes region names unique to this process, so instances running side by side never share
+/// a region.
+uint32_t get_process_id();
+
+}
@@ -1,5 +1,11 @@
 #pragma once
 
+#include "timeline.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+
 namespace mewo {
 
 /// Stores general application state. Also lets me avoid passing the entire `Mewo` class
@@ -7,6 +13,21 @@ namespace mewo {
 struct State {
   bool should_quit = false;
   float time = 0.f;
+
+  /// Set while building the UI, and handled at the end of the frame.
+  bool should_save_project = false;
+  /// Index of a project source to open in the editor. Handled at the end of the frame.
+  std::optional<size_t> pending_open_source;
+
+  /// From a watched file being changed by another program, to the recompiled shader being
+  /// presented. Empty until the first change.
+  std::optional<double> reload_latency_ms;
+
+  /// Heap allocations made on the main thread while building the previous frame.
+  uint64_t frame_allocation_count = 0;
+
+  /// Starts when the app is launched, and is complete once the first frame is presented.
+  Timeline startup;
 };
 
 }
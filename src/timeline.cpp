@@ -0,0 +1,45 @@
+#include "timeline.hpp"
+
+#include <chrono>
+#include <memory_resource>
+#include <mutex>
+#include <print>
+#include <string_view>
+#include <vector>
+
+namespace mewo {
+
+Timeline::Timeline()
+    : start_(std::chrono::steady_clock::now())
+{
+}
+
+uint64_t Timeline::elapsed_ns() const
+{
+  auto elapsed = std::chrono::duration_cast<std::chrono::nanoseconds>(
+      std::chrono::steady_clock::now() - start_);
+
+  return static_cast<uint64_t>(elapsed.count());
+}
+
+std::pmr::vector<Timeline::Mark> Timeline::marks(std::pmr::memory_resource* resource) const
+{
+  std::scoped_lock lock(mutex_);
+  return std::pmr::vector<Mark>(marks_.begin(), marks_.end(), resource);
+}
+
+void Timeline::mark(std::string_view label)
+{
+  uint64_t elapsed = elapsed_ns();
+
+  std::scoped_lock lock(mutex_);
+  marks_.push_back({ .label = label, .elapsed_ns = elapsed });
+}
+
+void Timeline::print() const
+{
+  for (const auto& [label, elapsed_ns] : marks())
+    std::println("  {:>9.2f} ms  {}", static_cast<double>(elapsed_ns) / 1'000'000.0, label);
+}
+
+}
@@ -0,0 +1,40 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <memory_resource>
+#include <mutex>
+#include <string_view>
+#include <vector>
+
+namespace mewo {
+
+/// Records when named steps finished, relative to when the timeline was created. Marks can
+/// be added from any thread, which is useful when steps run in parallel.
+class Timeline {
+  public:
+  struct Mark {
+    /// Must refer to a string that outlives the timeline, like a literal.
+    std::string_view label;
+    uint64_t elapsed_ns = 0;
+  };
+
+  Timeline();
+
+  uint64_t elapsed_ns() const;
+  /// Returns a copy, because other threads may still be adding marks. Allocated from the
+  /// given resource, so callers showing marks every frame can use a frame arena.
+  std::pmr::vector<Mark> marks(
+      std::pmr::memory_resource* resource = std::pmr::get_default_resource()) const;
+
+  void mark(std::string_view label);
+  void print() const;
+
+  private:
+  std::chrono::steady_clock::time_point start_;
+
+  mutable std::mutex mutex_;
+  std::vector<Mark> marks_;
+};
+
+}
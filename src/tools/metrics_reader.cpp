@@ -0,0 +1,167 @@
+// Prints metrics published by a running instance of Mewo as CSV, one row per presented frame.
+// Takes the process ID of the instance, since each one publishes under its own name. Waits for
+// the instance to finish launching, and exits once it quits. Mewo only publishes while this is
+// running, since it checks in with a heartbeat every time it polls.
+
+#include "metrics.hpp"
+#include "shared_memory.hpp"
+
+#include <atomic>
+#include <charconv>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <exception>
+#include <new>
+#include <optional>
+#include <print>
+#include <string>
+#include <string_view>
+#include <system_error>
+#include <thread>
+
+namespace metrics = mewo::metrics;
+
+static constexpr std::chrono::milliseconds POLL_INTERVAL { 50 };
+static constexpr std::chrono::seconds RECONNECT_INTERVAL { 1 };
+
+/// Empty if the region doesn't exist yet, or was created by an incompatible version of Mewo.
+static std::optional<mewo::ipc::SharedMemory> connect(const std::string& name)
+{
+  mewo::ipc::SharedMemory memory;
+
+  try {
+    memory = mewo::ipc::SharedMemory::open(name);
+  } catch (const std::exception&) {
+    return std::nullopt;
+  }
+
+  if (memory.size() < metrics::REGION_SIZE)
+    return std::nullopt;
+
+  auto* header = std::launder(reinterpret_cast<metrics::Header*>(memory.data()));
+
+  // Not set until the rest of the header is initialized
+  if (std::atomic_ref(header->magic).load(std::memory_order_acquire) != metrics::MAGIC)
+    return std::nullopt;
+
+  if (header->version != metrics::SCHEMA_VERSION || header->sample_size != sizeof(metrics::Sample)
+      || header->capacity != metrics::RING_CAPACITY) {
+    std::println(stderr, "Unsupported metrics schema version {} (expected {})", header->version,
+        metrics::SCHEMA_VERSION);
+    return std::nullopt;
+  }
+
+  return memory;
+}
+
+/// Empty if the writer got to the slot again while it was being copied.
+static std::optional<metrics::Sample> read_sample(const metrics::Slot& slot, uint64_t sample_idx)
+{
+  const uint64_t expected = metrics::get_written_sequence(sample_idx);
+
+  if (slot.sequence.load(std::memory_order_acquire) != expected)
+    return std::nullopt;
+
+  metrics::Sample sample;
+  std::memcpy(&sample, &slot.sample, sizeof(sample));
+
+  // Keeps the copy from being reordered after the second check
+  std::atomic_thread_fence(std::memory_order_acquire);
+
+  if (slot.sequence.load(std::memory_order_relaxed) != expected)
+    return std::nullopt;
+
+  return sample;
+}
+
+/// Empty if the argument isn't a process ID.
+static std::optional<uint32_t> parse_process_id(std::string_view arg)
+{
+  uint32_t process_id = 0;
+  auto [end, error] = std::from_chars(arg.data(), arg.data() + arg.size(), process_id);
+
+  if (error != std::errc() || end != arg.data() + arg.size())
+    return std::nullopt;
+
+  return process_id;
+}
+
+int main(int argc, char* argv[])
+{
+  std::optional<uint32_t> process_id
+      = argc == 2 ? parse_process_id(argv[1]) : std::optional<uint32_t>();
+
+  if (!process_id.has_value()) {
+    std::println(stderr, "Usage: mewo-metrics <process ID of Mewo>");
+    return 1;
+  }
+
+  const std::string name = metrics::get_shared_memory_name(process_id.value());
+
+  std::println("frame_index,presented_at_ns,frame_time_ms,gpu_pass_ms,compile_ms,dropped_frames,"
+               "texture_bytes,gpu_memory_bytes");
+  std::fflush(stdout);
+
+  std::println(stderr, "Waiting for Mewo...");
+
+  std::optional<mewo::ipc::SharedMemory> memory = connect(name);
+
+  while (!memory.has_value()) {
+    std::this_thread::sleep_for(RECONNECT_INTERVAL);
+    memory = connect(name);
+  }
+
+  std::println(stderr, "Connected to Mewo");
+
+  auto* header = std::launder(reinterpret_cast<metrics::Header*>(memory->data()));
+  auto* slots
+      = std::launder(reinterpret_cast<metrics::Slot*>(memory->data() + sizeof(metrics::Header)));
+
+  // Only samples written from now on are printed
+  uint64_t next_idx = header->write_count.load(std::memory_order_acquire);
+  uint64_t last_write_count = next_idx;
+  auto last_sample_at = std::chrono::steady_clock::now();
+
+  while (true) {
+    header->reader_heartbeat_ns.store(metrics::get_now_ns(), std::memory_order_relaxed);
+
+    uint64_t write_count = header->write_count.load(std::memory_order_acquire);
+
+    if (write_count - next_idx > metrics::RING_CAPACITY) {
+      std::println(stderr, "Skipped {} sample(s) that were overwritten before being read",
+          write_count - next_idx - metrics::RING_CAPACITY);
+      next_idx = write_count - metrics::RING_CAPACITY;
+    }
+
+    for (; next_idx < write_count; ++next_idx) {
+      auto sample = read_sample(slots[next_idx % metrics::RING_CAPACITY], next_idx);
+
+      if (!sample.has_value())
+        continue;
+
+      std::println("{},{},{:.3f},{:.3f},{:.3f},{},{},{}", sample->frame_index,
+          sample->presented_at_ns, sample->frame_time_ms, sample->gpu_pass_ms, sample->compile_ms,
+          sample->dropped_frames, sample->texture_bytes, sample->gpu_memory_bytes);
+    }
+
+    std::fflush(stdout);
+
+    auto now = std::chrono::steady_clock::now();
+
+    if (write_count != last_write_count) {
+      last_write_count = write_count;
+      last_sample_at = now;
+    }
+
+    // Mewo publishes every frame while a reader is attached, so silence means it has quit
+    // or crashed. A restarted Mewo has another process ID, so there's nothing to wait for
+    if (now - last_sample_at > metrics::READER_TIMEOUT) {
+      std::println(stderr, "Lost connection to Mewo");
+      return 0;
+    }
+
+    std::this_thread::sleep_for(POLL_INTERVAL);
+  }
+}
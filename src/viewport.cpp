@@ -3,26 +3,81 @@
 #include "aspect_ratio.hpp"
 #include "exception.hpp"
 #include "fs.hpp"
+#include "gfx/async.hpp"
 #include "gfx/create.hpp"
 #include "gfx/renderer.hpp"
+#include "gfx/shader_override.hpp"
 #include "gui/layout.hpp"
+#include "hash.hpp"
 #include "query.hpp"
 
 #include <SDL3/SDL_timer.h>
 #include <webgpu/webgpu_cpp.h>
 
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <charconv>
+#include <chrono>
 #include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <iterator>
 #include <optional>
 #include <print>
+#include <string>
 #include <string_view>
+#include <system_error>
 #include <utility>
+#include <vector>
 
 namespace mewo {
 
 static constexpr std::string_view DEFAULT_FRAG_SHADER_LABEL = "viewport-frag-shader";
 
+namespace parameter {
+
+constexpr std::string_view MODE = "viewport.mode";
+constexpr std::string_view RATIO_PRESET = "viewport.ratio_preset";
+constexpr std::string_view WIDTH = "viewport.width";
+constexpr std::string_view HEIGHT = "viewport.height";
+constexpr std::string_view QUALITY = "viewport.quality";
+constexpr std::string_view ACCUMULATE = "viewport.accumulate";
+constexpr std::string_view ACCUMULATION_TARGET = "viewport.accumulation_target";
+
+}
+
+template <typename T>
+static std::optional<T> parse_parameter(const Project& project, std::string_view key)
+{
+  auto value = project.parameter(key);
+
+  if (!value.has_value())
+    return std::nullopt;
+
+  T parsed = {};
+  auto [end, error] = std::from_chars(value->data(), value->data() + value->size(), parsed);
+
+  if (error != std::errc() || end != value->data() + value->size())
+    return std::nullopt;
+
+  return parsed;
+}
+
+static wgpu::TextureDescriptor get_target_desc(
+    wgpu::TextureFormat format, uint32_t supersampling, uint32_t width, uint32_t height)
+{
+  return {
+    .label = "viewport-target",
+    .usage = wgpu::TextureUsage::RenderAttachment | wgpu::TextureUsage::TextureBinding,
+    .size = { .width = width * supersampling, .height = height * supersampling },
+    .format = format,
+  };
+}
+
 Viewport::Viewport(const Assets& assets, const State& state, const gfx::Renderer& renderer,
-    std::string_view initial_code)
+    const gfx::NoiseTextures& noise, const gfx::LiteralScrub& scrub, std::string_view initial_code,
+    bool is_initial_code_recovered)
 {
   const wgpu::Device& device = renderer.device();
   const wgpu::SurfaceConfiguration& surface_config = renderer.surface_config();
@@ -33,7 +88,7 @@ Viewport::Viewport(const Assets& assets, const State& state, const gfx::Renderer
     .size = sizeof(Uniforms),
   };
 
-  unif_buf_ = device.CreateBuffer(&unif_buf_desc);
+  unif_buf_ = gfx::create::buffer(renderer, unif_buf_desc, gfx::MemoryTracker::Category::Uniforms);
 
   float width
       = std::floor(static_cast<float>(surface_config.width) * gui::Layout::SPLIT_LEFT_RATIO);
@@ -44,33 +99,40 @@ Viewport::Viewport(const Assets& assets, const State& state, const gfx::Renderer
   Uniforms unif = { .time = state.time, .resolution = { width, height } };
   renderer.queue().WriteBuffer(unif_buf_, 0, &unif, sizeof(Uniforms));
 
-  wgpu::BindGroupLayoutEntry render_pipeline_unif_bgl_entry = {
-    .binding = 0,
-    .visibility = wgpu::ShaderStage::Fragment,
-    .buffer = {
-      .type = wgpu::BufferBindingType::Uniform,
-      .minBindingSize = sizeof(Uniforms),
-    },
-  };
+  // Noise textures and scrubbed literals follow the uniforms, and are bound whether or not the
+  // shader uses them
+  std::vector<wgpu::BindGroupLayoutEntry> render_pipeline_bgl_entries = { {
+      .binding = 0,
+      .visibility = wgpu::ShaderStage::Fragment,
+      .buffer = {
+          .type = wgpu::BufferBindingType::Uniform,
+          .minBindingSize = sizeof(Uniforms),
+      },
+  } };
+  std::ranges::copy(noise.bind_group_layout_entries(),
+      std::back_inserter(render_pipeline_bgl_entries));
+  render_pipeline_bgl_entries.push_back(scrub.bind_group_layout_entry());
 
   wgpu::BindGroupLayoutDescriptor render_pipeline_bgl_desc = {
     .label = "viewport-render-pipeline-bind-group-layout",
-    .entryCount = 1,
-    .entries = &render_pipeline_unif_bgl_entry,
+    .entryCount = render_pipeline_bgl_entries.size(),
+    .entries = render_pipeline_bgl_entries.data(),
   };
   render_pipeline_bgl_ = device.CreateBindGroupLayout(&render_pipeline_bgl_desc);
 
-  wgpu::BindGroupEntry render_pipeline_unif_bg_entry = {
-    .binding = 0,
-    .buffer = unif_buf_,
-    .size = sizeof(Uniforms),
-  };
+  std::vector<wgpu::BindGroupEntry> render_pipeline_bg_entries = { {
+      .binding = 0,
+      .buffer = unif_buf_,
+      .size = sizeof(Uniforms),
+  } };
+  std::ranges::copy(noise.bind_group_entries(), std::back_inserter(render_pipeline_bg_entries));
+  render_pipeline_bg_entries.push_back(scrub.bind_group_entry());
 
   wgpu::BindGroupDescriptor render_pipeline_bg_desc = {
     .label = "viewport-render-pipeline-bind-group",
     .layout = render_pipeline_bgl_,
-    .entryCount = 1,
-    .entries = &render_pipeline_unif_bg_entry,
+    .entryCount = render_pipeline_bg_entries.size(),
+    .entries = render_pipeline_bg_entries.data(),
   };
 
   render_pipeline_bg_ = device.CreateBindGroup(&render_pipeline_bg_desc);
@@ -97,14 +159,46 @@ Viewport::Viewport(const Assets& assets, const State& state, const gfx::Renderer
     .vertex = { .module = vert_module_opt.value(), .entryPoint = "main" },
   };
 
-  // Compile a default fragment shader to enable render pipeline creation in constructor
-  const auto& [frag_module_opt, frag_diagnostics] = gfx::create::shader_module_from_wgsl(renderer,
-      fs::read_wgsl_shader(assets.get("shaders/viewport.frag.wgsl")),
-      DEFAULT_FRAG_SHADER_LABEL.data());
+  // Compile the initial code directly instead of going through a run request, so startup
+  // doesn't pay for compiling the default fragment shader as well. Recovered code may be what
+  // crashed the compiler, and helpers take a while to start, so it waits for the sandbox
+  // without blocking startup
+  std::optional<wgpu::ShaderModule> frag_module_opt;
 
+  if (is_initial_code_recovered) {
+    pending_run_request_ = std::string(initial_code);
+  } else {
+    auto [initial_module_opt, initial_diagnostics] = gfx::create::shader_module_from_wgsl(
+        renderer, initial_code, DEFAULT_FRAG_SHADER_LABEL.data());
+
+    frag_module_opt = std::move(initial_module_opt);
+    diagnostics_ = std::move(initial_diagnostics);
+  }
+
+  // Only fall back to the default fragment shader if the initial code is broken or still has to
+  // be checked. Diagnostics of the initial code are kept so they can still be shown to the user
   if (!frag_module_opt.has_value()) {
-    throw Exception("Compiling default viewport fragment shader failed! {} diagnostics reported",
-        frag_diagnostics.size());
+    std::string default_code = fs::read_wgsl_shader(assets.get("shaders/viewport.frag.wgsl"));
+    auto [default_module_opt, default_diagnostics] = gfx::create::shader_module_from_wgsl(
+        renderer, default_code, DEFAULT_FRAG_SHADER_LABEL.data());
+
+    if (!default_module_opt.has_value()) {
+      throw Exception("Compiling default viewport fragment shader failed! {} diagnostics reported",
+          default_diagnostics.size());
+    }
+
+    frag_module_opt = std::move(default_module_opt);
+    module_key_ = hash::fnv1a(default_code);
+  } else {
+    overrides_ = gfx::find_shader_overrides(initial_code);
+    module_key_ = hash::fnv1a(initial_code);
+
+    // So going back to the initial code in the edit history doesn't compile it again
+    cache_module(module_key_, {
+        .module = frag_module_opt.value(),
+        .overrides = overrides_,
+        .diagnostics = diagnostics_,
+    });
   }
 
   fragment_state_ = {
@@ -116,12 +210,11 @@ Viewport::Viewport(const Assets& assets, const State& state, const gfx::Renderer
 
   update_render_pipeline(device);
 
-  // Also send off a compilation request for the actual fragment shader
-  set_pending_run_request(std::string(initial_code));
-
   texture_desc_ = {
     .label = "viewport-texture",
-    .usage = wgpu::TextureUsage::RenderAttachment | wgpu::TextureUsage::TextureBinding,
+    // Copied from when frames are shared with other processes
+    .usage = wgpu::TextureUsage::RenderAttachment | wgpu::TextureUsage::TextureBinding
+        | wgpu::TextureUsage::CopySrc,
     .format = surface_config.format,
   };
 
@@ -142,9 +235,268 @@ Viewport::Viewport(const Assets& assets, const State& state, const gfx::Renderer
     .colorAttachmentCount = 1,
     .colorAttachments = &pass_color_attachment_,
   };
+
+  const auto& [resolve_module_opt, resolve_diagnostics]
+      = gfx::create::shader_module_from_wgsl(renderer,
+          fs::read_wgsl_shader(assets.get("shaders/viewport_resolve.frag.wgsl")),
+          "viewport-resolve-shader");
+
+  if (!resolve_module_opt.has_value()) {
+    throw Exception("Compiling viewport resolve shader failed! {} diagnostics reported",
+        resolve_diagnostics.size());
+  }
+
+  resolve_module_ = resolve_module_opt.value();
+
+  wgpu::BindGroupLayoutEntry resolve_bgl_entry = {
+    .binding = 0,
+    .visibility = wgpu::ShaderStage::Fragment,
+    // Covers 32-bit float targets, which can't be filtered without an optional feature
+    .texture = {
+      .sampleType = wgpu::TextureSampleType::UnfilterableFloat,
+      .viewDimension = wgpu::TextureViewDimension::e2D,
+    },
+  };
+
+  wgpu::BindGroupLayoutDescriptor resolve_bgl_desc = {
+    .label = "viewport-resolve-bind-group-layout",
+    .entryCount = 1,
+    .entries = &resolve_bgl_entry,
+  };
+  resolve_bgl_ = device.CreateBindGroupLayout(&resolve_bgl_desc);
+
+  wgpu::PipelineLayoutDescriptor resolve_layout_desc = {
+    .label = "viewport-resolve-pipeline-layout",
+    .bindGroupLayoutCount = 1,
+    .bindGroupLayouts = &resolve_bgl_,
+  };
+
+  // Shares the fullscreen vertex shader with the render pipeline
+  resolve_pipeline_desc_ = {
+    .label = "viewport-resolve-pipeline",
+    .layout = device.CreatePipelineLayout(&resolve_layout_desc),
+    .vertex = render_pipeline_desc_.vertex,
+  };
+
+  resolve_pass_color_attachment_ = {
+    .loadOp = wgpu::LoadOp::Clear,
+    .storeOp = wgpu::StoreOp::Store,
+  };
+
+  resolve_pass_desc_ = {
+    .label = "viewport-resolve-pass",
+    .colorAttachmentCount = 1,
+    .colorAttachments = &resolve_pass_color_attachment_,
+  };
+
+  const auto& [accumulate_module_opt, accumulate_diagnostics]
+      = gfx::create::shader_module_from_wgsl(renderer,
+          fs::read_wgsl_shader(assets.get("shaders/viewport_accumulate.frag.wgsl")),
+          "viewport-accumulate-shader");
+
+  if (!accumulate_module_opt.has_value()) {
+    throw Exception("Compiling viewport accumulate shader failed! {} diagnostics reported",
+        accumulate_diagnostics.size());
+  }
+
+  static constexpr wgpu::TextureBindingLayout ACCUMULATE_TEXTURE_LAYOUT = {
+    .sampleType = wgpu::TextureSampleType::UnfilterableFloat,
+    .viewDimension = wgpu::TextureViewDimension::e2D,
+  };
+
+  std::array<wgpu::BindGroupLayoutEntry, 3> accumulate_bgl_entries = { {
+      {
+          .binding = 0,
+          .visibility = wgpu::ShaderStage::Fragment,
+          .texture = ACCUMULATE_TEXTURE_LAYOUT,
+      },
+      {
+          .binding = 1,
+          .visibility = wgpu::ShaderStage::Fragment,
+          .texture = ACCUMULATE_TEXTURE_LAYOUT,
+      },
+      {
+          .binding = 2,
+          .visibility = wgpu::ShaderStage::Fragment,
+          .buffer = {
+            .type = wgpu::BufferBindingType::Uniform,
+            .minBindingSize = sizeof(Uniforms),
+          },
+      },
+  } };
+
+  wgpu::BindGroupLayoutDescriptor accumulate_bgl_desc = {
+    .label = "viewport-accumulate-bind-group-layout",
+    .entryCount = accumulate_bgl_entries.size(),
+    .entries = accumulate_bgl_entries.data(),
+  };
+  accumulate_bgl_ = device.CreateBindGroupLayout(&accumulate_bgl_desc);
+
+  wgpu::PipelineLayoutDescriptor accumulate_layout_desc = {
+    .label = "viewport-accumulate-pipeline-layout",
+    .bindGroupLayoutCount = 1,
+    .bindGroupLayouts = &accumulate_bgl_,
+  };
+
+  wgpu::ColorTargetState accumulate_target_state = { .format = HISTORY_FORMAT };
+
+  wgpu::FragmentState accumulate_fragment_state = {
+    .module = accumulate_module_opt.value(),
+    .entryPoint = "main",
+    .targetCount = 1,
+    .targets = &accumulate_target_state,
+  };
+
+  wgpu::RenderPipelineDescriptor accumulate_pipeline_desc = {
+    .label = "viewport-accumulate-pipeline",
+    .layout = device.CreatePipelineLayout(&accumulate_layout_desc),
+    .vertex = render_pipeline_desc_.vertex,
+    .fragment = &accumulate_fragment_state,
+  };
+
+  accumulate_pipeline_ = device.CreateRenderPipeline(&accumulate_pipeline_desc);
+
+  accumulate_pass_color_attachment_ = {
+    .loadOp = wgpu::LoadOp::Clear,
+    .storeOp = wgpu::StoreOp::Store,
+  };
+
+  accumulate_pass_desc_ = {
+    .label = "viewport-accumulate-pass",
+    .colorAttachmentCount = 1,
+    .colorAttachments = &accumulate_pass_color_attachment_,
+  };
+
+  const auto& [downsample_module_opt, downsample_diagnostics]
+      = gfx::create::shader_module_from_wgsl(renderer,
+          fs::read_wgsl_shader(assets.get("shaders/viewport_downsample.frag.wgsl")),
+          "viewport-downsample-shader");
+
+  if (!downsample_module_opt.has_value()) {
+    throw Exception("Compiling viewport downsample shader failed! {} diagnostics reported",
+        downsample_diagnostics.size());
+  }
+
+  std::array<wgpu::BindGroupLayoutEntry, 2> downsample_bgl_entries = { {
+      {
+          .binding = 0,
+          .visibility = wgpu::ShaderStage::Fragment,
+          .texture = {
+            .sampleType = wgpu::TextureSampleType::Float,
+            .viewDimension = wgpu::TextureViewDimension::e2D,
+          },
+      },
+      {
+          .binding = 1,
+          .visibility = wgpu::ShaderStage::Fragment,
+          .sampler = { .type = wgpu::SamplerBindingType::Filtering },
+      },
+  } };
+
+  wgpu::BindGroupLayoutDescriptor downsample_bgl_desc = {
+    .label = "viewport-downsample-bind-group-layout",
+    .entryCount = downsample_bgl_entries.size(),
+    .entries = downsample_bgl_entries.data(),
+  };
+  downsample_bgl_ = device.CreateBindGroupLayout(&downsample_bgl_desc);
+
+  wgpu::SamplerDescriptor downsample_sampler_desc = {
+    .label = "viewport-downsample-sampler",
+    .magFilter = wgpu::FilterMode::Linear,
+    .minFilter = wgpu::FilterMode::Linear,
+  };
+  downsample_sampler_ = device.CreateSampler(&downsample_sampler_desc);
+
+  wgpu::PipelineLayoutDescriptor downsample_layout_desc = {
+    .label = "viewport-downsample-pipeline-layout",
+    .bindGroupLayoutCount = 1,
+    .bindGroupLayouts = &downsample_bgl_,
+  };
+
+  wgpu::ColorTargetState downsample_target_state = { .format = texture_desc_.format };
+
+  wgpu::FragmentState downsample_fragment_state = {
+    .module = downsample_module_opt.value(),
+    .entryPoint = "main",
+    .targetCount = 1,
+    .targets = &downsample_target_state,
+  };
+
+  wgpu::RenderPipelineDescriptor downsample_pipeline_desc = {
+    .label = "viewport-downsample-pipeline",
+    .layout = device.CreatePipelineLayout(&downsample_layout_desc),
+    .vertex = render_pipeline_desc_.vertex,
+    .fragment = &downsample_fragment_state,
+  };
+
+  downsample_pipeline_ = device.CreateRenderPipeline(&downsample_pipeline_desc);
+
+  downsample_pass_color_attachment_ = {
+    .loadOp = wgpu::LoadOp::Clear,
+    .storeOp = wgpu::StoreOp::Store,
+  };
+
+  downsample_pass_desc_ = {
+    .label = "viewport-downsample-pass",
+    .colorAttachmentCount = 1,
+    .colorAttachments = &downsample_pass_color_attachment_,
+  };
+
+  // Optional, so tiers are still selectable without it, just without their GPU times
+  if (device.HasFeature(wgpu::FeatureName::TimestampQuery)) {
+    wgpu::QuerySetDescriptor query_set_desc = {
+      .label = "viewport-timestamp-query-set",
+      .type = wgpu::QueryType::Timestamp,
+      .count = TIMESTAMP_COUNT,
+    };
+
+    timestamp_query_set_ = device.CreateQuerySet(&query_set_desc);
+
+    wgpu::BufferDescriptor resolve_buf_desc = {
+      .label = "viewport-timestamp-resolve-buffer",
+      .usage = wgpu::BufferUsage::QueryResolve | wgpu::BufferUsage::CopySrc,
+      .size = TIMESTAMP_COUNT * sizeof(uint64_t),
+    };
+
+    timestamp_resolve_buf_ = gfx::create::buffer(
+        renderer, resolve_buf_desc, gfx::MemoryTracker::Category::Readback);
+
+    wgpu::BufferDescriptor readback_buf_desc = {
+      .label = "viewport-timestamp-readback-buffer",
+      .usage = wgpu::BufferUsage::MapRead | wgpu::BufferUsage::CopyDst,
+      .size = TIMESTAMP_COUNT * sizeof(uint64_t),
+    };
+
+    timestamp_readback_buf_ = gfx::create::buffer(
+        renderer, readback_buf_desc, gfx::MemoryTracker::Category::Readback);
+
+    render_timestamp_writes_ = {
+      .querySet = timestamp_query_set_,
+      .beginningOfPassWriteIndex = 0,
+      .endOfPassWriteIndex = 1,
+    };
+
+    resolve_timestamp_writes_ = {
+      .querySet = timestamp_query_set_,
+      .beginningOfPassWriteIndex = 2,
+      .endOfPassWriteIndex = 3,
+    };
+
+    accumulate_timestamp_writes_ = {
+      .querySet = timestamp_query_set_,
+      .beginningOfPassWriteIndex = 4,
+      .endOfPassWriteIndex = 5,
+    };
+  }
 }
 
-const wgpu::TextureView& Viewport::view() const { return view_; }
+const wgpu::Texture& Viewport::texture() const { return texture_; }
+
+const wgpu::TextureView& Viewport::view() const
+{
+  // Textures don't exist until the first frame is prepared
+  return mip_views_.empty() ? view_ : mip_views_[displayed_mip_level_];
+}
 
 Viewport::Mode Viewport::mode() const { return mode_; }
 
@@ -154,11 +506,48 @@ uint32_t Viewport::width() const { return width_; }
 
 uint32_t Viewport::height() const { return height_; }
 
-const std::vector<gfx::CompilationDiagnostic>& Viewport::diagnostics() const
+Viewport::Quality Viewport::quality() const { return quality_; }
+
+Viewport::QualityCost Viewport::quality_cost(Quality quality) const
+{
+  const QualityTier& tier = get_quality_tier(quality);
+  QualityCost cost = { .gpu_ms = gpu_costs_ms_[std::to_underlying(quality)] };
+
+  if (tier.format != wgpu::TextureFormat::Undefined) {
+    cost.target_size = gfx::MemoryTracker::get_texture_size(get_target_desc(
+        tier.format, tier.supersampling, texture_desc_.size.width, texture_desc_.size.height));
+  }
+
+  return cost;
+}
+
+bool Viewport::is_accumulating() const { return is_accumulating_; }
+
+uint32_t Viewport::accumulation_target() const { return accumulation_target_; }
+
+uint32_t Viewport::sample_count() const { return sample_count_; }
+
+const gfx::CompilationLog& Viewport::diagnostics() const
 {
   return diagnostics_;
 }
 
+std::optional<Viewport::RunResult> Viewport::take_run_result()
+{
+  return std::exchange(run_result_, std::nullopt);
+}
+
+Viewport::Counters Viewport::take_counters() { return std::exchange(counters_, {}); }
+
+const std::vector<gfx::ShaderOverride>& Viewport::overrides() const { return overrides_; }
+
+const wgpu::BindGroupLayout& Viewport::bind_group_layout() const { return render_pipeline_bgl_; }
+
+const wgpu::RenderPipelineDescriptor& Viewport::render_pipeline_desc() const
+{
+  return render_pipeline_desc_;
+}
+
 void Viewport::set_mode(Mode mode) { mode_ = mode; }
 
 void Viewport::set_ratio_preset(AspectRatio::Preset preset) { ratio_preset_ = preset; }
@@ -184,10 +573,133 @@ void Viewport::set_pending_resize(uint32_t new_width, uint32_t new_height)
 void Viewport::set_pending_run_request(std::string&& new_code)
 {
   pending_run_request_ = std::move(new_code);
+  pending_restore_ = std::nullopt;
+}
+
+bool Viewport::set_pending_restore(uint64_t module_key)
+{
+  if (!module_cache_.contains(module_key))
+    return false;
+
+  pending_restore_ = module_key;
+  pending_run_request_ = std::nullopt;
+  pending_check_ = nullptr;
+
+  return true;
 }
 
-void Viewport::record(const gfx::FrameContext& frame_ctx) const
+void Viewport::set_override_value(size_t idx, std::optional<double> value)
 {
+  if (idx >= overrides_.size())
+    return;
+
+  overrides_[idx].value = value;
+  pending_override_update_ = true;
+}
+
+void Viewport::set_pending_quality(Quality quality) { pending_quality_ = quality; }
+
+void Viewport::set_displayed_width(float width)
+{
+  displayed_mip_level_ = 0;
+
+  // Stops at the smallest level that's still as wide, so the GUI never minifies by 2× or more
+  while (displayed_mip_level_ + 1 < mip_views_.size()
+      && static_cast<float>(texture_desc_.size.width >> (displayed_mip_level_ + 1)) >= width) {
+    ++displayed_mip_level_;
+  }
+}
+
+void Viewport::set_pending_accumulation(bool is_accumulating)
+{
+  pending_accumulation_ = is_accumulating;
+}
+
+void Viewport::set_accumulation_target(uint32_t target)
+{
+  accumulation_target_ = std::max(target, 1u);
+}
+
+void Viewport::set_pending_accumulation_reset() { pending_accumulation_reset_ = true; }
+
+void Viewport::set_mouse(std::optional<std::array<float, 2>> pressed_position)
+{
+  if (pressed_position.has_value())
+    mouse_position_ = pressed_position.value();
+
+  is_mouse_pressed_ = pressed_position.has_value();
+}
+
+void Viewport::load_parameters(const Project& project)
+{
+  static constexpr uint32_t VIEWPORT_SIZE_MIN = 2;
+  static constexpr uint32_t VIEWPORT_SIZE_MAX = 2048;
+
+  if (auto mode = parse_parameter<int>(project, parameter::MODE);
+      mode == std::to_underlying(Mode::AspectRatio)
+      || mode == std::to_underlying(Mode::Resolution)) {
+    mode_ = static_cast<Mode>(mode.value());
+  }
+
+  if (auto preset = parse_parameter<int>(project, parameter::RATIO_PRESET);
+      preset >= std::to_underlying(AspectRatio::Preset::e1_1)
+      && preset <= std::to_underlying(AspectRatio::Preset::e16_9)) {
+    ratio_preset_ = static_cast<AspectRatio::Preset>(preset.value());
+  }
+
+  if (auto quality = parse_parameter<int>(project, parameter::QUALITY);
+      quality >= std::to_underlying(Quality::Standard)
+      && quality < std::to_underlying(Quality::Count)) {
+    pending_quality_ = static_cast<Quality>(quality.value());
+  }
+
+  if (auto accumulate = parse_parameter<int>(project, parameter::ACCUMULATE);
+      accumulate == 0 || accumulate == 1) {
+    pending_accumulation_ = accumulate == 1;
+  }
+
+  if (auto target = parse_parameter<uint32_t>(project, parameter::ACCUMULATION_TARGET);
+      target >= 1u) {
+    accumulation_target_ = target.value();
+  }
+
+  auto width = parse_parameter<uint32_t>(project, parameter::WIDTH);
+  auto height = parse_parameter<uint32_t>(project, parameter::HEIGHT);
+
+  // Only the resolution mode uses a fixed size, otherwise it's derived from the GUI panel
+  if (mode_ == Mode::Resolution && width >= VIEWPORT_SIZE_MIN && width <= VIEWPORT_SIZE_MAX
+      && height >= VIEWPORT_SIZE_MIN && height <= VIEWPORT_SIZE_MAX) {
+    width_ = width.value();
+    height_ = height.value();
+    set_pending_resize();
+  }
+}
+
+void Viewport::store_parameters(Project& project) const
+{
+  project.set_parameter(parameter::MODE, std::to_string(std::to_underlying(mode_)));
+  project.set_parameter(parameter::RATIO_PRESET, std::to_string(std::to_underlying(ratio_preset_)));
+  project.set_parameter(parameter::WIDTH, std::to_string(width_));
+  project.set_parameter(parameter::HEIGHT, std::to_string(height_));
+  project.set_parameter(parameter::QUALITY, std::to_string(std::to_underlying(quality_)));
+  project.set_parameter(parameter::ACCUMULATE, is_accumulating_ ? "1" : "0");
+  project.set_parameter(parameter::ACCUMULATION_TARGET, std::to_string(accumulation_target_));
+}
+
+void Viewport::record(const gfx::FrameContext& frame_ctx)
+{
+  // Nothing would change, so the GPU is left alone until something resets accumulation
+  if (is_accumulating_ && sample_count_ >= accumulation_target_) {
+    record_mips(frame_ctx);
+    return;
+  }
+
+  const bool needs_resolve = get_target_format() != wgpu::TextureFormat::Undefined;
+  // The readback buffer can't be copied into while it's still mapped
+  const bool is_timing = timestamp_query_set_ && !is_reading_timestamps_;
+
+  pass_desc_.timestampWrites = is_timing ? &render_timestamp_writes_ : nullptr;
+
   wgpu::RenderPassEncoder render_pass = frame_ctx.encoder.BeginRenderPass(&pass_desc_);
 
   render_pass.SetPipeline(render_pipeline_);
@@ -195,37 +707,593 @@ void Viewport::record(const gfx::FrameContext& frame_ctx) const
   render_pass.Draw(6);
 
   render_pass.End();
+
+  if (is_accumulating_) {
+    const size_t next_history_idx = 1 - history_idx_;
+
+    accumulate_pass_color_attachment_.view = history_views_[next_history_idx];
+    accumulate_pass_desc_.timestampWrites = is_timing ? &accumulate_timestamp_writes_ : nullptr;
+
+    wgpu::RenderPassEncoder accumulate_pass
+        = frame_ctx.encoder.BeginRenderPass(&accumulate_pass_desc_);
+
+    accumulate_pass.SetPipeline(accumulate_pipeline_);
+    accumulate_pass.SetBindGroup(0, accumulate_bgs_[history_idx_]);
+    accumulate_pass.Draw(6);
+
+    accumulate_pass.End();
+
+    // The uniform buffer already holds the count from before this sample
+    history_idx_ = next_history_idx;
+    ++sample_count_;
+  }
+
+  if (needs_resolve) {
+    resolve_pass_desc_.timestampWrites = is_timing ? &resolve_timestamp_writes_ : nullptr;
+
+    wgpu::RenderPassEncoder resolve_pass = frame_ctx.encoder.BeginRenderPass(&resolve_pass_desc_);
+
+    resolve_pass.SetPipeline(resolve_pipeline_);
+    // Accumulated images are resolved from the history instead of the latest sample
+    resolve_pass.SetBindGroup(
+        0, is_accumulating_ ? history_resolve_bgs_[history_idx_] : resolve_bg_);
+    resolve_pass.Draw(6);
+
+    resolve_pass.End();
+  }
+
+  // Every other level was downsampled from the previous image
+  valid_mip_count_ = 1;
+  record_mips(frame_ctx);
+
+  if (!is_timing)
+    return;
+
+  uint32_t timestamp_count = is_accumulating_ ? TIMESTAMP_COUNT : needs_resolve ? 4 : 2;
+
+  frame_ctx.encoder.ResolveQuerySet(
+      timestamp_query_set_, 0, timestamp_count, timestamp_resolve_buf_, 0);
+  frame_ctx.encoder.CopyBufferToBuffer(timestamp_resolve_buf_, 0, timestamp_readback_buf_, 0,
+      timestamp_count * sizeof(uint64_t));
+
+  pending_timestamps_ = {
+    .quality = quality_,
+    .has_resolve = needs_resolve,
+    .is_accumulating = is_accumulating_,
+  };
 }
 
 void Viewport::update_render_pipeline(const wgpu::Device& device)
 {
-  render_pipeline_desc_.fragment = &fragment_state_;
+  uint64_t cache_key = prepare_pipeline_key();
+
+  if (auto it = pipeline_cache_.find(cache_key); it != pipeline_cache_.end()) {
+    render_pipeline_ = it->second;
+
+    if constexpr (query::is_debug())
+      std::println("Reused cached viewport render pipeline");
+
+    return;
+  }
+
   render_pipeline_ = device.CreateRenderPipeline(&render_pipeline_desc_);
+  cache_pipeline(cache_key, render_pipeline_);
 }
 
-void Viewport::prepare_new_frame(State& state, const gfx::Renderer& renderer)
+uint64_t Viewport::prepare_pipeline_key()
 {
-  if (pending_run_request_.has_value()) {
-    // TODO: check if the code is the same before creating new fragment shader module
-    //       (how expensive is this anyway?)
-    auto frag_result = gfx::create::shader_module_from_wgsl(
-        renderer, pending_run_request_.value(), DEFAULT_FRAG_SHADER_LABEL.data());
-    diagnostics_ = std::move(frag_result.second);
+  // Quality tiers render into different formats, which needs a different pipeline too
+  auto format = std::to_underlying(color_target_state_.format);
+  uint64_t cache_key = hash::fnv1a(
+      std::string_view(reinterpret_cast<const char*>(&format), sizeof(format)), module_key_);
 
-    std::println("Shader compilation generated {} diagnostic(s)", diagnostics_.size());
+  override_constants_.clear();
 
-    if (const auto& frag_module_opt = frag_result.first; frag_module_opt.has_value()) {
-      fragment_state_.module = frag_module_opt.value();
-      update_render_pipeline(renderer.device());
+  for (const gfx::ShaderOverride& override_decl : overrides_) {
+    if (!override_decl.value.has_value())
+      continue;
 
-      if constexpr (query::is_debug())
-        std::println("Updated viewport render pipeline");
+    double value = override_decl.value.value();
+    override_constants_.push_back({ .key = override_decl.key.c_str(), .value = value });
+
+    cache_key = hash::fnv1a(override_decl.key, cache_key);
+    cache_key = hash::fnv1a(
+        std::string_view(reinterpret_cast<const char*>(&value), sizeof(value)), cache_key);
+  }
+
+  fragment_state_.constantCount = override_constants_.size();
+  fragment_state_.constants = override_constants_.data();
+  render_pipeline_desc_.fragment = &fragment_state_;
+
+  return cache_key;
+}
+
+void Viewport::cache_pipeline(uint64_t cache_key, wgpu::RenderPipeline pipeline)
+{
+  if (pipeline_cache_order_.size() >= PIPELINE_CACHE_CAPACITY) {
+    pipeline_cache_.erase(pipeline_cache_order_.front());
+    pipeline_cache_order_.pop_front();
+  }
+
+  pipeline_cache_.emplace(cache_key, std::move(pipeline));
+  pipeline_cache_order_.push_back(cache_key);
+}
+
+void Viewport::cache_module(uint64_t module_key, CachedModule cached)
+{
+  if (module_cache_order_.size() >= MODULE_CACHE_CAPACITY) {
+    module_cache_.erase(module_cache_order_.front());
+    module_cache_order_.pop_front();
+  }
+
+  module_cache_.emplace(module_key, std::move(cached));
+  module_cache_order_.push_back(module_key);
+}
+
+gfx::async::Task<> Viewport::create_render_pipeline(wgpu::Device device)
+{
+  uint64_t cache_key = prepare_pipeline_key();
+
+  if (auto it = pipeline_cache_.find(cache_key); it != pipeline_cache_.end()) {
+    render_pipeline_ = it->second;
+    co_return;
+  }
+
+  gfx::async::PipelineResult result
+      = co_await gfx::async::create_render_pipeline(device, render_pipeline_desc_);
+
+  if (result.status != wgpu::CreatePipelineAsyncStatus::Success) {
+    std::println("Creating viewport render pipeline failed. {}", result.message);
+    co_return;
+  }
+
+  // Keys include the module, so the pipeline can be cached even if it's been replaced since
+  cache_pipeline(cache_key, result.pipeline);
+
+  // Module, overrides or quality tier may have changed in the meantime, which already updated
+  // the pipeline
+  if (prepare_pipeline_key() == cache_key)
+    render_pipeline_ = std::move(result.pipeline);
+}
+
+gfx::async::Task<> Viewport::switch_module(uint64_t module_key, wgpu::Device device)
+{
+  const CachedModule& cached = module_cache_.at(module_key);
+  std::vector<gfx::ShaderOverride> overrides = cached.overrides;
+
+  // Keep values picked for overrides that still exist, so tweaks survive editing the code
+  for (gfx::ShaderOverride& override_decl : overrides) {
+    auto prev_it = std::ranges::find_if(overrides_, [&override_decl](const auto& prev) {
+      return prev.key == override_decl.key && prev.type == override_decl.type;
+    });
+
+    if (prev_it != overrides_.end() && prev_it->value.has_value())
+      override_decl.value = prev_it->value;
+  }
+
+  overrides_ = std::move(overrides);
+  diagnostics_ = cached.diagnostics;
+  fragment_state_.module = cached.module;
+  module_key_ = module_key;
+
+  co_await create_render_pipeline(std::move(device));
+  reset_accumulation();
+}
+
+gfx::async::Task<> Viewport::run(std::string code, const gfx::Renderer& renderer,
+    const gfx::ShaderWarmup& warmup, std::optional<gfx::CompilationLog> checked_diagnostics)
+{
+  auto compile_start = std::chrono::steady_clock::now();
+  const uint64_t module_key = hash::fnv1a(code);
+
+  // Code that compiled before, like when going back in the edit history, isn't compiled again
+  if (!module_cache_.contains(module_key)) {
+    gfx::create::ShaderCompilationResult frag_result;
+
+    // Opening another shader of the project skips compiling if warm-up already got to it
+    if (const auto* warm = warmup.find(code); warm != nullptr) {
+      frag_result = { warm->module, warm->diagnostics };
+    } else if (checked_diagnostics.has_value()) {
+      frag_result = {
+        gfx::create::shader_module_from_checked_wgsl(renderer, code, DEFAULT_FRAG_SHADER_LABEL),
+        std::move(checked_diagnostics).value(),
+      };
     } else {
+      frag_result = co_await gfx::async::shader_module_from_wgsl(
+          renderer, code, std::string(DEFAULT_FRAG_SHADER_LABEL));
+    }
+
+    std::println("Shader compilation generated {} diagnostic(s)", frag_result.second.size());
+
+    if (!frag_result.first.has_value()) {
+      diagnostics_ = std::move(frag_result.second);
+      run_result_ = { .module_key = module_key, .is_compiled = false };
+
       if constexpr (query::is_debug())
         std::println("Shader compilation errors occurred, viewport render pipeline not updated");
+
+      co_return;
+    }
+
+    cache_module(module_key, {
+        .module = frag_result.first.value(),
+        .overrides = gfx::find_shader_overrides(code),
+        .diagnostics = std::move(frag_result.second),
+    });
+  }
+
+  co_await switch_module(module_key, renderer.device());
+  run_result_ = { .module_key = module_key, .is_compiled = true };
+
+  std::chrono::duration<double, std::milli> compile_duration
+      = std::chrono::steady_clock::now() - compile_start;
+  counters_.compile_ms = compile_duration.count();
+
+  if constexpr (query::is_debug())
+    std::println("Updated viewport render pipeline");
+}
+
+const Viewport::QualityTier& Viewport::get_quality_tier(Quality quality)
+{
+  return QUALITY_TIERS[std::to_underlying(quality)];
+}
+
+void Viewport::apply_quality(const wgpu::Device& device)
+{
+  const QualityTier& tier = get_quality_tier(quality_);
+
+  if constexpr (query::is_debug())
+    std::println("Viewport quality set to {} ({})", tier.name, tier.description);
+
+  const wgpu::TextureFormat target_format = get_target_format();
+
+  if (target_format == wgpu::TextureFormat::Undefined) {
+    color_target_state_.format = texture_desc_.format;
+    update_render_pipeline(device);
+
+    resolve_pipeline_ = {};
+    return;
+  }
+
+  color_target_state_.format = target_format;
+  update_render_pipeline(device);
+
+  // Unrolls the resolve loop for the tier's supersampling factor
+  wgpu::ConstantEntry scale_constant = {
+    .key = "SCALE",
+    .value = static_cast<double>(tier.supersampling),
+  };
+
+  wgpu::ColorTargetState resolve_target_state = { .format = texture_desc_.format };
+
+  wgpu::FragmentState resolve_fragment_state = {
+    .module = resolve_module_,
+    .entryPoint = "main",
+    .constantCount = 1,
+    .constants = &scale_constant,
+    .targetCount = 1,
+    .targets = &resolve_target_state,
+  };
+
+  resolve_pipeline_desc_.fragment = &resolve_fragment_state;
+  resolve_pipeline_ = device.CreateRenderPipeline(&resolve_pipeline_desc_);
+  resolve_pipeline_desc_.fragment = nullptr;
+}
+
+void Viewport::create_textures(const gfx::Renderer& renderer, uint32_t width, uint32_t height)
+{
+  texture_desc_.size.width = width;
+  texture_desc_.size.height = height;
+  // Only the resolution mode displays the texture at a different size than it's rendered at
+  texture_desc_.mipLevelCount = mode_ == Mode::Resolution
+      ? static_cast<uint32_t>(std::bit_width(std::max(width, height)))
+      : 1;
+  // Replacing the texture releases the previous one's tracked memory
+  texture_
+      = gfx::create::texture(renderer, texture_desc_, gfx::MemoryTracker::Category::RenderTargets);
+
+  mip_views_.clear();
+  downsample_bgs_.clear();
+
+  for (uint32_t level = 0; level < texture_desc_.mipLevelCount; ++level) {
+    // Render attachments can only have one level, and so can each level's source
+    wgpu::TextureViewDescriptor mip_view_desc = {
+      .label = "viewport-view",
+      .baseMipLevel = level,
+      .mipLevelCount = 1,
+    };
+
+    mip_views_.push_back(texture_.get().CreateView(&mip_view_desc));
+  }
+
+  for (uint32_t level = 0; level + 1 < texture_desc_.mipLevelCount; ++level) {
+    std::array<wgpu::BindGroupEntry, 2> downsample_bg_entries = { {
+        { .binding = 0, .textureView = mip_views_[level] },
+        { .binding = 1, .sampler = downsample_sampler_ },
+    } };
+
+    wgpu::BindGroupDescriptor downsample_bg_desc = {
+      .label = "viewport-downsample-bind-group",
+      .layout = downsample_bgl_,
+      .entryCount = downsample_bg_entries.size(),
+      .entries = downsample_bg_entries.data(),
+    };
+
+    downsample_bgs_.push_back(renderer.device().CreateBindGroup(&downsample_bg_desc));
+  }
+
+  view_ = mip_views_.front();
+  displayed_mip_level_ = 0;
+  valid_mip_count_ = 0;
+
+  const uint32_t supersampling = get_quality_tier(quality_).supersampling;
+  const wgpu::TextureFormat target_format = get_target_format();
+
+  // Whatever was accumulated so far has the previous size
+  reset_accumulation();
+
+  auto release_history = [this] {
+    history_ = {};
+    history_views_ = {};
+    accumulate_bgs_ = {};
+    history_resolve_bgs_ = {};
+  };
+
+  if (target_format == wgpu::TextureFormat::Undefined) {
+    target_ = {};
+    target_view_ = {};
+    resolve_bg_ = {};
+    release_history();
+
+    pass_color_attachment_.view = view_;
+    return;
+  }
+
+  wgpu::TextureDescriptor target_desc
+      = get_target_desc(target_format, supersampling, width, height);
+  target_
+      = gfx::create::texture(renderer, target_desc, gfx::MemoryTracker::Category::RenderTargets);
+
+  static const wgpu::TextureViewDescriptor TARGET_VIEW_DESC = { .label = "viewport-target-view" };
+
+  target_view_ = target_.get().CreateView(&TARGET_VIEW_DESC);
+
+  wgpu::BindGroupEntry resolve_bg_entry = {
+    .binding = 0,
+    .textureView = target_view_,
+  };
+
+  wgpu::BindGroupDescriptor resolve_bg_desc = {
+    .label = "viewport-resolve-bind-group",
+    .layout = resolve_bgl_,
+    .entryCount = 1,
+    .entries = &resolve_bg_entry,
+  };
+
+  resolve_bg_ = renderer.device().CreateBindGroup(&resolve_bg_desc);
+
+  pass_color_attachment_.view = target_view_;
+  resolve_pass_color_attachment_.view = view_;
+
+  if (!is_accumulating_) {
+    release_history();
+    return;
+  }
+
+  wgpu::TextureDescriptor history_desc
+      = get_target_desc(HISTORY_FORMAT, supersampling, width, height);
+  history_desc.label = "viewport-history";
+
+  static const wgpu::TextureViewDescriptor HISTORY_VIEW_DESC = { .label = "viewport-history-view" };
+
+  for (size_t idx = 0; idx < history_.size(); ++idx) {
+    history_[idx]
+        = gfx::create::texture(renderer, history_desc, gfx::MemoryTracker::Category::RenderTargets);
+    history_views_[idx] = history_[idx].get().CreateView(&HISTORY_VIEW_DESC);
+
+    wgpu::BindGroupEntry history_resolve_bg_entry = {
+      .binding = 0,
+      .textureView = history_views_[idx],
+    };
+
+    wgpu::BindGroupDescriptor history_resolve_bg_desc = {
+      .label = "viewport-history-resolve-bind-group",
+      .layout = resolve_bgl_,
+      .entryCount = 1,
+      .entries = &history_resolve_bg_entry,
+    };
+
+    history_resolve_bgs_[idx] = renderer.device().CreateBindGroup(&history_resolve_bg_desc);
+  }
+
+  for (size_t idx = 0; idx < history_.size(); ++idx) {
+    std::array<wgpu::BindGroupEntry, 3> accumulate_bg_entries = { {
+        { .binding = 0, .textureView = target_view_ },
+        { .binding = 1, .textureView = history_views_[idx] },
+        { .binding = 2, .buffer = unif_buf_, .size = sizeof(Uniforms) },
+    } };
+
+    wgpu::BindGroupDescriptor accumulate_bg_desc = {
+      .label = "viewport-accumulate-bind-group",
+      .layout = accumulate_bgl_,
+      .entryCount = accumulate_bg_entries.size(),
+      .entries = accumulate_bg_entries.data(),
+    };
+
+    accumulate_bgs_[idx] = renderer.device().CreateBindGroup(&accumulate_bg_desc);
+  }
+}
+
+wgpu::TextureFormat Viewport::get_target_format() const
+{
+  const wgpu::TextureFormat format = get_quality_tier(quality_).format;
+
+  if (format == wgpu::TextureFormat::Undefined && is_accumulating_)
+    return ACCUMULATION_SAMPLE_FORMAT;
+
+  return format;
+}
+
+void Viewport::reset_accumulation() { sample_count_ = 0; }
+
+void Viewport::record_mips(const gfx::FrameContext& frame_ctx)
+{
+  if (valid_mip_count_ == 0)
+    return;
+
+  for (; valid_mip_count_ <= displayed_mip_level_; ++valid_mip_count_) {
+    downsample_pass_color_attachment_.view = mip_views_[valid_mip_count_];
+
+    wgpu::RenderPassEncoder downsample_pass
+        = frame_ctx.encoder.BeginRenderPass(&downsample_pass_desc_);
+
+    downsample_pass.SetPipeline(downsample_pipeline_);
+    downsample_pass.SetBindGroup(0, downsample_bgs_[valid_mip_count_ - 1]);
+    downsample_pass.Draw(6);
+
+    downsample_pass.End();
+  }
+}
+
+void Viewport::read_timestamps()
+{
+  reading_timestamps_ = std::exchange(pending_timestamps_, std::nullopt).value();
+  is_reading_timestamps_ = true;
+
+  const wgpu::Buffer& readback_buf = timestamp_readback_buf_;
+
+  // Callback is invoked during `wgpu::Instance::ProcessEvents` in the main loop. It's a plain
+  // function with the viewport as userdata, since capturing lambdas are allocated on the heap
+  // every time, and timestamps are read back every other frame
+  readback_buf.MapAsync(wgpu::MapMode::Read, 0, readback_buf.GetSize(),
+      wgpu::CallbackMode::AllowProcessEvents,
+      [](wgpu::MapAsyncStatus status, wgpu::StringView message, Viewport* viewport) {
+        // Also invoked when the instance is destroyed, at which point the viewport may be gone
+        if (status == wgpu::MapAsyncStatus::CallbackCancelled)
+          return;
+
+        viewport->finish_reading_timestamps(status, message);
+      },
+      this);
+}
+
+void Viewport::finish_reading_timestamps(wgpu::MapAsyncStatus status, wgpu::StringView message)
+{
+  is_reading_timestamps_ = false;
+
+  if (status != wgpu::MapAsyncStatus::Success) {
+    std::println("Failed to read back viewport timestamps: {}", std::string_view(message));
+    return;
+  }
+
+  const wgpu::Buffer& readback_buf = timestamp_readback_buf_;
+  const PendingTimestamps& pending = reading_timestamps_;
+
+  const auto* timestamps
+      = static_cast<const uint64_t*>(readback_buf.GetConstMappedRange(0, readback_buf.GetSize()));
+
+  // Timestamps may be quantized or reset by the driver, so a pass can appear to end before it
+  // began
+  auto get_pass_duration = [timestamps](size_t begin_idx) -> uint64_t {
+    uint64_t begin = timestamps[begin_idx];
+    uint64_t end = timestamps[begin_idx + 1];
+
+    return end > begin ? end - begin : 0;
+  };
+
+  uint64_t duration_ns = get_pass_duration(0) + (pending.has_resolve ? get_pass_duration(2) : 0)
+      + (pending.is_accumulating ? get_pass_duration(4) : 0);
+  readback_buf.Unmap();
+
+  double sample_ms = static_cast<double>(duration_ns) / 1'000'000.0;
+  counters_.gpu_pass_ms = sample_ms;
+
+  if (pending.is_accumulating)
+    return;
+
+  std::optional<double>& cost_ms = gpu_costs_ms_[std::to_underlying(pending.quality)];
+
+  cost_ms
+      = cost_ms.has_value() ? std::lerp(cost_ms.value(), sample_ms, COST_SMOOTHING) : sample_ms;
+}
+
+void Viewport::prepare_new_frame(State& state, const gfx::Renderer& renderer,
+    const gfx::ShaderWarmup& warmup, gfx::CompileSandbox& sandbox)
+{
+  if (pending_timestamps_.has_value())
+    read_timestamps();
+
+  if (pending_accumulation_.has_value()) {
+    is_accumulating_ = pending_accumulation_.value();
+    pending_accumulation_ = std::nullopt;
+
+    // Accumulating may need an intermediate target, so it's applied like switching tiers
+    if (!pending_quality_.has_value())
+      pending_quality_ = quality_;
+  }
+
+  if (pending_quality_.has_value()) {
+    quality_ = pending_quality_.value();
+    apply_quality(renderer.device());
+
+    // Textures depend on the tier, so recreate them at the current size if nothing else will
+    if (!pending_resize_.has_value())
+      pending_resize_ = { texture_desc_.size.width, texture_desc_.size.height };
+
+    pending_quality_ = std::nullopt;
+  }
+
+  // Rethrows whatever the previous run failed with
+  if (run_task_.has_value() && run_task_->is_done())
+    std::exchange(run_task_, std::nullopt)->get();
+
+  // Requests made while the previous run is still checked or compiling wait for it, and only
+  // the newest one is kept. Code that isn't compiled yet goes through the sandbox first
+  if (pending_run_request_.has_value() && !run_task_.has_value() && !pending_check_) {
+    std::string code = std::exchange(pending_run_request_, std::nullopt).value();
+
+    if (module_cache_.contains(hash::fnv1a(code)) || warmup.find(code) != nullptr)
+      run_task_ = run(std::move(code), renderer, warmup);
+    else
+      pending_check_ = sandbox.submit(std::move(code));
+  }
+
+  if (pending_check_ && pending_check_->is_done()) {
+    auto check = std::exchange(pending_check_, nullptr);
+
+    // Dropped if a newer request came in while it was being checked. Code the helper found
+    // valid reuses its diagnostics, rather than waiting for the device to report them again
+    if (!pending_run_request_.has_value()) {
+      const gfx::CompileSandbox::Result& checked = check->result();
+
+      if (checked.status == gfx::CompileSandbox::Result::Status::Valid) {
+        run_task_ = run(check->code(), renderer, warmup, checked.diagnostics);
+      } else if (checked.should_compile()) {
+        run_task_ = run(check->code(), renderer, warmup);
+      } else {
+        diagnostics_ = checked.diagnostics;
+        run_result_ = { .module_key = hash::fnv1a(check->code()), .is_compiled = false };
+      }
+    }
+  }
+
+  // Modules may have been evicted by runs since the restore was requested
+  if (pending_restore_.has_value() && !run_task_.has_value()) {
+    if (uint64_t module_key = std::exchange(pending_restore_, std::nullopt).value();
+        module_cache_.contains(module_key)) {
+      run_task_ = switch_module(module_key, renderer.device());
     }
+  }
+
+  if (pending_override_update_) {
+    update_render_pipeline(renderer.device());
+    reset_accumulation();
+    pending_override_update_ = false;
+  }
 
-    pending_run_request_ = std::nullopt;
+  if (pending_accumulation_reset_) {
+    reset_accumulation();
+    pending_accumulation_reset_ = false;
   }
 
   if (pending_resize_.has_value()) {
@@ -236,22 +1304,37 @@ void Viewport::prepare_new_frame(State& state, const gfx::Renderer& renderer)
 
     // TODO: on initialization a couple of intermediary resizes occur, including
     //       a strange one to a resolution of 16×9 (yes, 16 pixels by 9 pixels)
-    texture_desc_.size.width = new_width;
-    texture_desc_.size.height = new_height;
-    texture_ = renderer.device().CreateTexture(&texture_desc_);
+    create_textures(renderer, new_width, new_height);
+
+    pending_resize_ = std::nullopt;
+  }
 
-    static const wgpu::TextureViewDescriptor VIEW_DESC = { .label = "viewport-view" };
+  // Shaders see the size they actually render at, which includes supersampling
+  const uint32_t supersampling = get_quality_tier(quality_).supersampling;
 
-    view_ = texture_.CreateView(&VIEW_DESC);
-    pass_color_attachment_.view = view_;
+  const std::array<float, 2> resolution = {
+    static_cast<float>(texture_desc_.size.width * supersampling),
+    static_cast<float>(texture_desc_.size.height * supersampling),
+  };
 
-    pending_resize_ = std::nullopt;
+  const std::array<float, 4> mouse = {
+    mouse_position_[0] * resolution[0],
+    mouse_position_[1] * resolution[1],
+    is_mouse_pressed_ ? 1.f : 0.f,
+    0.f,
+  };
+
+  // Shaders may react to the mouse, so anything accumulated with the previous state is stale
+  if (mouse != prev_unif_mouse_) {
+    prev_unif_mouse_ = mouse;
+    reset_accumulation();
   }
 
   Uniforms unif = {
     .time = static_cast<float>(SDL_GetTicksNS()) / 1'000'000'000.f,
-    .resolution
-    = { static_cast<float>(texture_.GetWidth()), static_cast<float>(texture_.GetHeight()) },
+    .resolution = resolution,
+    .mouse = mouse,
+    .sample_count = sample_count_,
   };
 
   renderer.queue().WriteBuffer(unif_buf_, 0, &unif, sizeof(Uniforms));
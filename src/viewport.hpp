@@ -2,17 +2,30 @@
 
 #include "aspect_ratio.hpp"
 #include "assets.hpp"
+#include "gfx/async.hpp"
 #include "gfx/compilation_diagnostic.hpp"
+#include "gfx/compile_sandbox.hpp"
 #include "gfx/frame_context.hpp"
+#include "gfx/literal_scrub.hpp"
+#include "gfx/memory_tracker.hpp"
+#include "gfx/noise_textures.hpp"
 #include "gfx/renderer.hpp"
+#include "gfx/shader_override.hpp"
+#include "gfx/shader_warmup.hpp"
+#include "project.hpp"
 #include "state.hpp"
 
 #include <webgpu/webgpu_cpp.h>
 
 #include <array>
+#include <cstddef>
 #include <cstdint>
+#include <deque>
+#include <memory>
 #include <optional>
+#include <string>
 #include <string_view>
+#include <unordered_map>
 #include <utility>
 #include <vector>
 
@@ -34,15 +47,111 @@ class Viewport {
     Resolution,
   };
 
+  /// Trades bandwidth and memory for precision and smoother edges. Every tier above
+  /// `Standard` renders into an intermediate target, which is resolved into the displayed
+  /// texture. The GUI always samples the displayed texture, so it's unaffected by the tier.
+  enum class Quality : int {
+    Standard,
+    High,
+    Supersampled,
+    Maximum,
+    Count,
+  };
+
+  static constexpr size_t QUALITY_COUNT = static_cast<size_t>(Quality::Count);
+
+  struct QualityTier {
+    std::string_view name;
+    std::string_view description;
+    /// Format the fragment shader renders into. Undefined means rendering directly into the
+    /// displayed texture, which uses the surface's 8-bit format.
+    wgpu::TextureFormat format = wgpu::TextureFormat::Undefined;
+    /// Rendered pixels per displayed pixel, along each axis.
+    uint32_t supersampling = 1;
+  };
+
+  static constexpr std::array<QualityTier, QUALITY_COUNT> QUALITY_TIERS = { {
+      { "Standard", "8-bit unorm, 1×1", wgpu::TextureFormat::Undefined, 1 },
+      { "High", "rgba16float, 1×1", wgpu::TextureFormat::RGBA16Float, 1 },
+      { "Supersampled", "rgba16float, 2×2", wgpu::TextureFormat::RGBA16Float, 2 },
+      { "Maximum", "rgba32float, 2×2", wgpu::TextureFormat::RGBA32Float, 2 },
+  } };
+
+  /// What a quality tier costs at the current size.
+  struct QualityCost {
+    /// Time spent rendering and resolving on the GPU, averaged over recent frames. Only
+    /// available once the tier has been used, and if the device supports timestamp queries.
+    std::optional<double> gpu_ms;
+    /// Estimated size of the intermediate target. Zero if the tier renders directly.
+    uint64_t target_size = 0;
+  };
+
+  /// Measurements taken since they were last taken out. Empty if nothing was measured.
+  struct Counters {
+    /// From a run request being picked up to its render pipeline being ready.
+    std::optional<double> compile_ms;
+    /// Latest raw GPU time of the viewport's passes, unlike the averaged quality costs.
+    std::optional<double> gpu_pass_ms;
+  };
+
+  /// How a run request ended.
+  struct RunResult {
+    /// Hash of the requested code.
+    uint64_t module_key = 0;
+    /// Set if the code compiled and the viewport draws with its module from now on.
+    bool is_compiled = false;
+  };
+
+  /// Mirrors the `Uniforms` struct declared in the fragment shader prefix. Fields are only
+  /// ever appended, so shaders declaring an older, shorter version still bind.
+  struct alignas(16) Uniforms {
+    float time = 0;
+    alignas(8) std::array<float, 2> resolution = {};
+    /// In rendered pixels. `xy` follows the cursor while the left button is held over the
+    /// viewport, and `z` is 1 while it is.
+    alignas(16) std::array<float, 4> mouse = {};
+    /// Frames blended into the accumulated image so far. Zero unless accumulating.
+    uint32_t sample_count = 0;
+  };
+
+  static_assert(sizeof(Uniforms) == 48, "Must match the size of the WGSL struct");
+
+  static constexpr uint32_t DEFAULT_ACCUMULATION_TARGET = 1024;
+
+  /// Noise textures and scrubbed literals are bound next to the uniforms, so every shader can
+  /// read them. The initial code is compiled right away, unless the journal recovered it after
+  /// a crash. Then it's run like any other request, which the sandbox checks first, and the
+  /// default shader is shown until it's done.
   Viewport(const Assets& assets, const State& state, const gfx::Renderer& renderer,
-      std::string_view initial_code);
+      const gfx::NoiseTextures& noise, const gfx::LiteralScrub& scrub,
+      std::string_view initial_code, bool is_initial_code_recovered);
 
+  /// Displayed texture, which can also be copied from. Its first mip level is the full image.
+  const wgpu::Texture& texture() const;
+  /// Mip level of the displayed texture that's closest to the width it's displayed at.
   const wgpu::TextureView& view() const;
   Mode mode() const;
   AspectRatio::Preset ratio_preset() const;
   uint32_t width() const;
   uint32_t height() const;
-  const std::vector<gfx::CompilationDiagnostic>& diagnostics() const;
+  Quality quality() const;
+  QualityCost quality_cost(Quality quality) const;
+  bool is_accumulating() const;
+  uint32_t accumulation_target() const;
+  /// Frames blended into the displayed image since the last reset.
+  uint32_t sample_count() const;
+  const gfx::CompilationLog& diagnostics() const;
+  /// Resets the counters, so each measurement is only reported once.
+  Counters take_counters();
+  /// Result of the latest run request that finished, once. Used by the edit history to restore
+  /// compiled modules later, and to tell when a reloaded file is on the screen.
+  std::optional<RunResult> take_run_result();
+  /// Overrides declared in the current fragment shader.
+  const std::vector<gfx::ShaderOverride>& overrides() const;
+  /// Other render pipelines that draw user fragment shaders can share this layout.
+  const wgpu::BindGroupLayout& bind_group_layout() const;
+  /// Note that the fragment state is owned by the viewport and should be replaced.
+  const wgpu::RenderPipelineDescriptor& render_pipeline_desc() const;
 
   void set_mode(Mode display_mode);
   void set_ratio_preset(AspectRatio::Preset preset);
@@ -55,20 +164,116 @@ class Viewport {
   /// Will use given width and height.
   void set_pending_resize(uint32_t new_width, uint32_t new_height);
   void set_pending_run_request(std::string&& new_code);
+  /// Switches back to a module compiled earlier, along with its pipelines if they're still
+  /// cached. Returns false if the module isn't cached anymore, so its code has to be run again.
+  bool set_pending_restore(uint64_t module_key);
+  /// Applied next frame. Unsetting the value goes back to the shader's own initializer.
+  void set_override_value(size_t idx, std::optional<double> value);
+  /// Like resizing, switching tiers recreates textures, so it's also applied next frame.
+  void set_pending_quality(Quality quality);
+  /// Picks the mip level returned by `view`, in physical pixels. In resolution mode, the
+  /// displayed texture has a mip chain, so the GUI samples a level close to its own size
+  /// instead of aliasing while minifying a much larger texture.
+  void set_displayed_width(float width);
+  /// Blends every frame into a history instead of replacing it, which is what progressive
+  /// renderers like path tracers need to converge. Rendering stops once the target sample
+  /// count is reached, and starts over whenever the code, size, overrides or mouse change.
+  void set_pending_accumulation(bool is_accumulating);
+  void set_accumulation_target(uint32_t target);
+  void set_pending_accumulation_reset();
+  /// Normalized position of the cursor over the viewport while the left button is held, or
+  /// empty once it's released. The last position is kept, just like Shadertoy does.
+  void set_mouse(std::optional<std::array<float, 2>> pressed_position);
 
-  void record(const gfx::FrameContext& frame_ctx) const;
-  /// Updates the fragment shader and creates the render pipeline.
+  /// Restores display settings saved in the project, ignoring any that are missing or invalid.
+  void load_parameters(const Project& project);
+  void store_parameters(Project& project) const;
+
+  /// Also records GPU timestamps for the current quality tier, unless the previous ones are
+  /// still being read back. Records nothing once accumulation has reached its target, since
+  /// the displayed texture keeps the converged image.
+  void record(const gfx::FrameContext& frame_ctx);
+  /// Specializes the fragment shader with the current override values and target format.
+  /// Specialized pipelines are cached, so switching back to one is instant.
   void update_render_pipeline(const wgpu::Device& device);
-  /// Updates uniform buffer and checks for a pending resize, applying it if it exists.
-  void prepare_new_frame(State& state, const gfx::Renderer& renderer);
+  /// Updates uniform buffer and checks for a pending resize, applying it if it exists. Run
+  /// requests reuse shaders that warm-up has already compiled. Otherwise they're checked by
+  /// the compile sandbox, then compiled over the next few frames while the previous shader
+  /// keeps rendering.
+  void prepare_new_frame(State& state, const gfx::Renderer& renderer,
+      const gfx::ShaderWarmup& warmup, gfx::CompileSandbox& sandbox);
 
   private:
-  struct Uniforms {
-    float time = 0;
-    alignas(8) std::array<float, 2> resolution = {};
+  /// Dragging an override's value creates a pipeline for every step, so old ones are evicted.
+  static constexpr size_t PIPELINE_CACHE_CAPACITY = 64;
+  /// Modules are kept around for going back in the edit history, which rarely goes far.
+  static constexpr size_t MODULE_CACHE_CAPACITY = 32;
+  /// Begin and end of the render, resolve and accumulate passes.
+  static constexpr uint32_t TIMESTAMP_COUNT = 6;
+  /// Weight of the newest sample in each tier's averaged GPU time.
+  static constexpr double COST_SMOOTHING = 0.1;
+  /// Keeps precision once thousands of samples have been averaged.
+  static constexpr wgpu::TextureFormat HISTORY_FORMAT = wgpu::TextureFormat::RGBA32Float;
+  /// Samples of the standard tier go through this while accumulating, since they can't be
+  /// blended into the displayed texture directly.
+  static constexpr wgpu::TextureFormat ACCUMULATION_SAMPLE_FORMAT
+      = wgpu::TextureFormat::RGBA16Float;
+
+  /// Fragment shader that compiled successfully, kept so switching back to its code is instant.
+  struct CachedModule {
+    wgpu::ShaderModule module;
+    /// As declared in the code, without any values picked in the GUI.
+    std::vector<gfx::ShaderOverride> overrides;
+    gfx::CompilationLog diagnostics;
   };
 
-  wgpu::Buffer unif_buf_;
+  /// Tier whose timestamps were recorded, and which passes they cover.
+  struct PendingTimestamps {
+    Quality quality = Quality::Standard;
+    bool has_resolve = false;
+    /// Accumulation adds a pass, so its times aren't representative of the tier.
+    bool is_accumulating = false;
+  };
+
+  static const QualityTier& get_quality_tier(Quality quality);
+
+  /// Format the fragment shader renders into. Undefined means rendering directly into the
+  /// displayed texture, which is only possible when the tier does and nothing is accumulated.
+  wgpu::TextureFormat get_target_format() const;
+  /// Called whenever the rendered frame changes, which makes the history stale.
+  void reset_accumulation();
+
+  /// Switches the render pipeline's target format and creates the matching resolve pipeline.
+  void apply_quality(const wgpu::Device& device);
+  /// Recreates the displayed texture and, if the tier needs one, the intermediate target. The
+  /// accumulation history is recreated too while accumulating.
+  void create_textures(const gfx::Renderer& renderer, uint32_t width, uint32_t height);
+  /// Maps the timestamps recorded last frame. Their frame has already been submitted.
+  void read_timestamps();
+  /// Averages the mapped timestamps into the cost of the tier they were recorded with.
+  void finish_reading_timestamps(wgpu::MapAsyncStatus status, wgpu::StringView message);
+  /// Downsamples each mip level down to the displayed one that isn't up to date yet.
+  void record_mips(const gfx::FrameContext& frame_ctx);
+
+  /// Points the fragment state at the current override values, and returns the key of the
+  /// specialized pipeline in the cache.
+  uint64_t prepare_pipeline_key();
+  void cache_pipeline(uint64_t cache_key, wgpu::RenderPipeline pipeline);
+  void cache_module(uint64_t module_key, CachedModule cached);
+  /// Like `update_render_pipeline`, but keeps the current pipeline until the new one is
+  /// created. Only used if the module and specialization are still the same by then.
+  gfx::async::Task<> create_render_pipeline(wgpu::Device device);
+  /// Makes a cached module current, keeping override values that still apply.
+  gfx::async::Task<> switch_module(uint64_t module_key, wgpu::Device device);
+  /// Compiles the code and switches to it once its pipeline is ready. Failing to compile
+  /// keeps the current pipeline and only updates the diagnostics. Code that's still in the
+  /// module cache isn't compiled again. Diagnostics are only given if the compile sandbox found
+  /// the code valid, and are used instead of the device's.
+  gfx::async::Task<> run(std::string code, const gfx::Renderer& renderer,
+      const gfx::ShaderWarmup& warmup,
+      std::optional<gfx::CompilationLog> checked_diagnostics = std::nullopt);
+
+  gfx::Tracked<wgpu::Buffer> unif_buf_;
 
   wgpu::BindGroupLayout render_pipeline_bgl_;
   wgpu::BindGroup render_pipeline_bg_;
@@ -77,13 +282,98 @@ class Viewport {
   wgpu::RenderPipelineDescriptor render_pipeline_desc_;
   wgpu::RenderPipeline render_pipeline_;
 
+  std::vector<gfx::ShaderOverride> overrides_;
+  /// Keys point into `overrides_`, so it must be rebuilt whenever that changes.
+  std::vector<wgpu::ConstantEntry> override_constants_;
+  /// Specialized pipelines, keyed by their module too. Pipelines of the same module share it,
+  /// so none have to parse the shader again.
+  std::unordered_map<uint64_t, wgpu::RenderPipeline> pipeline_cache_;
+  /// Oldest first, used for eviction.
+  std::deque<uint64_t> pipeline_cache_order_;
+  /// Fragment shaders that compiled successfully, keyed by the hash of their code.
+  std::unordered_map<uint64_t, CachedModule> module_cache_;
+  /// Oldest first, used for eviction.
+  std::deque<uint64_t> module_cache_order_;
+  /// Key of the current fragment shader module.
+  uint64_t module_key_ = 0;
+  /// Set once a run request finishes, until it's taken.
+  std::optional<RunResult> run_result_;
+
   wgpu::RenderPassColorAttachment pass_color_attachment_;
   wgpu::RenderPassDescriptor pass_desc_;
 
   wgpu::TextureDescriptor texture_desc_;
-  wgpu::Texture texture_;
+  gfx::Tracked<wgpu::Texture> texture_;
+  /// First mip level, which is what the viewport renders into.
   wgpu::TextureView view_;
 
+  /// One per level of the displayed texture.
+  std::vector<wgpu::TextureView> mip_views_;
+  /// Each renders the level after its index, from the level at its index.
+  std::vector<wgpu::BindGroup> downsample_bgs_;
+  wgpu::BindGroupLayout downsample_bgl_;
+  wgpu::Sampler downsample_sampler_;
+  wgpu::RenderPipeline downsample_pipeline_;
+  wgpu::RenderPassColorAttachment downsample_pass_color_attachment_;
+  wgpu::RenderPassDescriptor downsample_pass_desc_;
+  uint32_t displayed_mip_level_ = 0;
+  /// Levels holding the current image. Converged accumulation keeps the image, so only levels
+  /// it hasn't displayed yet are generated.
+  uint32_t valid_mip_count_ = 0;
+
+  /// Only exists if the current tier doesn't render directly into the displayed texture.
+  gfx::Tracked<wgpu::Texture> target_;
+  wgpu::TextureView target_view_;
+
+  wgpu::ShaderModule resolve_module_;
+  wgpu::BindGroupLayout resolve_bgl_;
+  wgpu::BindGroup resolve_bg_;
+  wgpu::RenderPipelineDescriptor resolve_pipeline_desc_;
+  wgpu::RenderPipeline resolve_pipeline_;
+  wgpu::RenderPassColorAttachment resolve_pass_color_attachment_;
+  wgpu::RenderPassDescriptor resolve_pass_desc_;
+
+  /// Ping-ponged, since a texture can't be read and rendered into by the same pass. Only exist
+  /// while accumulating.
+  std::array<gfx::Tracked<wgpu::Texture>, 2> history_;
+  std::array<wgpu::TextureView, 2> history_views_;
+  /// History holding the accumulated image. The other one is written next.
+  size_t history_idx_ = 0;
+  wgpu::BindGroupLayout accumulate_bgl_;
+  /// Each reads the history at its index, and is paired with rendering into the other one.
+  std::array<wgpu::BindGroup, 2> accumulate_bgs_;
+  /// Each resolves the history at its index into the displayed texture.
+  std::array<wgpu::BindGroup, 2> history_resolve_bgs_;
+  wgpu::RenderPipeline accumulate_pipeline_;
+  wgpu::RenderPassColorAttachment accumulate_pass_color_attachment_;
+  wgpu::RenderPassDescriptor accumulate_pass_desc_;
+
+  /// Null if the device doesn't support timestamp queries.
+  wgpu::QuerySet timestamp_query_set_;
+  gfx::Tracked<wgpu::Buffer> timestamp_resolve_buf_;
+  gfx::Tracked<wgpu::Buffer> timestamp_readback_buf_;
+  wgpu::PassTimestampWrites render_timestamp_writes_;
+  wgpu::PassTimestampWrites resolve_timestamp_writes_;
+  wgpu::PassTimestampWrites accumulate_timestamp_writes_;
+  /// Recorded last frame, and still have to be read back.
+  std::optional<PendingTimestamps> pending_timestamps_;
+  /// Timestamps that are currently being read back.
+  PendingTimestamps reading_timestamps_;
+  bool is_reading_timestamps_ = false;
+  std::array<std::optional<double>, QUALITY_COUNT> gpu_costs_ms_;
+  Counters counters_;
+
+  Quality quality_ = Quality::Standard;
+
+  bool is_accumulating_ = false;
+  uint32_t accumulation_target_ = DEFAULT_ACCUMULATION_TARGET;
+  uint32_t sample_count_ = 0;
+  /// Normalized, and only updated while the button is held.
+  std::array<float, 2> mouse_position_ = {};
+  bool is_mouse_pressed_ = false;
+  /// As written to the uniform buffer last frame, so any change resets accumulation.
+  std::array<float, 4> prev_unif_mouse_ = {};
+
   Mode mode_ = Mode::AspectRatio;
   AspectRatio::Preset ratio_preset_ = AspectRatio::Preset::e16_9;
   uint32_t width_ = 0;
@@ -96,8 +386,19 @@ class Viewport {
   /// Stores pending (combined) fragment shader that will be applied next frame. Populated
   /// while building UI for current frame.
   std::optional<std::string> pending_run_request_;
+  /// Key of a cached module to switch back to. Replaced by run requests, and the other way
+  /// around, so only the newest one applies.
+  std::optional<uint64_t> pending_restore_;
+  /// Run request that the compile sandbox is still checking. Only run once it passes.
+  std::shared_ptr<const gfx::CompileSandbox::Check> pending_check_;
+  /// Run request that's still compiling or creating its pipeline.
+  std::optional<gfx::async::Task<>> run_task_;
+  std::optional<Quality> pending_quality_;
+  std::optional<bool> pending_accumulation_;
+  bool pending_override_update_ = false;
+  bool pending_accumulation_reset_ = false;
 
-  std::vector<gfx::CompilationDiagnostic> diagnostics_;
+  gfx::CompilationLog diagnostics_;
 };
 
 }